@@ -51,6 +51,8 @@
 #define FLASH_WRITE_STATUS_REG_OPCODE   0x01
 #define FLASH_READ_STATUS_REG_OPCODE    0x05
 #define FLASH_READ_STATUS_HIGH_REG_OPCODE    0x35
+#define FLASH_PE_SUSPEND_OPCODE         0x75
+#define FLASH_PE_RESUME_OPCODE          0x7A
 
 #define FLASH_SEC_REG_READ_OPCODE       (0x48)
 #define FLASH_SEC_REG_PROGRAM_OPCODE    (0x42)
@@ -62,6 +64,67 @@
 #define FLASH_OP_TYPE_ERASE             0
 #define FLASH_OP_TYPE_WRITE             1
 
+/* erase granularity */
+#define FLASH_ERASE_SIZE_4K             0x1000
+#define FLASH_ERASE_SIZE_32K            0x8000
+#define FLASH_ERASE_SIZE_64K            0x10000
+
+/* block erases supported by a flash, sector erase is always supported */
+#define FLASH_ERASE_SUPPORT_32K         0x01
+#define FLASH_ERASE_SUPPORT_64K         0x02
+
+/* one erase command of an erase plan */
+struct flash_erase_step_t {
+    uint32_t offset;
+    /* FLASH_ERASE_SIZE_xxx */
+    uint32_t size;
+};
+
+/* state of an erase or write operation */
+enum flash_op_state_t {
+    FLASH_OP_STATE_IDLE,
+    FLASH_OP_STATE_RUNNING,
+    FLASH_OP_STATE_DONE,
+};
+
+struct flash_op_t;
+
+/* called in the context of flash_op_process when the operation is finished */
+typedef void (*flash_op_callback_t)(struct flash_op_t *op);
+
+/*
+ * Erase or write operation. It is split into sector erases and page programs,
+ * interrupts are served between them and during them (by suspending the flash)
+ * when flash_op_process is called with interrupt enabled.
+ */
+struct flash_op_t {
+    struct qspi_regs_t *qspi;
+    /* FLASH_OP_TYPE_ERASE or FLASH_OP_TYPE_WRITE */
+    uint8_t type;
+    /* @ref flash_op_state_t */
+    uint8_t state;
+    /* address and length of the part not started yet */
+    uint32_t offset;
+    uint32_t length;
+    const uint8_t *buffer;
+    /* FLASH_ERASE_SUPPORT_xxx of the flash, set when the operation is started */
+    uint8_t erase_support;
+    flash_op_callback_t callback;
+    void *arg;
+};
+
+/*
+ * Protection window. The flash is kept unprotected while a session is open, so a
+ * batch of writes and erases inside the window costs one status register write at
+ * open and one at close, instead of two for each call.
+ */
+struct flash_session_t {
+    struct qspi_regs_t *qspi;
+    uint32_t offset;
+    uint32_t size;
+    bool opened;
+};
+
 /* flash gen uuid type */
 enum flash_gen_uuid_type_t {
     FLASH_GEN_UUID_TYPE_40,
@@ -123,6 +186,27 @@ uint8_t FR_DRIVER_WRAPPER(flash_read)(struct qspi_regs_t *qspi, uint32_t offset,
 uint8_t FR_DRIVER_WRAPPER(flash_erase)(struct qspi_regs_t *qspi, uint32_t offset, uint32_t size);
 void flash_chip_erase(struct qspi_regs_t *qspi);
 
+/* flash_erase_plan */
+/* flash_erase_plan_check, available when FLASH_ERASE_PLAN_CHECK is enabled in driver_flash.c */
+uint32_t flash_erase_plan(uint32_t offset, uint32_t size, uint8_t support, struct flash_erase_step_t *steps, uint32_t max_steps);
+uint32_t flash_erase_plan_check(void);
+
+/* flash_session_open */
+/* flash_session_write */
+/* flash_session_erase */
+/* flash_session_close */
+uint8_t flash_session_open(struct flash_session_t *session, struct qspi_regs_t *qspi, uint32_t offset, uint32_t size);
+uint8_t flash_session_write(struct flash_session_t *session, uint32_t offset, uint32_t length, const uint8_t *buffer);
+uint8_t flash_session_erase(struct flash_session_t *session, uint32_t offset, uint32_t size);
+void flash_session_close(struct flash_session_t *session);
+
+/* flash_op_erase_init */
+/* flash_op_write_init */
+/* flash_op_process */
+void flash_op_erase_init(struct flash_op_t *op, struct qspi_regs_t *qspi, uint32_t offset, uint32_t size, flash_op_callback_t callback, void *arg);
+void flash_op_write_init(struct flash_op_t *op, struct qspi_regs_t *qspi, uint32_t offset, uint32_t length, const uint8_t *buffer, flash_op_callback_t callback, void *arg);
+bool flash_op_process(struct flash_op_t *op);
+
 /* flash_set_read_type */
 /* flash_set_write_type */
 /* flash_init_controller */
@@ -16,6 +16,13 @@
 */
 #include "fr30xx.h"
 
+/* set to 1 to build flash_erase_plan_check */
+#define FLASH_ERASE_PLAN_CHECK          0
+
+#if FLASH_ERASE_PLAN_CHECK
+#include <stdio.h>
+#endif
+
 #define FLASH_ID_PUYA_P25Q32            0x00166085
 #define FLASH_ID_PUYA_P25Q16            0x00156085
 #define FLASH_ID_PUYA_P25Q80            0x00146085
@@ -27,6 +34,15 @@
 #define FLASH_ID_GD_GD25WQ80E           0x001465c8
 #define FLASH_ID_GD_GD25LQ16E           0x001560C8
 
+/* status is read every FLASH_ENGINE_POLL_US while an erase or program is ongoing */
+#define FLASH_ENGINE_POLL_US            20
+/*
+ * an erase or program runs at least this long before it is suspended for pending
+ * interrupts, the flash makes no progress when it is suspended too often.
+ */
+#define FLASH_ENGINE_MIN_RUN_US         400
+#define FLASH_ENGINE_MIN_RUN_POLLS      (FLASH_ENGINE_MIN_RUN_US / FLASH_ENGINE_POLL_US)
+
 struct qspi_stig_reg_t sector_erase_cmd = {
     .enable_bank = 0,
     .dummy_cycles = 0,
@@ -183,6 +199,19 @@ struct qspi_stig_reg_t block_erase_cmd = {
     .opcode = 0xD8,
 };
 
+struct qspi_stig_reg_t block_32k_erase_cmd = {
+    .enable_bank = 0,
+    .dummy_cycles = 0,
+    .write_bytes = 0,
+    .enable_write = 0,
+    .addr_bytes = QSPI_STIG_ADDR_BYTES_3,
+    .enable_mode = 0,
+    .enable_cmd_addr = 1,
+    .read_bytes = 0,
+    .enable_read = 0,
+    .opcode = FLASH_BLOCK_32K_ERASE_OPCODE,
+};
+
 struct qspi_stig_reg_t chip_erase_cmd = {
     .enable_bank = 0,
     .dummy_cycles = 0,
@@ -313,6 +342,66 @@ struct qspi_stig_reg_t read_uid_cmd = {
     .opcode = 0x4b,
 };
 
+struct qspi_stig_reg_t pe_suspend_cmd = {
+    .enable_bank = 0,
+    .dummy_cycles = 0,
+    .write_bytes = 0,
+    .enable_write = 0,
+    .addr_bytes = 0,
+    .enable_mode = 0,
+    .enable_cmd_addr = 0,
+    .read_bytes = 0,
+    .enable_read = 0,
+    .opcode = FLASH_PE_SUSPEND_OPCODE,
+};
+
+struct qspi_stig_reg_t pe_resume_cmd = {
+    .enable_bank = 0,
+    .dummy_cycles = 0,
+    .write_bytes = 0,
+    .enable_write = 0,
+    .addr_bytes = 0,
+    .enable_mode = 0,
+    .enable_cmd_addr = 0,
+    .read_bytes = 0,
+    .enable_read = 0,
+    .opcode = FLASH_PE_RESUME_OPCODE,
+};
+
+/* erase and program of the flash can be suspended by 75h/7Ah */
+#define FLASH_CAP_SUSPEND               0x80
+
+/* capabilities of known flash, used by the erase/program engine */
+static const struct {
+    uint32_t flash_id;
+    uint8_t caps;
+} flash_caps_table[] = {
+    {FLASH_ID_PUYA_P25Q32,      FLASH_CAP_SUSPEND | FLASH_ERASE_SUPPORT_32K | FLASH_ERASE_SUPPORT_64K},
+    {FLASH_ID_PUYA_P25Q16,      FLASH_CAP_SUSPEND | FLASH_ERASE_SUPPORT_32K | FLASH_ERASE_SUPPORT_64K},
+    {FLASH_ID_PUYA_P25Q80,      FLASH_CAP_SUSPEND | FLASH_ERASE_SUPPORT_32K | FLASH_ERASE_SUPPORT_64K},
+    {FLASH_ID_PUYA_P25Q40,      FLASH_CAP_SUSPEND | FLASH_ERASE_SUPPORT_32K | FLASH_ERASE_SUPPORT_64K},
+    {FLASH_ID_XMC_XM25LU32,     FLASH_CAP_SUSPEND | FLASH_ERASE_SUPPORT_32K | FLASH_ERASE_SUPPORT_64K},
+    {FLASH_ID_XMC_XMQ25U80,     FLASH_CAP_SUSPEND | FLASH_ERASE_SUPPORT_32K | FLASH_ERASE_SUPPORT_64K},
+    {FLASH_ID_GIANTEC_GT25Q16A, FLASH_CAP_SUSPEND | FLASH_ERASE_SUPPORT_32K | FLASH_ERASE_SUPPORT_64K},
+    {FLASH_ID_GIANTEC_GT25Q80A, FLASH_CAP_SUSPEND | FLASH_ERASE_SUPPORT_32K | FLASH_ERASE_SUPPORT_64K},
+    {FLASH_ID_GD_GD25WQ80E,     FLASH_CAP_SUSPEND | FLASH_ERASE_SUPPORT_32K | FLASH_ERASE_SUPPORT_64K},
+    {FLASH_ID_GD_GD25LQ16E,     FLASH_CAP_SUSPEND | FLASH_ERASE_SUPPORT_32K | FLASH_ERASE_SUPPORT_64K},
+};
+
+/* erase or program command in flight, shared by all operations */
+static struct {
+    /* qspi of the command in flight, NULL when flash is idle */
+    struct qspi_regs_t *qspi;
+    /* the command in flight is suspended */
+    bool suspended;
+    /* id of the flash in QSPI0 and QSPI1, read when it's idle for the first time */
+    uint32_t flash_id[2];
+    /* capabilities of the flash in QSPI0 and QSPI1, looked up with flash_id */
+    uint8_t flash_caps[2];
+    /* operations and sessions holding the flash unprotected */
+    uint8_t unprotect_count;
+} flash_engine_env;
+
 static __RAM_CODE __attribute__((noinline)) void do_write(const uint8_t *src, uint8_t *dst, uint32_t length)
 {
     __asm (
@@ -969,67 +1058,600 @@ __RAM_CODE void flash_protect_bit_set(struct qspi_regs_t *qspi, uint8_t bits, ui
 }
 
 /************************************************************************************
- * @fn      flash_write.
+ * @fn      flash_engine_caps
  *
- * @brief   flash write.
+ * @brief   look up capabilities of a flash, unknown flash is erased by sectors and
+ *          never suspended. Should not be called while an erase or program is ongoing,
+ *          the table is stored in flash.
  *
- * @param   qspi: qspi controller base address.
- *          offset: flash operation address offset.
- *          length: buffer length to be write from flash section.
- *          buffer: pointer to buffer which will store data.
+ * @return  FLASH_ERASE_SUPPORT_xxx and FLASH_CAP_SUSPEND
  */
-__RAM_CODE __attribute__((noinline)) uint8_t FR_DRIVER_WRAPPER(flash_write)(struct qspi_regs_t *qspi, uint32_t offset, uint32_t length, const uint8_t *buffer)
+static uint8_t flash_engine_caps(uint32_t flash_id)
 {
-    uint32_t page_left;
-    uint32_t dac_addr_offset;
-    uint8_t *dst;
+    for (uint32_t i=0; i<sizeof(flash_caps_table)/sizeof(flash_caps_table[0]); i++) {
+        if (flash_caps_table[i].flash_id == flash_id) {
+            return flash_caps_table[i].caps;
+        }
+    }
 
-    if(length == 0) {
-        return 0;
+    return 0;
+}
+
+/************************************************************************************
+ * @fn      flash_erase_step_size
+ *
+ * @brief   size of the largest erase command which can be used at offset.
+ *
+ * @param   offset: start of the range, aligned to 4KB.
+ *          size: size of the range, multiple of 4KB and not 0.
+ *          support: FLASH_ERASE_SUPPORT_xxx of the flash.
+ *
+ * @return  FLASH_ERASE_SIZE_xxx
+ */
+static __RAM_CODE uint32_t flash_erase_step_size(uint32_t offset, uint32_t size, uint8_t support)
+{
+    if ((support & FLASH_ERASE_SUPPORT_64K)
+            && ((offset & (FLASH_ERASE_SIZE_64K - 1)) == 0)
+            && (size >= FLASH_ERASE_SIZE_64K)) {
+        return FLASH_ERASE_SIZE_64K;
     }
-    
-    if ((uint32_t)qspi == FLASH_QSPI_BASE) {
-        dac_addr_offset = FLASH_DAC_BASE;
+    if ((support & FLASH_ERASE_SUPPORT_32K)
+            && ((offset & (FLASH_ERASE_SIZE_32K - 1)) == 0)
+            && (size >= FLASH_ERASE_SIZE_32K)) {
+        return FLASH_ERASE_SIZE_32K;
+    }
+    return FLASH_ERASE_SIZE_4K;
+}
+
+/************************************************************************************
+ * @fn      flash_erase_plan
+ *
+ * @brief   split an erase range into the largest aligned 64KB and 32KB block erases
+ *          and 4KB sector erases, the same commands are used by flash_erase.
+ *
+ * @param   offset: start of the range, aligned down to 4KB.
+ *          size: size of the range, 0 means 4KB.
+ *          support: FLASH_ERASE_SUPPORT_xxx of the flash.
+ *          steps: buffer to store the commands, can be NULL to count them only.
+ *          max_steps: capacity of steps.
+ *
+ * @return  number of commands needed by the whole range, may be larger than max_steps.
+ */
+uint32_t flash_erase_plan(uint32_t offset, uint32_t size, uint8_t support, struct flash_erase_step_t *steps, uint32_t max_steps)
+{
+    uint32_t count = 0;
+    uint32_t step;
+
+    if(size == 0) {
+        size = FLASH_ERASE_SIZE_4K;
     }
-    else if ((uint32_t)qspi == DSP_QSPI_BASE) {
-        dac_addr_offset = DSP_FLASH_DAC_BASE;
+    offset &= ~(FLASH_ERASE_SIZE_4K - 1);
+    size = (size + FLASH_ERASE_SIZE_4K - 1) & ~(FLASH_ERASE_SIZE_4K - 1);
+
+    while(size) {
+        step = flash_erase_step_size(offset, size, support);
+        if ((steps != NULL) && (count < max_steps)) {
+            steps[count].offset = offset;
+            steps[count].size = step;
+        }
+        count++;
+        offset += step;
+        size -= step;
+    }
+
+    return count;
+}
+
+#if FLASH_ERASE_PLAN_CHECK
+/* check one plan: steps are contiguous, aligned to their size, supported and cover the range */
+static bool flash_erase_plan_check_one(uint32_t offset, uint32_t size, uint8_t support, uint32_t expected_count)
+{
+    struct flash_erase_step_t steps[40];
+    uint32_t count, start, end;
+
+    count = flash_erase_plan(offset, size, support, steps, 40);
+    if ((count > 40) || (count != flash_erase_plan(offset, size, support, NULL, 0))) {
+        return false;
+    }
+    if ((expected_count != 0) && (count != expected_count)) {
+        return false;
+    }
+
+    if (size == 0) {
+        size = FLASH_ERASE_SIZE_4K;
+    }
+    start = offset & ~(FLASH_ERASE_SIZE_4K - 1);
+    end = start + ((size + FLASH_ERASE_SIZE_4K - 1) & ~(FLASH_ERASE_SIZE_4K - 1));
+    for (uint32_t i=0; i<count; i++) {
+        if ((steps[i].offset != start) || (steps[i].offset & (steps[i].size - 1))) {
+            return false;
+        }
+        if (((steps[i].size == FLASH_ERASE_SIZE_64K) && ((support & FLASH_ERASE_SUPPORT_64K) == 0))
+                || ((steps[i].size == FLASH_ERASE_SIZE_32K) && ((support & FLASH_ERASE_SUPPORT_32K) == 0))) {
+            return false;
+        }
+        start += steps[i].size;
+    }
+
+    return start == end;
+}
+
+/************************************************************************************
+ * @fn      flash_erase_plan_check
+ *
+ * @brief   check flash_erase_plan with fixed cases and pseudo random ranges, no flash
+ *          is accessed.
+ *
+ * @return  number of failed cases.
+ */
+uint32_t flash_erase_plan_check(void)
+{
+    const uint8_t all = FLASH_ERASE_SUPPORT_32K | FLASH_ERASE_SUPPORT_64K;
+    uint32_t failed = 0;
+    uint32_t seed = 1;
+
+    /* 5 sectors, 32KB block, three 64KB blocks, 3 sectors */
+    failed += !flash_erase_plan_check_one(0x3000, 0x40000, all, 12);
+    /* sector erase only */
+    failed += !flash_erase_plan_check_one(0x3000, 0x10000, 0, 16);
+    /* 32KB blocks only */
+    failed += !flash_erase_plan_check_one(0x10000, 0x20000, FLASH_ERASE_SUPPORT_32K, 4);
+    /* size 0 and unaligned ranges are handled like flash_erase */
+    failed += !flash_erase_plan_check_one(0x12345, 0, all, 1);
+    failed += !flash_erase_plan_check_one(0x1800, 0x1000, all, 1);
+    failed += !flash_erase_plan_check_one(0x0, 0x1, all, 1);
+
+    for (uint32_t i=0; i<10000; i++) {
+        uint32_t offset, size;
+
+        seed = seed * 1103515245 + 12345;
+        offset = (seed >> 8) & 0x1fffff;
+        seed = seed * 1103515245 + 12345;
+        /* up to 33 sectors */
+        size = (seed >> 8) & 0x1ffff;
+        failed += !flash_erase_plan_check_one(offset, size, (uint8_t)(i & all), 0);
+    }
+
+    printf("flash_erase_plan_check: %d failed\r\n", failed);
+
+    return failed;
+}
+#endif  // FLASH_ERASE_PLAN_CHECK
+
+/************************************************************************************
+ * @fn      flash_engine_irq_pending
+ *
+ * @brief   check whether any interrupt is waiting for the current operation.
+ */
+static __RAM_CODE bool flash_engine_irq_pending(void)
+{
+    return (SCB->ICSR & (SCB_ICSR_ISRPENDING_Msk | SCB_ICSR_PENDSTSET_Msk)) != 0;
+}
+
+/************************************************************************************
+ * @fn      flash_engine_wait
+ *
+ * @brief   wait for the command in flight to finish, should be called with interrupt
+ *          disabled.
+ *
+ * @param   yield: stop waiting when any interrupt is pending.
+ *
+ * @return  true: the command is finished. false: the command is suspended, or it is
+ *          running in a flash which is not used by XIP.
+ */
+static __RAM_CODE __attribute__((noinline)) bool flash_engine_wait(bool yield)
+{
+    struct qspi_regs_t *qspi = flash_engine_env.qspi;
+    uint32_t polls = 0;
+    uint8_t status;
+
+    while(1) {
+        system_delay_us(FLASH_ENGINE_POLL_US);
+        qspi_stig_cmd(qspi, read_status_cmd, QSPI_STIG_CMD_READ, 1, &status);
+        if((status & 0x03) == 0) {
+            flash_engine_env.qspi = NULL;
+            return true;
+        }
+
+        if(yield && (++polls >= FLASH_ENGINE_MIN_RUN_POLLS) && flash_engine_irq_pending()) {
+            if ((uint32_t)qspi != FLASH_QSPI_BASE) {
+                /* code is not executed from this flash, interrupts can be served directly */
+                return false;
+            }
+            if (flash_engine_env.flash_caps[0] & FLASH_CAP_SUSPEND) {
+                qspi_stig_cmd(qspi, pe_suspend_cmd, QSPI_STIG_CMD_EXE, 0, 0);
+                do {
+                    system_delay_us(FLASH_ENGINE_POLL_US);
+                    qspi_stig_cmd(qspi, read_status_cmd, QSPI_STIG_CMD_READ, 1, &status);
+                } while(status & 0x01);
+                flash_engine_env.suspended = true;
+                return false;
+            }
+        }
+    }
+}
+
+/************************************************************************************
+ * @fn      flash_engine_unprotect
+ *
+ * @brief   take a reference on the unprotected state, the protection bits are cleared
+ *          by the first holder. Should be called with interrupt and cache disabled.
+ */
+static __RAM_CODE void flash_engine_unprotect(void)
+{
+    if (flash_engine_env.unprotect_count++ == 0) {
+        flash_protect_bit_set(QSPI0, 0x00, 0xff, true, false);
+    }
+}
+
+/************************************************************************************
+ * @fn      flash_engine_protect
+ *
+ * @brief   release a reference on the unprotected state, the protection bits are set
+ *          again by the last holder. Should be called with interrupt and cache disabled.
+ */
+static __RAM_CODE void flash_engine_protect(void)
+{
+    if (--flash_engine_env.unprotect_count == 0) {
+        flash_protect_bit_set(QSPI0, 0x1f, 0xff, true, false);
+    }
+}
+
+/************************************************************************************
+ * @fn      flash_engine_issue
+ *
+ * @brief   start the next sector erase or page program of an operation.
+ */
+static __RAM_CODE void flash_engine_issue(struct flash_op_t *op)
+{
+    struct qspi_regs_t *qspi = op->qspi;
+    uint32_t size;
+    uint8_t *dst;
+
+    if (op->type == FLASH_OP_TYPE_ERASE) {
+        size = flash_erase_step_size(op->offset, op->length, op->erase_support);
+        qspi_stig_cmd(qspi, write_enable_cmd, QSPI_STIG_CMD_EXE, 0, 0);
+        __QSPI_CMD_ADDRESS_SET(qspi, op->offset);
+        if (size == FLASH_ERASE_SIZE_64K) {
+            qspi_stig_cmd(qspi, block_erase_cmd, QSPI_STIG_CMD_EXE, 0, 0);
+        }
+        else if (size == FLASH_ERASE_SIZE_32K) {
+            qspi_stig_cmd(qspi, block_32k_erase_cmd, QSPI_STIG_CMD_EXE, 0, 0);
+        }
+        else {
+            qspi_stig_cmd(qspi, sector_erase_cmd, QSPI_STIG_CMD_EXE, 0, 0);
+        }
     }
     else {
-        return 0;
+        size = 0x100 - (op->offset & 0xff);
+        if (op->length < size) {
+            size = op->length;
+        }
+        if ((uint32_t)qspi == FLASH_QSPI_BASE) {
+            dst = (void *)(op->offset | FLASH_DAC_BASE);
+        }
+        else {
+            dst = (void *)(op->offset | DSP_FLASH_DAC_BASE);
+        }
+        do_write(op->buffer, dst, size);
+        op->buffer += size;
     }
-    
-    page_left = 0x100 - (offset & 0xff);
-    if(length < page_left) {
-        page_left = length;
+
+    flash_engine_env.qspi = qspi;
+    op->offset += size;
+    op->length -= size;
+}
+
+/************************************************************************************
+ * @fn      flash_op_erase_init.
+ *
+ * @brief   prepare an erase operation, the operation is executed by flash_op_process.
+ *          The range is erased by the commands planned by flash_erase_plan.
+ *
+ * @param   op: operation to be initialized.
+ *          qspi: qspi controller base address.
+ *          offset: flash operation address offset, aligned to 4KB by this function.
+ *          size: erase the size of the flash, 0 means 4KB.
+ *          callback: called when the operation is finished, can be NULL.
+ *          arg: reserved for user.
+ */
+void flash_op_erase_init(struct flash_op_t *op, struct qspi_regs_t *qspi, uint32_t offset, uint32_t size, flash_op_callback_t callback, void *arg)
+{
+    if(size == 0) {
+        size = 0x1000;
     }
-    
-    dst = (void *)(offset | dac_addr_offset);
+
+    op->qspi = qspi;
+    op->type = FLASH_OP_TYPE_ERASE;
+    op->state = FLASH_OP_STATE_IDLE;
+    op->offset = offset & 0xFFFFF000;
+    op->length = (size + 0xFFF) & 0xFFFFF000;
+    op->buffer = NULL;
+    op->erase_support = 0;
+    op->callback = callback;
+    op->arg = arg;
+}
+
+/************************************************************************************
+ * @fn      flash_op_write_init.
+ *
+ * @brief   prepare a write operation, the operation is executed by flash_op_process.
+ *
+ * @param   op: operation to be initialized.
+ *          qspi: qspi controller base address.
+ *          offset: flash operation address offset.
+ *          length: buffer length to be write from flash section.
+ *          buffer: data to be written, should be kept until the operation is finished.
+ *          callback: called when the operation is finished, can be NULL.
+ *          arg: reserved for user.
+ */
+void flash_op_write_init(struct flash_op_t *op, struct qspi_regs_t *qspi, uint32_t offset, uint32_t length, const uint8_t *buffer, flash_op_callback_t callback, void *arg)
+{
+    op->qspi = qspi;
+    op->type = FLASH_OP_TYPE_WRITE;
+    op->state = FLASH_OP_STATE_IDLE;
+    op->offset = offset;
+    op->length = length;
+    op->buffer = buffer;
+    op->erase_support = 0;
+    op->callback = callback;
+    op->arg = arg;
+}
+
+/************************************************************************************
+ * @fn      flash_op_process.
+ *
+ * @brief   execute an erase or write operation. When it is called with interrupt
+ *          enabled, it returns as soon as an interrupt is pending, with the flash idle
+ *          or suspended so that interrupt handlers can be executed from flash. The
+ *          operation is continued by the next call. When it is called with interrupt
+ *          disabled or from an interrupt handler, the whole operation is finished in
+ *          this call.
+ *          Commands of other operations in flight are finished first, so operations
+ *          started in different tasks are serialized.
+ *
+ * @param   op: operation initialized by flash_op_erase_init or flash_op_write_init.
+ *
+ * @return  true when the operation is finished.
+ */
+__RAM_CODE __attribute__((noinline)) bool flash_op_process(struct flash_op_t *op)
+{
+    /*
+     * interrupts can't be served when they are masked by caller, or when it is called
+     * from an interrupt handler which blocks the pending ones.
+     */
+    bool yield = (__get_PRIMASK() == 0) && (__get_BASEPRI() == 0) && (__get_IPSR() == 0);
+    bool progressed = false;
+    bool xip;
+    uint8_t id;
+
+    if (op->state == FLASH_OP_STATE_DONE) {
+        return true;
+    }
+    if (((uint32_t)op->qspi != FLASH_QSPI_BASE) && ((uint32_t)op->qspi != DSP_QSPI_BASE)) {
+        op->length = 0;
+        op->state = FLASH_OP_STATE_DONE;
+        if (op->callback != NULL) {
+            op->callback(op);
+        }
+        return true;
+    }
+
     GLOBAL_INT_DISABLE();
 
-    if ((uint32_t)qspi == FLASH_QSPI_BASE) {
+    xip = ((uint32_t)op->qspi == FLASH_QSPI_BASE) || ((uint32_t)flash_engine_env.qspi == FLASH_QSPI_BASE);
+    if (xip) {
         system_cache_disable();
     }
-    flash_protect_bit_set(QSPI0, 0x00, 0xFF, true, false);
-    
-    while(length) {
-        do_write(buffer, dst, page_left);
-        buffer += page_left;
-        dst += page_left;
-        flash_wait_wip_clear(qspi);
+    if (flash_engine_env.suspended) {
+        flash_engine_env.suspended = false;
+        qspi_stig_cmd(flash_engine_env.qspi, pe_resume_cmd, QSPI_STIG_CMD_EXE, 0, 0);
+    }
+
+    while(1) {
+        if (flash_engine_env.qspi != NULL) {
+            if (flash_engine_wait(yield) == false) {
+                break;
+            }
+            progressed = true;
+        }
 
-        length -= page_left;
-        page_left = (length > 256) ? 256 : length;
+        if (op->state == FLASH_OP_STATE_IDLE) {
+            id = ((uint32_t)op->qspi == FLASH_QSPI_BASE) ? 0 : 1;
+            if (flash_engine_env.flash_id[id] == 0) {
+                flash_engine_env.flash_id[id] = flash_read_id(op->qspi);
+                flash_engine_env.flash_caps[id] = flash_engine_caps(flash_engine_env.flash_id[id]);
+            }
+            op->erase_support = flash_engine_env.flash_caps[id] & (FLASH_ERASE_SUPPORT_32K | FLASH_ERASE_SUPPORT_64K);
+            flash_engine_unprotect();
+            op->state = FLASH_OP_STATE_RUNNING;
+        }
+
+        if (op->length == 0) {
+            flash_engine_protect();
+            op->state = FLASH_OP_STATE_DONE;
+            break;
+        }
+
+        /* at least one command is finished or issued in each call, so progress is guaranteed */
+        if (yield && progressed && flash_engine_irq_pending()) {
+            break;
+        }
+
+        flash_engine_issue(op);
+        progressed = true;
     }
-    
-    flash_protect_bit_set(QSPI0, 0x1f, 0xff, true, false);
-    if ((uint32_t)qspi == FLASH_QSPI_BASE) {
+
+    if (xip) {
         system_cache_enable(true);
-    }    
+    }
+    GLOBAL_INT_RESTORE();
+
+    if ((op->state == FLASH_OP_STATE_DONE) && (op->callback != NULL)) {
+        op->callback(op);
+    }
+
+    return op->state == FLASH_OP_STATE_DONE;
+}
+
+/************************************************************************************
+ * @fn      flash_session_open.
+ *
+ * @brief   open a protection window, the flash is kept unprotected until the session
+ *          is closed, so writes and erases inside it don't rewrite the status register
+ *          each time. Status register is written in volatile mode.
+ *
+ * @param   session: session to be opened.
+ *          qspi: qspi controller base address.
+ *          offset: start of the window.
+ *          size: size of the window.
+ *
+ * @return  0: success, 1: the session is already opened.
+ */
+__RAM_CODE __attribute__((noinline)) uint8_t flash_session_open(struct flash_session_t *session, struct qspi_regs_t *qspi, uint32_t offset, uint32_t size)
+{
+    /* each opened session holds one unprotect reference, which is released only once */
+    if (session->opened) {
+        return 1;
+    }
+
+    session->qspi = qspi;
+    session->offset = offset;
+    session->size = size;
+    session->opened = true;
+
+    /*
+     * an erase or program in flight always holds a reference, so the status register
+     * is only written when the flash is idle.
+     */
+    GLOBAL_INT_DISABLE();
+    system_cache_disable();
+    flash_engine_unprotect();
+    system_cache_enable(true);
+    GLOBAL_INT_RESTORE();
+
+    return 0;
+}
+
+/************************************************************************************
+ * @fn      flash_session_close.
+ *
+ * @brief   close a protection window, the flash is protected again when no other
+ *          session or operation is ongoing.
+ *
+ * @param   session: session opened by flash_session_open.
+ */
+__RAM_CODE __attribute__((noinline)) void flash_session_close(struct flash_session_t *session)
+{
+    if (session->opened == false) {
+        return;
+    }
+    session->opened = false;
+
+    GLOBAL_INT_DISABLE();
+    system_cache_disable();
+    flash_engine_protect();
+    system_cache_enable(true);
     GLOBAL_INT_RESTORE();
+}
+
+/************************************************************************************
+ * @fn      flash_session_contain
+ *
+ * @brief   check whether a range is inside the window of an opened session.
+ */
+static bool flash_session_contain(struct flash_session_t *session, struct qspi_regs_t *qspi, uint32_t offset, uint32_t length)
+{
+    if ((session->opened == false) || (session->qspi != qspi) || (offset < session->offset)) {
+        return false;
+    }
+
+    return (length <= session->size) && ((offset - session->offset) <= (session->size - length));
+}
+
+/************************************************************************************
+ * @fn      flash_session_write.
+ *
+ * @brief   write flash inside a protection window, interrupts are served as in flash_write.
+ *
+ * @param   session: session opened by flash_session_open.
+ *          offset: flash operation address offset.
+ *          length: buffer length to be write from flash section.
+ *          buffer: pointer to buffer which will store data.
+ *
+ * @return  0: success, 1: the range is outside of the window.
+ */
+uint8_t flash_session_write(struct flash_session_t *session, uint32_t offset, uint32_t length, const uint8_t *buffer)
+{
+    struct flash_op_t op;
+
+    if (flash_session_contain(session, session->qspi, offset, length) == false) {
+        return 1;
+    }
+    if(length == 0) {
+        return 0;
+    }
+
+    flash_op_write_init(&op, session->qspi, offset, length, buffer, NULL, NULL);
+    while(flash_op_process(&op) == false);
+
+    return 0;
+}
+
+/************************************************************************************
+ * @fn      flash_session_erase.
+ *
+ * @brief   erase flash inside a protection window, interrupts are served as in flash_erase.
+ *
+ * @param   session: session opened by flash_session_open.
+ *          offset: flash operation address offset, aligned to 4KB.
+ *          size: erase the size of the flash, 0 means 4KB.
+ *
+ * @return  0: success, 1: the range is outside of the window.
+ */
+uint8_t flash_session_erase(struct flash_session_t *session, uint32_t offset, uint32_t size)
+{
+    struct flash_op_t op;
+
+    flash_op_erase_init(&op, session->qspi, offset, size, NULL, NULL);
+    if (flash_session_contain(session, session->qspi, op.offset, op.length) == false) {
+        return 1;
+    }
+
+    while(flash_op_process(&op) == false);
 
     return 0;
 }
 
+/************************************************************************************
+ * @fn      flash_write.
+ *
+ * @brief   flash write, interrupts are served between pages and during programming
+ *          when it is called with interrupt enabled.
+ *
+ * @param   qspi: qspi controller base address.
+ *          offset: flash operation address offset.
+ *          length: buffer length to be write from flash section.
+ *          buffer: pointer to buffer which will store data.
+ *
+ * @return  0: success, 1: failed.
+ */
+__RAM_CODE __attribute__((noinline)) uint8_t FR_DRIVER_WRAPPER(flash_write)(struct qspi_regs_t *qspi, uint32_t offset, uint32_t length, const uint8_t *buffer)
+{
+    struct flash_session_t session;
+    uint8_t result;
+
+    if(length == 0) {
+        return 0;
+    }
+
+    flash_session_open(&session, qspi, offset, length);
+    result = flash_session_write(&session, offset, length, buffer);
+    flash_session_close(&session);
+
+    return result;
+}
+
 /************************************************************************************
  * @fn      flash_read.
  *
@@ -1055,46 +1677,32 @@ uint8_t FR_DRIVER_WRAPPER(flash_read)(struct qspi_regs_t *qspi, uint32_t offset,
 /************************************************************************************
  * @fn      flash_erase.
  *
- * @brief   flash erase.
+ * @brief   flash erase, aligned 64KB and 32KB blocks are erased by block erase when
+ *          supported by the flash. Interrupts are served between commands and during
+ *          erasing when it is called with interrupt enabled.
  *
  * @param   qspi: qspi controller base address.
  *          offset: flash operation address offset.
  *          size: erase the size of the flash.
+ *
+ * @return  0: success, 1: failed.
  */
 __RAM_CODE __attribute__((noinline)) uint8_t FR_DRIVER_WRAPPER(flash_erase)(struct qspi_regs_t *qspi, uint32_t offset, uint32_t size)
 {
+    struct flash_session_t session;
+    uint8_t result;
+
     if(size == 0) {
         size = 0x1000;
     }
-    
     offset &= 0xFFFFF000;
-    GLOBAL_INT_DISABLE();
+    size = (size + 0xFFF) & 0xFFFFF000;
 
-    if ((uint32_t)qspi == FLASH_QSPI_BASE) {
-        system_cache_disable();
-    }
-    flash_protect_bit_set(QSPI0, 0x00, 0xff, true, false);
-    
-    while(size) {
-        qspi_stig_cmd(qspi, write_enable_cmd, QSPI_STIG_CMD_EXE, 0, 0);
-        __QSPI_CMD_ADDRESS_SET(qspi, offset);
-        qspi_stig_cmd(qspi, sector_erase_cmd, QSPI_STIG_CMD_EXE, 0, 0);
-        flash_wait_wip_clear(qspi);
+    flash_session_open(&session, qspi, offset, size);
+    result = flash_session_erase(&session, offset, size);
+    flash_session_close(&session);
 
-        offset += 0x1000;
-        if(size > 0x1000)
-            size -= 0x1000;
-        else {
-            size = 0;
-        }
-    }
-    flash_protect_bit_set(QSPI0, 0x1f, 0xff, true, false);
-    if ((uint32_t)qspi == FLASH_QSPI_BASE) {
-        system_cache_enable(true);
-    }    
-    GLOBAL_INT_RESTORE();
-    
-    return 0;
+    return result;
 }
 
 /************************************************************************************
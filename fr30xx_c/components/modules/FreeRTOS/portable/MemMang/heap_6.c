@@ -5,6 +5,7 @@
 #include "fr30xx.h"
 #include "FreeRTOS.h"
 #include "heap.h"
+#include "heap_slab.h"
 
 #if 0
 void * pvPortMalloc( size_t xWantedSize )
@@ -52,12 +53,12 @@ void * pvPortMalloc( size_t xWantedSize )
         heap_mem_init(HEAP_TYPE_SRAM_BLOCK, (void *)ucHeap, configTOTAL_HEAP_SIZE);
     }
     
-    return heap_mem_alloc(HEAP_TYPE_SRAM_BLOCK, xWantedSize);
+    return heap_slab_alloc(HEAP_TYPE_SRAM_BLOCK, xWantedSize);
 }
 
 void vPortFree( void * pv )
 {
-    heap_mem_free(pv);
+    heap_slab_free(pv);
 }
 
 void * pvPortRealloc ( void *pv, size_t xNewSize )
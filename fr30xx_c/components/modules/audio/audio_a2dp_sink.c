@@ -10,6 +10,18 @@
 
 #define TONE_RAW_DATA_BUFFER_SIZE           128
 
+/* received frames are stored in preallocated pool, larger frames are allocated from heap */
+#define A2DP_SINK_FRAME_POOL_COUNT          (DECODER_DATA_MAX_THD + 4)
+#define A2DP_SINK_FRAME_POOL_LENGTH         1024
+
+/*
+ * follow clock drift between a2dp source and local audio hardware by resampling on MCU.
+ * Every stream is resampled when enabled, even if the sample rates are the same.
+ * Otherwise drift is handled by dropping the missed samples.
+ */
+#define A2DP_SINK_USE_ASRC                  0
+#define A2DP_SINK_ASRC_TARGET_LEVEL         60      // ms
+
 typedef struct {
     audio_hw_t *hw;
     audio_decoder_t *decoder;
@@ -47,7 +59,7 @@ static void hw_request_pcm_handler(void *pcm, uint32_t samples, uint8_t channels
 static void decoder_request_raw_data_handler(audio_decoder_t *decoder, uint8_t event)
 {
     if (event == AUDIO_DECODER_EVENT_REQ_RAW_DATA) {
-        audio_scene_evt_req_encoded_frame_t *evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_req_encoded_frame_t));
+        audio_scene_evt_req_encoded_frame_t *evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_req_encoded_frame_t));
         
         if (evt) {
             evt->evt.type = AUDIO_SCENE_EVT_TYPE_REQ_ENCODED_FRAME;
@@ -97,11 +109,15 @@ static void init(audio_scene_t *scene)
     env->start_thd = DECODER_DATA_READY_THD;
     env->raw_frame_nb_in_list = 0;
     co_list_init(&env->raw_frame_list);
+    audio_scene_frame_pool_create(A2DP_SINK_FRAME_POOL_COUNT, A2DP_SINK_FRAME_POOL_LENGTH);
     
     /* initialize audio decoder module */
     audio_decoder_init(param->channels, param->sample_rate);
     /* create and start a decoder */
     env->decoder = audio_decoder_add(param->decoder_type, &param->decoder_param, decoder_request_raw_data_handler);
+#if A2DP_SINK_USE_ASRC
+    audio_decoder_set_asrc(env->decoder, A2DP_SINK_ASRC_TARGET_LEVEL);
+#endif
     /* add an output to initialized audio decoder module */
     env->decoder_output_to_hw = audio_decoder_output_add(true, param->channels);
     
@@ -118,9 +134,10 @@ static void destroy(audio_scene_t *scene)
     
     audio_data_element_t *elt = (void *)co_list_pop_front(&env->raw_frame_list);
     while (elt) {
-        vPortFree(elt);
+        audio_scene_frame_free(elt);
         elt = (void *)co_list_pop_front(&env->raw_frame_list);
     }
+    audio_scene_frame_pool_destroy();
     
     vPortFree(scene->env);
     vPortFree(scene->param);
@@ -147,13 +164,16 @@ static void event_handler(audio_scene_t *scene, audio_scene_evt_t *evt)
                             elt = (void *)co_list_pick(&env->raw_frame_list);
                             while (elt) {
                                 uint32_t length = elt->length - elt->offset;
+                                if (elt->offset == 0) {
+                                    audio_decoder_set_timestamp(env->decoder, elt->timestamp);
+                                }
                                 ret = audio_decoder_decode(env->decoder, &elt->buffer[elt->offset], &length);
                                 elt->offset += length;
                                 if (elt->length == elt->offset) {
                                     elt = (void *)co_list_pop_front(&env->raw_frame_list);
 //                                    fputc(elt->seq, NULL);
                                     env->raw_frame_nb_in_list--;
-                                    vPortFree(elt);
+                                    audio_scene_frame_free(elt);
                                     elt = (void *)co_list_pick(&env->raw_frame_list);
                                 }
                                 if (ret == AUDIO_RET_OUTPUT_ALMOTE_FULL) {
@@ -176,7 +196,8 @@ static void event_handler(audio_scene_t *scene, audio_scene_evt_t *evt)
                     {
                         audio_decoder_start(env->decoder);
                     }
-                    vPortFree(_evt->raw_frame);
+                    audio_stats_overrun(1);
+                    audio_scene_frame_free(_evt->raw_frame);
                 }
                 else{
                     co_list_push_back(&env->raw_frame_list, &_evt->raw_frame->hdr);
@@ -208,10 +229,16 @@ static bool decoder_started(audio_scene_t *scene)
 
 void audio_a2dp_sink_handle_missed_samples(void *arg, uint32_t samples)
 {
+#if A2DP_SINK_USE_ASRC
+    /* clock drift is absorbed by ASRC in audio decoder, missed samples are real underruns */
+    (void)arg;
+    (void)samples;
+#else
     audio_a2dp_sink_env_t *env = a2dp_sink_scene->env;
     GLOBAL_INT_DISABLE();
     env->decoder_output_to_hw->missed_samples -= samples;
     GLOBAL_INT_RESTORE();
+#endif
 }
 
 audio_scene_operator_t audio_a2dp_sink_operator = {
@@ -9,6 +9,14 @@
 
 #define RAW_DATA_BUFFER_SIZE                    128
 
+/* encoded frames preallocated for encoder */
+#define A2DP_SOURCE_FRAME_POOL_COUNT            8
+/* AAC frame length is variable, longer frames are allocated from heap */
+#define A2DP_SOURCE_AAC_FRAME_MAX_LENGTH        768
+#define A2DP_SOURCE_AAC_FRAME_SAMPLES           1024
+/* dynamic payload type used in RTP header of A2DP media packets */
+#define A2DP_SOURCE_RTP_PAYLOAD_TYPE            96
+
 enum {
     A2DP_SOURCE_EVT_REQ_NEW_SBC_PACKET = AUDIO_SCENE_EVT_YTPE_MAX,
 };
@@ -23,6 +31,9 @@ typedef struct {
     uint32_t i2s_cnt;
     
     uint8_t *raw_data;                          // used to store raw encoded data
+
+    audio_encoder_rtp_t rtp;
+    uint8_t *packet;                            // used to pack media packets when packet_mtu is set
 } a2dp_source_env_t;
 
 static audio_scene_t *a2dp_source_scene = NULL;
@@ -35,7 +46,7 @@ static void hw_receive_output_pcm(uint32_t samples)
     env->i2s_cnt ++;
     if(env->i2s_cnt == 40){
         env->i2s_cnt = 0;
-        evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_t));
+        evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_t));
         if (evt) {
             evt->type = A2DP_SOURCE_EVT_REQ_NEW_SBC_PACKET;
             evt->scene = a2dp_source_scene;
@@ -48,7 +59,7 @@ static void decoder_request_raw_data_handler(audio_decoder_t *decoder, uint8_t e
 {
     if ( event == AUDIO_DECODER_EVENT_REQ_RAW_DATA )
     {
-        audio_scene_evt_req_encoded_frame_t *evt = (void *)pvPortMalloc( sizeof(audio_scene_evt_req_encoded_frame_t) );
+        audio_scene_evt_req_encoded_frame_t *evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_req_encoded_frame_t));
 
         if ( evt )
         {
@@ -93,7 +104,7 @@ static void init(audio_scene_t *scene)
 {
     audio_a2dp_source_param_t *param = scene->param;
     a2dp_source_env_t *env = scene->env;
-    uint16_t frame_len;
+    uint16_t frame_len, frame_max_length, pool_frame_length;
     
     a2dp_source_scene = scene;
     
@@ -128,13 +139,39 @@ static void init(audio_scene_t *scene)
         if(temp%8){
             frame_len++;
         }
+        env->rtp.frame_samples = _param->i_blocks * _param->i_subbands;
     }
     else {
         frame_len = 128;
+        env->rtp.frame_samples = A2DP_SOURCE_AAC_FRAME_SAMPLES;
     }
     
-    /* max frame len set to 5*frame_len, shall complied with hw i2s trigger*/
-    env->encoder = audio_encoder_init(param->audio_output_type, param->channels, param->sample_rate, 5*frame_len, &param->encoder_param);
+    if (param->packet_mtu) {
+        /* keep one codec frame in each encoded frame, they are packed by audio_encoder_pack_a2dp */
+        if ((param->audio_output_type == AUDIO_TYPE_SBC)
+                || (param->audio_output_type == AUDIO_TYPE_SBC_V2)) {
+            frame_max_length = frame_len;
+            pool_frame_length = frame_len;
+        }
+        else {
+            frame_max_length = FRAME_MAX_LENGTH_FIT_SINGLE;
+            pool_frame_length = A2DP_SOURCE_AAC_FRAME_MAX_LENGTH;
+        }
+        env->packet = pvPortMalloc(param->packet_mtu);
+    }
+    else {
+        /* max frame len set to 5*frame_len, shall complied with hw i2s trigger*/
+        frame_max_length = 5*frame_len;
+        pool_frame_length = frame_max_length;
+        env->packet = NULL;
+    }
+    env->rtp.seq_num = 0;
+    env->rtp.timestamp = 0;
+    env->rtp.ssrc = 1;
+    env->rtp.payload_type = A2DP_SOURCE_RTP_PAYLOAD_TYPE;
+
+    env->encoder = audio_encoder_init(param->audio_output_type, param->channels, param->sample_rate, frame_max_length, &param->encoder_param);
+    audio_encoder_frame_pool_create(env->encoder, A2DP_SOURCE_FRAME_POOL_COUNT, pool_frame_length);
     
     /* initialize audio hardware */
     env->audio_hw = audio_hw_create(param->hw_type, 
@@ -160,6 +197,9 @@ static void destroy(audio_scene_t *scene)
     audio_encoder_destroy(env->encoder);
     
     vPortFree(env->raw_data);
+    if (env->packet) {
+        vPortFree(env->packet);
+    }
     vPortFree(scene->env);
     vPortFree(scene->param);
     vPortFree(scene);
@@ -210,14 +250,25 @@ static void event_handler(audio_scene_t *scene, audio_scene_evt_t *evt)
                     ret = audio_encoder_encode(env->encoder, (const uint8_t *)pcm, A2DP_SOURCE_PACKET_SAMPLE_CNT * sizeof(uint16_t) * param->channels,  \
                                                 param->channels, param->sample_rate);
                     /* send encoded frame to peer device */
-                    encoded_frame = audio_encoder_get_frame_count(env->encoder);
-                    while (encoded_frame--) {
-                        audio_encoder_frame_t *frame;
-                        frame = audio_encoder_frame_pop(env->encoder);
-                        if (param->report_enc_cb) {
-                            param->report_enc_cb(param->report_enc_arg, frame->data, frame->length);
+                    if (env->packet) {
+                        uint16_t length;
+
+                        while ((length = audio_encoder_pack_a2dp(env->encoder, &env->rtp, env->packet, param->packet_mtu)) != 0) {
+                            if (param->report_enc_cb) {
+                                param->report_enc_cb(param->report_enc_arg, env->packet, length);
+                            }
+                        }
+                    }
+                    else {
+                        encoded_frame = audio_encoder_get_frame_count(env->encoder);
+                        while (encoded_frame--) {
+                            audio_encoder_frame_t *frame;
+                            frame = audio_encoder_frame_pop(env->encoder);
+                            if (param->report_enc_cb) {
+                                param->report_enc_cb(param->report_enc_arg, frame->data, frame->length);
+                            }
+                            audio_encoder_frame_release(frame);
                         }
-                        audio_encoder_frame_release(frame);
                     }
                 }
                 vPortFree((void *)pcm);
@@ -38,6 +38,12 @@ typedef struct {
     
     audio_a2dp_source_report_encoded_frame report_enc_cb;
     void *report_enc_arg;
+    /*
+     * 0: encoded frames are reported by report_enc_cb without header.
+     * others: A2DP media packets not larger than packet_mtu are reported, RTP header
+     *         and SBC media payload header are included.
+     */
+    uint16_t packet_mtu;
     audio_scene_decoder_req_raw_cb dec_req_raw_cb;
 } audio_a2dp_source_param_t;
 
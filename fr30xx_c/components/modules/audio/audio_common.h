@@ -2,6 +2,7 @@
 #define _AUDIO_COMMON_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "co_list.h"
 
 #define AUDIO_SPECIAL_LENGTH_FOR_PLC        0xFFFFFFFF
@@ -36,11 +37,39 @@ typedef enum {
     AUDIO_CHANNELS_STEREO = 2,
 } audio_channels_t;
 
+/* maximum channels of PCM data handled by mixer */
+#define AUDIO_CHANNELS_MAX                  8
+
+/*
+ * Sample format of PCM data. 24-bit samples can be packed in 3 bytes (USB audio)
+ * or stored in low 24 bits of a 4-byte container with sign extended. Multi-byte
+ * samples are little endian. For non-interleaved data, each channel is stored in
+ * its own plane and the length of each plane is the sample count of the buffer.
+ */
+typedef struct {
+    uint8_t bits;           // valid bits of each sample: 16, 24 or 32
+    uint8_t container;      // bytes of each sample in memory: 2, 3 or 4
+    uint8_t channels;       // 1 ~ AUDIO_CHANNELS_MAX
+    bool interleaved;
+} audio_pcm_format_t;
+
+#define AUDIO_PCM_FORMAT_S16(ch)            {16, 2, (ch), true}
+#define AUDIO_PCM_FORMAT_S24_PACKED(ch)     {24, 3, (ch), true}
+#define AUDIO_PCM_FORMAT_S24(ch)            {24, 4, (ch), true}
+#define AUDIO_PCM_FORMAT_S32(ch)            {32, 4, (ch), true}
+/* bytes of one sample of all channels */
+#define AUDIO_PCM_FRAME_BYTES(fmt)          ((fmt)->container * (fmt)->channels)
+
 typedef struct {
     struct co_list_hdr hdr;
     bool valid;
+    /* seq is set by sender when seq_valid is true, used to reorder frames */
+    bool seq_valid;
+    uint16_t seq;
     uint32_t length;
     uint32_t offset;
+    /* when this frame is received, @ref audio_stats_timestamp */
+    uint32_t timestamp;
     uint8_t buffer[];
 } audio_data_element_t;
 
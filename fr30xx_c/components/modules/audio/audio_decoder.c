@@ -5,9 +5,22 @@
 #include "task.h"
 #include "co_list.h"
 #include "codec.h"
+#include "audio_mix.h"
 
 #define FIX_44100_TEMP              0
 #define AUDIO_DECODER_USER_DRAM     0
+/* write decoded PCM into mixed buffer directly when only one decoder is active */
+#define AUDIO_DECODER_DIRECT_WRITE  1
+/* decode, get param and resample in one DSP invocation */
+#define AUDIO_DECODER_DSP_PIPELINE  1
+/* exchange raw and decoded data with DSP through shared memory rings */
+#define AUDIO_DECODER_DSP_STREAM    0
+/* look-ahead limiter on mixed PCM data before it is published to outputs */
+#define AUDIO_DECODER_LIMITER       1
+
+#if AUDIO_DECODER_DSP_STREAM
+#include "dsp_ring.h"
+#endif
 
 #if FIX_44100_TEMP
 static bool add_sample = false;
@@ -18,14 +31,27 @@ static uint32_t record_samples = 0;
 #define AUDIO_DECODER_REQUEST_DATA_THD          60      // ms
 #define AUDIO_DECODER_PCM_MIXED_BUFFER_FULL_THD 5       // ms
 #define AUDIO_DECODER_PCM_RSV_AT_BEGINNING      40      // ms
-#define AUDIO_DECODER_MIXED_STORE_UPPER         (audio_decoder_env.rd_ptr == 0 ? audio_decoder_env.pcm_total_samples - 1 : audio_decoder_env.rd_ptr - 1)
+#define AUDIO_DECODER_MIXED_STORE_UPPER         mixed_store_upper()
+#define AUDIO_DECODER_RESAMPLE_BUF_SAMPLES      256     // output buffer of MCU resampler, unit is sample
+#define AUDIO_DECODER_STREAM_IN_SIZE            2048    // raw data ring in streaming mode, unit is byte
+#define AUDIO_DECODER_STREAM_OUT_SIZE           8192    // decoded frame ring in streaming mode, unit is byte
+#define AUDIO_DECODER_LIMITER_LOOKAHEAD         1       // ms
+#define AUDIO_DECODER_LIMITER_THRESHOLD         0x721482C0  // -1dBFS in Q31
+#define AUDIO_DECODER_LIMITER_RELEASE_SHIFT     11      // release time constant is about 2048 samples
+
+#if AUDIO_DECODER_LIMITER
+/* streams are mixed at 1/4 scale to keep headroom for summing, restored by limiter */
+#define AUDIO_DECODER_MIX_HEADROOM              2
+#else
+#define AUDIO_DECODER_MIX_HEADROOM              0
+#endif
 
 #if AUDIO_DECODER_PCM_RSV_AT_BEGINNING >= AUDIO_DECODER_REQUEST_DATA_THD
 #error("AUDIO_DECODER_PCM_RSV_AT_BEGINNING should be smaller than AUDIO_DECODER_REQUEST_DATA_THD\r\n")
 #endif
 
 #if AUDIO_DECODER_USER_DRAM
-__attribute__((section("dram_section"))) static uint8_t decoder_pcm[16*1024];
+__attribute__((section("dram_section"))) static uint8_t decoder_pcm[16*1024*sizeof(audio_mix_sample_t)/sizeof(int16_t)];
 #endif
 
 enum {
@@ -43,29 +69,97 @@ typedef struct {
     uint8_t out_ch_num;
     uint32_t out_sample_rate;
 
-    struct co_list decoder_list;
+    struct co_dlist decoder_list;
     struct co_list output_list;
-    struct co_list decoder_wait_start_list;
-    struct co_list decoder_wait_pcm_consumed_list;
-    struct co_list decoder_wait_to_be_destroyed;
+    struct co_dlist decoder_wait_start_list;
+    struct co_dlist decoder_wait_pcm_consumed_list;
 
+    /*
+     * The mixed PCM buffer is a single-producer/single-consumer ring. wr_ptr is
+     * only written by decoder task, rd_ptr is only written by the outputs (audio
+     * HW interrupt). Both of them are published with one aligned store after the
+     * related PCM data is ready, so no interrupt masking is needed around them.
+     * Decoder lists are only modified in task context as well, outputs walk them
+     * in interrupt, see move_decoder.
+     */
     /* current write pointer in Mixed pcm buffer, unit is sample */
-    uint32_t wr_ptr;
+    volatile uint32_t wr_ptr;
     /* current read pointer from Mixed pcm buffer, unit is sample */
-    uint32_t rd_ptr;
+    volatile uint32_t rd_ptr;
 
-    /* used to store data after mixed */
-    int16_t *pcm;
+    /* updated by outputs when no enough data is available in mixed PCM buffer */
+    uint32_t underrun_cnt;
+    uint32_t underrun_samples;
+
+    /* used to store data after mixed, @ref audio_mix_sample_t with out_ch_num channels interleaved */
+    audio_mix_sample_t *pcm;
     uint32_t pcm_total_samples;
 
+    /* used to store output of MCU resampler, allocated when it is needed */
+    int16_t *resample_buf;
+
+#if AUDIO_DECODER_LIMITER
+    /* only accessed in task context when new wr_ptr is published */
+    audio_mix_limiter_t limiter;
+#endif
+
     uint32_t request_data_thd;
     uint32_t mixed_buffer_almost_full_thd;
 } audio_decoder_env_t;
 
-const static uint16_t ratio_table[] = {0, 0x8000};
-
 static audio_decoder_env_t audio_decoder_env;
 static void mix_decoded_data(audio_decoder_t *decoder);
+#if AUDIO_DECODER_DSP_STREAM
+static void decoder_stream_open(audio_decoder_t *decoder);
+static void decoder_stream_close(audio_decoder_t *decoder, bool drain);
+#endif
+
+/* the last position can be written by decoders, rd_ptr is sampled only once */
+static uint32_t mixed_store_upper(void)
+{
+    uint32_t rd_ptr = audio_decoder_env.rd_ptr;
+
+    return rd_ptr == 0 ? audio_decoder_env.pcm_total_samples - 1 : rd_ptr - 1;
+}
+
+/*
+ * move a decoder between decoder lists, should only be called in task context.
+ * check_request_raw_data walks decoder_list and audio_decoder_get_pcm walks
+ * decoder_wait_pcm_consumed_list from output interrupt, both of them only follow
+ * next pointers. Extract unlinks the decoder with one store to its predecessor and
+ * push_back publishes it with one store after its next pointer is cleared, so a
+ * walker preempting the move either sees the decoder in one of the lists or stops
+ * at it. The latter only delays a request or a state check to next interrupt.
+ */
+static bool move_decoder(struct co_dlist *from, struct co_dlist *to, audio_decoder_t *decoder)
+{
+    bool extracted;
+
+    extracted = co_dlist_extract(from, &decoder->hdr);
+    if (extracted) {
+        co_dlist_push_back(to, &decoder->hdr);
+    }
+
+    return extracted;
+}
+
+/*
+ * Decoders stopped by outputs in interrupt are only marked as idle, they are moved
+ * out of decoder list here in task context.
+ */
+static void sync_stopped_decoders(void)
+{
+    audio_decoder_t *tmp, *next;
+
+    tmp = (void *)co_dlist_pick(&audio_decoder_env.decoder_list);
+    while (tmp) {
+        next = (void *)tmp->hdr.next;
+        if (tmp->state == AUDIO_DECODER_STATE_IDLE) {
+            audio_decoder_stop(tmp);
+        }
+        tmp = next;
+    }
+}
 
 void print_int16(uint16_t value)
 {
@@ -84,11 +178,15 @@ static bool update_wr_ptr(void)
     bool ret;
 
     /* update wr_ptr according to minimum distance */
-    GLOBAL_INT_DISABLE();
-    tmp = (void *)co_list_pick(&audio_decoder_env.decoder_list);
+    tmp = (void *)co_dlist_pick(&audio_decoder_env.decoder_list);
     while (tmp) {
         uint32_t distance;
         uint32_t wr_ptr = tmp->wr_ptr;
+        if (tmp->state == AUDIO_DECODER_STATE_IDLE) {
+            /* stopped by output in interrupt, will be moved to wait start list later */
+            tmp = (void *)tmp->hdr.next;
+            continue;
+        }
         if (wr_ptr == audio_decoder_env.wr_ptr) {
             min_distance = 0;
             break;
@@ -104,13 +202,28 @@ static bool update_wr_ptr(void)
 
         tmp = (void *)tmp->hdr.next;
     }
-    GLOBAL_INT_RESTORE();
 
     if ((min_distance != 0) && (min_distance != 0xffffffff)){
-        audio_decoder_env.wr_ptr += min_distance;
-        if (audio_decoder_env.wr_ptr >= audio_decoder_env.pcm_total_samples) {
-            audio_decoder_env.wr_ptr -= audio_decoder_env.pcm_total_samples;
+        uint32_t wr_ptr = audio_decoder_env.wr_ptr + min_distance;
+        if (wr_ptr >= audio_decoder_env.pcm_total_samples) {
+            wr_ptr -= audio_decoder_env.pcm_total_samples;
+        }
+
+#if AUDIO_DECODER_LIMITER
+        /* all decoders have been mixed into these samples, they will not be changed any more */
+        if (wr_ptr > audio_decoder_env.wr_ptr) {
+            audio_mix_limiter_process(&audio_decoder_env.limiter, &audio_decoder_env.pcm[audio_decoder_env.wr_ptr * audio_decoder_env.out_ch_num], min_distance);
+        }
+        else {
+            audio_mix_limiter_process(&audio_decoder_env.limiter, &audio_decoder_env.pcm[audio_decoder_env.wr_ptr * audio_decoder_env.out_ch_num],
+                                        audio_decoder_env.pcm_total_samples - audio_decoder_env.wr_ptr);
+            audio_mix_limiter_process(&audio_decoder_env.limiter, &audio_decoder_env.pcm[0], wr_ptr);
         }
+#endif
+
+        /* make sure mixed PCM data is visible before new wr_ptr is published */
+        __DMB();
+        audio_decoder_env.wr_ptr = wr_ptr;
 
         ret = true;
     }
@@ -121,7 +234,7 @@ static bool update_wr_ptr(void)
 //    printf("update_wr_ptr: ");
 //    print_int16(audio_decoder_env.wr_ptr);
 //    fputc(' ', NULL);
-//    tmp = (void *)co_list_pick(&audio_decoder_env.decoder_list);
+//    tmp = (void *)co_dlist_pick(&audio_decoder_env.decoder_list);
 //    while (tmp) {
 //        print_int16(tmp->wr_ptr);
 //        fputc(' ', NULL);
@@ -133,6 +246,50 @@ static bool update_wr_ptr(void)
     return ret;
 }
 
+#if AUDIO_DECODER_LIMITER
+/* push samples delayed by limiter into mixed buffer, used after the last decoder is stopped */
+static void limiter_flush(void)
+{
+    uint32_t wr_ptr = audio_decoder_env.wr_ptr;
+    uint32_t rd_ptr = audio_decoder_env.rd_ptr;
+    uint32_t free_samples, samples, tail_samples;
+
+    if (wr_ptr >= rd_ptr) {
+        free_samples = audio_decoder_env.pcm_total_samples - (wr_ptr - rd_ptr);
+    }
+    else {
+        free_samples = rd_ptr - wr_ptr;
+    }
+
+    /* wr_ptr should not catch up with rd_ptr */
+    samples = audio_decoder_env.limiter.lookahead;
+    if (samples >= free_samples) {
+        samples = free_samples - 1;
+    }
+
+    tail_samples = audio_decoder_env.pcm_total_samples - wr_ptr;
+    if (tail_samples > samples) {
+        tail_samples = samples;
+    }
+    /* space after wr_ptr may still hold data of the stopped decoder */
+    memset((void *)&audio_decoder_env.pcm[wr_ptr * audio_decoder_env.out_ch_num], 0, sizeof(audio_mix_sample_t) * audio_decoder_env.out_ch_num * tail_samples);
+    audio_mix_limiter_process(&audio_decoder_env.limiter, &audio_decoder_env.pcm[wr_ptr * audio_decoder_env.out_ch_num], tail_samples);
+    if (samples > tail_samples) {
+        memset((void *)&audio_decoder_env.pcm[0], 0, sizeof(audio_mix_sample_t) * audio_decoder_env.out_ch_num * (samples - tail_samples));
+        audio_mix_limiter_process(&audio_decoder_env.limiter, &audio_decoder_env.pcm[0], samples - tail_samples);
+    }
+
+    wr_ptr += samples;
+    if (wr_ptr >= audio_decoder_env.pcm_total_samples) {
+        wr_ptr -= audio_decoder_env.pcm_total_samples;
+    }
+
+    /* make sure flushed PCM data is visible before new wr_ptr is published */
+    __DMB();
+    audio_decoder_env.wr_ptr = wr_ptr;
+}
+#endif
+
 /* update read pointer after PCM is fetched by an output or any output is removed */
 static bool update_rd_ptr(void)
 {
@@ -141,7 +298,6 @@ static bool update_rd_ptr(void)
     bool ret;
     uint32_t curr_rd_ptr;
 
-    GLOBAL_INT_DISABLE();
     curr_rd_ptr = audio_decoder_env.rd_ptr;
     /* update rd_ptr according to minimum distance */
     tmp = (void *)co_list_pick(&audio_decoder_env.output_list);
@@ -164,17 +320,33 @@ static bool update_rd_ptr(void)
         tmp = (void *)tmp->hdr.next;
     }
 
-    if (min_distance == 0) {
+    if ((min_distance == 0) || (min_distance == 0xffffffff)) {
         ret = false;
     }
     else {
-        audio_decoder_env.rd_ptr = curr_rd_ptr + min_distance;
-        if (audio_decoder_env.rd_ptr >= audio_decoder_env.pcm_total_samples) {
-            audio_decoder_env.rd_ptr -= audio_decoder_env.pcm_total_samples;
+        uint32_t rd_ptr = curr_rd_ptr + min_distance;
+        if (rd_ptr >= audio_decoder_env.pcm_total_samples) {
+            rd_ptr -= audio_decoder_env.pcm_total_samples;
         }
+
+        /* PCM data should be fetched by all outputs before the space is released */
+        __DMB();
+        audio_decoder_env.rd_ptr = rd_ptr;
         ret = true;
+
+        {
+            uint32_t wr_ptr = audio_decoder_env.wr_ptr;
+            uint32_t fill_samples;
+
+            if (wr_ptr >= rd_ptr) {
+                fill_samples = wr_ptr - rd_ptr;
+            }
+            else {
+                fill_samples = audio_decoder_env.pcm_total_samples - rd_ptr + wr_ptr;
+            }
+            audio_stats_pcm_consumed(min_distance, fill_samples);
+        }
     }
-    GLOBAL_INT_RESTORE();
     
 //    audio_decoder_output_t *_tmp;
 //    printf("rd: ");
@@ -216,10 +388,8 @@ static audio_ret_t pcm_buffer_status(uint32_t wr_ptr)
 static void request_raw_data(void)
 {
     audio_decoder_t *tmp;
-    audio_ret_t ret;
 
-    GLOBAL_INT_DISABLE();
-    tmp = (void *)co_list_pick(&audio_decoder_env.decoder_list);
+    tmp = (void *)co_dlist_pick(&audio_decoder_env.decoder_list);
     while (tmp) {
         if (tmp->state == AUDIO_DECODER_STATE_DECODING) {
             if (tmp->evt_cb) {
@@ -229,17 +399,19 @@ static void request_raw_data(void)
 
         tmp = (void *)tmp->hdr.next;
     }
-    GLOBAL_INT_RESTORE();
 }
 
-/* After rd_ptr is updated, new space is available for decoder */
+/* 
+ * After rd_ptr is updated, new space is available for decoder. This function is
+ * called by outputs in interrupt, decoder lists are only walked here. Remaining
+ * PCM data of decoders whose input is over are mixed in audio_decoder_decode.
+ */
 static void check_request_raw_data(void)
 {
     audio_decoder_t *tmp;
     audio_ret_t ret;
 
-    GLOBAL_INT_DISABLE();
-    tmp = (void *)co_list_pick(&audio_decoder_env.decoder_list);
+    tmp = (void *)co_dlist_pick(&audio_decoder_env.decoder_list);
     while (tmp) {
         if (tmp->state == AUDIO_DECODER_STATE_DECODING) {
             ret = pcm_buffer_status(tmp->wr_ptr);
@@ -249,57 +421,36 @@ static void check_request_raw_data(void)
                 }
             }
         }else if(tmp->state == AUDIO_DECODER_STATE_INPUT_OVER) {
-            mix_decoded_data(tmp);
+            if (tmp->evt_cb && !co_list_is_empty(&tmp->pcm_list)) {
+                tmp->evt_cb(tmp, AUDIO_DECODER_EVENT_REQ_RAW_DATA);
+            }
         }
         tmp = (void *)tmp->hdr.next;
     }
-    GLOBAL_INT_RESTORE();
 }
 
-static void *add_to_mixed_buffer(int16_t *mixed_pcm_ptr, int16_t *src, uint32_t samples)
+/* gain of decoder is applied in the same pass with mixing */
+static void *add_to_mixed_buffer(audio_mix_sample_t *mixed_pcm_ptr, audio_mix_sample_t *src, uint32_t samples, audio_mix_ramp_t *gain)
 {
-    if (audio_decoder_env.out_ch_num == 1) {
-        for (uint32_t i=0; i<samples; i++) {
-            *mixed_pcm_ptr += *src++;
-            mixed_pcm_ptr++;
-        }
-    }
-    else {
-        for (uint32_t i=0; i<samples; i++) {
-            *mixed_pcm_ptr += *src++;
-            mixed_pcm_ptr++;
-            *mixed_pcm_ptr += *src++;
-            mixed_pcm_ptr++;
-        }
-    }
-    
-    return src;
+    audio_mix_ramp_add_q31(mixed_pcm_ptr, src, audio_decoder_env.out_ch_num, samples, gain);
+
+    return src + samples * audio_decoder_env.out_ch_num;
 }
 
-static void *copy_to_mixed_buffer(int16_t *mixed_pcm_ptr, int16_t *src, uint32_t samples)
+static void *copy_to_mixed_buffer(audio_mix_sample_t *mixed_pcm_ptr, audio_mix_sample_t *src, uint32_t samples, audio_mix_ramp_t *gain)
 {
-    if (audio_decoder_env.out_ch_num == 1) {
-        for (uint32_t i=0; i<samples; i++) {
-            *mixed_pcm_ptr++ = *src++;
-        }
-    }
-    else {
-        for (uint32_t i=0; i<samples; i++) {
-            *mixed_pcm_ptr++ = *src++;
-            *mixed_pcm_ptr++ = *src++;
-        }
-    }
-    
-    return src;
+    audio_mix_ramp_copy_q31(mixed_pcm_ptr, src, audio_decoder_env.out_ch_num, samples, gain);
+
+    return src + samples * audio_decoder_env.out_ch_num;
 }
 
 static uint32_t save_data_to_mixed_buffer(uint32_t add_start_index, uint32_t copy_start_index, 
-                                                    uint32_t end_index, int16_t *pcm, uint32_t samples)
+                                                    uint32_t end_index, audio_mix_sample_t *pcm, uint32_t samples, audio_mix_ramp_t *gain)
 {
     uint32_t copy_samples = 0, add_samples = 0;
     uint32_t dealed_samples;
     uint32_t dealing_index;
-    int16_t *mixed_pcm_ptr;
+    audio_mix_sample_t *mixed_pcm_ptr;
     
 //    printf("save_data_to_mixed_buffer: ");
 //    print_int16(add_start_index);
@@ -348,14 +499,14 @@ static uint32_t save_data_to_mixed_buffer(uint32_t add_start_index, uint32_t cop
     if (add_samples) {
         uint32_t last_samples = audio_decoder_env.pcm_total_samples - dealing_index;
         if (last_samples <= add_samples) {
-            pcm = add_to_mixed_buffer(mixed_pcm_ptr, pcm, last_samples);
+            pcm = add_to_mixed_buffer(mixed_pcm_ptr, pcm, last_samples, gain);
             add_samples -= last_samples;
             dealing_index = 0;
             mixed_pcm_ptr = &audio_decoder_env.pcm[0];
         }
 
         if (add_samples) {
-            pcm = add_to_mixed_buffer(mixed_pcm_ptr, pcm, add_samples);
+            pcm = add_to_mixed_buffer(mixed_pcm_ptr, pcm, add_samples, gain);
         }
     }
 
@@ -364,20 +515,32 @@ static uint32_t save_data_to_mixed_buffer(uint32_t add_start_index, uint32_t cop
     if (copy_samples) {
         uint32_t last_samples = audio_decoder_env.pcm_total_samples - dealing_index;
         if (last_samples <= copy_samples) {
-            pcm = copy_to_mixed_buffer(mixed_pcm_ptr, pcm, last_samples);
+            pcm = copy_to_mixed_buffer(mixed_pcm_ptr, pcm, last_samples, gain);
             copy_samples -= last_samples;
             dealing_index = 0;
             mixed_pcm_ptr = &audio_decoder_env.pcm[0];
         }
 
         if (copy_samples) {
-            pcm = copy_to_mixed_buffer(mixed_pcm_ptr, pcm, copy_samples);
+            pcm = copy_to_mixed_buffer(mixed_pcm_ptr, pcm, copy_samples, gain);
         }
     }
 
     return dealed_samples;
 }
 
+/* move decoder to wait_pcm_consumed list once input is over and all PCM data are mixed */
+static void check_all_pcm_mixed(audio_decoder_t *decoder)
+{
+    if (decoder->state == AUDIO_DECODER_STATE_INPUT_OVER) {
+        if (co_list_is_empty(&decoder->pcm_list)) {
+            audio_decoder_stop(decoder);
+            decoder->state = AUDIO_DECODER_STATE_PCM_ALL_MIXED;
+            move_decoder(&audio_decoder_env.decoder_wait_start_list, &audio_decoder_env.decoder_wait_pcm_consumed_list, decoder);
+        }
+    }
+}
+
 /* update mixed PCM buffer with PCM data from pcm list of coresponding decoder. */
 static void mix_decoded_data(audio_decoder_t *decoder)
 {
@@ -389,6 +552,8 @@ static void mix_decoded_data(audio_decoder_t *decoder)
 
     pcm_data = (void *)co_list_pick(&decoder->pcm_list);
     if (pcm_data == NULL) {
+        /* PCM data may be written into mixed buffer directly */
+        check_all_pcm_mixed(decoder);
         return;
     }
     
@@ -397,10 +562,13 @@ static void mix_decoded_data(audio_decoder_t *decoder)
     /* search the fastest wr_ptr in decoder list */
     max_distance = 0;
     fastest_wr_ptr = audio_decoder_env.wr_ptr;
-    GLOBAL_INT_DISABLE();
-    tmp = (void *)co_list_pick(&audio_decoder_env.decoder_list);
+    tmp = (void *)co_dlist_pick(&audio_decoder_env.decoder_list);
     while (tmp) {
         uint32_t distance;
+        if (tmp->state == AUDIO_DECODER_STATE_IDLE) {
+            tmp = (void *)tmp->hdr.next;
+            continue;
+        }
         if (tmp->wr_ptr >= audio_decoder_env.wr_ptr) {
             distance = tmp->wr_ptr - audio_decoder_env.wr_ptr;
         }
@@ -415,7 +583,6 @@ static void mix_decoded_data(audio_decoder_t *decoder)
 
         tmp = (void *)tmp->hdr.next;
     }
-    GLOBAL_INT_RESTORE();
 
     /* save incomming decoded data into mixed buffer */
     pcm_data = (void *)co_list_pick(&decoder->pcm_list);
@@ -426,7 +593,8 @@ static void mix_decoded_data(audio_decoder_t *decoder)
                                                     fastest_wr_ptr, 
                                                     AUDIO_DECODER_MIXED_STORE_UPPER, 
                                                     &pcm_data->pcm[pcm_data->offset*audio_decoder_env.out_ch_num], 
-                                                    pcm_data->samples - pcm_data->offset);
+                                                    pcm_data->samples - pcm_data->offset,
+                                                    &decoder->gain);
         pcm_data->offset += dealed_samples;
         decoder->wr_ptr += dealed_samples;
         if (decoder->wr_ptr >= audio_decoder_env.pcm_total_samples) {
@@ -457,117 +625,137 @@ static void mix_decoded_data(audio_decoder_t *decoder)
         }
     }
     
-    if (decoder->state == AUDIO_DECODER_STATE_INPUT_OVER) {
-        if (co_list_is_empty(&decoder->pcm_list)) {
-            GLOBAL_INT_DISABLE();
-            audio_decoder_stop(decoder);
-            co_list_extract(&audio_decoder_env.decoder_wait_start_list, &decoder->hdr);
-            decoder->state = AUDIO_DECODER_STATE_PCM_ALL_MIXED;
-            co_list_push_back(&audio_decoder_env.decoder_wait_pcm_consumed_list, &decoder->hdr);
-            GLOBAL_INT_RESTORE();
-        }
-    }
+    check_all_pcm_mixed(decoder);
 
     update_wr_ptr();
     
 //    ( void ) xTaskResumeAll();
 }
 
+#if AUDIO_DECODER_DIRECT_WRITE
+static const uint8_t *write_to_mixed_buffer(audio_mix_sample_t *mixed_pcm_ptr, const uint8_t *src, uint32_t samples, const audio_pcm_format_t *format, audio_mix_ramp_t *gain)
+{
+    audio_mix_ramp_to_q31(mixed_pcm_ptr, audio_decoder_env.out_ch_num, src, format, samples, gain);
+
+    return src + samples * AUDIO_PCM_FRAME_BYTES(format);
+}
+
+/*
+ * When only one decoder is active, nothing has to be mixed. Decoded PCM data is
+ * written into mixed PCM buffer directly instead of allocating a pcm_data and
+ * copying it twice. false will be returned when this shortcut can not be taken,
+ * then caller should fall back to save_decoded_data.
+ */
+static bool write_decoded_data_direct(audio_decoder_t *decoder, const uint8_t *decoder_out_ptr, uint32_t sample_count, const audio_pcm_format_t *format)
+{
+    uint32_t available_space, tail_samples;
+    uint32_t wr_ptr, wr_limit;
+    const uint8_t *src;
+
+#if FIX_44100_TEMP
+    if (add_sample) {
+        return false;
+    }
+#endif
+
+    /* data saved in pcm list should be mixed at first to keep the order */
+    if ((audio_decoder_env.decoder_count != 1)
+            || (decoder->wr_ptr != audio_decoder_env.wr_ptr)
+            || !co_list_is_empty(&decoder->pcm_list)
+            || ((format->interleaved == false) && (format->channels > 1))) {
+        return false;
+    }
+
+    wr_ptr = decoder->wr_ptr;
+    wr_limit = AUDIO_DECODER_MIXED_STORE_UPPER;
+    if (wr_limit >= wr_ptr) {
+        available_space = wr_limit - wr_ptr;
+    }
+    else {
+        available_space = wr_limit + audio_decoder_env.pcm_total_samples - wr_ptr;
+    }
+    if (available_space < sample_count) {
+        return false;
+    }
+
+    src = decoder_out_ptr;
+    tail_samples = audio_decoder_env.pcm_total_samples - wr_ptr;
+    if (tail_samples <= sample_count) {
+        src = write_to_mixed_buffer(&audio_decoder_env.pcm[wr_ptr * audio_decoder_env.out_ch_num], src, tail_samples, format, &decoder->gain);
+        sample_count -= tail_samples;
+        wr_ptr = 0;
+    }
+    if (sample_count) {
+        write_to_mixed_buffer(&audio_decoder_env.pcm[wr_ptr * audio_decoder_env.out_ch_num], src, sample_count, format, &decoder->gain);
+        wr_ptr += sample_count;
+    }
+
+    /* PCM data is ready, publish new write pointer to outputs */
+    decoder->wr_ptr = wr_ptr;
+    update_wr_ptr();
+
+    return true;
+}
+#endif
+
 /* 
  * save PCM data into pcm list of corresponding decoder, the sample rate 
- * and channels of saved PCM data are the same with settings in 
- * audio_decoder_env
+ * of saved PCM data is the same with settings in audio_decoder_env. PCM data
+ * is converted into Q31 format with channels of mixed PCM buffer, gain of decoder
+ * is applied later when it is mixed.
  */
-static void save_decoded_data(audio_decoder_t *decoder, uint8_t *decoder_out_ptr, uint32_t decoder_out_length, uint8_t channels)
-{    
+static void save_decoded_pcm(audio_decoder_t *decoder, const uint8_t *decoder_out_ptr, uint32_t sample_count, const audio_pcm_format_t *format)
+{
     audio_decoder_pcm_data_t *pcm_data;
-    int16_t *src, *dst;
-    uint32_t sample_count;
-    uint16_t ratio;
-    int16_t value;
+    uint32_t alloc_samples;
 
-    ratio = ratio_table[audio_decoder_env.decoder_count - 1];
+    if (sample_count == 0) {
+        return;
+    }
 
-    if (channels == audio_decoder_env.out_ch_num) {
-#if FIX_44100_TEMP
-        if (add_sample) {
-            decoder_out_length += 4;
-        }
+    if (decoder->pcm_tap) {
+        decoder->pcm_tap(decoder, decoder_out_ptr, sample_count, format);
+    }
+
+#if AUDIO_DECODER_DIRECT_WRITE
+    if (write_decoded_data_direct(decoder, decoder_out_ptr, sample_count, format)) {
+        return;
+    }
 #endif
-        pcm_data = pvPortMalloc(sizeof(audio_decoder_pcm_data_t) + decoder_out_length);
-        sample_count = decoder_out_length / (channels * sizeof(int16_t));
-        pcm_data->samples = sample_count;
-        pcm_data->offset = 0;
-        if (audio_decoder_env.decoder_count == 1) {
-            memcpy((void *)&pcm_data->pcm[0], decoder_out_ptr, decoder_out_length);
+
+    alloc_samples = sample_count;
 #if FIX_44100_TEMP
-            if (add_sample) {
-                add_sample = false;
-                memcpy((void *)&pcm_data->pcm[(decoder_out_length-4)>>1], (void *)&pcm_data->pcm[(decoder_out_length-8)>>1], 4);
-            }
+    if (add_sample) {
+        alloc_samples++;
+    }
 #endif
-        }
-        else {
-            src = (void *)decoder_out_ptr;
-            dst = (void *)&pcm_data->pcm[0];
-            for (uint32_t i=0; i<sample_count * channels; i++) {
-                value = (((*src++) * ratio) >> 16);
-                *dst++ = value;
-            }
-        }
+    pcm_data = pvPortMalloc(sizeof(audio_decoder_pcm_data_t) + alloc_samples * audio_decoder_env.out_ch_num * sizeof(audio_mix_sample_t));
+    if (pcm_data == NULL) {
+        return;
     }
-    else {
-        if (channels == 1) {
-            /* source: mono; destination: stereo */
-            pcm_data = pvPortMalloc(sizeof(audio_decoder_pcm_data_t) + decoder_out_length * 2);
-            sample_count = decoder_out_length / sizeof(int16_t);
-            pcm_data->samples = sample_count;
-            pcm_data->offset = 0;
-
-            src = (void *)decoder_out_ptr;
-            dst = (void *)&pcm_data->pcm[0];
-            if (audio_decoder_env.decoder_count == 1) {
-                for (uint32_t i=0; i<sample_count; i++) {
-                    *dst++ = *src;
-                    *dst++ = *src++;
-                }
-            }
-            else {
-                for (uint32_t i=0; i<sample_count; i++) {
-                    value = (((*src++) * ratio) >> 16);
-                    *dst++ = value;
-                    *dst++ = value;
-                }
-            }
-        }
-        else {
-            /* source: stereo; destination: mono */
-            pcm_data = pvPortMalloc(sizeof(audio_decoder_pcm_data_t) + decoder_out_length / 2);
-            sample_count = decoder_out_length / sizeof(int16_t) / 2;
-            pcm_data->samples = sample_count;
-            pcm_data->offset = 0;
-
-            src = (void *)decoder_out_ptr;
-            dst = (void *)&pcm_data->pcm[0];
-            if (audio_decoder_env.decoder_count == 1) {
-                for (uint32_t i=0; i<sample_count; i++) {
-                    *dst++ = *src;
-                    src += 2;
-                }
-            }
-            else {
-                for (uint32_t i=0; i<sample_count; i++) {
-                    value = (((*src) * ratio) >> 16);
-                    *dst++ = value;
-                    src += 2;
-                }
-            }
-        }
+    pcm_data->samples = alloc_samples;
+    pcm_data->offset = 0;
+
+    audio_mix_to_q31(&pcm_data->pcm[0], audio_decoder_env.out_ch_num, decoder_out_ptr, format, sample_count);
+#if FIX_44100_TEMP
+    if (add_sample) {
+        uint32_t count = sample_count * audio_decoder_env.out_ch_num;
+        /* repeat the last sample */
+        add_sample = false;
+        memcpy((void *)&pcm_data->pcm[count], (void *)&pcm_data->pcm[count - audio_decoder_env.out_ch_num], 
+                audio_decoder_env.out_ch_num * sizeof(audio_mix_sample_t));
     }
+#endif
 
-    GLOBAL_INT_DISABLE();
     co_list_push_back(&decoder->pcm_list, &pcm_data->hdr);
-    GLOBAL_INT_RESTORE();
+}
+
+/* save 16-bit interleaved PCM data from codec or resampler */
+static void save_decoded_data(audio_decoder_t *decoder, uint8_t *decoder_out_ptr, uint32_t decoder_out_length, uint8_t channels)
+{
+    audio_pcm_format_t format = AUDIO_PCM_FORMAT_S16(channels);
+
+    save_decoded_pcm(decoder, decoder_out_ptr, decoder_out_length / AUDIO_PCM_FRAME_BYTES(&format), &format);
 }
 
 void audio_decoder_start(audio_decoder_t *decoder)
@@ -577,17 +765,18 @@ void audio_decoder_start(audio_decoder_t *decoder)
     uint32_t max_distance;
     uint32_t fastest_wr_ptr = 0;
     uint32_t tmp_wr_ptr = 0;
+    uint32_t rd_ptr;
     audio_decoder_t *tmp = NULL;
     bool extracted = false;
     
-    GLOBAL_INT_DISABLE();
+    sync_stopped_decoders();
         
-    if(!co_list_find(&audio_decoder_env.decoder_list, &decoder->hdr))
+    if(!co_dlist_find(&audio_decoder_env.decoder_list, &decoder->hdr))
     {
         /* search the fastest wr_ptr in decoder list */
         max_distance = 0;
         fastest_wr_ptr = audio_decoder_env.wr_ptr;
-        tmp = (void *)co_list_pick(&audio_decoder_env.decoder_list);
+        tmp = (void *)co_dlist_pick(&audio_decoder_env.decoder_list);
         while (tmp) {
             uint32_t distance;
             if (tmp->wr_ptr >= audio_decoder_env.wr_ptr) {
@@ -611,18 +800,19 @@ void audio_decoder_start(audio_decoder_t *decoder)
         /*In case that one decoder was stoped due to data insufficient, when restart it, valid PCM samples should be more than mini_vacuumn_sample_num,
         audio_decoder_get_pcm() from interrupt is likely to stop the decoder before it decodes valid PCM samples successfully otherwise.
         */
-        if (fastest_wr_ptr >= audio_decoder_env.rd_ptr) {
-            available_samples = fastest_wr_ptr - audio_decoder_env.rd_ptr;
+        rd_ptr = audio_decoder_env.rd_ptr;
+        if (fastest_wr_ptr >= rd_ptr) {
+            available_samples = fastest_wr_ptr - rd_ptr;
         }
         else {
-            available_samples = audio_decoder_env.pcm_total_samples - (audio_decoder_env.rd_ptr - fastest_wr_ptr);
+            available_samples = audio_decoder_env.pcm_total_samples - (rd_ptr - fastest_wr_ptr);
         }
 
         mini_vacuumn_sample_num =  audio_decoder_env.out_sample_rate * AUDIO_DECODER_PCM_RSV_AT_BEGINNING / 1000;
 
         if(available_samples < mini_vacuumn_sample_num)
         {
-            tmp_wr_ptr = (audio_decoder_env.rd_ptr + mini_vacuumn_sample_num);
+            tmp_wr_ptr = (rd_ptr + mini_vacuumn_sample_num);
 
             if (tmp_wr_ptr >= audio_decoder_env.pcm_total_samples) {
                 tmp_wr_ptr -= audio_decoder_env.pcm_total_samples;
@@ -631,43 +821,59 @@ void audio_decoder_start(audio_decoder_t *decoder)
             if(tmp_wr_ptr > fastest_wr_ptr)
             {
                 memset((void *)&audio_decoder_env.pcm[fastest_wr_ptr * audio_decoder_env.out_ch_num], 
-                        0, sizeof(int16_t) * audio_decoder_env.out_ch_num * (tmp_wr_ptr - fastest_wr_ptr));
+                        0, sizeof(audio_mix_sample_t) * audio_decoder_env.out_ch_num * (tmp_wr_ptr - fastest_wr_ptr));
 
             }else{
                 memset((void *)&audio_decoder_env.pcm[fastest_wr_ptr * audio_decoder_env.out_ch_num], 
-                        0, sizeof(int16_t) * audio_decoder_env.out_ch_num * (audio_decoder_env.pcm_total_samples - fastest_wr_ptr));
+                        0, sizeof(audio_mix_sample_t) * audio_decoder_env.out_ch_num * (audio_decoder_env.pcm_total_samples - fastest_wr_ptr));
                 memset((void *)&audio_decoder_env.pcm[0], 
-                        0, sizeof(int16_t) * audio_decoder_env.out_ch_num * tmp_wr_ptr);
+                        0, sizeof(audio_mix_sample_t) * audio_decoder_env.out_ch_num * tmp_wr_ptr);
             }
             decoder->wr_ptr = tmp_wr_ptr;
         }
 
-        extracted = co_list_extract(&audio_decoder_env.decoder_wait_start_list, &decoder->hdr);
+        decoder->state = AUDIO_DECODER_STATE_DECODING;
+        extracted = move_decoder(&audio_decoder_env.decoder_wait_start_list, &audio_decoder_env.decoder_list, decoder);
         if (extracted) {
-            co_list_push_back(&audio_decoder_env.decoder_list, &decoder->hdr);
-            decoder->state = AUDIO_DECODER_STATE_DECODING;
             audio_decoder_env.decoder_count++;
         }else{
+            decoder->state = AUDIO_DECODER_STATE_IDLE;
             assert(extracted == true);
         }
         update_wr_ptr();
     }
-    GLOBAL_INT_RESTORE();
 }
 
 void audio_decoder_stop(audio_decoder_t *decoder)
 {
     bool extracted = false;
+
+    if (xPortIsInsideInterrupt()) {
+        /*
+         * Decoder lists are only modified in task context. Mark the decoder as idle
+         * to stop requesting data, it will be moved to wait start list later.
+         */
+        if (decoder->state == AUDIO_DECODER_STATE_DECODING) {
+            decoder->state = AUDIO_DECODER_STATE_IDLE;
+        }
+        return;
+    }
     
-    GLOBAL_INT_DISABLE();
-    extracted = co_list_extract(&audio_decoder_env.decoder_list, &decoder->hdr);
+    extracted = move_decoder(&audio_decoder_env.decoder_list, &audio_decoder_env.decoder_wait_start_list, decoder);
     if (extracted) {
+        decoder->state = AUDIO_DECODER_STATE_IDLE;
         audio_decoder_env.decoder_count--;
         update_wr_ptr();
-        co_list_push_back(&audio_decoder_env.decoder_wait_start_list, &decoder->hdr);
-        decoder->state = AUDIO_DECODER_STATE_IDLE;
+#if AUDIO_DECODER_LIMITER
+        if (audio_decoder_env.decoder_count == 0) {
+            /* output tail of this stream, then don't carry limiter state into the next one */
+            limiter_flush();
+            audio_mix_limiter_reset(&audio_decoder_env.limiter);
+            /* tail belongs to this decoder, PCM_CONSUMED is reported after it is fetched */
+            decoder->wr_ptr = audio_decoder_env.wr_ptr;
+        }
+#endif
     }
-    GLOBAL_INT_RESTORE();
 }
 
 audio_decoder_t *audio_decoder_add(audio_type_t type, audio_decoder_param_t *param, void (*evt_cb)(audio_decoder_t *, uint8_t event))
@@ -703,9 +909,13 @@ audio_decoder_t *audio_decoder_add(audio_type_t type, audio_decoder_param_t *par
             case AUDIO_TYPE_LC3:
                 break;
             case AUDIO_TYPE_PCM:
-                {
+                if (param) {
                     decoder->decoder = codec_decoder_init(CODEC_DECODER_TYPE_PCM, (void *)&param->pcm);
                 }
+                else {
+                    /* PCM data is written by audio_decoder_write_pcm, DSP is not involved */
+                    decoder->decoder = NULL;
+                }
                 break;
             case AUDIO_TYPE_SBC_V2:
                 decoder->decoder = codec_decoder_init(CODEC_DECODER_TYPE_SBC_V2, NULL);
@@ -722,14 +932,26 @@ audio_decoder_t *audio_decoder_add(audio_type_t type, audio_decoder_param_t *par
 
         decoder->evt_cb = evt_cb;
         decoder->current_sample_rate = 0;
+        decoder->current_channels = 0;
         decoder->resample = NULL;
+        decoder->resample_poly = NULL;
+        decoder->asrc_target = 0;
         decoder->wr_ptr = 0;
+        decoder->in_stamp = 0;
+        decoder->decode_stamp = 0;
+        decoder->stream_in = NULL;
+        decoder->stream_out = NULL;
+        audio_mix_ramp_set(&decoder->gain, AUDIO_MIX_RAMP_UNITY >> AUDIO_DECODER_MIX_HEADROOM);
+        decoder->pcm_tap = NULL;
+#if AUDIO_DECODER_DSP_STREAM
+        if (decoder->decoder) {
+            decoder_stream_open(decoder);
+        }
+#endif
 
         co_list_init(&decoder->pcm_list);
         decoder->state = AUDIO_DECODER_STATE_IDLE;
-        GLOBAL_INT_DISABLE();
-        co_list_push_back(&audio_decoder_env.decoder_wait_start_list, &decoder->hdr);
-        GLOBAL_INT_RESTORE();
+        co_dlist_push_back(&audio_decoder_env.decoder_wait_start_list, &decoder->hdr);
     }
 
     return decoder;
@@ -742,12 +964,9 @@ void audio_decoder_remove(audio_decoder_t *decoder)
     }
     audio_decoder_pcm_data_t *pcm_data;
     
-    GLOBAL_INT_DISABLE();
     audio_decoder_stop(decoder);
-    co_list_extract(&audio_decoder_env.decoder_wait_start_list, &decoder->hdr);
-    co_list_extract(&audio_decoder_env.decoder_wait_to_be_destroyed, &decoder->hdr);
-    co_list_extract(&audio_decoder_env.decoder_wait_pcm_consumed_list, &decoder->hdr);
-    GLOBAL_INT_RESTORE();
+    co_dlist_extract(&audio_decoder_env.decoder_wait_start_list, &decoder->hdr);
+    co_dlist_extract(&audio_decoder_env.decoder_wait_pcm_consumed_list, &decoder->hdr);
 
     do {
         pcm_data = (void *)co_list_pop_front(&decoder->pcm_list);
@@ -759,7 +978,15 @@ void audio_decoder_remove(audio_decoder_t *decoder)
     if (decoder->resample) {
         resample_destroy(decoder->resample);
     }
-    codec_decoder_destroy(decoder->decoder);
+    if (decoder->resample_poly) {
+        resample_poly_destroy(decoder->resample_poly);
+    }
+#if AUDIO_DECODER_DSP_STREAM
+    decoder_stream_close(decoder, false);
+#endif
+    if (decoder->decoder) {
+        codec_decoder_destroy(decoder->decoder);
+    }
 
     vPortFree(decoder);
 }
@@ -800,17 +1027,239 @@ void audio_decoder_output_remove(audio_decoder_output_t *output)
     GLOBAL_INT_RESTORE();
 }
 
+static void *create_resample_poly(uint32_t in_sample_rate, uint8_t channels)
+{
+    if (audio_decoder_env.resample_buf == NULL) {
+        /* large enough for stereo data */
+        audio_decoder_env.resample_buf = pvPortMalloc(AUDIO_DECODER_RESAMPLE_BUF_SAMPLES * 2 * sizeof(int16_t));
+        if (audio_decoder_env.resample_buf == NULL) {
+            return NULL;
+        }
+    }
+
+    return resample_poly_init(in_sample_rate, audio_decoder_env.out_sample_rate, channels);
+}
+
+static void resample_and_save_data(audio_decoder_t *decoder, int16_t *pcm, uint32_t samples, uint8_t channels)
+{
+    while (samples) {
+        uint32_t in_samples = samples;
+        uint32_t out_samples;
+
+        out_samples = resample_poly_exec(decoder->resample_poly, pcm, &in_samples, audio_decoder_env.resample_buf, AUDIO_DECODER_RESAMPLE_BUF_SAMPLES);
+        if (out_samples) {
+            save_decoded_data(decoder, (uint8_t *)audio_decoder_env.resample_buf, out_samples * sizeof(int16_t) * channels, channels);
+        }
+        pcm += in_samples * channels;
+        samples -= in_samples;
+    }
+}
+
+/*
+ * Resample decoded data when needed and save them into mixed PCM buffer. Resampler
+ * is recreated when the format of decoded data is changed.
+ */
+static void process_decoded_data(audio_decoder_t *decoder, uint8_t *decoder_out_ptr, uint32_t decoder_out_length,
+                                    uint32_t sample_rate, uint8_t channels, bool resampled)
+{
+    if (decoder->current_sample_rate != sample_rate) {
+        decoder->current_sample_rate = sample_rate;
+        decoder->current_channels = channels;
+
+        if (decoder->resample) {
+            resample_destroy(decoder->resample);
+            decoder->resample = NULL;
+        }
+        if (decoder->resample_poly) {
+            resample_poly_destroy(decoder->resample_poly);
+            decoder->resample_poly = NULL;
+        }
+
+        if (decoder->asrc_target) {
+            /* conversion ratio is adjusted dynamically, always resample on MCU */
+            decoder->resample_poly = create_resample_poly(sample_rate, channels);
+        }
+        else if (sample_rate != audio_decoder_env.out_sample_rate) {
+            enum resample_type type;
+
+            type = resample_get_type(sample_rate, audio_decoder_env.out_sample_rate);
+            if (type != RESAMPLE_TYPE_INVALID) {
+                decoder->resample = resample_init(type, channels);
+            }
+            else {
+                /* this ratio is not supported by DSP */
+                decoder->resample_poly = create_resample_poly(sample_rate, channels);
+            }
+        }
+    }
+
+    if (resampled) {
+        /* already resampled by DSP */
+        save_decoded_data(decoder, decoder_out_ptr, decoder_out_length, channels);
+    }
+    else if (decoder->resample_poly) {
+        resample_and_save_data(decoder, (int16_t *)decoder_out_ptr, decoder_out_length / (sizeof(int16_t) * channels), channels);
+    }
+    else if (decoder->resample) {
+        while (decoder_out_length) {
+            uint32_t dealed_length = decoder_out_length;
+            uint32_t out_length;
+            uint8_t *out_buf = NULL;
+            resample_exec(decoder->resample, 
+                            (const uint8_t *)&decoder_out_ptr[0], 
+                            &dealed_length, 
+                            &out_buf, 
+                            &out_length);
+            if (out_length) {
+                save_decoded_data(decoder, out_buf, out_length, channels);
+            }
+            decoder_out_length -= dealed_length;
+            decoder_out_ptr += dealed_length;
+        }
+    }
+    else {
+        save_decoded_data(decoder, decoder_out_ptr, decoder_out_length, channels);
+    }
+
+    mix_decoded_data(decoder);
+
+    if (decoder->in_stamp) {
+        uint32_t rd_ptr = audio_decoder_env.rd_ptr;
+        uint32_t samples_ahead;
+
+        if (decoder->wr_ptr >= rd_ptr) {
+            samples_ahead = decoder->wr_ptr - rd_ptr;
+        }
+        else {
+            samples_ahead = audio_decoder_env.pcm_total_samples - rd_ptr + decoder->wr_ptr;
+        }
+        audio_stats_latency(AUDIO_STATS_STAGE_DECODE, decoder->decode_stamp);
+        audio_stats_frame_mixed(decoder->in_stamp, samples_ahead);
+    }
+
+    if (decoder->asrc_target && decoder->resample_poly) {
+        audio_decoder_ring_status_t status;
+
+        audio_decoder_get_ring_status(&status);
+        resample_poly_track_level(decoder->resample_poly, status.fill_samples, decoder->asrc_target);
+    }
+}
+
+#if AUDIO_DECODER_DSP_STREAM
+/* doorbell from DSP: new decoded frame is available or raw data ring has space */
+static void decoder_stream_notify(dsp_ring_t *ring, void *arg)
+{
+    audio_decoder_t *decoder = arg;
+
+    if ((decoder->state == AUDIO_DECODER_STATE_DECODING) && decoder->evt_cb) {
+        decoder->evt_cb(decoder, AUDIO_DECODER_EVENT_REQ_RAW_DATA);
+    }
+}
+
+static void decoder_stream_open(audio_decoder_t *decoder)
+{
+    uint8_t stream_id;
+    dsp_ring_t *in, *out;
+
+    stream_id = dsp_ring_stream_alloc();
+    if (stream_id == DSP_RING_STREAM_ID_INVALID) {
+        return;
+    }
+
+    in = dsp_ring_create(stream_id, DSP_RING_DIR_TO_DSP, AUDIO_DECODER_STREAM_IN_SIZE);
+    out = dsp_ring_create(stream_id, DSP_RING_DIR_FROM_DSP, AUDIO_DECODER_STREAM_OUT_SIZE);
+    if (in && out
+            && (codec_decoder_stream_attach(decoder->decoder, dsp_ring_get_dsp_addr(in), dsp_ring_get_dsp_addr(out)) == CODEC_ERROR_NO_ERROR)) {
+        dsp_ring_set_notify(in, decoder_stream_notify, decoder);
+        dsp_ring_set_notify(out, decoder_stream_notify, decoder);
+        decoder->stream_in = in;
+        decoder->stream_out = out;
+        return;
+    }
+
+    /* streaming mode is not supported by DSP, keep using call mode */
+    dsp_ring_destroy(in);
+    dsp_ring_destroy(out);
+    dsp_ring_stream_free(stream_id);
+}
+
+/* fetch all decoded frames from output ring, frame data may be split at the end of ring */
+static void decoder_stream_drain(audio_decoder_t *decoder)
+{
+    struct codec_stream_frame_hdr hdr;
+    uint32_t length, count;
+    uint8_t *data;
+
+    while (dsp_ring_read(decoder->stream_out, &hdr, sizeof(hdr)) == sizeof(hdr)) {
+        length = hdr.length;
+        while (length) {
+            count = dsp_ring_peek(decoder->stream_out, &data);
+            if (count == 0) {
+                break;
+            }
+            if (count > length) {
+                count = length;
+            }
+            process_decoded_data(decoder, data, count, hdr.sample_rate, hdr.channels, false);
+            dsp_ring_consume(decoder->stream_out, count);
+            length -= count;
+        }
+        dsp_ring_consume(decoder->stream_out, ((hdr.length + 3) & ~3) - hdr.length);
+    }
+}
+
+static void decoder_stream_close(audio_decoder_t *decoder, bool drain)
+{
+    uint8_t stream_id;
+
+    if (decoder->stream_in == NULL) {
+        return;
+    }
+
+    /* DSP has processed all raw data in ring after detached */
+    codec_decoder_stream_attach(decoder->decoder, 0, 0);
+    if (drain) {
+        decoder_stream_drain(decoder);
+    }
+
+    stream_id = decoder->stream_in->stream_id;
+    dsp_ring_destroy(decoder->stream_in);
+    dsp_ring_destroy(decoder->stream_out);
+    dsp_ring_stream_free(stream_id);
+    decoder->stream_in = NULL;
+    decoder->stream_out = NULL;
+}
+#endif
+
 int audio_decoder_decode(audio_decoder_t *decoder, const uint8_t *buffer, uint32_t *length)
 {
     uint32_t decoder_in_length;
     uint8_t *decoder_out_ptr;
     uint32_t decoder_out_length;
     uint32_t input_length, consumed_length;
+#if AUDIO_DECODER_DSP_PIPELINE
+    struct codec_decoder_pipeline pipeline;
+#endif
     
+    sync_stopped_decoders();
+
+    if (decoder->state == AUDIO_DECODER_STATE_INPUT_OVER) {
+        /* input is over, mix remaining PCM data requested by outputs */
+        mix_decoded_data(decoder);
+        *length = 0;
+        return AUDIO_RET_OUTPUT_ALMOTE_FULL;
+    }
+
     if (decoder->state != AUDIO_DECODER_STATE_DECODING) {
         *length = 0;
         return AUDIO_RET_OUTPUT_ALMOTE_FULL;
     }
+
+#if AUDIO_DECODER_DSP_STREAM
+    if (decoder->stream_in) {
+        decoder_stream_drain(decoder);
+    }
+#endif
     
     if (co_list_pick(&decoder->pcm_list)) {
         audio_ret_t ret;
@@ -825,13 +1274,49 @@ int audio_decoder_decode(audio_decoder_t *decoder, const uint8_t *buffer, uint32
 
     input_length = *length;
     consumed_length = 0;
+    if (decoder->in_stamp) {
+        decoder->decode_stamp = audio_stats_timestamp();
+        audio_stats_latency(AUDIO_STATS_STAGE_QUEUE, decoder->in_stamp);
+    }
     while (input_length) {
 
         decoder_in_length = input_length;
         decoder_out_ptr = NULL;
+#if AUDIO_DECODER_DSP_PIPELINE
+        pipeline.decoder = NULL;
+        pipeline.resampled = false;
+#endif
+#if AUDIO_DECODER_DSP_STREAM
+        if (decoder->stream_in) {
+            if ((input_length == AUDIO_SPECIAL_LENGTH_FOR_INPUT_OVER)
+                    || (input_length == AUDIO_SPECIAL_LENGTH_FOR_PLC)) {
+                /* these operations are executed in call mode, the remaining frames are fetched before */
+                decoder_stream_close(decoder, true);
+            }
+            else {
+                decoder_in_length = dsp_ring_write(decoder->stream_in, buffer, input_length);
+                decoder_stream_drain(decoder);
+                if (decoder_in_length == 0) {
+                    /* raw data ring is full, wait for doorbell from DSP */
+                    break;
+                }
+                input_length -= decoder_in_length;
+                buffer += decoder_in_length;
+                consumed_length += decoder_in_length;
+                continue;
+            }
+        }
+#endif
         if (input_length == AUDIO_SPECIAL_LENGTH_FOR_INPUT_OVER) {
             uint8_t exec_done;
-            codec_decoder_input_over(decoder->decoder, &decoder_out_ptr, &decoder_out_length, &exec_done);
+            if (decoder->decoder) {
+                codec_decoder_input_over(decoder->decoder, &decoder_out_ptr, &decoder_out_length, &exec_done);
+            }
+            else {
+                /* nothing is buffered in a PCM only decoder */
+                decoder_out_length = 0;
+                exec_done = true;
+            }
             if (exec_done) {
                 decoder_in_length = input_length;
                 decoder->state = AUDIO_DECODER_STATE_INPUT_OVER;
@@ -845,7 +1330,15 @@ int audio_decoder_decode(audio_decoder_t *decoder, const uint8_t *buffer, uint32
             decoder_in_length = input_length;
         }
         else {
+#if AUDIO_DECODER_DSP_PIPELINE
+            pipeline.decoder = decoder->decoder;
+            pipeline.resample = decoder->resample;
+            pipeline.resample_sample_rate = decoder->current_sample_rate;
+            pipeline.resample_channels = decoder->current_channels;
+            codec_decoder_pipeline_exec(&pipeline, buffer, &decoder_in_length, &decoder_out_ptr, &decoder_out_length);
+#else
             codec_decoder_decode(decoder->decoder, buffer, &decoder_in_length, &decoder_out_ptr, &decoder_out_length);
+#endif
         }
         
         if (decoder_out_length) 
@@ -863,6 +1356,13 @@ int audio_decoder_decode(audio_decoder_t *decoder, const uint8_t *buffer, uint32
 //                }
 //            }
 
+#if AUDIO_DECODER_DSP_PIPELINE
+            if (pipeline.decoder) {
+                sample_rate = pipeline.sample_rate;
+                channels = pipeline.channels;
+            }
+            else
+#endif
             if (input_length != AUDIO_SPECIAL_LENGTH_FOR_PLC) {
                 codec_decoder_get_param(decoder->decoder, &sample_rate, &channels);
             }
@@ -881,66 +1381,15 @@ int audio_decoder_decode(audio_decoder_t *decoder, const uint8_t *buffer, uint32
             }
 #endif
 
-            if (decoder->current_sample_rate != sample_rate) {
-                decoder->current_sample_rate = sample_rate;
-
-                if (sample_rate == audio_decoder_env.out_sample_rate) {
-                    if (decoder->resample) {
-                        resample_destroy(decoder->resample);
-                    }
-                    decoder->resample = 0;
-                }
-                else {
-                    enum resample_type type;
-
-                    if (decoder->resample) {
-                        resample_destroy(decoder->resample);
-                    }
-
-                    type = resample_get_type(sample_rate, audio_decoder_env.out_sample_rate);
-                    if (type != RESAMPLE_TYPE_INVALID) {
-                        decoder->resample = resample_init(type, channels);
-                    }
-                    else {
-                        /// TODO
-                        decoder->resample = 0;
-                    }
-                }
-            }
-
-            if (decoder->resample) {
-                while (decoder_out_length) {
-                    uint32_t dealed_length = decoder_out_length;
-                    uint32_t out_length;
-                    uint8_t *out_buf = NULL;
-                    resample_exec(decoder->resample, 
-                                    (const uint8_t *)&decoder_out_ptr[0], 
-                                    &dealed_length, 
-                                    &out_buf, 
-                                    &out_length);
-                    if (out_length) {
-                        save_decoded_data(decoder, out_buf, out_length, channels);
-                    }
-                    decoder_out_length -= dealed_length;
-                    decoder_out_ptr += dealed_length;
-                }
-            }
-            else {
-                save_decoded_data(decoder, decoder_out_ptr, decoder_out_length, channels);
-            }
-
-            mix_decoded_data(decoder);
+#if AUDIO_DECODER_DSP_PIPELINE
+            process_decoded_data(decoder, decoder_out_ptr, decoder_out_length, sample_rate, channels, pipeline.resampled);
+#else
+            process_decoded_data(decoder, decoder_out_ptr, decoder_out_length, sample_rate, channels, false);
+#endif
         }
         else {
             if (input_length == AUDIO_SPECIAL_LENGTH_FOR_INPUT_OVER) {
-                if (co_list_is_empty(&decoder->pcm_list)) {
-                    GLOBAL_INT_DISABLE();
-                    audio_decoder_stop(decoder);
-                    co_list_extract(&audio_decoder_env.decoder_wait_start_list, &decoder->hdr);
-                    decoder->state = AUDIO_DECODER_STATE_PCM_ALL_MIXED;
-                    co_list_push_back(&audio_decoder_env.decoder_wait_pcm_consumed_list, &decoder->hdr);
-                    GLOBAL_INT_RESTORE();
-                }
+                check_all_pcm_mixed(decoder);
             }
         }
 
@@ -949,63 +1398,74 @@ int audio_decoder_decode(audio_decoder_t *decoder, const uint8_t *buffer, uint32
         consumed_length += decoder_in_length;
 
     }
+    /* timestamp is only valid for this operation */
+    decoder->in_stamp = 0;
+#if AUDIO_DECODER_DSP_STREAM
+    if (input_length) {
+        /* unconsumed raw data should be kept by caller until next request */
+        *length = consumed_length;
+        return AUDIO_RET_OUTPUT_ALMOTE_FULL;
+    }
+#endif
     *length = consumed_length;
 
     return pcm_buffer_status(decoder->wr_ptr);
 }
 
-static int16_t *copy_pcm(int16_t *dst, int16_t *src, uint32_t samples, uint8_t channels)
+int audio_decoder_write_pcm(audio_decoder_t *decoder, const void *pcm, uint32_t samples, const audio_pcm_format_t *format)
 {
-    if (audio_decoder_env.out_ch_num == AUDIO_CHANNELS_MONO) {
-        if (channels == AUDIO_CHANNELS_MONO) {
-            for (uint32_t i=0; i<samples; i++) {
-                *dst++ = *src++;
-            }
-        }
-        else {
-            for (uint32_t i=0; i<samples; i++) {
-                *dst++ = *src;
-                *dst++ = *src++;
-            }
-        }
+    sync_stopped_decoders();
+
+    if (decoder->state != AUDIO_DECODER_STATE_DECODING) {
+        return AUDIO_RET_OUTPUT_ALMOTE_FULL;
     }
-    else {
-        if (channels == AUDIO_CHANNELS_MONO) {
-            for (uint32_t i=0; i<samples; i++) {
-                *dst++ = *src;
-                src += 2 ;
-            }
-        }
-        else {
-            uint32_t *_dst, *_src;
-            _dst = (void *)dst;
-            _src = (void *)src;
-            for (uint32_t i=0; i<samples; i++) {
-                *_dst++ = *_src++;
-            }
-            dst = (void *)_dst;
+    if ((format->channels == 0) || (format->channels > AUDIO_CHANNELS_MAX)) {
+        return AUDIO_RET_FAILED;
+    }
+
+    /* keep the order of PCM data saved before */
+    if (co_list_pick(&decoder->pcm_list)) {
+        mix_decoded_data(decoder);
+    }
+
+    save_decoded_pcm(decoder, pcm, samples, format);
+    mix_decoded_data(decoder);
+
+    return pcm_buffer_status(decoder->wr_ptr);
+}
+
+/* check whether any decoder is waiting for its last PCM data to be consumed */
+static bool pcm_wait_consumed(void)
+{
+    audio_decoder_t *decoder;
+
+    decoder = (void *)co_dlist_pick(&audio_decoder_env.decoder_wait_pcm_consumed_list);
+    while (decoder) {
+        if (decoder->state == AUDIO_DECODER_STATE_PCM_ALL_MIXED) {
+            return true;
         }
+        decoder = (void *)decoder->hdr.next;
     }
-    
-    return dst;
+
+    return false;
 }
 
-uint32_t audio_decoder_get_pcm(audio_decoder_output_t *output, int16_t *pcm, uint32_t samples, uint8_t channels)
+uint32_t audio_decoder_get_pcm_format(audio_decoder_output_t *output, void *pcm, uint32_t samples, const audio_pcm_format_t *format)
 {
     uint32_t available_samples, tail_samples, fill_zero_samples, valid_samples;
-    int16_t *mixed_pcm_ptr;
-    uint32_t current_wr_ptr;
+    audio_mix_sample_t *mixed_pcm_ptr;
+    uint32_t current_wr_ptr, current_rd_ptr;
 
     if ((audio_decoder_env.inited == false)
-            || ((audio_decoder_env.decoder_count == 0) && co_list_is_empty(&audio_decoder_env.decoder_wait_pcm_consumed_list))
+            || ((audio_decoder_env.decoder_count == 0) && !pcm_wait_consumed())
             || (output == NULL)) {
-        for (uint32_t i=0; i<samples * channels; i++) {
-            *pcm++ = 0;
-        }
+        memset(pcm, 0, samples * AUDIO_PCM_FRAME_BYTES(format));
         return samples;
     }
 
     current_wr_ptr = audio_decoder_env.wr_ptr;
+    /* PCM data before wr_ptr should be read after wr_ptr is sampled */
+    __DMB();
     if (current_wr_ptr >= output->rd_ptr) {
         available_samples = current_wr_ptr - output->rd_ptr;
     }
@@ -1048,31 +1508,23 @@ uint32_t audio_decoder_get_pcm(audio_decoder_output_t *output, int16_t *pcm, uin
     mixed_pcm_ptr = &audio_decoder_env.pcm[output->rd_ptr * audio_decoder_env.out_ch_num];
     tail_samples = audio_decoder_env.pcm_total_samples - output->rd_ptr;
     if (available_samples >= tail_samples) {
-        pcm = copy_pcm(pcm, mixed_pcm_ptr, tail_samples, channels);
+        pcm = audio_mix_from_q31(pcm, format, mixed_pcm_ptr, audio_decoder_env.out_ch_num, tail_samples);
         available_samples -= tail_samples;
         output->rd_ptr = 0;
         mixed_pcm_ptr = &audio_decoder_env.pcm[0];
     }
 
     if (available_samples) {
-        pcm = copy_pcm(pcm, mixed_pcm_ptr, available_samples, channels);
+        pcm = audio_mix_from_q31(pcm, format, mixed_pcm_ptr, audio_decoder_env.out_ch_num, available_samples);
         output->rd_ptr += available_samples;
     }
 
     if (fill_zero_samples) {
         output->missed_samples += fill_zero_samples;
-        if (channels == AUDIO_CHANNELS_MONO) {
-            for (uint32_t i=0; i<fill_zero_samples; i++) {
-                *pcm++ = 0;
-            }
-        }
-        else {
-            uint32_t *dst;
-            dst = (void *)pcm;
-            for (uint32_t i=0; i<fill_zero_samples; i++) {
-                *dst++ = 0;
-            }
-        }
+        audio_decoder_env.underrun_cnt++;
+        audio_decoder_env.underrun_samples += fill_zero_samples;
+        audio_stats_underrun(fill_zero_samples);
+        memset(pcm, 0, fill_zero_samples * AUDIO_PCM_FRAME_BYTES(format));
     }
 
     /*
@@ -1084,38 +1536,45 @@ uint32_t audio_decoder_get_pcm(audio_decoder_output_t *output, int16_t *pcm, uin
         check_request_raw_data();
     }
     
-    GLOBAL_INT_DISABLE();
+    /* 
+     * decoders stay in wait_pcm_consumed list until they are removed in task context,
+     * only their state is changed here.
+     */
     {
-        audio_decoder_t *decoder;
-        decoder = (void *)co_list_pick(&audio_decoder_env.decoder_wait_pcm_consumed_list);
+        audio_decoder_t *decoder, *next;
+        current_rd_ptr = audio_decoder_env.rd_ptr;
+        decoder = (void *)co_dlist_pick(&audio_decoder_env.decoder_wait_pcm_consumed_list);
         while (decoder) {
             uint32_t distance;
-            if (audio_decoder_env.rd_ptr >= decoder->wr_ptr) {
-                distance = decoder->wr_ptr + audio_decoder_env.pcm_total_samples - audio_decoder_env.rd_ptr;
-            }
-            else {
-                distance = decoder->wr_ptr - audio_decoder_env.rd_ptr;
-            }
-            if (distance <= samples) {
-                void *next = decoder->hdr.next;
-                if (decoder->evt_cb) {
-                    decoder->evt_cb(decoder, AUDIO_DECODER_EVENT_PCM_CONSUMED);
+            next = (void *)decoder->hdr.next;
+            if (decoder->state == AUDIO_DECODER_STATE_PCM_ALL_MIXED) {
+                if (current_rd_ptr >= decoder->wr_ptr) {
+                    distance = decoder->wr_ptr + audio_decoder_env.pcm_total_samples - current_rd_ptr;
+                }
+                else {
+                    distance = decoder->wr_ptr - current_rd_ptr;
+                }
+                if (distance <= samples) {
+                    decoder->state = AUDIO_DECODER_STATE_IDLE;
+                    if (decoder->evt_cb) {
+                        decoder->evt_cb(decoder, AUDIO_DECODER_EVENT_PCM_CONSUMED);
+                    }
                 }
-                co_list_extract(&audio_decoder_env.decoder_wait_pcm_consumed_list, &decoder->hdr);
-                decoder->state = AUDIO_DECODER_STATE_IDLE;
-                co_list_push_back(&audio_decoder_env.decoder_wait_to_be_destroyed, &decoder->hdr);
-                decoder = next;
-            }
-            else {
-                decoder = (void *)decoder->hdr.next;
             }
+            decoder = next;
         }
     }
-    GLOBAL_INT_RESTORE();
 
     return valid_samples;
 }
 
+uint32_t audio_decoder_get_pcm(audio_decoder_output_t *output, int16_t *pcm, uint32_t samples, uint8_t channels)
+{
+    audio_pcm_format_t format = AUDIO_PCM_FORMAT_S16(channels);
+
+    return audio_decoder_get_pcm_format(output, pcm, samples, &format);
+}
+
 bool audio_decoder_is_started(audio_decoder_t *decoder)
 {
     if (decoder) {
@@ -1136,38 +1595,141 @@ void audio_decoder_clear_missed_sample_cnt(audio_decoder_output_t *output)
     output->missed_samples = 0;
 }
 
+void audio_decoder_set_asrc(audio_decoder_t *decoder, uint32_t target_ms)
+{
+    if (decoder == NULL) {
+        return;
+    }
+
+    decoder->asrc_target = audio_decoder_env.out_sample_rate * target_ms / 1000;
+    /* resampler will be created again when next frame is decoded */
+    decoder->current_sample_rate = 0;
+}
+
+void audio_decoder_set_timestamp(audio_decoder_t *decoder, uint32_t timestamp)
+{
+    decoder->in_stamp = timestamp;
+}
+
+void audio_decoder_set_gain(audio_decoder_t *decoder, int16_t gain, uint32_t ramp_samples, uint8_t curve)
+{
+    int32_t target;
+
+    if (decoder == NULL) {
+        return;
+    }
+
+    if (gain >= AUDIO_MIX_GAIN_UNITY) {
+        target = AUDIO_MIX_RAMP_UNITY;
+    }
+    else if (gain <= 0) {
+        target = 0;
+    }
+    else {
+        target = (int32_t)gain << 15;
+    }
+
+    /* gain may be changed by other task while decoder is mixing */
+    GLOBAL_INT_DISABLE();
+    audio_mix_ramp_start(&decoder->gain, target >> AUDIO_DECODER_MIX_HEADROOM, ramp_samples, curve);
+    GLOBAL_INT_RESTORE();
+}
+
+void audio_decoder_set_pcm_tap(audio_decoder_t *decoder, void (*tap)(audio_decoder_t *, const void *, uint32_t, const audio_pcm_format_t *))
+{
+    if (decoder == NULL) {
+        return;
+    }
+
+    decoder->pcm_tap = tap;
+}
+
+uint32_t audio_decoder_get_sample_rate(void)
+{
+    if (audio_decoder_env.inited == false) {
+        return 0;
+    }
+
+    return audio_decoder_env.out_sample_rate;
+}
+
+void audio_decoder_get_ring_status(audio_decoder_ring_status_t *status)
+{
+    uint32_t wr_ptr, rd_ptr;
+
+    wr_ptr = audio_decoder_env.wr_ptr;
+    rd_ptr = audio_decoder_env.rd_ptr;
+
+    status->total_samples = audio_decoder_env.pcm_total_samples;
+    if (wr_ptr >= rd_ptr) {
+        status->fill_samples = wr_ptr - rd_ptr;
+    }
+    else {
+        status->fill_samples = wr_ptr + audio_decoder_env.pcm_total_samples - rd_ptr;
+    }
+    status->underrun_cnt = audio_decoder_env.underrun_cnt;
+    status->underrun_samples = audio_decoder_env.underrun_samples;
+#if AUDIO_DECODER_LIMITER
+    status->limited_samples = audio_decoder_env.limiter.limited_samples;
+#else
+    status->limited_samples = 0;
+#endif
+}
+
 int audio_decoder_init(uint8_t out_ch_num, uint32_t out_sample_rate)
 {
     if (audio_decoder_env.inited) {
         return AUDIO_RET_ERR_CREATED;
     }
+    if ((out_ch_num == 0) || (out_ch_num > AUDIO_CHANNELS_MAX)) {
+        return AUDIO_RET_FAILED;
+    }
 
     audio_decoder_env.decoder_count = 0;
     audio_decoder_env.out_ch_num = out_ch_num;
     audio_decoder_env.out_sample_rate = out_sample_rate;
     co_list_init(&audio_decoder_env.output_list);
-    co_list_init(&audio_decoder_env.decoder_list);
-    co_list_init(&audio_decoder_env.decoder_wait_start_list);
-    co_list_init(&audio_decoder_env.decoder_wait_pcm_consumed_list);
-    co_list_init(&audio_decoder_env.decoder_wait_to_be_destroyed);
+    co_dlist_init(&audio_decoder_env.decoder_list);
+    co_dlist_init(&audio_decoder_env.decoder_wait_start_list);
+    co_dlist_init(&audio_decoder_env.decoder_wait_pcm_consumed_list);
+    audio_decoder_env.underrun_cnt = 0;
+    audio_decoder_env.underrun_samples = 0;
 
     audio_decoder_env.pcm_total_samples = out_sample_rate * AUDIO_DECODER_PCM_MIXED_BUFFER_DUR / 1000;
+    audio_decoder_env.resample_buf = NULL;
 #if AUDIO_DECODER_USER_DRAM == 0
-    audio_decoder_env.pcm = (void *)pvPortMalloc(audio_decoder_env.pcm_total_samples * out_ch_num * sizeof(int16_t));
+    audio_decoder_env.pcm = (void *)pvPortMalloc(audio_decoder_env.pcm_total_samples * out_ch_num * sizeof(audio_mix_sample_t));
 #else
     audio_decoder_env.pcm = (void *)&decoder_pcm[0];
 #endif
     audio_decoder_env.wr_ptr = 0;
     #if AUDIO_DECODER_PCM_RSV_AT_BEGINNING != 0
     audio_decoder_env.rd_ptr = out_sample_rate * (AUDIO_DECODER_PCM_MIXED_BUFFER_DUR - AUDIO_DECODER_PCM_RSV_AT_BEGINNING) / 1000;
-    memset((void *)&audio_decoder_env.pcm[audio_decoder_env.rd_ptr * out_ch_num], 0, sizeof(int16_t) * out_ch_num * (audio_decoder_env.pcm_total_samples - audio_decoder_env.rd_ptr));
+    memset((void *)&audio_decoder_env.pcm[audio_decoder_env.rd_ptr * out_ch_num], 0, sizeof(audio_mix_sample_t) * out_ch_num * (audio_decoder_env.pcm_total_samples - audio_decoder_env.rd_ptr));
     #else
     audio_decoder_env.rd_ptr = 0;
     #endif
 
+#if AUDIO_DECODER_LIMITER
+    {
+        uint32_t lookahead = out_sample_rate * AUDIO_DECODER_LIMITER_LOOKAHEAD / 1000;
+        int32_t *delay = pvPortMalloc(lookahead * out_ch_num * sizeof(int32_t));
+        if (delay == NULL) {
+#if AUDIO_DECODER_USER_DRAM == 0
+            vPortFree(audio_decoder_env.pcm);
+#endif
+            return AUDIO_RET_FAILED;
+        }
+        audio_mix_limiter_init(&audio_decoder_env.limiter, delay, lookahead, out_ch_num,
+                                AUDIO_DECODER_LIMITER_THRESHOLD, AUDIO_DECODER_MIX_HEADROOM, AUDIO_DECODER_LIMITER_RELEASE_SHIFT);
+    }
+#endif
+
     audio_decoder_env.request_data_thd = out_sample_rate * AUDIO_DECODER_REQUEST_DATA_THD / 1000;
     audio_decoder_env.mixed_buffer_almost_full_thd = out_sample_rate * AUDIO_DECODER_PCM_MIXED_BUFFER_FULL_THD / 1000;
 
+    audio_stats_reset();
+
     audio_decoder_env.inited = true;
 
 #if FIX_44100_TEMP
@@ -1190,25 +1752,19 @@ void audio_decoder_destroy(void)
     audio_decoder_env.inited = false;
 
     do {
-        decoder = (void *)co_list_pick(&audio_decoder_env.decoder_wait_start_list);
+        decoder = (void *)co_dlist_pick(&audio_decoder_env.decoder_wait_start_list);
         if (decoder) {
             audio_decoder_remove(decoder);
         }
     } while(decoder);
     do {
-        decoder = (void *)co_list_pick(&audio_decoder_env.decoder_list);
+        decoder = (void *)co_dlist_pick(&audio_decoder_env.decoder_list);
         if (decoder) {
             audio_decoder_remove(decoder);
         }
     } while(decoder);
     do {
-        decoder = (void *)co_list_pick(&audio_decoder_env.decoder_wait_pcm_consumed_list);
-        if (decoder) {
-            audio_decoder_remove(decoder);
-        }
-    } while(decoder);
-    do {
-        decoder = (void *)co_list_pick(&audio_decoder_env.decoder_wait_to_be_destroyed);
+        decoder = (void *)co_dlist_pick(&audio_decoder_env.decoder_wait_pcm_consumed_list);
         if (decoder) {
             audio_decoder_remove(decoder);
         }
@@ -1224,4 +1780,11 @@ void audio_decoder_destroy(void)
 #if AUDIO_DECODER_USER_DRAM == 0
     vPortFree(audio_decoder_env.pcm);
 #endif
+#if AUDIO_DECODER_LIMITER
+    vPortFree(audio_decoder_env.limiter.delay);
+#endif
+    if (audio_decoder_env.resample_buf) {
+        vPortFree(audio_decoder_env.resample_buf);
+        audio_decoder_env.resample_buf = NULL;
+    }
 }
@@ -6,8 +6,11 @@
 #include "co_list.h"
 #include "codec.h"
 #include "resample.h"
+#include "resample_poly.h"
 
 #include "audio_common.h"
+#include "audio_mix.h"
+#include "audio_stats.h"
 
 #define AUDIO_DECODER_EVENT_REQ_RAW_DATA        0x00
 #define AUDIO_DECODER_EVENT_PCM_CONSUMED        0x01
@@ -19,7 +22,8 @@ typedef struct {
     uint16_t samples;
     uint16_t offset;
 
-    int16_t pcm[];
+    /* channels of mixed PCM buffer, @ref audio_mix_to_q31 and audio_mix_sample_t */
+    audio_mix_sample_t pcm[];
 } audio_decoder_pcm_data_t;
 
 typedef struct {
@@ -36,12 +40,16 @@ typedef struct {
 } audio_decoder_output_t;
 
 typedef struct _audio_decoder_t {
-    struct co_list_hdr hdr;
+    struct co_dlist_hdr hdr;
 
     uint32_t current_sample_rate;
+    /* channels of PCM data when resample instance is created */
+    uint8_t current_channels;
 
     struct codec_decoder_handle *decoder;
     void *resample;
+    /* resampler running on MCU, used when ratio is not supported by DSP or in ASRC mode */
+    void *resample_poly;
 
     /* ====Internal Usage==== */
     /* reserved for upper layer */
@@ -50,10 +58,36 @@ typedef struct _audio_decoder_t {
     struct co_list pcm_list;
     /* current write pointer in Mixed pcm buffer, unit is sample */
     uint32_t wr_ptr;
-    /* current working state */
-    uint8_t state;
+    /* current working state, may be changed by outputs in interrupt */
+    volatile uint8_t state;
+    /* expected level of mixed PCM buffer in ASRC mode, unit is sample. 0: ASRC is disabled */
+    uint32_t asrc_target;
+    /* receive timestamp of raw data in current decode operation, 0: not stamped */
+    uint32_t in_stamp;
+    /* when current decode operation is started */
+    uint32_t decode_stamp;
+    /* shared memory rings in streaming mode, NULL: raw data is decoded by calling DSP */
+    struct dsp_ring *stream_in;
+    struct dsp_ring *stream_out;
+    /* gain applied when PCM data is mixed, @ref audio_decoder_set_gain */
+    audio_mix_ramp_t gain;
+    /* called with decoded and resampled PCM data before it is mixed, NULL: not used */
+    void (*pcm_tap)(struct _audio_decoder_t *, const void *pcm, uint32_t samples, const audio_pcm_format_t *format);
 } audio_decoder_t;
 
+typedef struct {
+    /* size of mixed PCM buffer, unit is sample */
+    uint32_t total_samples;
+    /* samples written by decoders and not fetched by all outputs yet */
+    uint32_t fill_samples;
+    /* how many times outputs have to fill zero because of no enough data */
+    uint32_t underrun_cnt;
+    /* total number of zero samples filled by outputs */
+    uint32_t underrun_samples;
+    /* total number of samples attenuated by limiter */
+    uint32_t limited_samples;
+} audio_decoder_ring_status_t;
+
 typedef union {
     struct lc3_decoder_param lc3;
     struct cvsd_decoder_param cvsd;
@@ -71,7 +105,9 @@ typedef union {
  *          will be mixed into one PCM stream.
  *
  * @param   type: audio type, @ref audio_type_t.
- *          param: decoder parameters, @ref audio_decoder_param_t
+ *          param: decoder parameters, @ref audio_decoder_param_t. When type is AUDIO_TYPE_PCM
+ *                  and param is NULL, no decoder is created in DSP, PCM data should be
+ *                  written by audio_decoder_write_pcm.
  *          req_dec_cb: When available PCM data is less than a certain threshold, this
  *                  function will be call to request a new decode operation.
  *
@@ -164,12 +200,44 @@ int audio_decoder_decode(audio_decoder_t *decoder, const uint8_t *buffer, uint32
  */
 uint32_t audio_decoder_get_pcm(audio_decoder_output_t *output, int16_t *pcm, uint32_t samples, uint8_t channels);
 
+/************************************************************************************
+ * @fn      audio_decoder_get_pcm_format
+ *
+ * @brief   used by output to fetch PCM data in specified format. PCM data are mixed in
+ *          32-bit and converted into this format only once here, 24-bit and 32-bit
+ *          outputs are not truncated into 16-bit.
+ *
+ * @param   output: output handler.
+ * @param   pcm: buffer to store PCM data.
+ * @param   samples: number of request samples.
+ * @param   format: format of output buffer, only interleaved format is supported.
+ *
+ * @return  actual saved samples into buffer.
+ */
+uint32_t audio_decoder_get_pcm_format(audio_decoder_output_t *output, void *pcm, uint32_t samples, const audio_pcm_format_t *format);
+
+/************************************************************************************
+ * @fn      audio_decoder_write_pcm
+ *
+ * @brief   write PCM data into a started decoder without decoding, used by sources
+ *          carrying high resolution PCM data such as USB audio and SPDIF. The sample
+ *          rate should be the same with the output sample rate of audio decoder module.
+ *
+ * @param   decoder: decoder handler.
+ * @param   pcm: PCM buffer.
+ * @param   samples: number of samples in buffer.
+ * @param   format: format of PCM data, @ref audio_pcm_format_t.
+ *
+ * @return  PCM buffer level status of this decoder, @ref audio_ret_t.
+ */
+int audio_decoder_write_pcm(audio_decoder_t *decoder, const void *pcm, uint32_t samples, const audio_pcm_format_t *format);
+
 /************************************************************************************
  * @fn      audio_decoder_init
  *
  * @brief   Init audio decoder module.
  *
- * @param   channels: channel numbers stored in internal mixed PCM buffer.
+ * @param   channels: channel numbers stored in internal mixed PCM buffer, up to AUDIO_CHANNELS_MAX.
  * @param   out_sample_rate: PCM sample rate stored in internal mixed PCM buffer.
  *
  * @return  init result, @ref audio_ret_t.
@@ -216,6 +284,78 @@ uint32_t audio_decoder_get_missed_sample_cnt(audio_decoder_output_t *output);
  */
 void audio_decoder_clear_missed_sample_cnt(audio_decoder_output_t *output);
 
+/************************************************************************************
+ * @fn      audio_decoder_set_asrc
+ *
+ * @brief   enable or disable ASRC mode of a decoder. In ASRC mode decoded PCM data is always
+ *          resampled on MCU, and the conversion ratio is adjusted according to the level of
+ *          mixed PCM buffer to follow the clock drift between audio source and local audio
+ *          hardware. This function should be called before the decoder is started.
+ *
+ * @param   decoder: decoder handler.
+ * @param   target_ms: expected level of mixed PCM buffer, unit is ms. 0: disable ASRC mode.
+ */
+void audio_decoder_set_asrc(audio_decoder_t *decoder, uint32_t target_ms);
+
+/************************************************************************************
+ * @fn      audio_decoder_set_timestamp
+ *
+ * @brief   set receive timestamp of raw data passed to next audio_decoder_decode, it is
+ *          used to track latency of each stage, @ref audio_stats.h. Call this function
+ *          only once for each received frame.
+ *
+ * @param   decoder: decoder handler.
+ * @param   timestamp: receive timestamp, @ref audio_data_element_t.
+ */
+void audio_decoder_set_timestamp(audio_decoder_t *decoder, uint32_t timestamp);
+
+/************************************************************************************
+ * @fn      audio_decoder_set_gain
+ *
+ * @brief   change gain of a decoder. The gain is applied when decoded PCM data is mixed,
+ *          so the ramp is sample accurate in mixed PCM stream and no extra pass over
+ *          PCM data is needed. Sum of all streams is protected by a limiter, gain of
+ *          other decoders is not changed when a decoder is added or removed.
+ *
+ * @param   decoder: decoder handler.
+ * @param   gain: Q15 gain, AUDIO_MIX_GAIN_UNITY means 1.0 (default value).
+ * @param   ramp_samples: length of ramp at output sample rate, 0: change immediately.
+ * @param   curve: @ref audio_mix_ramp_curve, exponential ramp is suggested for volume
+ *                 change and ducking.
+ */
+void audio_decoder_set_gain(audio_decoder_t *decoder, int16_t gain, uint32_t ramp_samples, uint8_t curve);
+
+/************************************************************************************
+ * @fn      audio_decoder_set_pcm_tap
+ *
+ * @brief   set a handler to receive a copy of decoded PCM data of a decoder, such as
+ *          recording a tone into tone cache. PCM data is resampled to the sample rate
+ *          of audio decoder module and gain is not applied yet.
+ *
+ * @param   decoder: decoder handler.
+ * @param   tap: handler called in the context of audio_decoder_decode, NULL: disable.
+ */
+void audio_decoder_set_pcm_tap(audio_decoder_t *decoder, void (*tap)(audio_decoder_t *, const void *, uint32_t, const audio_pcm_format_t *));
+
+/************************************************************************************
+ * @fn      audio_decoder_get_sample_rate
+ *
+ * @brief   get sample rate of internal mixed PCM buffer.
+ *
+ * @return  sample rate, 0 will be returned when audio decoder module is not initialized.
+ */
+uint32_t audio_decoder_get_sample_rate(void);
+
+/************************************************************************************
+ * @fn      audio_decoder_get_ring_status
+ *
+ * @brief   get fill level and underrun counters of internal mixed PCM buffer. This
+ *          function can be called from both task and interrupt context.
+ *
+ * @param   status: used to store current status, @ref audio_decoder_ring_status_t.
+ */
+void audio_decoder_get_ring_status(audio_decoder_ring_status_t *status);
+
 
 #endif  //_AUDIO_DECODER_H
 
@@ -1,6 +1,30 @@
 #include "audio_encoder.h"
 
 #include "FreeRTOS.h"
+#include "task.h"
+
+/* exchange PCM and encoded data with DSP through shared memory rings */
+#define AUDIO_ENCODER_DSP_STREAM            0
+
+#define AUDIO_ENCODER_STREAM_IN_SIZE        4096    // PCM data ring in streaming mode, unit is byte
+#define AUDIO_ENCODER_STREAM_OUT_SIZE       2048    // encoded frame ring in streaming mode, unit is byte
+#define AUDIO_ENCODER_STREAM_WAIT_MS        5       // maximum time to wait for space of PCM data ring
+
+struct audio_encoder_frame_pool {
+    struct co_list free_list;
+    uint16_t count;
+    uint16_t used;
+    uint16_t max_length;
+    /* owner encoder is destroyed, pool is released when all frames are returned */
+    bool retired;
+};
+
+#if AUDIO_ENCODER_DSP_STREAM
+#include "dsp_ring.h"
+
+static void encoder_stream_open(audio_encoder_t *encoder);
+static void encoder_stream_close(audio_encoder_t *encoder);
+#endif
 
 audio_encoder_t *audio_encoder_init(audio_type_t type, uint8_t channels, uint32_t sample_rate, uint16_t frame_max_length, audio_encoder_param_t *param)
 {
@@ -34,11 +58,19 @@ audio_encoder_t *audio_encoder_init(audio_type_t type, uint8_t channels, uint32_
             goto __err;
     }
     encoder->resampler = NULL;
+    encoder->stream_in = NULL;
+    encoder->stream_out = NULL;
+#if AUDIO_ENCODER_DSP_STREAM
+    if (encoder->encoder) {
+        encoder_stream_open(encoder);
+    }
+#endif
     
     encoder->frame_count = 0;
     encoder->frame_max_length = frame_max_length;
     co_list_init(&encoder->frame_list);
     encoder->frame_tmp = NULL;
+    encoder->frame_pool = NULL;
     
     return encoder;
     
@@ -50,18 +82,35 @@ __err:
 void audio_encoder_destroy(audio_encoder_t *encoder)
 {
     audio_encoder_frame_t *frame;
+    struct audio_encoder_frame_pool *pool = encoder->frame_pool;
 
     if (encoder->frame_tmp) {
-        vPortFree(encoder->frame_tmp);
+        audio_encoder_frame_release(encoder->frame_tmp);
     }
 
     do {
         frame = (void *)co_list_pop_front(&encoder->frame_list);
         if (frame) {
-            vPortFree(frame);
+            audio_encoder_frame_release(frame);
         }
     } while (frame);
+
+    if (pool) {
+        /* frames popped by user may be still in use */
+        GLOBAL_INT_DISABLE();
+        pool->retired = true;
+        if (pool->used) {
+            pool = NULL;
+        }
+        GLOBAL_INT_RESTORE();
+        if (pool) {
+            vPortFree(pool);
+        }
+    }
     
+#if AUDIO_ENCODER_DSP_STREAM
+    encoder_stream_close(encoder);
+#endif
     codec_encoder_destroy(encoder->encoder);
     if (encoder->resampler) {
         resample_destroy(encoder->resampler);
@@ -70,6 +119,32 @@ void audio_encoder_destroy(audio_encoder_t *encoder)
     vPortFree(encoder);
 }
 
+static audio_encoder_frame_t *frame_alloc(audio_encoder_t *encoder, uint32_t length)
+{
+    struct audio_encoder_frame_pool *pool = encoder->frame_pool;
+    audio_encoder_frame_t *frame = NULL;
+
+    if (pool && (length <= pool->max_length)) {
+        GLOBAL_INT_DISABLE();
+        frame = (void *)co_list_pop_front(&pool->free_list);
+        if (frame) {
+            pool->used++;
+        }
+        GLOBAL_INT_RESTORE();
+        if (frame) {
+            frame->pool = pool;
+            return frame;
+        }
+    }
+
+    frame = pvPortMalloc(sizeof(audio_encoder_frame_t) + length);
+    if (frame) {
+        frame->pool = NULL;
+    }
+
+    return frame;
+}
+
 static void save_encoded_data(audio_encoder_t *encoder, const uint8_t *buffer, uint32_t length)
 {
     if (encoder->frame_tmp) {
@@ -97,10 +172,10 @@ static void save_encoded_data(audio_encoder_t *encoder, const uint8_t *buffer, u
         audio_encoder_frame_t *frame;
 
         if (encoder->frame_max_length == FRAME_MAX_LENGTH_FIT_SINGLE) {
-            frame = pvPortMalloc(sizeof(audio_encoder_frame_t) + length);
+            frame = frame_alloc(encoder, length);
         }
         else {
-            frame = pvPortMalloc(sizeof(audio_encoder_frame_t) + encoder->frame_max_length);
+            frame = frame_alloc(encoder, encoder->frame_max_length);
         }
         if (frame) {
             memcpy(&frame->data[0], buffer, length);
@@ -118,6 +193,97 @@ static void save_encoded_data(audio_encoder_t *encoder, const uint8_t *buffer, u
     }
 }
 
+#if AUDIO_ENCODER_DSP_STREAM
+static void encoder_stream_open(audio_encoder_t *encoder)
+{
+    uint8_t stream_id;
+    dsp_ring_t *in, *out;
+
+    stream_id = dsp_ring_stream_alloc();
+    if (stream_id == DSP_RING_STREAM_ID_INVALID) {
+        return;
+    }
+
+    in = dsp_ring_create(stream_id, DSP_RING_DIR_TO_DSP, AUDIO_ENCODER_STREAM_IN_SIZE);
+    out = dsp_ring_create(stream_id, DSP_RING_DIR_FROM_DSP, AUDIO_ENCODER_STREAM_OUT_SIZE);
+    if (in && out
+            && (codec_encoder_stream_attach(encoder->encoder, dsp_ring_get_dsp_addr(in), dsp_ring_get_dsp_addr(out)) == CODEC_ERROR_NO_ERROR)) {
+        encoder->stream_in = in;
+        encoder->stream_out = out;
+        return;
+    }
+
+    /* streaming mode is not supported by DSP, keep using call mode */
+    dsp_ring_destroy(in);
+    dsp_ring_destroy(out);
+    dsp_ring_stream_free(stream_id);
+}
+
+static void encoder_stream_close(audio_encoder_t *encoder)
+{
+    uint8_t stream_id;
+
+    if (encoder->stream_in == NULL) {
+        return;
+    }
+
+    codec_encoder_stream_attach(encoder->encoder, 0, 0);
+
+    stream_id = encoder->stream_in->stream_id;
+    dsp_ring_destroy(encoder->stream_in);
+    dsp_ring_destroy(encoder->stream_out);
+    dsp_ring_stream_free(stream_id);
+    encoder->stream_in = NULL;
+    encoder->stream_out = NULL;
+}
+
+/* fetch all encoded frames from output ring, frame data may be split at the end of ring */
+static void encoder_stream_drain(audio_encoder_t *encoder)
+{
+    struct codec_stream_frame_hdr hdr;
+    uint32_t length, count;
+    uint8_t *data;
+
+    while (dsp_ring_read(encoder->stream_out, &hdr, sizeof(hdr)) == sizeof(hdr)) {
+        length = hdr.length;
+        while (length) {
+            count = dsp_ring_peek(encoder->stream_out, &data);
+            if (count == 0) {
+                break;
+            }
+            if (count > length) {
+                count = length;
+            }
+            save_encoded_data(encoder, data, count);
+            dsp_ring_consume(encoder->stream_out, count);
+            length -= count;
+        }
+        dsp_ring_consume(encoder->stream_out, ((hdr.length + 3) & ~3) - hdr.length);
+    }
+}
+
+/* write PCM data into input ring, wait for a while when DSP is not fast enough */
+static bool encoder_stream_feed(audio_encoder_t *encoder, const uint8_t *buffer, uint32_t length)
+{
+    uint32_t wait_ms = 0;
+
+    while (1) {
+        uint32_t written = dsp_ring_write(encoder->stream_in, buffer, length);
+
+        buffer += written;
+        length -= written;
+        encoder_stream_drain(encoder);
+        if (length == 0) {
+            return true;
+        }
+        if (wait_ms++ >= AUDIO_ENCODER_STREAM_WAIT_MS) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+}
+#endif
+
 int audio_encoder_encode(audio_encoder_t *encoder, const uint8_t *buffer, uint32_t length, uint8_t channels, uint32_t sample_rate)
 {
     if ((encoder == NULL)
@@ -151,6 +317,14 @@ int audio_encoder_encode(audio_encoder_t *encoder, const uint8_t *buffer, uint32
             uint32_t output_length;
             uint8_t *out_buffer = NULL;
             resample_exec(encoder->resampler, buffer, &input_length, &out_buffer, &output_length);
+#if AUDIO_ENCODER_DSP_STREAM
+            if (encoder->stream_in) {
+                if (encoder_stream_feed(encoder, out_buffer, output_length) == false) {
+                    return AUDIO_RET_FAILED;
+                }
+                output_length = 0;
+            }
+#endif
             while (output_length) {
                 uint32_t encode_input_length = output_length;
                 uint32_t encode_output_length;
@@ -165,6 +339,14 @@ int audio_encoder_encode(audio_encoder_t *encoder, const uint8_t *buffer, uint32
             buffer += input_length;
             length -= input_length;
         }
+#if AUDIO_ENCODER_DSP_STREAM
+        else if (encoder->stream_in) {
+            if (encoder_stream_feed(encoder, buffer, length) == false) {
+                return AUDIO_RET_FAILED;
+            }
+            length = 0;
+        }
+#endif
         else {
             uint32_t encode_input_length = length;
             uint32_t encode_output_length = 0;
@@ -219,7 +401,127 @@ audio_encoder_frame_t *audio_encoder_frame_pop(audio_encoder_t *encoder)
 
 void audio_encoder_frame_release(audio_encoder_frame_t *frame)
 {
-    if (frame) {
+    struct audio_encoder_frame_pool *pool;
+
+    if (frame == NULL) {
+        return;
+    }
+
+    pool = frame->pool;
+    if (pool == NULL) {
         vPortFree(frame);
+        return;
+    }
+
+    GLOBAL_INT_DISABLE();
+    co_list_push_front(&pool->free_list, &frame->hdr);
+    pool->used--;
+    if ((pool->retired == false) || pool->used) {
+        pool = NULL;
+    }
+    GLOBAL_INT_RESTORE();
+
+    if (pool) {
+        vPortFree(pool);
+    }
+}
+
+bool audio_encoder_frame_pool_create(audio_encoder_t *encoder, uint16_t count, uint16_t max_length)
+{
+    struct audio_encoder_frame_pool *pool;
+    uint32_t frame_size;
+
+    if ((encoder == NULL) || encoder->frame_pool || (count == 0)) {
+        return false;
+    }
+
+    frame_size = (sizeof(audio_encoder_frame_t) + max_length + 3) & (~3);
+    pool = pvPortMalloc(sizeof(struct audio_encoder_frame_pool) + frame_size * count);
+    if (pool == NULL) {
+        return false;
     }
+
+    pool->count = count;
+    pool->used = 0;
+    pool->max_length = max_length;
+    pool->retired = false;
+    co_list_pool_init(&pool->free_list, &pool[1], frame_size, count, NULL, POOL_LINKED_LIST);
+
+    encoder->frame_pool = pool;
+
+    return true;
+}
+
+static void rtp_header_write(uint8_t *packet, audio_encoder_rtp_t *rtp)
+{
+    packet[0] = AUDIO_ENCODER_RTP_VERSION;
+    packet[1] = rtp->payload_type & 0x7f;
+    packet[2] = rtp->seq_num >> 8;
+    packet[3] = rtp->seq_num;
+    packet[4] = rtp->timestamp >> 24;
+    packet[5] = rtp->timestamp >> 16;
+    packet[6] = rtp->timestamp >> 8;
+    packet[7] = rtp->timestamp;
+    packet[8] = rtp->ssrc >> 24;
+    packet[9] = rtp->ssrc >> 16;
+    packet[10] = rtp->ssrc >> 8;
+    packet[11] = rtp->ssrc;
+}
+
+uint16_t audio_encoder_pack_a2dp(audio_encoder_t *encoder, audio_encoder_rtp_t *rtp, uint8_t *packet, uint16_t mtu)
+{
+    audio_encoder_frame_t *frame;
+    uint16_t offset, max_frames;
+    uint8_t frames = 0;
+    bool is_sbc;
+
+    if ((encoder == NULL) || (encoder->frame_count == 0)) {
+        return 0;
+    }
+
+    is_sbc = (encoder->type == AUDIO_TYPE_SBC) || (encoder->type == AUDIO_TYPE_SBC_V2);
+    if (is_sbc) {
+        offset = AUDIO_ENCODER_RTP_HEADER_LENGTH + AUDIO_ENCODER_SBC_HEADER_LENGTH;
+        max_frames = AUDIO_ENCODER_SBC_MAX_PACKET_FRAMES;
+    }
+    else {
+        offset = AUDIO_ENCODER_RTP_HEADER_LENGTH;
+        max_frames = 1;
+    }
+
+    while (frames < max_frames) {
+        GLOBAL_INT_DISABLE();
+        frame = (void *)co_list_pick(&encoder->frame_list);
+        GLOBAL_INT_RESTORE();
+        if (frame == NULL) {
+            break;
+        }
+
+        if ((offset + frame->length) > mtu) {
+            if (frames) {
+                break;
+            }
+            /* this frame can never be sent with this mtu */
+            audio_encoder_frame_release(audio_encoder_frame_pop(encoder));
+            continue;
+        }
+
+        memcpy(&packet[offset], frame->data, frame->length);
+        offset += frame->length;
+        frames++;
+        audio_encoder_frame_release(audio_encoder_frame_pop(encoder));
+    }
+
+    if (frames == 0) {
+        return 0;
+    }
+
+    rtp_header_write(packet, rtp);
+    if (is_sbc) {
+        packet[AUDIO_ENCODER_RTP_HEADER_LENGTH] = frames & 0x0f;
+    }
+    rtp->seq_num++;
+    rtp->timestamp += (uint32_t)rtp->frame_samples * frames;
+
+    return offset;
 }
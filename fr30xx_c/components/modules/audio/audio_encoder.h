@@ -2,6 +2,7 @@
 #define _AUDIO_ENCODER_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "co_list.h"
 #include "codec.h"
@@ -16,13 +17,34 @@
  */
 #define FRAME_MAX_LENGTH_FIT_SINGLE         0xFFFF
 
+/* A2DP media packet: RTP header followed by media payload header (SBC only) and frames */
+#define AUDIO_ENCODER_RTP_HEADER_LENGTH     12
+#define AUDIO_ENCODER_SBC_HEADER_LENGTH     1
+/* number of frames field in SBC media payload header is 4 bits */
+#define AUDIO_ENCODER_SBC_MAX_PACKET_FRAMES 15
+#define AUDIO_ENCODER_RTP_VERSION           0x80
+
+struct audio_encoder_frame_pool;
+
 typedef struct {
     struct co_list_hdr hdr;
     
+    /* pool this frame belongs to, NULL: allocated from heap */
+    struct audio_encoder_frame_pool *pool;
     uint16_t length;
     uint8_t data[];
 } audio_encoder_frame_t;
 
+/* RTP state of an A2DP stream, updated by audio_encoder_pack_a2dp */
+typedef struct {
+    uint16_t seq_num;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    uint8_t payload_type;
+    /* timestamp increment of each frame, unit is sample */
+    uint16_t frame_samples;
+} audio_encoder_rtp_t;
+
 typedef union {
     struct sbc_encoder_param sbc;
     struct aac_encoder_param aac;
@@ -40,11 +62,16 @@ typedef struct {
     
     void *encoder;
     void *resampler;
+    /* shared memory rings in streaming mode, NULL: PCM data is encoded by calling DSP */
+    struct dsp_ring *stream_in;
+    struct dsp_ring *stream_out;
     
     uint8_t frame_count;
     uint16_t frame_max_length;
     struct co_list frame_list;
     audio_encoder_frame_t *frame_tmp;
+    /* preallocated frames, NULL: frames are allocated from heap */
+    struct audio_encoder_frame_pool *frame_pool;
 } audio_encoder_t;
 
 /************************************************************************************
@@ -117,4 +144,37 @@ audio_encoder_frame_t *audio_encoder_frame_pop(audio_encoder_t *encoder);
  */
 void audio_encoder_frame_release(audio_encoder_frame_t *frame);
 
+/************************************************************************************
+ * @fn      audio_encoder_frame_pool_create
+ *
+ * @brief   Preallocate encoded frames for an encoder. Frames longer than max_length
+ *          or requested when pool is exhausted are still allocated from heap. The
+ *          pool is released when encoder is destroyed and all frames are returned.
+ *
+ * @param   encoder: encoder handler.
+ * @param   count: number of frames in pool.
+ * @param   max_length: maximum data length of frames in pool, unit is byte.
+ *
+ * @return  true: pool is created, false: failed.
+ */
+bool audio_encoder_frame_pool_create(audio_encoder_t *encoder, uint16_t count, uint16_t max_length);
+
+/************************************************************************************
+ * @fn      audio_encoder_pack_a2dp
+ *
+ * @brief   Pack stored frames into an A2DP media packet: RTP header, SBC media payload
+ *          header and as many frames as fit in mtu. For AAC only one frame is packed
+ *          per packet. Each stored frame should hold exactly one codec frame, so the
+ *          encoder should be initialized with frame_max_length equal to SBC frame
+ *          length or FRAME_MAX_LENGTH_FIT_SINGLE. Frames larger than mtu are dropped.
+ *
+ * @param   encoder: encoder handler.
+ * @param   rtp: RTP state of this stream, sequence number and timestamp are updated.
+ * @param   packet: buffer to store the packet, the size should be at least mtu.
+ * @param   mtu: maximum packet length, unit is byte.
+ *
+ * @return  length of the packet, 0 means no frame is packed.
+ */
+uint16_t audio_encoder_pack_a2dp(audio_encoder_t *encoder, audio_encoder_rtp_t *rtp, uint8_t *packet, uint16_t mtu);
+
 #endif  //_AUDIO_ENCODER_H
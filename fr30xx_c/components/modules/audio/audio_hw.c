@@ -54,6 +54,7 @@ static void i2s_rx_callback(I2S_HandleTypeDef *i2s_handle)
         }
         
         hw->wr_ptr += I2S_FIFO_HALF_DEPTH;
+        hw->wr_total += I2S_FIFO_HALF_DEPTH;
         if (hw->wr_ptr >= hw->pcm_samples) {
             hw->wr_ptr = 0;
         }
@@ -123,6 +124,7 @@ static void pdm_rx_callback(PDM_HandleTypeDef *pdm_handle)
         /* store data into internal buffer */
         pdm_read_data(pdm_handle, (void *)&hw->pcm[hw->channels * sizeof(int16_t) * hw->wr_ptr]);
         hw->wr_ptr += AUDIO_HW_PDM_RX_INT_LEVEL;
+        hw->wr_total += AUDIO_HW_PDM_RX_INT_LEVEL;
         if (hw->wr_ptr >= hw->pcm_samples) {
             hw->wr_ptr = 0;
         }
@@ -216,6 +218,8 @@ audio_hw_t *audio_hw_create(audio_hw_type_t type, audio_hw_request_pcm_t handler
     tmp->request_handler = handler;
     tmp->pcm_out = NULL;
     tmp->wr_ptr = 0;
+    tmp->wr_total = 0;
+    tmp->wr_block = 0;
     co_list_init(&tmp->output_list);
     tmp->pcm = NULL;
 
@@ -285,6 +289,7 @@ audio_hw_t *audio_hw_create(audio_hw_type_t type, audio_hw_request_pcm_t handler
                 /* Initialize and start I2S */
                 i2s_init(i2s_handle);
                 if (dir & AUDIO_HW_DIR_IN) {
+                    tmp->wr_block = I2S_FIFO_HALF_DEPTH;
                     tmp->pcm_samples = I2S_FIFO_HALF_DEPTH * AUDIO_HW_STORE_FRAME_COUNT;
                     tmp->pcm = (void *)pvPortMalloc(sizeof(int16_t) * channels * tmp->pcm_samples);
                     if (tmp->pcm == NULL) {
@@ -327,6 +332,7 @@ audio_hw_t *audio_hw_create(audio_hw_type_t type, audio_hw_request_pcm_t handler
                     goto __err;
                 }
                 tmp->hw_handle = pdm_handle;
+                tmp->wr_block = AUDIO_HW_PDM_RX_INT_LEVEL;
                 tmp->pcm_samples = AUDIO_HW_PDM_RX_INT_LEVEL * AUDIO_HW_STORE_FRAME_COUNT;
                 tmp->pcm = (void *)pvPortMalloc(sizeof(int16_t) * channels * tmp->pcm_samples);
                 if (tmp->pcm == NULL) {
@@ -584,6 +590,9 @@ audio_hw_output_t *audio_hw_output_add(audio_hw_t *hw, audio_hw_receive_pcm_ntf_
         output->audio_hw = hw;
         output->handler = handler;
         output->rd_ptr = hw->wr_ptr;
+        output->rd_total = hw->wr_total;
+        output->view_samples = 0;
+        output->overrun_cnt = 0;
         co_list_push_back(&hw->output_list, &output->hdr);
         GLOBAL_INT_RESTORE();
     }
@@ -650,12 +659,56 @@ static void *copy_pcm(audio_hw_output_t *output, void *pcm, uint32_t samples, ui
     return pcm;
 }
 
+/*
+ * skip unread samples overwritten by hardware, region of next hardware update is
+ * treated as overwritten too. return unread samples of this output.
+ */
+static uint32_t audio_hw_output_sync(audio_hw_output_t *output)
+{
+    audio_hw_t *hw = output->audio_hw;
+    uint32_t wr_total;
+    uint32_t unread, limit;
+
+    GLOBAL_INT_DISABLE();
+    wr_total = hw->wr_total;
+    GLOBAL_INT_RESTORE();
+
+    unread = wr_total - output->rd_total;
+    limit = hw->pcm_samples - hw->wr_block;
+    if (unread > limit) {
+        uint32_t skip = unread - limit;
+
+        output->overrun_cnt++;
+        output->rd_total += skip;
+        output->rd_ptr += skip % hw->pcm_samples;
+        if (output->rd_ptr >= hw->pcm_samples) {
+            output->rd_ptr -= hw->pcm_samples;
+        }
+        unread = limit;
+    }
+
+    return unread;
+}
+
+static void audio_hw_output_advance(audio_hw_output_t *output, uint32_t samples)
+{
+    audio_hw_t *hw = output->audio_hw;
+
+    output->rd_total += samples;
+    output->rd_ptr += samples;
+    if (output->rd_ptr >= hw->pcm_samples) {
+        output->rd_ptr -= hw->pcm_samples;
+    }
+}
+
 uint32_t audio_hw_read_pcm(audio_hw_output_t *output, void *pcm, uint32_t samples, uint8_t channels)
 {
     audio_hw_t *hw = output->audio_hw;
     uint32_t tail_samples;
     uint32_t read_samples = 0;
 
+    audio_hw_output_sync(output);
+
     tail_samples = hw->pcm_samples - output->rd_ptr;
     if (tail_samples <= samples) {
         pcm = copy_pcm(output, pcm, tail_samples, channels);
@@ -668,7 +721,66 @@ uint32_t audio_hw_read_pcm(audio_hw_output_t *output, void *pcm, uint32_t sample
         output->rd_ptr += samples;
         read_samples += samples;
     }
+    output->rd_total += read_samples;
 
     return read_samples;
 }
 
+uint32_t audio_hw_view_acquire(audio_hw_output_t *output, audio_hw_view_t *view, uint32_t samples)
+{
+    audio_hw_t *hw = output->audio_hw;
+    const int16_t *pcm = (const int16_t *)hw->pcm;
+    uint32_t unread, tail_samples;
+
+    unread = audio_hw_output_sync(output);
+    if (samples > unread) {
+        samples = unread;
+    }
+
+    view->channels = hw->channels;
+    view->data[0] = samples ? &pcm[output->rd_ptr * hw->channels] : NULL;
+    tail_samples = hw->pcm_samples - output->rd_ptr;
+    if (samples > tail_samples) {
+        view->samples[0] = tail_samples;
+        view->data[1] = pcm;
+        view->samples[1] = samples - tail_samples;
+    }
+    else {
+        view->samples[0] = samples;
+        view->data[1] = NULL;
+        view->samples[1] = 0;
+    }
+    output->view_samples = samples;
+
+    return samples;
+}
+
+bool audio_hw_view_release(audio_hw_output_t *output, uint32_t samples)
+{
+    audio_hw_t *hw = output->audio_hw;
+    uint32_t wr_total;
+    bool valid = true;
+
+    if (samples > output->view_samples) {
+        samples = output->view_samples;
+    }
+
+    /* check whether hardware has reached the start of this view during it is held */
+    GLOBAL_INT_DISABLE();
+    wr_total = hw->wr_total;
+    GLOBAL_INT_RESTORE();
+    if ((wr_total - output->rd_total) > (hw->pcm_samples - hw->wr_block)) {
+        output->overrun_cnt++;
+        valid = false;
+    }
+
+    audio_hw_output_advance(output, samples);
+    output->view_samples = 0;
+
+    return valid;
+}
+
+uint32_t audio_hw_output_get_overrun(audio_hw_output_t *output)
+{
+    return output->overrun_cnt;
+}
@@ -2,6 +2,7 @@
 #define _AUDIO_HW_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "co_list.h"
 
@@ -38,6 +39,8 @@ typedef struct {
 
     /* used for input mode */
     uint32_t wr_ptr;        /* unit is sample */
+    uint32_t wr_total;      /* free running counter of samples written by hardware */
+    uint32_t wr_block;      /* samples written by hardware in each update */
     struct co_list output_list;
     uint32_t pcm_samples;   /* unit is sample */
     uint8_t *pcm;
@@ -49,8 +52,23 @@ typedef struct {
     audio_hw_t *audio_hw;
     audio_hw_receive_pcm_ntf_t handler;
     uint32_t rd_ptr;    /* unit is sample */
+    uint32_t rd_total;  /* free running counter of samples consumed by this reader */
+    uint32_t view_samples;  /* samples in view acquired and not released yet */
+    uint32_t overrun_cnt;   /* how many times unread samples are overwritten by hardware */
 } audio_hw_output_t;
 
+/*
+ * Read-only view of samples in the capture buffer of an audio hardware, no copy
+ * is involved. The view may be split into two spans when it crosses the end of
+ * the ring. Samples are in the format of hardware: interleaved int16_t with
+ * channels of hardware.
+ */
+typedef struct {
+    const int16_t *data[2]; /* start of each span, NULL when the span is empty */
+    uint32_t samples[2];    /* unit is sample */
+    uint8_t channels;
+} audio_hw_view_t;
+
 /*
  * @fn          audio_hw_create
  *
@@ -112,4 +130,44 @@ void audio_hw_output_remove(audio_hw_t *hw, audio_hw_output_t *output);
  */
 uint32_t audio_hw_read_pcm(audio_hw_output_t *output, void *pcm, uint32_t samples, uint8_t channels);
 
+/*
+ * @fn          audio_hw_view_acquire
+ *
+ * @brief       get a view of unread samples of an output without copy. The samples stay
+ *              valid until hardware writes one more update after audio_hw_view_acquire,
+ *              so the view should be released soon. When hardware has overwritten unread
+ *              samples, they are skipped and overrun_cnt of this output is increased.
+ *
+ * @param[in]   output: pointer to the output structure added to hardware output list before.
+ * @param[out]  view: used to store the spans of samples.
+ * @param[in]   samples: maximum samples wanted to be read.
+ *
+ * @return      samples in the view, it may be less than wanted.
+ */
+uint32_t audio_hw_view_acquire(audio_hw_output_t *output, audio_hw_view_t *view, uint32_t samples);
+
+/*
+ * @fn          audio_hw_view_release
+ *
+ * @brief       mark samples at the start of acquired view as consumed.
+ *
+ * @param[in]   output: pointer to the output structure added to hardware output list before.
+ * @param[in]   samples: consumed samples, should not be larger than samples in the view.
+ *
+ * @return      false when samples in the view are overwritten by hardware before released,
+ *              overrun_cnt of this output is increased in this case.
+ */
+bool audio_hw_view_release(audio_hw_output_t *output, uint32_t samples);
+
+/*
+ * @fn          audio_hw_output_get_overrun
+ *
+ * @brief       get how many times unread samples of an output are overwritten by hardware.
+ *
+ * @param[in]   output: pointer to the output structure added to hardware output list before.
+ *
+ * @return      overrun count.
+ */
+uint32_t audio_hw_output_get_overrun(audio_hw_output_t *output);
+
 #endif  // _AUDIO_HW_H
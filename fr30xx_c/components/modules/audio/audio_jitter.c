@@ -0,0 +1,275 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+
+#include "audio_jitter.h"
+#include "audio_scene.h"
+
+#define AUDIO_JITTER_MASK                   (AUDIO_JITTER_SLOTS - 1)
+
+/* sequence jump larger than this is treated as restart of stream */
+#define AUDIO_JITTER_RESYNC_THD             (AUDIO_JITTER_SLOTS * 4)
+
+static void audio_jitter_flush(audio_jitter_t *jitter)
+{
+    for (uint32_t i = 0; i < AUDIO_JITTER_SLOTS; i++) {
+        if (jitter->slots[i]) {
+            audio_scene_frame_free(jitter->slots[i]);
+            jitter->slots[i] = NULL;
+            jitter->status.dropped++;
+        }
+    }
+    jitter->count = 0;
+    jitter->started = false;
+}
+
+static void audio_jitter_update_target(audio_jitter_t *jitter)
+{
+    uint32_t target = jitter->min_depth;
+
+    if (jitter->interval) {
+        uint32_t jitter_us = jitter->jitter_q4 >> 4;
+        target = 1 + (jitter_us * AUDIO_JITTER_DEPTH_FACTOR + jitter->interval - 1) / jitter->interval;
+    }
+    target += jitter->boost;
+
+    if (target < jitter->min_depth) {
+        target = jitter->min_depth;
+    }
+    if (target > jitter->max_depth) {
+        target = jitter->max_depth;
+    }
+    jitter->target = target;
+}
+
+static void audio_jitter_add_boost(audio_jitter_t *jitter)
+{
+    if ((jitter->min_depth + jitter->boost) < jitter->max_depth) {
+        jitter->boost++;
+    }
+    jitter->boost_cnt = 0;
+    audio_jitter_update_target(jitter);
+}
+
+static void audio_jitter_estimate(audio_jitter_t *jitter, uint16_t seq, uint32_t stamp)
+{
+    int32_t d;
+
+    /* timestamp is not available when audio statistics is disabled */
+    if ((stamp == 0) || (jitter->interval == 0)) {
+        return;
+    }
+
+    if (jitter->last_valid) {
+        /* difference of transit time between this frame and last one */
+        d = (int32_t)(stamp - jitter->last_stamp) - (int32_t)(int16_t)(seq - jitter->last_seq) * (int32_t)jitter->interval;
+        if (d < 0) {
+            d = -d;
+        }
+        jitter->jitter_q4 += d - ((jitter->jitter_q4 + 8) >> 4);
+        audio_jitter_update_target(jitter);
+    }
+    jitter->last_valid = true;
+    jitter->last_seq = seq;
+    jitter->last_stamp = stamp;
+}
+
+audio_jitter_t *audio_jitter_create(uint32_t interval, uint8_t min_depth, uint8_t max_depth)
+{
+    audio_jitter_t *jitter;
+
+    if (max_depth >= AUDIO_JITTER_SLOTS) {
+        max_depth = AUDIO_JITTER_SLOTS - 1;
+    }
+    if (min_depth == 0) {
+        min_depth = 1;
+    }
+    if (min_depth > max_depth) {
+        return NULL;
+    }
+
+    jitter = pvPortMalloc(sizeof(audio_jitter_t));
+    if (jitter == NULL) {
+        return NULL;
+    }
+
+    memset((void *)jitter, 0, sizeof(audio_jitter_t));
+    jitter->interval = interval;
+    jitter->min_depth = min_depth;
+    jitter->max_depth = max_depth;
+    jitter->target = min_depth;
+
+    return jitter;
+}
+
+void audio_jitter_destroy(audio_jitter_t *jitter)
+{
+    if (jitter == NULL) {
+        return;
+    }
+
+    audio_jitter_flush(jitter);
+    vPortFree(jitter);
+}
+
+void audio_jitter_set_interval(audio_jitter_t *jitter, uint32_t interval)
+{
+    jitter->interval = interval;
+    jitter->last_valid = false;
+    audio_jitter_update_target(jitter);
+}
+
+uint32_t audio_jitter_get_interval(audio_jitter_t *jitter)
+{
+    return jitter->interval;
+}
+
+void audio_jitter_put(audio_jitter_t *jitter, audio_data_element_t *elt)
+{
+    uint16_t seq;
+    int16_t diff;
+
+    if (elt->seq_valid) {
+        seq = elt->seq;
+    }
+    else {
+        seq = jitter->in_seq++;
+    }
+
+    if (jitter->seq_inited == false) {
+        jitter->seq_inited = true;
+        jitter->next_seq = seq;
+    }
+
+    diff = (int16_t)(seq - jitter->next_seq);
+    if ((diff >= AUDIO_JITTER_RESYNC_THD) || (diff <= -AUDIO_JITTER_RESYNC_THD)) {
+        /* sequence of remote device is restarted */
+        audio_jitter_flush(jitter);
+        jitter->next_seq = seq;
+        jitter->last_valid = false;
+        diff = 0;
+    }
+    else if (diff < 0) {
+        /* playout time of this frame is passed, more depth is needed */
+        jitter->status.late++;
+        audio_jitter_add_boost(jitter);
+        audio_scene_frame_free(elt);
+        return;
+    }
+
+    /* no space for this frame, drop the oldest ones */
+    while (diff >= AUDIO_JITTER_SLOTS) {
+        audio_data_element_t **slot = &jitter->slots[jitter->next_seq & AUDIO_JITTER_MASK];
+        if (*slot) {
+            audio_scene_frame_free(*slot);
+            *slot = NULL;
+            jitter->count--;
+        }
+        jitter->status.dropped++;
+        jitter->next_seq++;
+        diff--;
+    }
+
+    if (jitter->slots[seq & AUDIO_JITTER_MASK]) {
+        jitter->status.duplicate++;
+        audio_scene_frame_free(elt);
+        return;
+    }
+
+    jitter->slots[seq & AUDIO_JITTER_MASK] = elt;
+    jitter->count++;
+    jitter->status.received++;
+
+    audio_jitter_estimate(jitter, seq, elt->timestamp);
+}
+
+uint8_t audio_jitter_get(audio_jitter_t *jitter, audio_data_element_t **elt)
+{
+    audio_data_element_t **slot;
+
+    if (jitter->started == false) {
+        if (jitter->count < jitter->target) {
+            return AUDIO_JITTER_EMPTY;
+        }
+        jitter->started = true;
+        /* skip lost frames before the first received one */
+        while (jitter->slots[jitter->next_seq & AUDIO_JITTER_MASK] == NULL) {
+            jitter->next_seq++;
+        }
+    }
+
+    if (++jitter->boost_cnt >= AUDIO_JITTER_BOOST_DECAY) {
+        jitter->boost_cnt = 0;
+        if (jitter->boost) {
+            jitter->boost--;
+            audio_jitter_update_target(jitter);
+        }
+    }
+
+    slot = &jitter->slots[jitter->next_seq & AUDIO_JITTER_MASK];
+    if (*slot) {
+        *elt = *slot;
+        *slot = NULL;
+        jitter->count--;
+        jitter->next_seq++;
+        if ((*elt)->valid) {
+            jitter->status.played++;
+        }
+        else {
+            jitter->status.concealed++;
+        }
+
+        /* reduce latency slowly when depth is larger than needed */
+        if (jitter->count > (jitter->target + 1)) {
+            if (++jitter->shrink_cnt >= AUDIO_JITTER_SHRINK_PERIOD) {
+                jitter->shrink_cnt = 0;
+                slot = &jitter->slots[jitter->next_seq & AUDIO_JITTER_MASK];
+                if (*slot) {
+                    audio_scene_frame_free(*slot);
+                    *slot = NULL;
+                    jitter->count--;
+                    jitter->next_seq++;
+                    jitter->status.dropped++;
+                }
+            }
+        }
+        else {
+            jitter->shrink_cnt = 0;
+        }
+
+        return AUDIO_JITTER_FRAME;
+    }
+
+    if (jitter->count == 0) {
+        /* nothing is received, buffering again with more depth */
+        jitter->started = false;
+        jitter->status.underrun++;
+        audio_jitter_add_boost(jitter);
+        return AUDIO_JITTER_EMPTY;
+    }
+
+    if (jitter->count < jitter->target) {
+        /* give reordered frame a chance to arrive */
+        return AUDIO_JITTER_EMPTY;
+    }
+
+    jitter->next_seq++;
+    jitter->status.concealed++;
+
+    return AUDIO_JITTER_LOST;
+}
+
+void audio_jitter_get_status(audio_jitter_t *jitter, audio_jitter_status_t *status)
+{
+    uint32_t total;
+
+    *status = jitter->status;
+    status->depth = jitter->count;
+    status->target = jitter->target;
+    status->jitter = jitter->jitter_q4 >> 4;
+
+    total = status->played + status->concealed;
+    status->conceal_rate = total ? (uint16_t)((uint64_t)status->concealed * 1000 / total) : 0;
+}
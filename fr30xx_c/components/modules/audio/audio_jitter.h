@@ -0,0 +1,160 @@
+#ifndef _AUDIO_JITTER_H
+#define _AUDIO_JITTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "audio_common.h"
+
+/*
+ * Jitter buffer for voice frames (CVSD, mSBC, LC3). Received frames are stored
+ * by sequence number, out-of-order frames are reordered and duplicated or late
+ * frames are dropped. Playout depth follows arrival jitter estimated from the
+ * timestamp of each frame (RFC 3550 style), missing frames are reported to caller
+ * so that PLC is only used for frames which are really lost.
+ */
+
+/* maximum frames held in jitter buffer, should be power of 2 */
+#define AUDIO_JITTER_SLOTS                  16
+/* playout depth = 1 + jitter * AUDIO_JITTER_DEPTH_FACTOR / frame interval */
+#define AUDIO_JITTER_DEPTH_FACTOR           3
+/* one frame is dropped when depth stays above target for this number of frames */
+#define AUDIO_JITTER_SHRINK_PERIOD          64
+/* extra depth added after underrun or late frame decays after this number of frames */
+#define AUDIO_JITTER_BOOST_DECAY            256
+
+enum audio_jitter_result {
+    AUDIO_JITTER_FRAME,         // a frame is returned, frames with valid == false should be concealed
+    AUDIO_JITTER_LOST,          // next frame is lost, PLC should be used for one frame
+    AUDIO_JITTER_EMPTY,         // buffering, no frame should be played now
+};
+
+typedef struct {
+    /* frames in buffer and current target depth */
+    uint8_t depth;
+    uint8_t target;
+    /* estimated arrival jitter, unit is us */
+    uint32_t jitter;
+
+    uint32_t received;
+    uint32_t played;
+    /* frames concealed by PLC, including lost and invalid ones */
+    uint32_t concealed;
+    /* frames arrived after their playout time */
+    uint32_t late;
+    uint32_t duplicate;
+    /* frames dropped because of overflow or depth shrinking */
+    uint32_t dropped;
+    uint32_t underrun;
+    /* concealed / (played + concealed), unit is 1/1000 */
+    uint16_t conceal_rate;
+} audio_jitter_status_t;
+
+typedef struct {
+    audio_data_element_t *slots[AUDIO_JITTER_SLOTS];
+    uint8_t count;
+
+    uint8_t min_depth;
+    uint8_t max_depth;
+    uint8_t target;
+    uint8_t boost;
+    uint16_t boost_cnt;
+    uint16_t shrink_cnt;
+    bool started;
+
+    /* sequence number of next frame to be played */
+    bool seq_inited;
+    uint16_t next_seq;
+    /* generated for frames without sequence number */
+    uint16_t in_seq;
+
+    /* nominal frame interval, unit is us */
+    uint32_t interval;
+    bool last_valid;
+    uint16_t last_seq;
+    uint32_t last_stamp;
+    /* jitter in Q4 */
+    uint32_t jitter_q4;
+
+    audio_jitter_status_t status;
+} audio_jitter_t;
+
+/************************************************************************************
+ * @fn      audio_jitter_create
+ *
+ * @brief   create a jitter buffer.
+ *
+ * @param   interval: nominal frame interval in us, 0 means unknown until audio_jitter_set_interval.
+ * @param   min_depth: minimum playout depth in frames.
+ * @param   max_depth: maximum playout depth in frames, should be smaller than AUDIO_JITTER_SLOTS.
+ *
+ * @return  jitter buffer handler, NULL will be returned when failed.
+ */
+audio_jitter_t *audio_jitter_create(uint32_t interval, uint8_t min_depth, uint8_t max_depth);
+
+/************************************************************************************
+ * @fn      audio_jitter_destroy
+ *
+ * @brief   destroy a jitter buffer, frames in buffer are released.
+ *
+ * @param   jitter: jitter buffer handler.
+ */
+void audio_jitter_destroy(audio_jitter_t *jitter);
+
+/************************************************************************************
+ * @fn      audio_jitter_set_interval
+ *
+ * @brief   set nominal frame interval, used when it depends on packet length such as CVSD.
+ *
+ * @param   jitter: jitter buffer handler.
+ * @param   interval: frame interval in us.
+ */
+void audio_jitter_set_interval(audio_jitter_t *jitter, uint32_t interval);
+
+/************************************************************************************
+ * @fn      audio_jitter_get_interval
+ *
+ * @brief   get nominal frame interval.
+ *
+ * @param   jitter: jitter buffer handler.
+ *
+ * @return  frame interval in us, 0 means it is not set yet.
+ */
+uint32_t audio_jitter_get_interval(audio_jitter_t *jitter);
+
+/************************************************************************************
+ * @fn      audio_jitter_put
+ *
+ * @brief   save a received frame into jitter buffer. elt->seq is used when elt->seq_valid
+ *          is true, otherwise frames are numbered in arrival order. The element is owned
+ *          by jitter buffer after this function is called.
+ *
+ * @param   jitter: jitter buffer handler.
+ * @param   elt: received frame allocated by audio_scene_frame_alloc.
+ */
+void audio_jitter_put(audio_jitter_t *jitter, audio_data_element_t *elt);
+
+/************************************************************************************
+ * @fn      audio_jitter_get
+ *
+ * @brief   get next frame to be played.
+ *
+ * @param   jitter: jitter buffer handler.
+ * @param   elt: used to store returned frame when AUDIO_JITTER_FRAME is returned, caller
+ *               should release it with audio_scene_frame_free.
+ *
+ * @return  @ref audio_jitter_result.
+ */
+uint8_t audio_jitter_get(audio_jitter_t *jitter, audio_data_element_t **elt);
+
+/************************************************************************************
+ * @fn      audio_jitter_get_status
+ *
+ * @brief   get depth, jitter and concealment statistics.
+ *
+ * @param   jitter: jitter buffer handler.
+ * @param   status: used to store current status.
+ */
+void audio_jitter_get_status(audio_jitter_t *jitter, audio_jitter_status_t *status);
+
+#endif  // _AUDIO_JITTER_H
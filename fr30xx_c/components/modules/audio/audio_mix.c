@@ -0,0 +1,470 @@
+#include <string.h>
+#include <math.h>
+
+#include "audio_mix.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "fr30xx.h"
+#define AUDIO_MIX_USE_DSP_EXT           1
+#else
+#define AUDIO_MIX_USE_DSP_EXT           0
+#endif
+
+/* convert between audio_mix_sample_t in buffers and Q31 used in processing */
+#if AUDIO_MIX_WIDE
+#define AUDIO_MIX_LOAD(v)               (v)
+#define AUDIO_MIX_STORE(v)              (v)
+#define AUDIO_MIX_FROM_S16(v)           ((int32_t)(v) << 16)
+#else
+#define AUDIO_MIX_LOAD(v)               ((int32_t)(v) << 16)
+#define AUDIO_MIX_STORE(v)              ((int16_t)audio_mix_round_q31(v, 16))
+#define AUDIO_MIX_FROM_S16(v)           (v)
+#endif
+
+static inline int32_t audio_mix_read_q31(const uint8_t *src, const audio_pcm_format_t *format)
+{
+    switch (format->container) {
+        case 2:
+            return (int32_t)(*(const int16_t *)src) << 16;
+        case 3:
+            return (int32_t)(((uint32_t)src[0] << 8) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 24));
+        default:
+            if (format->bits == 24) {
+                return (int32_t)((uint32_t)(*(const int32_t *)src) << 8);
+            }
+            return *(const int32_t *)src;
+    }
+}
+
+/* round Q31 value to bits width, the result is LSB aligned */
+static inline int32_t audio_mix_round_q31(int32_t value, uint8_t bits)
+{
+    uint8_t shift = 32 - bits;
+    int32_t max = (int32_t)(0x7FFFFFFF >> shift);
+    int32_t result;
+
+    if (shift == 0) {
+        return value;
+    }
+#if AUDIO_MIX_USE_DSP_EXT
+    if (bits == 16) {
+        return __SSAT(((value >> 15) + 1) >> 1, 16);
+    }
+#endif
+
+    result = (value >> shift) + ((value >> (shift - 1)) & 1);
+
+    return result > max ? max : result;
+}
+
+static inline uint8_t *audio_mix_write_q31(uint8_t *dst, const audio_pcm_format_t *format, int32_t value)
+{
+    int32_t result = audio_mix_round_q31(value, format->bits);
+
+    switch (format->container) {
+        case 2:
+            *(int16_t *)dst = (int16_t)result;
+            break;
+        case 3:
+            dst[0] = result;
+            dst[1] = result >> 8;
+            dst[2] = result >> 16;
+            break;
+        default:
+            *(int32_t *)dst = result;
+            break;
+    }
+
+    return dst + format->container;
+}
+
+static inline int32_t audio_mix_scale_q30(int32_t value, int32_t gain)
+{
+    return (int32_t)(((int64_t)value * gain) >> 30);
+}
+
+/*
+ * scale a sample with Q30 gain. SMMULR keeps the rounded upper word of the product,
+ * the lowest 2 bits are lost after it is shifted back, unity and larger gains would
+ * overflow so they take the 64-bit path. Ramp state always uses audio_mix_scale_q30.
+ */
+static inline int32_t audio_mix_mul_q30(int32_t value, int32_t gain)
+{
+#if AUDIO_MIX_USE_DSP_EXT
+    if (gain < AUDIO_MIX_RAMP_UNITY) {
+        int32_t result;
+        __asm ("smmulr %0, %1, %2" : "=r" (result) : "r" (value), "r" (gain));
+        return result << 2;
+    }
+#endif
+    return audio_mix_scale_q30(value, gain);
+}
+
+/* get gain for current sample and advance the ramp by one sample */
+static inline int32_t audio_mix_ramp_next(audio_mix_ramp_t *ramp)
+{
+    int32_t gain = ramp->gain;
+
+    if (ramp->remaining) {
+        if (--ramp->remaining == 0) {
+            ramp->gain = ramp->target;
+        }
+        else if (ramp->curve == AUDIO_MIX_RAMP_LINEAR) {
+            ramp->gain += ramp->step;
+        }
+        else {
+            ramp->gain = audio_mix_scale_q30(ramp->gain, ramp->step);
+        }
+    }
+
+    return gain;
+}
+
+static inline int32_t audio_mix_qadd(int32_t a, int32_t b)
+{
+#if AUDIO_MIX_USE_DSP_EXT
+    return __QADD(a, b);
+#else
+    return audio_mix_sat32((int64_t)a + b);
+#endif
+}
+
+void audio_mix_add_q31(audio_mix_sample_t *dst, const audio_mix_sample_t *src, uint32_t count)
+{
+#if AUDIO_MIX_USE_DSP_EXT
+    while (count >= 4) {
+        dst[0] = AUDIO_MIX_STORE(__QADD(AUDIO_MIX_LOAD(dst[0]), AUDIO_MIX_LOAD(src[0])));
+        dst[1] = AUDIO_MIX_STORE(__QADD(AUDIO_MIX_LOAD(dst[1]), AUDIO_MIX_LOAD(src[1])));
+        dst[2] = AUDIO_MIX_STORE(__QADD(AUDIO_MIX_LOAD(dst[2]), AUDIO_MIX_LOAD(src[2])));
+        dst[3] = AUDIO_MIX_STORE(__QADD(AUDIO_MIX_LOAD(dst[3]), AUDIO_MIX_LOAD(src[3])));
+        dst += 4;
+        src += 4;
+        count -= 4;
+    }
+#endif
+    while (count--) {
+        *dst = AUDIO_MIX_STORE(audio_mix_qadd(AUDIO_MIX_LOAD(*dst), AUDIO_MIX_LOAD(*src++)));
+        dst++;
+    }
+}
+
+/* dst = sat(dst + src * gain) with constant gain */
+static void audio_mix_gain_add(audio_mix_sample_t *dst, const audio_mix_sample_t *src, int32_t gain, uint32_t count)
+{
+    if (gain == AUDIO_MIX_RAMP_UNITY) {
+        audio_mix_add_q31(dst, src, count);
+        return;
+    }
+
+#if AUDIO_MIX_USE_DSP_EXT
+    while (count >= 4) {
+        dst[0] = AUDIO_MIX_STORE(__QADD(AUDIO_MIX_LOAD(dst[0]), audio_mix_mul_q30(AUDIO_MIX_LOAD(src[0]), gain)));
+        dst[1] = AUDIO_MIX_STORE(__QADD(AUDIO_MIX_LOAD(dst[1]), audio_mix_mul_q30(AUDIO_MIX_LOAD(src[1]), gain)));
+        dst[2] = AUDIO_MIX_STORE(__QADD(AUDIO_MIX_LOAD(dst[2]), audio_mix_mul_q30(AUDIO_MIX_LOAD(src[2]), gain)));
+        dst[3] = AUDIO_MIX_STORE(__QADD(AUDIO_MIX_LOAD(dst[3]), audio_mix_mul_q30(AUDIO_MIX_LOAD(src[3]), gain)));
+        dst += 4;
+        src += 4;
+        count -= 4;
+    }
+#endif
+    while (count--) {
+        *dst = AUDIO_MIX_STORE(audio_mix_qadd(AUDIO_MIX_LOAD(*dst), audio_mix_mul_q30(AUDIO_MIX_LOAD(*src++), gain)));
+        dst++;
+    }
+}
+
+/* dst = src * gain with constant gain */
+static void audio_mix_gain_copy(audio_mix_sample_t *dst, const audio_mix_sample_t *src, int32_t gain, uint32_t count)
+{
+    if (gain == AUDIO_MIX_RAMP_UNITY) {
+        memcpy((void *)dst, (const void *)src, count * sizeof(audio_mix_sample_t));
+        return;
+    }
+
+#if AUDIO_MIX_USE_DSP_EXT
+    while (count >= 4) {
+        dst[0] = AUDIO_MIX_STORE(audio_mix_mul_q30(AUDIO_MIX_LOAD(src[0]), gain));
+        dst[1] = AUDIO_MIX_STORE(audio_mix_mul_q30(AUDIO_MIX_LOAD(src[1]), gain));
+        dst[2] = AUDIO_MIX_STORE(audio_mix_mul_q30(AUDIO_MIX_LOAD(src[2]), gain));
+        dst[3] = AUDIO_MIX_STORE(audio_mix_mul_q30(AUDIO_MIX_LOAD(src[3]), gain));
+        dst += 4;
+        src += 4;
+        count -= 4;
+    }
+#endif
+    while (count--) {
+        *dst++ = AUDIO_MIX_STORE(audio_mix_mul_q30(AUDIO_MIX_LOAD(*src++), gain));
+    }
+}
+
+void audio_mix_to_q31(audio_mix_sample_t *dst, uint8_t dst_channels, const void *src, const audio_pcm_format_t *format, uint32_t samples)
+{
+    audio_mix_ramp_to_q31(dst, dst_channels, src, format, samples, NULL);
+}
+
+void audio_mix_ramp_to_q31(audio_mix_sample_t *dst, uint8_t dst_channels, const void *src, const audio_pcm_format_t *format, uint32_t samples, audio_mix_ramp_t *ramp)
+{
+    const uint8_t *ptr = src;
+    uint32_t sample_step, channel_step;
+
+    /* the most common case: 16-bit interleaved data with the same channels */
+    if ((format->container == 2) && format->interleaved && (format->channels == dst_channels)) {
+        const int16_t *src16 = src;
+        if ((ramp == NULL) || ((ramp->remaining == 0) && (ramp->gain == AUDIO_MIX_RAMP_UNITY))) {
+            for (uint32_t i=0; i<samples * dst_channels; i++) {
+                *dst++ = AUDIO_MIX_FROM_S16(*src16++);
+            }
+        }
+        else {
+            while (samples) {
+                int32_t gain;
+
+                if (ramp->remaining == 0) {
+                    /* constant gain for the rest samples */
+                    gain = ramp->gain;
+                    for (uint32_t i=0; i<samples * dst_channels; i++) {
+                        *dst++ = AUDIO_MIX_STORE(audio_mix_mul_q30((int32_t)(*src16++) << 16, gain));
+                    }
+                    return;
+                }
+
+                gain = audio_mix_ramp_next(ramp);
+                for (uint8_t c=0; c<dst_channels; c++) {
+                    *dst++ = AUDIO_MIX_STORE(audio_mix_mul_q30((int32_t)(*src16++) << 16, gain));
+                }
+                samples--;
+            }
+        }
+        return;
+    }
+
+    if (format->interleaved) {
+        sample_step = AUDIO_PCM_FRAME_BYTES(format);
+        channel_step = format->container;
+    }
+    else {
+        sample_step = format->container;
+        channel_step = format->container * samples;
+    }
+
+    for (uint32_t i=0; i<samples; i++) {
+        const uint8_t *frame = ptr + sample_step * i;
+        int32_t gain = AUDIO_MIX_RAMP_UNITY;
+        int32_t value = 0;
+
+        if (ramp) {
+            gain = audio_mix_ramp_next(ramp);
+        }
+
+        for (uint8_t c=0; c<dst_channels; c++) {
+            if (format->channels == 1) {
+                /* mono source is duplicated into all channels */
+                if (c == 0) {
+                    value = audio_mix_read_q31(frame, format);
+                }
+            }
+            else {
+                value = c < format->channels ? audio_mix_read_q31(frame + channel_step * c, format) : 0;
+            }
+            *dst++ = AUDIO_MIX_STORE(audio_mix_mul_q30(value, gain));
+        }
+    }
+}
+
+void *audio_mix_from_q31(void *dst, const audio_pcm_format_t *format, const audio_mix_sample_t *src, uint8_t src_channels, uint32_t samples)
+{
+    uint8_t *ptr = dst;
+
+    if ((format->container == 2) && (format->channels == src_channels)) {
+        int16_t *dst16 = dst;
+#if AUDIO_MIX_WIDE
+        for (uint32_t i=0; i<samples * src_channels; i++) {
+            *dst16++ = (int16_t)audio_mix_round_q31(*src++, 16);
+        }
+#else
+        memcpy((void *)dst16, (const void *)src, samples * src_channels * sizeof(int16_t));
+        dst16 += samples * src_channels;
+#endif
+        return dst16;
+    }
+
+    for (uint32_t i=0; i<samples; i++) {
+        for (uint8_t c=0; c<format->channels; c++) {
+            int32_t value;
+            if (src_channels == 1) {
+                value = AUDIO_MIX_LOAD(src[0]);
+            }
+            else {
+                value = c < src_channels ? AUDIO_MIX_LOAD(src[c]) : 0;
+            }
+            ptr = audio_mix_write_q31(ptr, format, value);
+        }
+        src += src_channels;
+    }
+
+    return ptr;
+}
+
+void audio_mix_ramp_set(audio_mix_ramp_t *ramp, int32_t gain)
+{
+    ramp->gain = gain;
+    ramp->target = gain;
+    ramp->step = 0;
+    ramp->remaining = 0;
+    ramp->curve = AUDIO_MIX_RAMP_LINEAR;
+}
+
+void audio_mix_ramp_start(audio_mix_ramp_t *ramp, int32_t target, uint32_t samples, uint8_t curve)
+{
+    if ((samples == 0) || (target == ramp->gain)) {
+        audio_mix_ramp_set(ramp, target);
+        return;
+    }
+
+    ramp->target = target;
+    ramp->curve = AUDIO_MIX_RAMP_LINEAR;
+    if (curve == AUDIO_MIX_RAMP_EXP) {
+        int32_t from = ramp->gain > AUDIO_MIX_RAMP_EXP_FLOOR ? ramp->gain : AUDIO_MIX_RAMP_EXP_FLOOR;
+        int32_t to = target > AUDIO_MIX_RAMP_EXP_FLOOR ? target : AUDIO_MIX_RAMP_EXP_FLOOR;
+        float factor = powf((float)to / (float)from, 1.0f / (float)samples);
+
+        /* multiplier should be stored in Q30 */
+        if (factor < 1.99f) {
+            ramp->gain = from;
+            ramp->step = (int32_t)(factor * (float)AUDIO_MIX_RAMP_UNITY);
+            ramp->curve = AUDIO_MIX_RAMP_EXP;
+        }
+    }
+    if (ramp->curve == AUDIO_MIX_RAMP_LINEAR) {
+        ramp->step = (target - ramp->gain) / (int32_t)samples;
+    }
+    ramp->remaining = samples;
+}
+
+void audio_mix_ramp_add_q31(audio_mix_sample_t *dst, const audio_mix_sample_t *src, uint8_t channels, uint32_t samples, audio_mix_ramp_t *ramp)
+{
+    while (samples) {
+        int32_t gain;
+
+        if (ramp->remaining == 0) {
+            /* constant gain for the rest samples */
+            audio_mix_gain_add(dst, src, ramp->gain, samples * channels);
+            return;
+        }
+
+        gain = audio_mix_ramp_next(ramp);
+        for (uint8_t c=0; c<channels; c++) {
+            *dst = AUDIO_MIX_STORE(audio_mix_qadd(AUDIO_MIX_LOAD(*dst), audio_mix_mul_q30(AUDIO_MIX_LOAD(*src++), gain)));
+            dst++;
+        }
+        samples--;
+    }
+}
+
+void audio_mix_ramp_copy_q31(audio_mix_sample_t *dst, const audio_mix_sample_t *src, uint8_t channels, uint32_t samples, audio_mix_ramp_t *ramp)
+{
+    while (samples) {
+        int32_t gain;
+
+        if (ramp->remaining == 0) {
+            audio_mix_gain_copy(dst, src, ramp->gain, samples * channels);
+            return;
+        }
+
+        gain = audio_mix_ramp_next(ramp);
+        for (uint8_t c=0; c<channels; c++) {
+            *dst++ = AUDIO_MIX_STORE(audio_mix_mul_q30(AUDIO_MIX_LOAD(*src++), gain));
+        }
+        samples--;
+    }
+}
+
+void audio_mix_limiter_init(audio_mix_limiter_t *limiter, int32_t *delay, uint16_t lookahead, uint8_t channels,
+                                uint32_t threshold, uint8_t headroom, uint8_t release_shift)
+{
+    limiter->delay = delay;
+    limiter->lookahead = lookahead;
+    limiter->channels = channels;
+    limiter->headroom = headroom;
+    limiter->release_shift = release_shift;
+    limiter->threshold = threshold >> headroom;
+    limiter->limited_samples = 0;
+
+    audio_mix_limiter_reset(limiter);
+}
+
+void audio_mix_limiter_reset(audio_mix_limiter_t *limiter)
+{
+    memset((void *)limiter->delay, 0, limiter->lookahead * limiter->channels * sizeof(int32_t));
+    limiter->pos = 0;
+    limiter->gain = AUDIO_MIX_RAMP_UNITY;
+    limiter->target = AUDIO_MIX_RAMP_UNITY;
+    limiter->slope = 0;
+    limiter->hold = 0;
+}
+
+void audio_mix_limiter_process(audio_mix_limiter_t *limiter, audio_mix_sample_t *pcm, uint32_t samples)
+{
+    uint8_t out_shift = 30 - limiter->headroom;
+
+    while (samples--) {
+        int32_t *slot = &limiter->delay[limiter->pos * limiter->channels];
+        uint32_t peak = 0;
+
+        for (uint8_t c=0; c<limiter->channels; c++) {
+            int32_t sample = AUDIO_MIX_LOAD(pcm[c]);
+            uint32_t value = sample < 0 ? 0u - (uint32_t)sample : (uint32_t)sample;
+            if (value > peak) {
+                peak = value;
+            }
+        }
+
+        if (peak > limiter->threshold) {
+            /* this sample leaves delay line after lookahead samples, gain should be low enough by then */
+            int32_t need = (int32_t)(((uint64_t)limiter->threshold << 30) / peak);
+            /* keep gain until this sample is output */
+            limiter->hold = limiter->lookahead + 1;
+            if (need < limiter->target) {
+                /* never ramp slower than current attack, earlier peaks still depend on it */
+                int32_t slope = (limiter->gain - need + limiter->lookahead - 1) / limiter->lookahead;
+                if (slope > limiter->slope) {
+                    limiter->slope = slope;
+                }
+                limiter->target = need;
+            }
+        }
+
+        if (limiter->gain > limiter->target) {
+            limiter->gain -= limiter->slope;
+            if (limiter->gain <= limiter->target) {
+                limiter->gain = limiter->target;
+                limiter->slope = 0;
+            }
+        }
+        else if (limiter->hold) {
+            limiter->hold--;
+        }
+        else if (limiter->gain < AUDIO_MIX_RAMP_UNITY) {
+            limiter->target = AUDIO_MIX_RAMP_UNITY;
+            limiter->gain += ((AUDIO_MIX_RAMP_UNITY - limiter->gain) >> limiter->release_shift) + 1;
+            if (limiter->gain > AUDIO_MIX_RAMP_UNITY) {
+                limiter->gain = AUDIO_MIX_RAMP_UNITY;
+            }
+        }
+
+        /* output delayed sample and store current one into delay line */
+        for (uint8_t c=0; c<limiter->channels; c++) {
+            int32_t value = AUDIO_MIX_LOAD(pcm[c]);
+            pcm[c] = AUDIO_MIX_STORE(audio_mix_sat32(((int64_t)slot[c] * limiter->gain) >> out_shift));
+            slot[c] = value;
+        }
+        if (limiter->gain < AUDIO_MIX_RAMP_UNITY) {
+            limiter->limited_samples++;
+        }
+
+        if (++limiter->pos >= limiter->lookahead) {
+            limiter->pos = 0;
+        }
+        pcm += limiter->channels;
+    }
+}
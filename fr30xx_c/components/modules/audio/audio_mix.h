@@ -0,0 +1,254 @@
+#ifndef _AUDIO_MIX_H
+#define _AUDIO_MIX_H
+
+#include <stdint.h>
+
+#include "audio_common.h"
+
+/* unity gain in Q15 format, used by audio_decoder_set_gain */
+#define AUDIO_MIX_GAIN_UNITY                0x7FFF
+
+/************************************************************************************
+ * @fn      audio_mix_sat32
+ *
+ * @brief   saturate a 64-bit intermediate value into Q31 range.
+ *
+ * @param   value: value to be saturated.
+ *
+ * @return  saturated value.
+ */
+static inline int32_t audio_mix_sat32(int64_t value)
+{
+    if (value > 2147483647LL) {
+        return 2147483647;
+    }
+    else if (value < -2147483648LL) {
+        return (int32_t)0x80000000;
+    }
+    else {
+        return (int32_t)value;
+    }
+}
+
+/*
+ * Wide mixing: PCM data of all sources are converted into Q31 (16-bit samples are
+ * shifted left by 16, 24-bit ones by 8) and accumulated in 32-bit. They are converted
+ * into format of output only once when fetched.
+ *
+ * Mixing buffers are stored in audio_mix_sample_t. With AUDIO_MIX_WIDE all 32 bits
+ * are kept, so streams mixed with headroom for the limiter and 24-bit sources keep
+ * their precision. Otherwise only the upper 16 bits are stored, which halves the
+ * mixed PCM buffer and decoded frames waiting to be mixed, samples are still
+ * processed in Q31 and rounded to 16 bits in each pass.
+ */
+#ifndef AUDIO_MIX_WIDE
+#define AUDIO_MIX_WIDE                      1
+#endif
+
+#if AUDIO_MIX_WIDE
+typedef int32_t audio_mix_sample_t;
+#else
+typedef int16_t audio_mix_sample_t;
+#endif
+
+/************************************************************************************
+ * @fn      audio_mix_add_q31
+ *
+ * @brief   add Q31 PCM data into destination buffer with saturation: dst = sat(dst + src).
+ *
+ * @param   dst: destination buffer, also used as one of the addends.
+ * @param   src: source buffer.
+ * @param   count: number of values to be mixed (samples * channels).
+ */
+void audio_mix_add_q31(audio_mix_sample_t *dst, const audio_mix_sample_t *src, uint32_t count);
+
+/************************************************************************************
+ * @fn      audio_mix_to_q31
+ *
+ * @brief   convert PCM data into interleaved Q31 format. When channels are different,
+ *          mono source is duplicated into all channels, the first channel is taken for
+ *          mono destination, otherwise missing channels are filled with zero and extra
+ *          ones are dropped.
+ *
+ * @param   dst: destination buffer, should be able to store samples * dst_channels values.
+ * @param   dst_channels: channels of destination buffer.
+ * @param   src: source buffer.
+ * @param   format: format of source buffer.
+ * @param   samples: number of samples.
+ */
+void audio_mix_to_q31(audio_mix_sample_t *dst, uint8_t dst_channels, const void *src, const audio_pcm_format_t *format, uint32_t samples);
+
+/************************************************************************************
+ * @fn      audio_mix_from_q31
+ *
+ * @brief   convert interleaved Q31 PCM data into output format with rounding and
+ *          saturation. Channels are mapped as audio_mix_to_q31, output is always
+ *          interleaved.
+ *
+ * @param   dst: destination buffer.
+ * @param   format: format of destination buffer.
+ * @param   src: Q31 source buffer.
+ * @param   src_channels: channels of source buffer.
+ * @param   samples: number of samples.
+ *
+ * @return  position in destination buffer after converted samples.
+ */
+void *audio_mix_from_q31(void *dst, const audio_pcm_format_t *format, const audio_mix_sample_t *src, uint8_t src_channels, uint32_t samples);
+
+/*
+ * Gain ramp: gain of a stream is changed sample by sample from current value to
+ * target value, the ramp is applied while the stream is mixed so no extra pass
+ * over PCM data is needed. Gain is in Q30 format, AUDIO_MIX_RAMP_UNITY means 1.0.
+ */
+#define AUDIO_MIX_RAMP_UNITY                (1 << 30)
+/* exponential ramp starts from or stops at this level instead of zero, about -60dB */
+#define AUDIO_MIX_RAMP_EXP_FLOOR            (AUDIO_MIX_RAMP_UNITY / 1000)
+
+enum audio_mix_ramp_curve {
+    AUDIO_MIX_RAMP_LINEAR,      // gain changes with constant step
+    AUDIO_MIX_RAMP_EXP,         // gain changes with constant ratio, constant dB per sample
+};
+
+typedef struct {
+    /* gain applied to next sample, Q30 */
+    int32_t gain;
+    int32_t target;
+    /* linear: added to gain for each sample; exponential: gain multiplier in Q30 */
+    int32_t step;
+    /* samples left before target is reached, 0: gain is constant */
+    uint32_t remaining;
+    uint8_t curve;
+} audio_mix_ramp_t;
+
+/*
+ * Look-ahead peak limiter: mixed PCM data is delayed by lookahead samples, gain is
+ * decreased linearly before a peak above threshold leaves the delay line, held for
+ * lookahead samples and then released exponentially.
+ */
+typedef struct {
+    /* delay line provided by caller, lookahead * channels values */
+    int32_t *delay;
+    uint16_t lookahead;
+    uint16_t pos;
+    uint8_t channels;
+    /* input is scaled down by headroom bits, it is restored in output */
+    uint8_t headroom;
+    uint8_t release_shift;
+    /* threshold in scale of input */
+    uint32_t threshold;
+
+    /* Q30 gain state */
+    int32_t gain;
+    int32_t target;
+    int32_t slope;
+    uint32_t hold;
+
+    /* samples output with gain lower than unity */
+    uint32_t limited_samples;
+} audio_mix_limiter_t;
+
+/************************************************************************************
+ * @fn      audio_mix_ramp_set
+ *
+ * @brief   set gain of a ramp immediately without ramping.
+ *
+ * @param   ramp: ramp to be set.
+ * @param   gain: Q30 gain, AUDIO_MIX_RAMP_UNITY means 1.0.
+ */
+void audio_mix_ramp_set(audio_mix_ramp_t *ramp, int32_t gain);
+
+/************************************************************************************
+ * @fn      audio_mix_ramp_start
+ *
+ * @brief   start a ramp from current gain to target gain. The first sample mixed after
+ *          this function is called uses current gain, target gain is reached after
+ *          samples. Exponential ramp longer than needed is changed into linear one.
+ *
+ * @param   ramp: ramp to be started.
+ * @param   target: Q30 target gain.
+ * @param   samples: length of ramp, 0 means target is applied immediately.
+ * @param   curve: @ref audio_mix_ramp_curve.
+ */
+void audio_mix_ramp_start(audio_mix_ramp_t *ramp, int32_t target, uint32_t samples, uint8_t curve);
+
+/************************************************************************************
+ * @fn      audio_mix_ramp_add_q31
+ *
+ * @brief   scale Q31 PCM data with a ramp and add it into destination buffer with
+ *          saturation, the ramp is advanced by samples.
+ *
+ * @param   dst: destination buffer, also used as one of the addends.
+ * @param   src: source buffer.
+ * @param   channels: channels of both buffers, all channels of one sample use the same gain.
+ * @param   samples: number of samples.
+ * @param   ramp: gain ramp.
+ */
+void audio_mix_ramp_add_q31(audio_mix_sample_t *dst, const audio_mix_sample_t *src, uint8_t channels, uint32_t samples, audio_mix_ramp_t *ramp);
+
+/************************************************************************************
+ * @fn      audio_mix_ramp_copy_q31
+ *
+ * @brief   scale Q31 PCM data with a ramp into destination buffer, the ramp is
+ *          advanced by samples.
+ *
+ * @param   dst: destination buffer.
+ * @param   src: source buffer.
+ * @param   channels: channels of both buffers.
+ * @param   samples: number of samples.
+ * @param   ramp: gain ramp.
+ */
+void audio_mix_ramp_copy_q31(audio_mix_sample_t *dst, const audio_mix_sample_t *src, uint8_t channels, uint32_t samples, audio_mix_ramp_t *ramp);
+
+/************************************************************************************
+ * @fn      audio_mix_ramp_to_q31
+ *
+ * @brief   the same as audio_mix_to_q31, and the converted data is scaled with a ramp
+ *          in the same pass.
+ *
+ * @param   dst: destination buffer, should be able to store samples * dst_channels values.
+ * @param   dst_channels: channels of destination buffer.
+ * @param   src: source buffer.
+ * @param   format: format of source buffer.
+ * @param   samples: number of samples.
+ * @param   ramp: gain ramp, NULL means unity gain.
+ */
+void audio_mix_ramp_to_q31(audio_mix_sample_t *dst, uint8_t dst_channels, const void *src, const audio_pcm_format_t *format, uint32_t samples, audio_mix_ramp_t *ramp);
+
+/************************************************************************************
+ * @fn      audio_mix_limiter_init
+ *
+ * @brief   initialize a look-ahead limiter.
+ *
+ * @param   limiter: limiter to be initialized.
+ * @param   delay: delay line buffer, should be able to store lookahead * channels values.
+ * @param   lookahead: look-ahead length in samples, should not be 0.
+ * @param   channels: channels of processed data.
+ * @param   threshold: Q31 output threshold.
+ * @param   headroom: input data is scaled down by this number of bits.
+ * @param   release_shift: release time constant is about (1 << release_shift) samples.
+ */
+void audio_mix_limiter_init(audio_mix_limiter_t *limiter, int32_t *delay, uint16_t lookahead, uint8_t channels,
+                                uint32_t threshold, uint8_t headroom, uint8_t release_shift);
+
+/************************************************************************************
+ * @fn      audio_mix_limiter_reset
+ *
+ * @brief   clear delay line and restore unity gain, used when the stream is restarted.
+ *
+ * @param   limiter: limiter to be reset.
+ */
+void audio_mix_limiter_reset(audio_mix_limiter_t *limiter);
+
+/************************************************************************************
+ * @fn      audio_mix_limiter_process
+ *
+ * @brief   limit interleaved Q31 PCM data in place, output is delayed by lookahead
+ *          samples and restored to full scale.
+ *
+ * @param   limiter: limiter handler.
+ * @param   pcm: PCM buffer.
+ * @param   samples: number of samples.
+ */
+void audio_mix_limiter_process(audio_mix_limiter_t *limiter, audio_mix_sample_t *pcm, uint32_t samples);
+
+#endif  // _AUDIO_MIX_H
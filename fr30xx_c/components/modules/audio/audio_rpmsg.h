@@ -24,6 +24,9 @@
 #define RPMSG_SYNC_FUNC_VOICE_RECOGNIZE_LAUNCH      RPMSG_SYNC_FUNC_MSG(RPMSG_SYNC_FUNC_TYPE_AUDIO, 0x0011)
 #define RPMSG_SYNC_FUNC_VOICE_RECOGNIZE_RELEASE     RPMSG_SYNC_FUNC_MSG(RPMSG_SYNC_FUNC_TYPE_AUDIO, 0x0012)
 #define RPMSG_SYNC_FUNC_DEC_INPUT_DONE              RPMSG_SYNC_FUNC_MSG(RPMSG_SYNC_FUNC_TYPE_AUDIO, 0x0013)
+#define RPMSG_SYNC_FUNC_DEC_PIPELINE                RPMSG_SYNC_FUNC_MSG(RPMSG_SYNC_FUNC_TYPE_AUDIO, 0x0014)
+#define RPMSG_SYNC_FUNC_DEC_STREAM_ATTACH           RPMSG_SYNC_FUNC_MSG(RPMSG_SYNC_FUNC_TYPE_AUDIO, 0x0015)
+#define RPMSG_SYNC_FUNC_ENC_STREAM_ATTACH           RPMSG_SYNC_FUNC_MSG(RPMSG_SYNC_FUNC_TYPE_AUDIO, 0x0016)
 
 struct rpmsg_sync_msg_decoder_init_t {
     uint8_t decoder_type;
@@ -57,6 +60,37 @@ struct rpmsg_sync_msg_decoder_get_param_t {
     uint8_t *channels;
 };
 
+/*
+ * DSP handles this message as: decode with pipeline->decoder, store format of the
+ * decoded frame into pipeline->sample_rate and pipeline->channels, then resample
+ * all decoded data with pipeline->resample when it is not NULL and the format
+ * matches resample_sample_rate and resample_channels. pipeline->resampled tells MCU which
+ * buffer *out_buffer points to. Status of sync return is RPMSG_INVOKE_STATUS_UNKNOWN_FUNC
+ * when this message is not supported by DSP.
+ */
+struct rpmsg_sync_msg_decoder_pipeline_t {
+    void *pipeline;             // struct codec_decoder_pipeline
+    const uint8_t *in_buffer;
+    uint32_t *in_length;
+    uint8_t **out_buffer;
+    uint32_t *out_length;
+};
+
+/*
+ * Attach shared memory rings (dsp_ring.h) to a decoder or encoder instance, in_ring and
+ * out_ring are DSP addresses of ring control blocks. After attached, DSP consumes data
+ * from in_ring and writes each output frame into out_ring as one record: a struct
+ * codec_stream_frame_hdr followed by frame data, padded to 4 bytes. A record is only
+ * published when it fits completely. Both rings are 0 to detach, DSP should process
+ * all the remaining input and publish the outputs before returning. Status of sync
+ * return is not 0 when this message is not supported by DSP.
+ */
+struct rpmsg_sync_msg_stream_attach_t {
+    void *handle;
+    uint32_t in_ring;
+    uint32_t out_ring;
+};
+
 struct rpmsg_sync_msg_decoder_destroy_t {
     void *handle;
 };
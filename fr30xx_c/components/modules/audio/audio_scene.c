@@ -10,10 +10,31 @@
 #include "codec.h"
 #include "algorithm.h"
 #include "dsp_mem.h"
+#include "audio_stats.h"
 
 #define TONE_RAW_DATA_BUFFER_SIZE           128
 
+typedef struct {
+    struct co_list_hdr hdr;
+
+    struct co_list free_list;
+    uint8_t *start;
+    uint8_t *end;
+    uint16_t count;
+    uint16_t used;
+    uint16_t peak;
+    uint16_t max_length;
+} audio_scene_frame_pool_t;
+
 static struct co_list evt_list;
+
+/* preallocated events */
+static audio_scene_evt_storage_t evt_pool[AUDIO_SCENE_EVT_POOL_COUNT];
+static struct co_list evt_free_list;
+/* frame pool of current scene, and destroyed pools waiting for frames to be returned */
+static audio_scene_frame_pool_t *frame_pool = NULL;
+static struct co_list frame_pool_retired_list;
+static audio_scene_pool_status_t pool_status;
 static TaskHandle_t audio_scene_task_handle;
 
 /* 
@@ -32,6 +53,11 @@ typedef struct  {
     audio_decoder_output_t *decoder_output_to_hw;
     
     uint8_t *raw_data;         // used to save raw tone frame
+
+    /* tone being recorded into or replayed from tone cache */
+    audio_tone_cache_entry_t *cache;
+    audio_tone_cache_chunk_t *cache_chunk;    // next chunk to be replayed
+    bool cache_replay;
 } audio_tone_env_t;
 
 static audio_scene_t *allocate(void *_param);
@@ -52,7 +78,7 @@ struct audio_scene_operator audio_tone_operator = {
 static void decoder_request_raw_data_handler(audio_decoder_t *decoder, uint8_t event)
 {
     if (event == AUDIO_DECODER_EVENT_REQ_RAW_DATA) {
-        audio_scene_evt_req_encoded_frame_t *evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_req_encoded_frame_t));
+        audio_scene_evt_req_encoded_frame_t *evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_req_encoded_frame_t));
         
         if (evt) {
             evt->evt.type = AUDIO_SCENE_EVT_TYPE_REQ_ENCODED_FRAME;
@@ -73,13 +99,89 @@ static void decoder_request_raw_data_handler(audio_decoder_t *decoder, uint8_t e
             xSemaphoreTake(sema_audio_scene, portMAX_DELAY);
         }
         audio_scene_evt_t *evt;
-        evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_t));
+        evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_t));
         evt->type = AUDIO_SCENE_EVT_TYPE_DESTROY;
         evt->scene = audio_tone_scene;
         audio_scene_send_event(evt);
     }
 }
 
+static void tone_pcm_tap(audio_decoder_t *decoder, const void *pcm, uint32_t samples, const audio_pcm_format_t *format)
+{
+    audio_tone_env_t *env;
+
+    if (audio_tone_scene == NULL) {
+        return;
+    }
+
+    env = audio_tone_scene->env;
+    if (env->decoder == decoder) {
+        audio_tone_cache_record(env->cache, pcm, samples, format);
+    }
+}
+
+/* add tone decoder, decoded PCM data is replayed from tone cache when it is available */
+static void tone_decoder_add(audio_tone_env_t *env, audio_tone_param_t *param)
+{
+    uint32_t sample_rate = audio_decoder_get_sample_rate();
+
+    env->cache = param->cache ? audio_tone_cache_get(param->tone_id, sample_rate) : NULL;
+    if (env->cache) {
+        env->cache_replay = true;
+        env->cache_chunk = (void *)co_list_pick(&env->cache->chunk_list);
+        env->decoder = audio_decoder_add(AUDIO_TYPE_PCM, NULL, decoder_request_raw_data_handler);
+    }
+    else {
+        env->raw_data = pvPortMalloc(TONE_RAW_DATA_BUFFER_SIZE);
+        env->decoder = audio_decoder_add(param->audio_type, &param->decoder_param, decoder_request_raw_data_handler);
+        if (env->decoder && param->cache) {
+            env->cache = audio_tone_cache_record_start(param->tone_id, sample_rate);
+            if (env->cache) {
+                audio_decoder_set_pcm_tap(env->decoder, tone_pcm_tap);
+            }
+        }
+    }
+    audio_decoder_start(env->decoder);
+}
+
+/* release tone cache entry, data recorded from an unfinished tone is dropped */
+static void tone_cache_release(audio_tone_env_t *env)
+{
+    if (env->cache) {
+        if (env->cache_replay) {
+            audio_tone_cache_put(env->cache);
+        }
+        else {
+            audio_tone_cache_record_end(env->cache, false);
+        }
+        env->cache = NULL;
+    }
+}
+
+/* write cached PCM data into mixed PCM buffer, no DSP operation is needed */
+static void tone_cache_replay(audio_tone_env_t *env)
+{
+    audio_pcm_format_t format = AUDIO_PCM_FORMAT_S16(env->cache->channels);
+    uint32_t length = 0;
+    int ret;
+
+    /* PCM data saved in pcm list is mixed at first */
+    if (audio_decoder_decode(env->decoder, NULL, &length) == AUDIO_RET_OUTPUT_ALMOTE_FULL) {
+        return;
+    }
+
+    while (env->cache_chunk) {
+        ret = audio_decoder_write_pcm(env->decoder, env->cache_chunk->pcm, env->cache_chunk->samples, &format);
+        env->cache_chunk = (void *)env->cache_chunk->hdr.next;
+        if (ret != AUDIO_RET_NEED_MORE) {
+            return;
+        }
+    }
+
+    length = AUDIO_SPECIAL_LENGTH_FOR_INPUT_OVER;
+    audio_decoder_decode(env->decoder, NULL, &length);
+}
+
 static void hw_request_pcm_handler(void *pcm, uint32_t samples, uint8_t channels)
 {
     audio_tone_env_t *env = audio_tone_scene->env;
@@ -125,15 +227,12 @@ static void init(audio_scene_t *scene)
     
     audio_tone_scene = scene;
     
-    env->raw_data = pvPortMalloc(TONE_RAW_DATA_BUFFER_SIZE);
-    
     /* 这两个值如果一样，那么就意味着提示音是主场景 */
     if (audio_scene == audio_tone_scene) {
         /* initialize audio decoder module */
         audio_decoder_init(param->channels, param->sample_rate);
         /* create and start a decoder */
-        env->decoder = audio_decoder_add(param->audio_type, &param->decoder_param, decoder_request_raw_data_handler);
-        audio_decoder_start(env->decoder);
+        tone_decoder_add(env, param);
         /* add an output to initialized audio decoder module */
         env->decoder_output_to_hw = audio_decoder_output_add(true, param->channels);
         
@@ -142,8 +241,7 @@ static void init(audio_scene_t *scene)
     }
     else {
         /* create and start a decoder */
-        env->decoder = audio_decoder_add(param->audio_type, &param->decoder_param, decoder_request_raw_data_handler);
-        audio_decoder_start(env->decoder);
+        tone_decoder_add(env, param);
     }
 }
 
@@ -155,6 +253,7 @@ static void destroy(audio_scene_t *scene)
     }
     audio_tone_env_t *env = scene->env;
     
+    tone_cache_release(env);
     if (audio_scene == audio_tone_scene) {
         audio_hw_destroy(env->hw);
         audio_decoder_destroy();
@@ -183,7 +282,10 @@ static void event_handler(audio_scene_t *scene, audio_scene_evt_t *evt)
             {
                 uint32_t length = 0;
                 audio_scene_evt_req_encoded_frame_t *_evt = (void *)evt;
-                if (_evt->decoder == env->decoder) {
+                if ((_evt->decoder == env->decoder) && env->cache_replay) {
+                    tone_cache_replay(env);
+                }
+                else if (_evt->decoder == env->decoder) {
                     if (audio_decoder_decode(env->decoder,
                                                 NULL, &length) != AUDIO_RET_OUTPUT_ALMOTE_FULL) {
                         if(param->req_raw_cb){
@@ -197,6 +299,12 @@ static void event_handler(audio_scene_t *scene, audio_scene_evt_t *evt)
                                 else {
                                     length = AUDIO_SPECIAL_LENGTH_FOR_INPUT_OVER;
                                     audio_decoder_decode(env->decoder, NULL, &length);
+                                    if (env->cache) {
+                                        /* the whole tone is decoded, replay it from cache next time */
+                                        audio_decoder_set_pcm_tap(env->decoder, NULL);
+                                        audio_tone_cache_record_end(env->cache, true);
+                                        env->cache = NULL;
+                                    }
                                     break;
                                 }
                             } while(ret == AUDIO_RET_NEED_MORE);
@@ -280,13 +388,13 @@ static void audio_scene_task(void *arg)
                     else {
                         if (evt->type == AUDIO_SCENE_EVT_TYPE_RECV_ENCODED_FRAME) {
                             audio_scene_evt_recv_encoded_data_t *_evt = (void *)evt;
-                            vPortFree(_evt->raw_frame);
+                            audio_scene_frame_free(_evt->raw_frame);
                         }
                     }
                     break;
             }
             
-            vPortFree(evt);
+            audio_scene_evt_free(evt);
         }
     }
 }
@@ -294,6 +402,8 @@ static void audio_scene_task(void *arg)
 void audio_scene_init(uint32_t stack_size, uint8_t priority)
 {
     co_list_init(&evt_list);
+    co_list_pool_init(&evt_free_list, evt_pool, sizeof(audio_scene_evt_storage_t), AUDIO_SCENE_EVT_POOL_COUNT, NULL, POOL_LINKED_LIST);
+    co_list_init(&frame_pool_retired_list);
 
     xTaskCreate(audio_scene_task, "AUDIO_SCENE_TASK", stack_size, NULL, priority, &audio_scene_task_handle);
 }
@@ -304,14 +414,14 @@ audio_scene_t *audio_scene_create(audio_scene_operator_t *op, void *param)
 
     if (audio_scene != NULL) {
         audio_scene_evt_t *evt;
-        evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_t));
+        evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_t));
         evt->type = AUDIO_SCENE_EVT_TYPE_DESTROY;
         evt->scene = audio_scene;
         audio_scene_send_event(evt);
     }
     else if (audio_tone_scene != NULL) {
         audio_scene_evt_t *evt;
-        evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_t));
+        evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_t));
         evt->type = AUDIO_SCENE_EVT_TYPE_DESTROY;
         evt->scene = audio_tone_scene;//audio_scene;
         audio_scene_send_event(evt);
@@ -323,7 +433,7 @@ audio_scene_t *audio_scene_create(audio_scene_operator_t *op, void *param)
     if (audio_scene) {
         xSemaphoreTake(sema_audio_scene, portMAX_DELAY);
         audio_scene_evt_t *evt;
-        evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_t));
+        evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_t));
         evt->type = AUDIO_SCENE_EVT_TYPE_CREATE;
         evt->scene = audio_scene;
         audio_scene_send_event(evt);
@@ -337,7 +447,7 @@ void audio_scene_destroy(audio_scene_t *scene)
     if ((scene == audio_scene) || (scene == audio_tone_scene)) {
         xSemaphoreTake(sema_audio_scene, portMAX_DELAY);
         audio_scene_evt_t *evt;
-        evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_t));
+        evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_t));
         evt->type = AUDIO_SCENE_EVT_TYPE_DESTROY;
         evt->scene = scene;
         audio_scene_send_event(evt);
@@ -362,33 +472,232 @@ void audio_scene_send_event(audio_scene_evt_t *evt)
     }
 }
 
-void audio_scene_recv_encoded_data(audio_scene_t *scene, bool valid, const uint8_t *buffer, uint32_t length)
+static void recv_encoded_data(audio_scene_t *scene, bool valid, bool seq_valid, uint16_t seq, const uint8_t *buffer, uint32_t length)
 {
     audio_data_element_t *elt;
-    static uint8_t seq = 0;
         
     audio_scene_evt_recv_encoded_data_t *evt;
-    evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_recv_encoded_data_t));
+    evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_recv_encoded_data_t));
+    if (evt == NULL) {
+        pool_status.frame_dropped++;
+        return;
+    }
     evt->evt.type = AUDIO_SCENE_EVT_TYPE_RECV_ENCODED_FRAME;
     evt->evt.scene = scene;
     if (valid) {
-        elt = (void *)pvPortMalloc(sizeof(audio_data_element_t) + length);
-        elt->valid = true;
-        elt->length = length;
-        elt->offset = 0;
-        memcpy((void *)&elt->buffer[0], buffer, length);
+        elt = audio_scene_frame_alloc(length);
+        if (elt) {
+            elt->valid = true;
+            elt->length = length;
+            elt->offset = 0;
+            memcpy((void *)&elt->buffer[0], buffer, length);
+        }
     }
     else {
-        elt = (void *)pvPortMalloc(sizeof(audio_data_element_t));
-        elt->valid = false;
-        elt->length = AUDIO_SPECIAL_LENGTH_FOR_PLC;
-        elt->offset = 0;
+        elt = audio_scene_frame_alloc(0);
+        if (elt) {
+            elt->valid = false;
+            elt->length = AUDIO_SPECIAL_LENGTH_FOR_PLC;
+            elt->offset = 0;
+        }
+    }
+    if (elt == NULL) {
+        pool_status.frame_dropped++;
+        audio_scene_evt_free(&evt->evt);
+        return;
     }
-//    fputc(seq, NULL);
+    elt->seq_valid = seq_valid;
+    elt->seq = seq;
+    elt->timestamp = audio_stats_timestamp();
     evt->raw_frame = elt;
     audio_scene_send_event(&evt->evt);
 }
 
+void audio_scene_recv_encoded_data(audio_scene_t *scene, bool valid, const uint8_t *buffer, uint32_t length)
+{
+    recv_encoded_data(scene, valid, false, 0, buffer, length);
+}
+
+void audio_scene_recv_encoded_data_seq(audio_scene_t *scene, bool valid, uint16_t seq, const uint8_t *buffer, uint32_t length)
+{
+    recv_encoded_data(scene, valid, true, seq, buffer, length);
+}
+
+audio_scene_evt_t *audio_scene_evt_alloc(uint32_t size)
+{
+    audio_scene_evt_t *evt = NULL;
+
+    if (size <= sizeof(audio_scene_evt_storage_t)) {
+        GLOBAL_INT_DISABLE();
+        evt = (void *)co_list_pop_front(&evt_free_list);
+        if (evt) {
+            pool_status.evt_used++;
+            if (pool_status.evt_used > pool_status.evt_peak) {
+                pool_status.evt_peak = pool_status.evt_used;
+            }
+        }
+        else {
+            pool_status.evt_exhausted++;
+        }
+        GLOBAL_INT_RESTORE();
+    }
+
+    if ((evt == NULL) && !xPortIsInsideInterrupt()) {
+        evt = pvPortMalloc(size);
+    }
+
+    return evt;
+}
+
+void audio_scene_evt_free(audio_scene_evt_t *evt)
+{
+    if (((uint8_t *)evt >= (uint8_t *)&evt_pool[0])
+            && ((uint8_t *)evt < (uint8_t *)&evt_pool[AUDIO_SCENE_EVT_POOL_COUNT])) {
+        GLOBAL_INT_DISABLE();
+        co_list_push_front(&evt_free_list, &evt->hdr);
+        pool_status.evt_used--;
+        GLOBAL_INT_RESTORE();
+    }
+    else {
+        vPortFree(evt);
+    }
+}
+
+bool audio_scene_frame_pool_create(uint16_t count, uint16_t max_length)
+{
+    audio_scene_frame_pool_t *pool;
+    uint32_t elt_size;
+
+    /* frame pool of previous scene should be destroyed before */
+    audio_scene_frame_pool_destroy();
+
+    elt_size = (sizeof(audio_data_element_t) + max_length + 3) & ~3;
+    pool = pvPortMalloc(sizeof(audio_scene_frame_pool_t) + elt_size * count);
+    if (pool == NULL) {
+        return false;
+    }
+
+    pool->start = (uint8_t *)&pool[1];
+    pool->end = pool->start + elt_size * count;
+    pool->count = count;
+    pool->used = 0;
+    pool->peak = 0;
+    pool->max_length = max_length;
+    co_list_pool_init(&pool->free_list, pool->start, elt_size, count, NULL, POOL_LINKED_LIST);
+
+    GLOBAL_INT_DISABLE();
+    frame_pool = pool;
+    GLOBAL_INT_RESTORE();
+
+    return true;
+}
+
+void audio_scene_frame_pool_destroy(void)
+{
+    audio_scene_frame_pool_t *pool;
+
+    GLOBAL_INT_DISABLE();
+    pool = frame_pool;
+    frame_pool = NULL;
+    if (pool && pool->used) {
+        /* some frames are still in event list, release the memory after they are returned */
+        co_list_push_back(&frame_pool_retired_list, &pool->hdr);
+        pool = NULL;
+    }
+    GLOBAL_INT_RESTORE();
+
+    if (pool) {
+        vPortFree(pool);
+    }
+}
+
+audio_data_element_t *audio_scene_frame_alloc(uint32_t length)
+{
+    audio_data_element_t *elt = NULL;
+
+    GLOBAL_INT_DISABLE();
+    if (frame_pool && (length <= frame_pool->max_length)) {
+        elt = (void *)co_list_pop_front(&frame_pool->free_list);
+        if (elt) {
+            frame_pool->used++;
+            if (frame_pool->used > frame_pool->peak) {
+                frame_pool->peak = frame_pool->used;
+            }
+        }
+    }
+    if (elt == NULL) {
+        pool_status.frame_exhausted++;
+    }
+    GLOBAL_INT_RESTORE();
+
+    if ((elt == NULL) && !xPortIsInsideInterrupt()) {
+        elt = pvPortMalloc(sizeof(audio_data_element_t) + length);
+    }
+
+    return elt;
+}
+
+static bool frame_pool_put(audio_scene_frame_pool_t *pool, audio_data_element_t *elt)
+{
+    if (((uint8_t *)elt < pool->start) || ((uint8_t *)elt >= pool->end)) {
+        return false;
+    }
+
+    co_list_push_front(&pool->free_list, &elt->hdr);
+    pool->used--;
+
+    return true;
+}
+
+void audio_scene_frame_free(audio_data_element_t *elt)
+{
+    audio_scene_frame_pool_t *pool, *retired = NULL;
+    bool returned = false;
+
+    if (elt == NULL) {
+        return;
+    }
+
+    GLOBAL_INT_DISABLE();
+    if (frame_pool) {
+        returned = frame_pool_put(frame_pool, elt);
+    }
+    pool = (void *)co_list_pick(&frame_pool_retired_list);
+    while ((returned == false) && pool) {
+        returned = frame_pool_put(pool, elt);
+        if (returned && (pool->used == 0)) {
+            co_list_extract(&frame_pool_retired_list, &pool->hdr);
+            retired = pool;
+        }
+        pool = (void *)pool->hdr.next;
+    }
+    GLOBAL_INT_RESTORE();
+
+    if (returned == false) {
+        vPortFree(elt);
+    }
+    if (retired) {
+        vPortFree(retired);
+    }
+}
+
+void audio_scene_get_pool_status(audio_scene_pool_status_t *status)
+{
+    GLOBAL_INT_DISABLE();
+    *status = pool_status;
+    if (frame_pool) {
+        status->frame_count = frame_pool->count;
+        status->frame_used = frame_pool->used;
+        status->frame_peak = frame_pool->peak;
+    }
+    else {
+        status->frame_count = 0;
+        status->frame_used = 0;
+        status->frame_peak = 0;
+    }
+    GLOBAL_INT_RESTORE();
+}
+
 audio_scene_t *audio_scene_tone_play(audio_tone_param_t *param)
 {
     xSemaphoreTake(sema_audio_scene, portMAX_DELAY);
@@ -400,7 +709,7 @@ audio_scene_t *audio_scene_tone_play(audio_tone_param_t *param)
                     /* check whether an tone is ongoing  */
                     audio_tone_scene = allocate(param);
                     audio_scene_evt_t *evt;
-                    evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_t));
+                    evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_t));
                     evt->type = AUDIO_SCENE_EVT_TYPE_CREATE;
                     evt->scene = audio_tone_scene;
                     audio_scene_send_event(evt);
@@ -427,7 +736,7 @@ void audio_scene_tone_stop(bool immediate)
     if (audio_tone_scene){
         if(immediate){
             audio_scene_evt_t *evt;
-            evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_t));
+            evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_t));
             evt->type = AUDIO_SCENE_EVT_TYPE_DESTROY;
             evt->scene = audio_tone_scene;
             audio_scene_send_event(evt);
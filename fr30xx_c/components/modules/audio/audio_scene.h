@@ -10,6 +10,7 @@
 #include "audio_hw.h"
 #include "audio_decoder.h"
 #include "audio_encoder.h"
+#include "audio_tone_cache.h"
 
 typedef uint32_t (*audio_scene_decoder_req_raw_cb)(uint8_t *data, uint32_t length);
 typedef void (*audio_scene_tone_destroyed_cb)(void);
@@ -70,6 +71,33 @@ typedef struct {
     audio_data_element_t *raw_frame;
 } audio_scene_evt_recv_encoded_data_t;
 
+/* number of preallocated events, larger ones or events allocated after exhausted come from heap */
+#define AUDIO_SCENE_EVT_POOL_COUNT          16
+
+typedef union {
+    audio_scene_evt_t evt;
+    audio_scene_evt_req_encoded_frame_t req_encoded_frame;
+    audio_scene_evt_hw_in_new_samples_t hw_in_new_samples;
+    audio_scene_evt_tone_add_t tone_add;
+    audio_scene_evt_recv_encoded_data_t recv_encoded_data;
+} audio_scene_evt_storage_t;
+
+typedef struct {
+    /* events in pool */
+    uint16_t evt_used;
+    uint16_t evt_peak;
+    /* events allocated from heap because pool is exhausted */
+    uint32_t evt_exhausted;
+    /* frames in pool of current scene */
+    uint16_t frame_count;
+    uint16_t frame_used;
+    uint16_t frame_peak;
+    /* frames allocated from heap because pool is exhausted or frame is too large */
+    uint32_t frame_exhausted;
+    /* received frames dropped in interrupt because no event or frame is available */
+    uint32_t frame_dropped;
+} audio_scene_pool_status_t;
+
 struct audio_scene_operator {
     audio_scene_t *(*allocate)(void *param);
     void (*init)(audio_scene_t *);
@@ -90,6 +118,10 @@ typedef struct {
     uint32_t sample_rate;
     audio_scene_decoder_req_raw_cb req_raw_cb;
     audio_scene_tone_destroyed_cb tone_destroyed_cb;
+    /* true: decoded PCM data is cached with tone_id, @ref audio_tone_cache.h */
+    bool cache;
+    /* identifies the tone in cache, AUDIO_TONE_ID_NONE is invalid */
+    uint16_t tone_id;
 } audio_tone_param_t;
 
 /*
@@ -144,6 +176,92 @@ void audio_scene_send_event(audio_scene_evt_t *event);
  */
 void audio_scene_recv_encoded_data(audio_scene_t *scene, bool valid, const uint8_t *buffer, uint32_t length);
 
+/*
+ * @fn          audio_scene_recv_encoded_data_seq
+ *
+ * @brief       Same as audio_scene_recv_encoded_data, the sequence number of this packet is also carried
+ *              so that scenes with jitter buffer can reorder packets and detect lost ones.
+ *
+ * @param[in]   scene : pointer to the audio scene receiving and processing these data.
+ * @param[in]   valid: true when the data packet is intact; false indicates packet loss.
+ * @param[in]   seq : sequence number of this packet, increased by one for each packet.
+ * @param[in]   buffer : pointer to the buffer stored the received data.
+ * @param[in]   length: the length of received audio data.
+ */
+void audio_scene_recv_encoded_data_seq(audio_scene_t *scene, bool valid, uint16_t seq, const uint8_t *buffer, uint32_t length);
+
+/*
+ * @fn          audio_scene_evt_alloc
+ *
+ * @brief       allocate an event from preallocated pool, this function can be called in
+ *              interrupt. Heap is used when pool is exhausted in task context.
+ *
+ * @param[in]   size : size of event structure, such as sizeof(audio_scene_evt_req_encoded_frame_t).
+ *
+ * @return      allocated event, NULL will be returned when failed.
+ */
+audio_scene_evt_t *audio_scene_evt_alloc(uint32_t size);
+
+/*
+ * @fn          audio_scene_evt_free
+ *
+ * @brief       release an event allocated by audio_scene_evt_alloc.
+ *
+ * @param[in]   evt : event to be released.
+ */
+void audio_scene_evt_free(audio_scene_evt_t *evt);
+
+/*
+ * @fn          audio_scene_frame_pool_create
+ *
+ * @brief       create pool of received frames, called by scenes which receive encoded data
+ *              in init. Each scene should choose count and length according to its traffic.
+ *
+ * @param[in]   count : number of frames in pool.
+ * @param[in]   max_length : maximum data length of each frame.
+ *
+ * @return      true: success, false: no enough memory.
+ */
+bool audio_scene_frame_pool_create(uint16_t count, uint16_t max_length);
+
+/*
+ * @fn          audio_scene_frame_pool_destroy
+ *
+ * @brief       destroy pool of received frames, called by scene in destroy. The memory is
+ *              released after all frames are returned.
+ */
+void audio_scene_frame_pool_destroy(void);
+
+/*
+ * @fn          audio_scene_frame_alloc
+ *
+ * @brief       allocate an element to store received frame, this function can be called in
+ *              interrupt. Heap is used when pool is exhausted in task context.
+ *
+ * @param[in]   length : data length.
+ *
+ * @return      allocated element, NULL will be returned when failed.
+ */
+audio_data_element_t *audio_scene_frame_alloc(uint32_t length);
+
+/*
+ * @fn          audio_scene_frame_free
+ *
+ * @brief       release an element allocated by audio_scene_frame_alloc.
+ *
+ * @param[in]   elt : element to be released.
+ */
+void audio_scene_frame_free(audio_data_element_t *elt);
+
+/*
+ * @fn          audio_scene_get_pool_status
+ *
+ * @brief       get usage and exhaustion counters of event and frame pools.
+ *
+ * @param[out]  status : used to store current status.
+ */
+void audio_scene_get_pool_status(audio_scene_pool_status_t *status);
+
 /*
  * @fn          audio_scene_decoder_started
  *
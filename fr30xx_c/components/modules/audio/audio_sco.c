@@ -3,6 +3,7 @@
 #include "audio_decoder.h"
 #include "dsp_mem.h"
 #include "algorithm.h"
+#include "audio_jitter.h"
 
 #include "audio_sco.h"
 
@@ -13,6 +14,18 @@
 
 #define TONE_RAW_DATA_BUFFER_SIZE               128
 
+/* received frames are stored in preallocated pool, 120 bytes is enough for CVSD and mSBC packets */
+#define SCO_FRAME_POOL_COUNT                    (DECODER_DATA_MAX_THD + 6)
+#define SCO_FRAME_POOL_LENGTH                   120
+
+/* playout depth range of jitter buffer, unit: frame */
+#define SCO_JITTER_MIN_DEPTH                    2
+#define SCO_JITTER_MAX_DEPTH                    12
+/* CVSD and PCM links are sampled at 8KHz, frame interval depends on packet length */
+#define SCO_NB_US_PER_SAMPLE                    125
+/* CVSD is 8-bit on air, PCM is 16-bit linear */
+#define SCO_BYTES_PER_SAMPLE(type)              (((type) == AUDIO_TYPE_PCM) ? sizeof(int16_t) : sizeof(uint8_t))
+
 typedef struct {
     audio_decoder_t *decoder;       // for sco data decoder, PLC is included
     audio_decoder_output_t *decoder_to_algo;    // decoded data routed to algorithm
@@ -22,8 +35,9 @@ typedef struct {
     audio_hw_output_t *audio_hw_output;         // used to receive ADC data
     void *audio_algo_handle;
     
-    struct co_list sco_data_list;
-    uint16_t sco_data_counter;
+    audio_jitter_t *jitter;         // received frames are reordered and buffered here
+    audio_data_element_t *cur_frame;    // frame partially fed into decoder
+    bool plc_pending;               // a lost frame is reported by jitter buffer, not concealed yet
     uint8_t start_thd;
     
     uint32_t algo_frame_size;       // unit is sample
@@ -44,7 +58,7 @@ static void decoder_request_raw_data_cb(audio_decoder_t *decoder, uint8_t event)
 {
     if ( event == AUDIO_DECODER_EVENT_REQ_RAW_DATA )
     {
-        audio_scene_evt_req_encoded_frame_t *evt = (void *)pvPortMalloc( sizeof(audio_scene_evt_req_encoded_frame_t) );
+        audio_scene_evt_req_encoded_frame_t *evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_req_encoded_frame_t));
 
         if ( evt )
         {
@@ -66,7 +80,7 @@ static void hw_request_sco_pcm_cb(void *pcm, uint32_t samples, uint8_t channels)
 
 static void hw_receive_adc_pcm_cb(uint32_t samples)
 {
-    audio_scene_evt_hw_in_new_samples_t *evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_hw_in_new_samples_t));
+    audio_scene_evt_hw_in_new_samples_t *evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_hw_in_new_samples_t));
     
     if (evt) {
         evt->evt.type = AUDIO_SCENE_EVT_TYPE_HW_IN_NEW_SAMPLES;
@@ -112,10 +126,22 @@ static void init(audio_scene_t *scene)
     
     sco_scene = scene;
     
-    co_list_init(&env->sco_data_list);
-    env->sco_data_counter = 0;
+    env->cur_frame = NULL;
+    env->plc_pending = false;
+    audio_scene_frame_pool_create(SCO_FRAME_POOL_COUNT, SCO_FRAME_POOL_LENGTH);
     env->start_thd = DECODER_DATA_READY_THD;
     
+    /* create jitter buffer, frame interval of CVSD and PCM is set when first packet is received */
+    if (param->audio_type == AUDIO_TYPE_MSBC) {
+        env->jitter = audio_jitter_create(7500, SCO_JITTER_MIN_DEPTH, SCO_JITTER_MAX_DEPTH);
+    }
+    else if (param->audio_type == AUDIO_TYPE_LC3) {
+        env->jitter = audio_jitter_create((uint32_t)(param->decoder_param.lc3.frame_ms * 1000), SCO_JITTER_MIN_DEPTH, SCO_JITTER_MAX_DEPTH);
+    }
+    else {
+        env->jitter = audio_jitter_create(0, SCO_JITTER_MIN_DEPTH, SCO_JITTER_MAX_DEPTH);
+    }
+
     /* create audio algorithm instance */
     /*
         enum
@@ -188,11 +214,9 @@ static void destroy(audio_scene_t *scene)
     dsp_mem_free(env->decoder_output);
     dsp_mem_free(env->adc_input);
 
-    audio_data_element_t *elt = (void *)co_list_pop_front(&env->sco_data_list);
-    while (elt) {
-        vPortFree(elt);
-        elt = (void *)co_list_pop_front(&env->sco_data_list);
-    }
+    audio_scene_frame_free(env->cur_frame);
+    audio_jitter_destroy(env->jitter);
+    audio_scene_frame_pool_destroy();
     
     vPortFree(scene->env);
     vPortFree(scene->param);
@@ -200,6 +224,23 @@ static void destroy(audio_scene_t *scene)
     sco_scene = NULL;
 }
 
+bool audio_sco_get_jitter_status(audio_jitter_status_t *status)
+{
+    bool ret = false;
+
+    GLOBAL_INT_DISABLE();
+    if (sco_scene) {
+        audio_sco_env_t *env = sco_scene->env;
+        if (env->jitter) {
+            audio_jitter_get_status(env->jitter, status);
+            ret = true;
+        }
+    }
+    GLOBAL_INT_RESTORE();
+
+    return ret;
+}
+
 static void event_handler(audio_scene_t *scene, audio_scene_evt_t *evt)
 {
     audio_sco_env_t *sco_env = scene->env;
@@ -213,27 +254,47 @@ static void event_handler(audio_scene_t *scene, audio_scene_evt_t *evt)
                 if (_evt->decoder == sco_env->decoder) {
                     if (audio_decoder_decode(sco_env->decoder,
                                                 NULL, &length) != AUDIO_RET_OUTPUT_ALMOTE_FULL) {
-                        if (sco_env->start_thd == 0) {
+                        if ((sco_env->start_thd == 0) && sco_env->jitter) {
                             audio_data_element_t *elt;
                             int ret;
-                            elt = (void *)co_list_pick(&sco_env->sco_data_list);
-                            while (elt) {
-                                uint32_t length = elt->length - elt->offset;
-                                if (elt->valid) {
-                                    uint32_t length = elt->length - elt->offset;
-                                    ret = audio_decoder_decode(sco_env->decoder, &elt->buffer[elt->offset], &length);
-                                    elt->offset += length;
-                                }
-                                else {
+                            while (1) {
+                                if (sco_env->plc_pending) {
+                                    /* frame is lost, conceal it */
                                     uint32_t length = AUDIO_SPECIAL_LENGTH_FOR_PLC;
                                     ret = audio_decoder_decode(sco_env->decoder, NULL, &length);
-                                    elt->offset += length;
+                                    if (length == AUDIO_SPECIAL_LENGTH_FOR_PLC) {
+                                        sco_env->plc_pending = false;
+                                    }
+                                }
+                                else if (sco_env->cur_frame) {
+                                    elt = sco_env->cur_frame;
+                                    if (elt->valid) {
+                                        uint32_t length = elt->length - elt->offset;
+                                        if (elt->offset == 0) {
+                                            audio_decoder_set_timestamp(sco_env->decoder, elt->timestamp);
+                                        }
+                                        ret = audio_decoder_decode(sco_env->decoder, &elt->buffer[elt->offset], &length);
+                                        elt->offset += length;
+                                    }
+                                    else {
+                                        uint32_t length = AUDIO_SPECIAL_LENGTH_FOR_PLC;
+                                        ret = audio_decoder_decode(sco_env->decoder, NULL, &length);
+                                        elt->offset += length;
+                                    }
+                                    if (elt->length == elt->offset) {
+                                        sco_env->cur_frame = NULL;
+                                        audio_scene_frame_free(elt);
+                                    }
                                 }
-                                if (elt->length == elt->offset) {
-                                    elt = (void *)co_list_pop_front(&sco_env->sco_data_list);
-                                    sco_env->sco_data_counter--;
-                                    vPortFree(elt);
-                                    elt = (void *)co_list_pick(&sco_env->sco_data_list);
+                                else {
+                                    uint8_t result = audio_jitter_get(sco_env->jitter, &sco_env->cur_frame);
+                                    if (result == AUDIO_JITTER_EMPTY) {
+                                        break;
+                                    }
+                                    else if (result == AUDIO_JITTER_LOST) {
+                                        sco_env->plc_pending = true;
+                                    }
+                                    continue;
                                 }
                                 if (ret == AUDIO_RET_OUTPUT_ALMOTE_FULL) {
                                     break;
@@ -264,9 +325,15 @@ static void event_handler(audio_scene_t *scene, audio_scene_evt_t *evt)
         case AUDIO_SCENE_EVT_TYPE_RECV_ENCODED_FRAME:
             {
                 audio_scene_evt_recv_encoded_data_t *_evt = (void *)evt;
-                if ((_evt->raw_frame->valid) || (sco_env->start_thd == 0)) {
-                    co_list_push_back(&sco_env->sco_data_list, &_evt->raw_frame->hdr);
-                    sco_env->sco_data_counter++;
+                if (sco_env->jitter == NULL) {
+                    audio_scene_frame_free(_evt->raw_frame);
+                }
+                else if ((_evt->raw_frame->valid) || (sco_env->start_thd == 0)) {
+                    if ((audio_jitter_get_interval(sco_env->jitter) == 0) && _evt->raw_frame->valid) {
+                        audio_jitter_set_interval(sco_env->jitter, 
+                                                    _evt->raw_frame->length * SCO_NB_US_PER_SAMPLE / SCO_BYTES_PER_SAMPLE(param->audio_type));
+                    }
+                    audio_jitter_put(sco_env->jitter, _evt->raw_frame);
                     if (sco_env->start_thd) {
                         sco_env->start_thd--;
                         if (sco_env->start_thd == 0) {
@@ -275,7 +342,7 @@ static void event_handler(audio_scene_t *scene, audio_scene_evt_t *evt)
                     }
                 }
                 else {
-                    vPortFree(_evt->raw_frame);
+                    audio_scene_frame_free(_evt->raw_frame);
                 }
             }
             break;
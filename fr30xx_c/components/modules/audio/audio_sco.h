@@ -3,6 +3,7 @@
 
 #include "audio_common.h"
 #include "audio_scene.h"
+#include "audio_jitter.h"
 
 typedef void (*audio_sco_report_encoded_frame)(void *arg, uint8_t *data, uint16_t length);
 
@@ -21,4 +22,15 @@ typedef struct {
 
 extern audio_scene_operator_t audio_sco_operator;
 
+/************************************************************************************
+ * @fn      audio_sco_get_jitter_status
+ *
+ * @brief   get depth and concealment statistics of jitter buffer in SCO scene.
+ *
+ * @param   status: used to store current status.
+ *
+ * @return  false when SCO scene is not running.
+ */
+bool audio_sco_get_jitter_status(audio_jitter_status_t *status);
+
 #endif  // _AUDIO_SCO_H_
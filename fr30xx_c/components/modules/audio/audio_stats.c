@@ -0,0 +1,239 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fr30xx.h"
+
+#include "FreeRTOS.h"
+
+#include "audio_stats.h"
+
+#if AUDIO_STATS_ENABLE
+
+/* system tick: fine counter runs from 0 to TICK_FINE_VALUE_MAX-1 in each clock, one step is 1us */
+#define AUDIO_STATS_TICK_FINE_US            1
+
+typedef struct {
+    /* timestamp when the frame is received */
+    uint32_t in_stamp;
+    /* timestamp when the frame is written into mixed PCM buffer */
+    uint32_t mix_stamp;
+    /* the frame is fetched when consumed_total reaches this value */
+    uint32_t target;
+} audio_stats_marker_t;
+
+static audio_stats_t audio_stats;
+
+/* free running counter of samples fetched from mixed PCM buffer */
+static uint32_t consumed_total;
+static audio_stats_marker_t markers[AUDIO_STATS_MARKER_NUM];
+static uint8_t marker_head, marker_count;
+static uint32_t trend_start;
+
+static void audio_stats_trend_reset(audio_stats_trend_t *trend)
+{
+    trend->underrun_samples = 0;
+    trend->fill_min = 0xffffffff;
+}
+
+static audio_stats_trend_t *audio_stats_trend_current(uint32_t now)
+{
+    if ((now - trend_start) >= (AUDIO_STATS_TREND_PERIOD_MS * 1000)) {
+        trend_start = now;
+        audio_stats.trend_idx++;
+        if (audio_stats.trend_idx >= AUDIO_STATS_TREND_WINDOWS) {
+            audio_stats.trend_idx = 0;
+        }
+        audio_stats_trend_reset(&audio_stats.trends[audio_stats.trend_idx]);
+    }
+
+    return &audio_stats.trends[audio_stats.trend_idx];
+}
+
+static void audio_stats_add(audio_stats_latency_t *latency, uint32_t value)
+{
+    uint32_t bucket;
+
+    bucket = 32 - __CLZ(value >> AUDIO_STATS_HIST_BASE_SHIFT);
+    if (bucket >= AUDIO_STATS_HIST_BUCKETS) {
+        bucket = AUDIO_STATS_HIST_BUCKETS - 1;
+    }
+
+    latency->hist[bucket]++;
+    latency->sum += value;
+    if ((latency->count == 0) || (value < latency->min)) {
+        latency->min = value;
+    }
+    if (value > latency->max) {
+        latency->max = value;
+    }
+    latency->count++;
+}
+
+uint32_t audio_stats_timestamp(void)
+{
+    uint32_t clk, fine;
+    uint32_t stamp;
+
+    tick_get(&clk, &fine);
+    stamp = (clk * TICK_FINE_VALUE_MAX + fine) * AUDIO_STATS_TICK_FINE_US;
+
+    /* 0 is used as no timestamp */
+    return stamp ? stamp : 1;
+}
+
+void audio_stats_latency(uint8_t stage, uint32_t start)
+{
+    uint32_t now = audio_stats_timestamp();
+
+    if ((start == 0) || (stage >= AUDIO_STATS_STAGE_NUM)) {
+        return;
+    }
+
+    GLOBAL_INT_DISABLE();
+    audio_stats_add(&audio_stats.latency[stage], now - start);
+    GLOBAL_INT_RESTORE();
+}
+
+void audio_stats_frame_mixed(uint32_t in_stamp, uint32_t samples_ahead)
+{
+    uint32_t now = audio_stats_timestamp();
+
+    if (in_stamp == 0) {
+        return;
+    }
+
+    GLOBAL_INT_DISABLE();
+    if (marker_count < AUDIO_STATS_MARKER_NUM) {
+        audio_stats_marker_t *marker;
+        uint8_t idx = marker_head + marker_count;
+
+        if (idx >= AUDIO_STATS_MARKER_NUM) {
+            idx -= AUDIO_STATS_MARKER_NUM;
+        }
+        marker = &markers[idx];
+        marker->in_stamp = in_stamp;
+        marker->mix_stamp = now;
+        marker->target = consumed_total + samples_ahead;
+        marker_count++;
+    }
+    else {
+        audio_stats.marker_lost++;
+    }
+    GLOBAL_INT_RESTORE();
+}
+
+void audio_stats_pcm_consumed(uint32_t samples, uint32_t fill_samples)
+{
+    uint32_t now = audio_stats_timestamp();
+    audio_stats_trend_t *trend;
+
+    GLOBAL_INT_DISABLE();
+    consumed_total += samples;
+    while (marker_count) {
+        audio_stats_marker_t *marker = &markers[marker_head];
+
+        if ((int32_t)(consumed_total - marker->target) < 0) {
+            break;
+        }
+        audio_stats_add(&audio_stats.latency[AUDIO_STATS_STAGE_BUFFER], now - marker->mix_stamp);
+        audio_stats_add(&audio_stats.latency[AUDIO_STATS_STAGE_TOTAL], now - marker->in_stamp);
+        marker_head++;
+        if (marker_head >= AUDIO_STATS_MARKER_NUM) {
+            marker_head = 0;
+        }
+        marker_count--;
+    }
+
+    trend = audio_stats_trend_current(now);
+    if (fill_samples < trend->fill_min) {
+        trend->fill_min = fill_samples;
+    }
+    GLOBAL_INT_RESTORE();
+}
+
+void audio_stats_underrun(uint32_t samples)
+{
+    uint32_t now = audio_stats_timestamp();
+    audio_stats_trend_t *trend;
+
+    GLOBAL_INT_DISABLE();
+    audio_stats.underrun_cnt++;
+    audio_stats.underrun_samples += samples;
+    trend = audio_stats_trend_current(now);
+    trend->underrun_samples += samples;
+    trend->fill_min = 0;
+    GLOBAL_INT_RESTORE();
+}
+
+void audio_stats_overrun(uint32_t frames)
+{
+    GLOBAL_INT_DISABLE();
+    audio_stats.overrun_cnt += frames;
+    GLOBAL_INT_RESTORE();
+}
+
+void audio_stats_get(audio_stats_t *stats)
+{
+    GLOBAL_INT_DISABLE();
+    memcpy((void *)stats, (void *)&audio_stats, sizeof(audio_stats_t));
+    GLOBAL_INT_RESTORE();
+}
+
+void audio_stats_reset(void)
+{
+    uint32_t now = audio_stats_timestamp();
+
+    GLOBAL_INT_DISABLE();
+    memset((void *)&audio_stats, 0, sizeof(audio_stats_t));
+    for (uint32_t i = 0; i < AUDIO_STATS_TREND_WINDOWS; i++) {
+        audio_stats_trend_reset(&audio_stats.trends[i]);
+    }
+    /* frames in mixed PCM buffer are still tracked */
+    trend_start = now;
+    GLOBAL_INT_RESTORE();
+}
+
+void audio_stats_dump(void)
+{
+    const static char *stage_name[AUDIO_STATS_STAGE_NUM] = {"queue", "decode", "buffer", "total"};
+    audio_stats_t *stats;
+
+    /* take snapshot to keep interrupts enabled during printing */
+    stats = pvPortMalloc(sizeof(audio_stats_t));
+    if (stats == NULL) {
+        return;
+    }
+    audio_stats_get(stats);
+
+    printf("audio stats: underrun %d/%d samples, overrun %d, marker lost %d\r\n",
+            stats->underrun_cnt, stats->underrun_samples, stats->overrun_cnt, stats->marker_lost);
+    for (uint32_t i = 0; i < AUDIO_STATS_STAGE_NUM; i++) {
+        audio_stats_latency_t *latency = &stats->latency[i];
+        if (latency->count == 0) {
+            continue;
+        }
+        printf("%-6s n=%d min=%dus avg=%dus max=%dus hist:", stage_name[i], latency->count,
+                latency->min, (uint32_t)(latency->sum / latency->count), latency->max);
+        for (uint32_t j = 0; j < AUDIO_STATS_HIST_BUCKETS; j++) {
+            printf(" %d", latency->hist[j]);
+        }
+        printf("\r\n");
+    }
+    /* from oldest window to current one */
+    printf("trend (underrun/fill_min):");
+    for (uint32_t i = 1; i <= AUDIO_STATS_TREND_WINDOWS; i++) {
+        audio_stats_trend_t *trend = &stats->trends[(stats->trend_idx + i) % AUDIO_STATS_TREND_WINDOWS];
+        if (trend->fill_min == 0xffffffff) {
+            printf(" -");
+        }
+        else {
+            printf(" %d/%d", trend->underrun_samples, trend->fill_min);
+        }
+    }
+    printf("\r\n");
+
+    vPortFree(stats);
+}
+
+#endif  // AUDIO_STATS_ENABLE
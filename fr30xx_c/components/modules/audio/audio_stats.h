@@ -0,0 +1,154 @@
+#ifndef _AUDIO_STATS_H
+#define _AUDIO_STATS_H
+
+#include <stdint.h>
+
+/*
+ * Latency and underrun instrumentation of audio playback path. Each received frame
+ * is stamped in audio_scene_recv_encoded_data, the stamp is carried through decoder
+ * and mixed PCM buffer until the PCM data is fetched by audio hardware.
+ */
+#define AUDIO_STATS_ENABLE                  1
+
+/* latency histogram buckets: bucket n covers [2^(n-1), 2^n) * 256us, the last one is unlimited */
+#define AUDIO_STATS_HIST_BUCKETS            16
+#define AUDIO_STATS_HIST_BASE_SHIFT         8
+/* number of windows and window length of trends */
+#define AUDIO_STATS_TREND_WINDOWS           8
+#define AUDIO_STATS_TREND_PERIOD_MS         1000
+/* frames stamped in mixed PCM buffer and waiting to be fetched */
+#define AUDIO_STATS_MARKER_NUM              16
+
+enum audio_stats_stage {
+    AUDIO_STATS_STAGE_QUEUE,        // received -> decoding is started
+    AUDIO_STATS_STAGE_DECODE,       // decoding is started -> written into mixed PCM buffer (decode, resample, mix)
+    AUDIO_STATS_STAGE_BUFFER,       // written into mixed PCM buffer -> fetched by audio hardware
+    AUDIO_STATS_STAGE_TOTAL,        // received -> fetched by audio hardware
+    AUDIO_STATS_STAGE_NUM,
+};
+
+typedef struct {
+    uint32_t count;
+    /* unit is us */
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t hist[AUDIO_STATS_HIST_BUCKETS];
+} audio_stats_latency_t;
+
+typedef struct {
+    /* underrun samples filled with zero in this window */
+    uint32_t underrun_samples;
+    /* minimum level of mixed PCM buffer in this window, unit is sample */
+    uint32_t fill_min;
+} audio_stats_trend_t;
+
+typedef struct {
+    audio_stats_latency_t latency[AUDIO_STATS_STAGE_NUM];
+
+    /* how many times outputs have to fill zero */
+    uint32_t underrun_cnt;
+    uint32_t underrun_samples;
+    /* how many received frames are dropped because of no space */
+    uint32_t overrun_cnt;
+    /* stamped frames whose latency can not be tracked because marker FIFO is full */
+    uint32_t marker_lost;
+
+    /* trends[trend_idx] is the ongoing window, the others are completed ones */
+    audio_stats_trend_t trends[AUDIO_STATS_TREND_WINDOWS];
+    uint8_t trend_idx;
+} audio_stats_t;
+
+#if AUDIO_STATS_ENABLE
+/************************************************************************************
+ * @fn      audio_stats_timestamp
+ *
+ * @brief   get current timestamp from system tick, 0 is never returned.
+ *
+ * @return  timestamp, unit is us.
+ */
+uint32_t audio_stats_timestamp(void);
+
+/************************************************************************************
+ * @fn      audio_stats_latency
+ *
+ * @brief   record latency of a stage from start timestamp to now.
+ *
+ * @param   stage: @ref audio_stats_stage.
+ * @param   start: start timestamp of this stage.
+ */
+void audio_stats_latency(uint8_t stage, uint32_t start);
+
+/************************************************************************************
+ * @fn      audio_stats_frame_mixed
+ *
+ * @brief   called by decoder after a stamped frame is written into mixed PCM buffer.
+ *
+ * @param   in_stamp: timestamp when this frame is received.
+ * @param   samples_ahead: samples to be fetched before the end of this frame is fetched.
+ */
+void audio_stats_frame_mixed(uint32_t in_stamp, uint32_t samples_ahead);
+
+/************************************************************************************
+ * @fn      audio_stats_pcm_consumed
+ *
+ * @brief   called by decoder when samples in mixed PCM buffer are fetched by all outputs.
+ *
+ * @param   samples: fetched samples.
+ * @param   fill_samples: remaining samples in mixed PCM buffer.
+ */
+void audio_stats_pcm_consumed(uint32_t samples, uint32_t fill_samples);
+
+/************************************************************************************
+ * @fn      audio_stats_underrun
+ *
+ * @brief   called by outputs when zero is filled because of no enough PCM data.
+ *
+ * @param   samples: samples filled with zero.
+ */
+void audio_stats_underrun(uint32_t samples);
+
+/************************************************************************************
+ * @fn      audio_stats_overrun
+ *
+ * @brief   called by audio scenes when received frames are dropped.
+ *
+ * @param   frames: number of dropped frames.
+ */
+void audio_stats_overrun(uint32_t frames);
+
+/************************************************************************************
+ * @fn      audio_stats_get
+ *
+ * @brief   get a snapshot of current statistics.
+ *
+ * @param   stats: used to store the snapshot.
+ */
+void audio_stats_get(audio_stats_t *stats);
+
+/************************************************************************************
+ * @fn      audio_stats_reset
+ *
+ * @brief   clear all statistics.
+ */
+void audio_stats_reset(void);
+
+/************************************************************************************
+ * @fn      audio_stats_dump
+ *
+ * @brief   print current statistics.
+ */
+void audio_stats_dump(void);
+#else
+static inline uint32_t audio_stats_timestamp(void) { return 0; }
+static inline void audio_stats_latency(uint8_t stage, uint32_t start) {}
+static inline void audio_stats_frame_mixed(uint32_t in_stamp, uint32_t samples_ahead) {}
+static inline void audio_stats_pcm_consumed(uint32_t samples, uint32_t fill_samples) {}
+static inline void audio_stats_underrun(uint32_t samples) {}
+static inline void audio_stats_overrun(uint32_t frames) {}
+static inline void audio_stats_get(audio_stats_t *stats) {}
+static inline void audio_stats_reset(void) {}
+static inline void audio_stats_dump(void) {}
+#endif
+
+#endif  // _AUDIO_STATS_H
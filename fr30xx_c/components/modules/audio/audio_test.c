@@ -1,5 +1,11 @@
+#include <string.h>
+#include <math.h>
+
 #include "audio_test.h"
 #include "audio_scene.h"
+#include "audio_sco.h"
+#include "audio_mix.h"
+#include "resample_poly.h"
 
 #include "fr30xx.h"
 
@@ -254,6 +260,7 @@ static void sco_stop(void)
 //{
 //    audio_scene_param_tone_t param;
 
+//    memset((void *)&param, 0, sizeof(param));
 //    param.audio_type = AUDIO_TYPE_MP3;
 //    param.hw_type = AUDIO_HW_TYPE_I2S;
 //    param.hw_base_addr = I2S0_BASE;
@@ -293,6 +300,170 @@ void voice_recognize_stop(void)
     audio_scene_destroy(voice_recognize_scene);
 }
 
+#define MIX_BENCH_SAMPLES       480
+#define MIX_BENCH_LOOPS         16
+
+static void mix_bench_report(const char *name, uint8_t channels, uint32_t cycles)
+{
+    uint32_t samples = MIX_BENCH_SAMPLES * MIX_BENCH_LOOPS;
+
+    /* cycles per sample in 1/100 unit */
+    cycles = cycles * 100 / samples;
+    printf("%s %s: %d.%02d cycles/sample\r\n", name, channels == 1 ? "mono" : "stereo", cycles / 100, cycles % 100);
+}
+
+/*
+ * Measure kernels used by decoder mix path: a 16-bit source is converted into Q31
+ * with a gain ramp, added into mix buffer, and mix buffer is converted back to 16-bit.
+ */
+static void mix_benchmark(void)
+{
+    static int16_t pcm[MIX_BENCH_SAMPLES * 2];
+    static audio_mix_sample_t dst[MIX_BENCH_SAMPLES * 2];
+    static audio_mix_sample_t src[MIX_BENCH_SAMPLES * 2];
+    audio_mix_ramp_t ramp;
+    uint32_t start;
+
+    for (uint32_t i=0; i<MIX_BENCH_SAMPLES * 2; i++) {
+        pcm[i] = (int16_t)(i * 1237);
+        dst[i] = (audio_mix_sample_t)(i * 4099);
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (uint8_t channels=1; channels<=2; channels++) {
+        audio_pcm_format_t format = AUDIO_PCM_FORMAT_S16(channels);
+
+        start = DWT->CYCCNT;
+        for (uint32_t i=0; i<MIX_BENCH_LOOPS; i++) {
+            audio_mix_to_q31(src, channels, pcm, &format, MIX_BENCH_SAMPLES);
+        }
+        mix_bench_report("to_q31", channels, DWT->CYCCNT - start);
+
+        audio_mix_ramp_set(&ramp, AUDIO_MIX_RAMP_UNITY);
+        start = DWT->CYCCNT;
+        for (uint32_t i=0; i<MIX_BENCH_LOOPS; i++) {
+            audio_mix_ramp_start(&ramp, (i & 1) ? AUDIO_MIX_RAMP_UNITY : AUDIO_MIX_RAMP_UNITY / 4, MIX_BENCH_SAMPLES, AUDIO_MIX_RAMP_LINEAR);
+            audio_mix_ramp_to_q31(src, channels, pcm, &format, MIX_BENCH_SAMPLES, &ramp);
+        }
+        mix_bench_report("ramp_to_q31", channels, DWT->CYCCNT - start);
+
+        start = DWT->CYCCNT;
+        for (uint32_t i=0; i<MIX_BENCH_LOOPS; i++) {
+            audio_mix_add_q31(dst, src, MIX_BENCH_SAMPLES * channels);
+        }
+        mix_bench_report("add_q31", channels, DWT->CYCCNT - start);
+
+        start = DWT->CYCCNT;
+        for (uint32_t i=0; i<MIX_BENCH_LOOPS; i++) {
+            audio_mix_from_q31(pcm, &format, dst, channels, MIX_BENCH_SAMPLES);
+        }
+        mix_bench_report("from_q31", channels, DWT->CYCCNT - start);
+    }
+}
+
+#define RESAMPLE_BENCH_IN_SAMPLES       480
+#define RESAMPLE_BENCH_LOOPS            40
+#define RESAMPLE_BENCH_OUT_SAMPLES      (RESAMPLE_BENCH_IN_SAMPLES * 6 + 64)
+#define RESAMPLE_BENCH_SKIP_SAMPLES     64
+#define RESAMPLE_BENCH_TONE             1000
+
+/*
+ * Feed a 1kHz stereo tone into MCU resampler, measure cycles per output sample and
+ * SNR of output. SNR is calculated by a least square fit of the expected tone.
+ */
+static void resample_poly_bench_run(uint32_t in_sample_rate, uint32_t out_sample_rate)
+{
+    static int16_t in[RESAMPLE_BENCH_IN_SAMPLES * 2];
+    static int16_t out[RESAMPLE_BENCH_OUT_SAMPLES * 2];
+    double m[3][3] = {0}, r[3] = {0}, proj[3], x[3], energy = 0, noise;
+    uint32_t in_index = 0, out_index = 0;
+    uint32_t cycles = 0, produced = 0, start;
+    void *resample;
+
+    resample = resample_poly_init(in_sample_rate, out_sample_rate, 2);
+    if (resample == NULL) {
+        printf("resample %d->%d: init failed\r\n", in_sample_rate, out_sample_rate);
+        return;
+    }
+
+    for (uint32_t loop=0; loop<RESAMPLE_BENCH_LOOPS; loop++) {
+        uint32_t in_samples = RESAMPLE_BENCH_IN_SAMPLES;
+        uint32_t out_samples;
+
+        for (uint32_t i=0; i<RESAMPLE_BENCH_IN_SAMPLES; i++) {
+            int16_t value = (int16_t)(16000 * sin(2 * M_PI * RESAMPLE_BENCH_TONE * in_index++ / in_sample_rate));
+            in[i * 2] = value;
+            in[i * 2 + 1] = -value;
+        }
+
+        start = DWT->CYCCNT;
+        out_samples = resample_poly_exec(resample, in, &in_samples, out, RESAMPLE_BENCH_OUT_SAMPLES);
+        cycles += DWT->CYCCNT - start;
+        produced += out_samples;
+
+        for (uint32_t i=0; i<out_samples; i++, out_index++) {
+            double phase = 2 * M_PI * RESAMPLE_BENCH_TONE * out_index / out_sample_rate;
+            double v[3] = {cos(phase), sin(phase), 1.0};
+            double y = out[i * 2];
+
+            if (out_index < RESAMPLE_BENCH_SKIP_SAMPLES) {
+                continue;
+            }
+            for (uint8_t a=0; a<3; a++) {
+                r[a] += v[a] * y;
+                for (uint8_t b=0; b<3; b++) {
+                    m[a][b] += v[a] * v[b];
+                }
+            }
+            energy += y * y;
+        }
+    }
+    resample_poly_destroy(resample);
+
+    /* solve m * x = r, residual energy is energy - x * r */
+    memcpy((void *)proj, (void *)r, sizeof(proj));
+    for (uint8_t a=0; a<3; a++) {
+        for (uint8_t b=a+1; b<3; b++) {
+            double k = m[b][a] / m[a][a];
+            for (uint8_t c=0; c<3; c++) {
+                m[b][c] -= k * m[a][c];
+            }
+            r[b] -= k * r[a];
+        }
+    }
+    for (int8_t a=2; a>=0; a--) {
+        x[a] = r[a];
+        for (uint8_t c=a+1; c<3; c++) {
+            x[a] -= m[a][c] * x[c];
+        }
+        x[a] /= m[a][a];
+    }
+    noise = energy;
+    for (uint8_t a=0; a<3; a++) {
+        noise -= x[a] * proj[a];
+    }
+
+    cycles = cycles * 100 / produced;
+    printf("resample %d->%d: %d.%02d cycles/sample, SNR %d dB\r\n", in_sample_rate, out_sample_rate,
+                cycles / 100, cycles % 100,
+                (int)(10 * log10((x[0] * x[0] + x[1] * x[1]) / 2 * (out_index - RESAMPLE_BENCH_SKIP_SAMPLES) / noise)));
+}
+
+static void resample_poly_benchmark(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    resample_poly_bench_run(44100, 48000);
+    resample_poly_bench_run(22050, 48000);
+    resample_poly_bench_run(11025, 16000);
+    resample_poly_bench_run(48000, 16000);
+}
+
 void audio_test(uint8_t sub_cmd, uint8_t *param)
 {
     switch(sub_cmd) {
@@ -339,6 +510,26 @@ void audio_test(uint8_t sub_cmd, uint8_t *param)
         case 'N':
             voice_recognize_stop();
             break;
+        case 'O':
+            mix_benchmark();
+            break;
+        case 'P':
+            resample_poly_benchmark();
+            break;
+        case 'Q':
+            audio_stats_dump();
+            {
+                audio_jitter_status_t status;
+                if (audio_sco_get_jitter_status(&status)) {
+                    printf("sco jitter: depth %d/%d, jitter %dus, conceal %d/1000, late %d, dup %d, drop %d, underrun %d\r\n",
+                            status.depth, status.target, status.jitter, status.conceal_rate,
+                            status.late, status.duplicate, status.dropped, status.underrun);
+                }
+            }
+            break;
+        case 'R':
+            audio_stats_reset();
+            break;
         default:
             break;
     }
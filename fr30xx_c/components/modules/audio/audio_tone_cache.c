@@ -0,0 +1,276 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "heap_region.h"
+
+#include "audio_tone_cache.h"
+
+typedef struct {
+    /* least recently used entry is at the front */
+    struct co_list entry_list;
+    audio_tone_cache_status_t status;
+    bool inited;
+} audio_tone_cache_env_t;
+
+static audio_tone_cache_env_t tone_cache;
+
+static void tone_cache_check_init(void)
+{
+    if (tone_cache.inited == false) {
+        co_list_init(&tone_cache.entry_list);
+        memset((void *)&tone_cache.status, 0, sizeof(audio_tone_cache_status_t));
+        tone_cache.status.budget = AUDIO_TONE_CACHE_BUDGET;
+        tone_cache.inited = true;
+    }
+}
+
+static void tone_cache_free_chunks(audio_tone_cache_entry_t *entry)
+{
+    audio_tone_cache_chunk_t *chunk;
+
+    do {
+        chunk = (void *)co_list_pop_front(&entry->chunk_list);
+        if (chunk) {
+            AUDIO_TONE_CACHE_FREE(chunk);
+        }
+    } while (chunk);
+
+    tone_cache.status.used -= entry->size;
+    entry->size = 0;
+    entry->samples = 0;
+}
+
+static void tone_cache_remove(audio_tone_cache_entry_t *entry)
+{
+    co_list_extract(&tone_cache.entry_list, &entry->hdr);
+    tone_cache_free_chunks(entry);
+    tone_cache.status.entries--;
+    vPortFree(entry);
+}
+
+/* evict least recently used entries until size more bytes can be stored */
+static bool tone_cache_reserve(uint32_t size)
+{
+    audio_tone_cache_entry_t *entry, *next;
+
+    entry = (void *)co_list_pick(&tone_cache.entry_list);
+    while (entry && ((tone_cache.status.used + size) > tone_cache.status.budget)) {
+        next = (void *)entry->hdr.next;
+        if (entry->refs == 0) {
+            tone_cache_remove(entry);
+            tone_cache.status.evicted++;
+        }
+        entry = next;
+    }
+
+    return (tone_cache.status.used + size) <= tone_cache.status.budget;
+}
+
+static void *tone_cache_chunk_alloc(uint32_t size)
+{
+    void *chunk;
+
+    chunk = AUDIO_TONE_CACHE_MALLOC(size);
+#if HEAP_MEM_DEBUG
+    if ((chunk == NULL)
+            && heap_mem_is_inited(HEAP_TYPE_SRAM_BLOCK)
+            && (heap_get_mem_available(HEAP_TYPE_SRAM_BLOCK) >= (size + AUDIO_TONE_CACHE_SRAM_MIN_FREE))) {
+        chunk = AUDIO_TONE_CACHE_SRAM_MALLOC(size);
+    }
+#endif
+
+    return chunk;
+}
+
+static void tone_cache_record_fail(audio_tone_cache_entry_t *entry)
+{
+    tone_cache_free_chunks(entry);
+    entry->state = AUDIO_TONE_CACHE_FAILED;
+    tone_cache.status.failed++;
+}
+
+void audio_tone_cache_set_budget(uint32_t budget)
+{
+    tone_cache_check_init();
+
+    tone_cache.status.budget = budget;
+    tone_cache_reserve(0);
+}
+
+audio_tone_cache_entry_t *audio_tone_cache_get(uint16_t id, uint32_t sample_rate)
+{
+    audio_tone_cache_entry_t *entry;
+
+    tone_cache_check_init();
+
+    if (id == AUDIO_TONE_ID_NONE) {
+        return NULL;
+    }
+
+    entry = (void *)co_list_pick(&tone_cache.entry_list);
+    while (entry) {
+        if ((entry->id == id)
+                && (entry->sample_rate == sample_rate)
+                && (entry->state == AUDIO_TONE_CACHE_READY)) {
+            /* move to the most recently used position */
+            co_list_extract(&tone_cache.entry_list, &entry->hdr);
+            co_list_push_back(&tone_cache.entry_list, &entry->hdr);
+            entry->refs++;
+            tone_cache.status.hit++;
+            return entry;
+        }
+        entry = (void *)entry->hdr.next;
+    }
+
+    tone_cache.status.miss++;
+
+    return NULL;
+}
+
+void audio_tone_cache_put(audio_tone_cache_entry_t *entry)
+{
+    if (entry && entry->refs) {
+        entry->refs--;
+        tone_cache_reserve(0);
+    }
+}
+
+audio_tone_cache_entry_t *audio_tone_cache_record_start(uint16_t id, uint32_t sample_rate)
+{
+    audio_tone_cache_entry_t *entry;
+
+    tone_cache_check_init();
+
+    if ((id == AUDIO_TONE_ID_NONE) || (tone_cache.status.budget == 0)) {
+        return NULL;
+    }
+
+    entry = pvPortMalloc(sizeof(audio_tone_cache_entry_t));
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->id = id;
+    entry->state = AUDIO_TONE_CACHE_RECORDING;
+    entry->channels = 0;
+    entry->refs = 1;
+    entry->sample_rate = sample_rate;
+    entry->samples = 0;
+    entry->size = 0;
+    co_list_init(&entry->chunk_list);
+
+    co_list_push_back(&tone_cache.entry_list, &entry->hdr);
+    tone_cache.status.entries++;
+
+    return entry;
+}
+
+void audio_tone_cache_record(audio_tone_cache_entry_t *entry, const void *pcm, uint32_t samples, const audio_pcm_format_t *format)
+{
+    audio_tone_cache_chunk_t *chunk;
+    const int16_t *src = pcm;
+
+    if ((entry == NULL) || (entry->state != AUDIO_TONE_CACHE_RECORDING)) {
+        return;
+    }
+
+    if (entry->channels == 0) {
+        entry->channels = format->channels;
+    }
+    if ((format->container != 2)
+            || (format->channels != entry->channels)
+            || ((format->interleaved == false) && (format->channels > 1))) {
+        tone_cache_record_fail(entry);
+        return;
+    }
+
+    while (samples) {
+        uint32_t count;
+
+        chunk = (void *)entry->chunk_list.last;
+        if ((chunk == NULL) || (chunk->samples == AUDIO_TONE_CACHE_CHUNK_SAMPLES)) {
+            uint32_t size = sizeof(audio_tone_cache_chunk_t) + AUDIO_TONE_CACHE_CHUNK_SAMPLES * entry->channels * sizeof(int16_t);
+
+            if (tone_cache_reserve(size)) {
+                chunk = tone_cache_chunk_alloc(size);
+            }
+            else {
+                chunk = NULL;
+            }
+            if (chunk == NULL) {
+                tone_cache_record_fail(entry);
+                return;
+            }
+            chunk->samples = 0;
+            co_list_push_back(&entry->chunk_list, &chunk->hdr);
+            entry->size += size;
+            tone_cache.status.used += size;
+        }
+
+        count = AUDIO_TONE_CACHE_CHUNK_SAMPLES - chunk->samples;
+        if (count > samples) {
+            count = samples;
+        }
+        memcpy((void *)&chunk->pcm[chunk->samples * entry->channels], (const void *)src, count * entry->channels * sizeof(int16_t));
+        chunk->samples += count;
+        entry->samples += count;
+        src += count * entry->channels;
+        samples -= count;
+    }
+}
+
+void audio_tone_cache_record_end(audio_tone_cache_entry_t *entry, bool complete)
+{
+    if (entry == NULL) {
+        return;
+    }
+
+    if (complete && (entry->state == AUDIO_TONE_CACHE_RECORDING) && entry->samples) {
+        audio_tone_cache_entry_t *tmp;
+
+        /* the same tone may be recorded by another play before, keep only one copy */
+        tmp = (void *)co_list_pick(&tone_cache.entry_list);
+        while (tmp) {
+            if ((tmp != entry)
+                    && (tmp->id == entry->id)
+                    && (tmp->sample_rate == entry->sample_rate)
+                    && (tmp->state == AUDIO_TONE_CACHE_READY)
+                    && (tmp->refs == 0)) {
+                tone_cache_remove(tmp);
+                break;
+            }
+            tmp = (void *)tmp->hdr.next;
+        }
+
+        entry->state = AUDIO_TONE_CACHE_READY;
+        entry->refs--;
+    }
+    else {
+        tone_cache_remove(entry);
+    }
+}
+
+void audio_tone_cache_flush(void)
+{
+    audio_tone_cache_entry_t *entry, *next;
+
+    tone_cache_check_init();
+
+    entry = (void *)co_list_pick(&tone_cache.entry_list);
+    while (entry) {
+        next = (void *)entry->hdr.next;
+        if (entry->refs == 0) {
+            tone_cache_remove(entry);
+        }
+        entry = next;
+    }
+}
+
+void audio_tone_cache_get_status(audio_tone_cache_status_t *status)
+{
+    tone_cache_check_init();
+
+    *status = tone_cache.status;
+}
@@ -0,0 +1,163 @@
+#ifndef _AUDIO_TONE_CACHE_H
+#define _AUDIO_TONE_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "co_list.h"
+
+#include "audio_common.h"
+
+/*
+ * Cache of decoded tones. PCM data of a tone is recorded after it is decoded and
+ * resampled to the sample rate of mixed PCM buffer when it is played for the first
+ * time, later plays of the same tone are written into mixed PCM buffer directly
+ * without waking DSP. Only tones played with cache set in audio_tone_param_t are
+ * cached, they are identified by tone_id. The least recently used tones are evicted
+ * when total size exceeds the budget. All functions should be called in audio
+ * scene task.
+ */
+
+/* invalid tone_id, rejected by tone cache */
+#define AUDIO_TONE_ID_NONE                  0
+/* default size budget of all cached tones, unit is byte */
+#define AUDIO_TONE_CACHE_BUDGET             (16 * 1024)
+/* PCM data are stored in chunks, unit is sample */
+#define AUDIO_TONE_CACHE_CHUNK_SAMPLES      1024
+/*
+ * Without a bulk region such as PSRAM, chunks are taken from SRAM heap shared with
+ * pvPortMalloc, which halts the system when exhausted. Recording fails instead when
+ * free SRAM heap would drop below this value.
+ */
+#define AUDIO_TONE_CACHE_SRAM_MIN_FREE      (32 * 1024)
+
+/* memory used to store PCM data, SRAM is only used when no bulk region is available */
+#define AUDIO_TONE_CACHE_MALLOC(size)       heap_region_alloc(size, HEAP_CAP_BULK | HEAP_HINT_STRICT)
+#define AUDIO_TONE_CACHE_SRAM_MALLOC(size)  heap_region_alloc(size, HEAP_CAP_FAST | HEAP_HINT_STRICT)
+#define AUDIO_TONE_CACHE_FREE(ptr)          heap_region_free(ptr)
+
+enum audio_tone_cache_state {
+    AUDIO_TONE_CACHE_RECORDING,
+    AUDIO_TONE_CACHE_READY,
+    AUDIO_TONE_CACHE_FAILED,
+};
+
+typedef struct {
+    struct co_list_hdr hdr;
+
+    uint16_t samples;
+    /* 16-bit interleaved */
+    int16_t pcm[];
+} audio_tone_cache_chunk_t;
+
+typedef struct {
+    struct co_list_hdr hdr;
+
+    uint16_t id;
+    uint8_t state;
+    uint8_t channels;
+    /* entry can not be evicted when it is being played or recorded */
+    uint8_t refs;
+    uint32_t sample_rate;
+    uint32_t samples;
+    uint32_t size;
+
+    struct co_list chunk_list;
+} audio_tone_cache_entry_t;
+
+typedef struct {
+    uint32_t budget;
+    uint32_t used;
+    uint16_t entries;
+    uint32_t hit;
+    uint32_t miss;
+    uint32_t evicted;
+    /* recording failed because of no memory or unsupported format */
+    uint32_t failed;
+} audio_tone_cache_status_t;
+
+/************************************************************************************
+ * @fn      audio_tone_cache_set_budget
+ *
+ * @brief   change size budget of tone cache, unused entries are evicted when needed.
+ *
+ * @param   budget: size budget in bytes, 0 disables the cache.
+ */
+void audio_tone_cache_set_budget(uint32_t budget);
+
+/************************************************************************************
+ * @fn      audio_tone_cache_get
+ *
+ * @brief   search a recorded tone and mark it as used, audio_tone_cache_put should be
+ *          called after the tone is played.
+ *
+ * @param   id: tone id.
+ * @param   sample_rate: sample rate of mixed PCM buffer.
+ *
+ * @return  cached tone, NULL will be returned when it is not found.
+ */
+audio_tone_cache_entry_t *audio_tone_cache_get(uint16_t id, uint32_t sample_rate);
+
+/************************************************************************************
+ * @fn      audio_tone_cache_put
+ *
+ * @brief   release a cached tone got by audio_tone_cache_get.
+ *
+ * @param   entry: cached tone.
+ */
+void audio_tone_cache_put(audio_tone_cache_entry_t *entry);
+
+/************************************************************************************
+ * @fn      audio_tone_cache_record_start
+ *
+ * @brief   create an entry to record PCM data of a tone.
+ *
+ * @param   id: tone id.
+ * @param   sample_rate: sample rate of mixed PCM buffer.
+ *
+ * @return  created entry, NULL will be returned when cache is disabled.
+ */
+audio_tone_cache_entry_t *audio_tone_cache_record_start(uint16_t id, uint32_t sample_rate);
+
+/************************************************************************************
+ * @fn      audio_tone_cache_record
+ *
+ * @brief   append decoded PCM data into a recording entry. Recording is failed when
+ *          budget is exceeded, heap is under pressure or the format is not 16-bit
+ *          interleaved.
+ *
+ * @param   entry: recording entry.
+ * @param   pcm: PCM data.
+ * @param   samples: number of samples.
+ * @param   format: format of PCM data.
+ */
+void audio_tone_cache_record(audio_tone_cache_entry_t *entry, const void *pcm, uint32_t samples, const audio_pcm_format_t *format);
+
+/************************************************************************************
+ * @fn      audio_tone_cache_record_end
+ *
+ * @brief   finish recording of a tone.
+ *
+ * @param   entry: recording entry.
+ * @param   complete: true: the whole tone is recorded, false: tone is stopped before
+ *                    finished, recorded data is dropped.
+ */
+void audio_tone_cache_record_end(audio_tone_cache_entry_t *entry, bool complete);
+
+/************************************************************************************
+ * @fn      audio_tone_cache_flush
+ *
+ * @brief   drop all unused entries, for example when tone resources are updated.
+ */
+void audio_tone_cache_flush(void);
+
+/************************************************************************************
+ * @fn      audio_tone_cache_get_status
+ *
+ * @brief   get memory usage and hit statistics of tone cache.
+ *
+ * @param   status: used to store current status.
+ */
+void audio_tone_cache_get_status(audio_tone_cache_status_t *status);
+
+#endif  // _AUDIO_TONE_CACHE_H
@@ -257,6 +257,114 @@ int codec_decoder_get_param(struct codec_decoder_handle *handle, uint32_t *sampl
     return (int)result;
 }
 
+/************************************************************************************
+ * @fn      codec_decoder_pipeline_exec
+ *
+ * @brief   reqeust to execute decode, get information of decoded frame and resample
+ *          decoded data in one invocation. If this function is not supported by DSP,
+ *          decode and get param are executed separately and resample is skipped.
+ *
+ * @param   pipeline: pipeline descriptor, format of decoded frame and resample result
+ *                    are updated into this descriptor.
+ * @param   in_buf: buffer used to store raw data, caller should take care that this 
+ *                  buffer should be accessable for dsp.
+ * @param   in_length: the length of raw data, this value will be updated to length of
+ *                     dealed data after decode operation is executed.
+ * @param   out_buf: used to store the buffer address of decoded (or resampled) data, the
+ *                   same as codec_decoder_decode.
+ * @param   out_length: the length of decoded (or resampled) data.
+ *
+ * @return  execute result.
+ */
+int codec_decoder_pipeline_exec(struct codec_decoder_pipeline *pipeline,
+                            const uint8_t *in_buf,
+                            uint32_t *in_length,
+                            uint8_t **out_buf,
+                            uint32_t *out_length)
+{
+    static bool pipeline_unsupported = false;
+    /* the invocation is synchronous, message is not used after this function returns */
+    struct rpmsg_sync_msg_decoder_pipeline_t sync_msg;
+    const uint8_t *dsp_in_buf = in_buf;
+    int result;
+    uint32_t ret;
+    bool trans_addr = false;
+
+    pipeline->resampled = false;
+
+    if (pipeline_unsupported) {
+        result = codec_decoder_decode(pipeline->decoder, in_buf, in_length, out_buf, out_length);
+        codec_decoder_get_param(pipeline->decoder, &pipeline->sample_rate, &pipeline->channels);
+        return result;
+    }
+
+    if (((uint32_t)in_buf >= DSP_DRAM_MCU_BASE_ADDR) && ((uint32_t)in_buf < (DSP_DRAM_MCU_BASE_ADDR+DSP_DRAM_SIZE))) {
+        dsp_in_buf = (const void *)MCU_SRAM_2_DSP_DRAM(in_buf);
+    }
+
+    sync_msg.pipeline = pipeline;
+    sync_msg.in_buffer = dsp_in_buf;
+    sync_msg.in_length = in_length;
+    sync_msg.out_buffer = out_buf;
+    sync_msg.out_length = out_length;
+
+    if (*out_buf == NULL) {
+        trans_addr = true;
+    }
+
+    ret = rpmsg_sync_invoke(rpmsg_get_remote_instance(), RPMSG_SYNC_FUNC_DEC_PIPELINE, (void *)&sync_msg, (uint32_t *)&result);
+
+    if (ret == RPMSG_INVOKE_STATUS_UNKNOWN_FUNC) {
+        /* old DSP image without pipeline support, execute these steps separately */
+        pipeline_unsupported = true;
+        return codec_decoder_pipeline_exec(pipeline, in_buf, in_length, out_buf, out_length);
+    }
+    else if (ret != 0) {
+        /* no invocation slot or DSP is not responding, only this frame is dropped */
+        *out_length = 0;
+        return CODEC_ERROR_INSUFFICIENT_RESOURCE;
+    }
+
+    if (trans_addr) {
+        if ((uint32_t)*out_buf >= DSP_DRAM_BASE_ADDR) {
+            *out_buf = (void *)DSP_DRAM_2_MCU_SRAM(*out_buf);
+        }
+    }
+
+    return (int)result;
+}
+
+/************************************************************************************
+ * @fn      codec_decoder_stream_attach
+ *
+ * @brief   attach shared memory rings to a decoder instance to enter streaming mode,
+ *          @ref rpmsg_sync_msg_stream_attach_t for the record format of output ring.
+ *
+ * @param   handle: decoder instance
+ * @param   in_ring: DSP address of input ring control block, 0 to detach.
+ * @param   out_ring: DSP address of output ring control block, 0 to detach.
+ *
+ * @return  execute result, CODEC_ERROR_FAILED is returned when streaming mode is
+ *          not supported by DSP.
+ */
+int codec_decoder_stream_attach(struct codec_decoder_handle *handle, uint32_t in_ring, uint32_t out_ring)
+{
+    struct rpmsg_sync_msg_stream_attach_t sync_msg;
+    void *result;
+    uint32_t ret;
+
+    sync_msg.handle = handle;
+    sync_msg.in_ring = in_ring;
+    sync_msg.out_ring = out_ring;
+
+    ret = rpmsg_sync_invoke(rpmsg_get_remote_instance(), RPMSG_SYNC_FUNC_DEC_STREAM_ATTACH, (void *)&sync_msg, (uint32_t *)&result);
+    if (ret != 0) {
+        return CODEC_ERROR_FAILED;
+    }
+
+    return (int)result;
+}
+
 /************************************************************************************
  * @fn      codec_encoder_init
  *
@@ -370,3 +478,33 @@ int codec_encoder_encode(struct codec_encoder_handle *handle,
     return (int)result;
 }
 
+/************************************************************************************
+ * @fn      codec_encoder_stream_attach
+ *
+ * @brief   attach shared memory rings to a encoder instance to enter streaming mode,
+ *          @ref rpmsg_sync_msg_stream_attach_t for the record format of output ring.
+ *
+ * @param   handle: encoder instance
+ * @param   in_ring: DSP address of input ring control block, 0 to detach.
+ * @param   out_ring: DSP address of output ring control block, 0 to detach.
+ *
+ * @return  execute result, CODEC_ERROR_FAILED is returned when streaming mode is
+ *          not supported by DSP.
+ */
+int codec_encoder_stream_attach(struct codec_encoder_handle *handle, uint32_t in_ring, uint32_t out_ring)
+{
+    struct rpmsg_sync_msg_stream_attach_t sync_msg;
+    void *result;
+    uint32_t ret;
+
+    sync_msg.handle = handle;
+    sync_msg.in_ring = in_ring;
+    sync_msg.out_ring = out_ring;
+
+    ret = rpmsg_sync_invoke(rpmsg_get_remote_instance(), RPMSG_SYNC_FUNC_ENC_STREAM_ATTACH, (void *)&sync_msg, (uint32_t *)&result);
+    if (ret != 0) {
+        return CODEC_ERROR_FAILED;
+    }
+
+    return (int)result;
+}
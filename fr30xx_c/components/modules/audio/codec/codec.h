@@ -160,6 +160,35 @@ struct codec_decoder_handle {
 	void *decoder_env;
 };
 
+/*
+ * Descriptor of decode -> get param -> resample pipeline. The whole pipeline is
+ * executed by DSP in one invocation to save rpmsg round trips for each frame.
+ */
+struct codec_decoder_pipeline {
+    struct codec_decoder_handle *decoder;
+    /* DSP resample instance, NULL: decoded data is returned without resample */
+    void *resample;
+    /* decoded data is resampled only when its format matches these values */
+    uint32_t resample_sample_rate;
+    uint8_t resample_channels;
+
+    /* updated after execution, format of latest decoded frame */
+    uint32_t sample_rate;
+    uint8_t channels;
+    /* updated after execution, output data has been resampled or not */
+    uint8_t resampled;
+};
+
+/* header of each frame record in output ring of streaming mode */
+struct codec_stream_frame_hdr {
+    /* length of frame data following this header */
+    uint16_t length;
+    /* format of decoded PCM data, not used by encoder */
+    uint8_t channels;
+    uint8_t reserved;
+    uint32_t sample_rate;
+};
+
 struct codec_encoder_api {
     void *(*init)(void *param);
     void (*destroy)(void *handle);
@@ -186,6 +215,12 @@ int codec_decoder_input_over(struct codec_decoder_handle *handle,
                             uint32_t *out_length,
                             uint8_t *exec_done);
 int codec_decoder_get_param(struct codec_decoder_handle *handle, uint32_t *sample_rate, uint8_t *channels);
+int codec_decoder_pipeline_exec(struct codec_decoder_pipeline *pipeline,
+                            const uint8_t *in_buf,
+                            uint32_t *in_length,
+                            uint8_t **out_buf,
+                            uint32_t *out_length);
+int codec_decoder_stream_attach(struct codec_decoder_handle *handle, uint32_t in_ring, uint32_t out_ring);
 
 struct codec_encoder_handle *codec_encoder_init(uint8_t encoder_type, void *param);
 void codec_encoder_destroy(struct codec_encoder_handle *handle);
@@ -197,4 +232,5 @@ int codec_encoder_encode(struct codec_encoder_handle *handle,
 int codec_encoder_plc(struct codec_encoder_handle *handle,
                             uint8_t **out_buf,
                             uint32_t *out_length);
+int codec_encoder_stream_attach(struct codec_encoder_handle *handle, uint32_t in_ring, uint32_t out_ring);
 #endif /* _CODEC_H */
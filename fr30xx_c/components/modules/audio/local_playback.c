@@ -33,7 +33,7 @@ static void decoder_request_raw_data_cb(audio_decoder_t *decoder, uint8_t event)
 {
     if ( event == AUDIO_DECODER_EVENT_REQ_RAW_DATA )
     {
-        audio_scene_evt_req_encoded_frame_t *evt = (void *)pvPortMalloc( sizeof(audio_scene_evt_req_encoded_frame_t) );
+        audio_scene_evt_req_encoded_frame_t *evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_req_encoded_frame_t));
 
         if ( evt )
         {
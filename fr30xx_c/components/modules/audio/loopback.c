@@ -23,7 +23,7 @@ static audio_scene_t *loopback_scene = NULL;
 
 static void hw_receive_pcm(uint32_t samples)
 {
-    audio_scene_evt_hw_in_new_samples_t *evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_hw_in_new_samples_t));
+    audio_scene_evt_hw_in_new_samples_t *evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_hw_in_new_samples_t));
     
     if (evt) {
         evt->evt.type = AUDIO_SCENE_EVT_TYPE_HW_IN_NEW_SAMPLES;
@@ -14,6 +14,8 @@ typedef struct {
     
     /* used to store mic PCM data */
     uint16_t *buffer;
+    /* encoded frames dropped because capture buffer was overwritten while encoding */
+    uint32_t dropped_frames;
 } recorder_env_t;
 
 static audio_scene_t *recoder_scene = NULL;
@@ -21,7 +23,7 @@ static audio_scene_t *recoder_scene = NULL;
 static void hw_receive_pcm(uint32_t samples)
 {
 #if 1
-    audio_scene_evt_hw_in_new_samples_t *evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_hw_in_new_samples_t));
+    audio_scene_evt_hw_in_new_samples_t *evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_hw_in_new_samples_t));
     
     if (evt) {
         evt->evt.type = AUDIO_SCENE_EVT_TYPE_HW_IN_NEW_SAMPLES;
@@ -92,6 +94,7 @@ static void init(audio_scene_t *scene)
     
     recoder_scene = scene;
 
+    env->dropped_frames = 0;
     env->buffer = pvPortMalloc(STORE_MIC_PCM_DATA_SAMPLES * sizeof(uint16_t) * param->channels);
     env->hw = audio_hw_create(param->hw_type, NULL, param->base_addr, AUDIO_HW_DIR_IN, param->sample_rate, param->channels);
     env->hw_output = audio_hw_output_add(env->hw, hw_receive_pcm);
@@ -124,17 +127,27 @@ static void event_handler(audio_scene_t *scene, audio_scene_evt_t *evt)
                 int encoded_frame_count;
                 audio_scene_evt_hw_in_new_samples_t *_evt = (void *)evt;
                 uint32_t adc_new_samples = _evt->adc_new_samples;
-                while(adc_new_samples) {
-                    uint32_t samples = adc_new_samples > STORE_MIC_PCM_DATA_SAMPLES ? STORE_MIC_PCM_DATA_SAMPLES : adc_new_samples;
-                    samples = audio_hw_read_pcm(env->hw_output, env->buffer, samples, param->channels);
-                    audio_encoder_encode(env->encoder, (void *)env->buffer, samples*sizeof(uint16_t)*param->channels, param->channels, param->sample_rate);
-                    adc_new_samples -= samples;
+                audio_hw_view_t view;
+                uint32_t samples;
+                bool valid;
+
+                /* encode directly from capture buffer of audio hardware */
+                samples = audio_hw_view_acquire(env->hw_output, &view, adc_new_samples);
+                for (uint8_t i=0; i<2; i++) {
+                    if (view.samples[i]) {
+                        audio_encoder_encode(env->encoder, (const uint8_t *)view.data[i], view.samples[i]*sizeof(uint16_t)*view.channels, view.channels, param->sample_rate);
+                    }
                 }
+                /* frames are popped in every event, the pending ones are encoded from this view */
+                valid = audio_hw_view_release(env->hw_output, samples);
                 encoded_frame_count = audio_encoder_get_frame_count(env->encoder);
                 while(encoded_frame_count--) {
                     audio_encoder_frame_t *frame;
                     frame = audio_encoder_frame_pop(env->encoder);
-                    if (param->report_cb) {
+                    if (valid == false) {
+                        env->dropped_frames++;
+                    }
+                    else if (param->report_cb) {
                         param->report_cb(param->report_param, frame->data, frame->length);
                     }
                     audio_encoder_frame_release(frame);
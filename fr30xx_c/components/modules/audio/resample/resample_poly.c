@@ -0,0 +1,281 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "FreeRTOS.h"
+
+#include "resample_poly.h"
+
+#ifndef M_PI
+#define M_PI                                3.14159265358979323846
+#endif
+
+/* cutoff frequency relative to the lower nyquist frequency of input and output */
+#define RESAMPLE_POLY_CUTOFF                0.92f
+/* weight of phase interpolation is in Q15 format */
+#define RESAMPLE_POLY_WEIGHT_BITS           15
+/* level error is filtered with this factor (2^-n) before used by controller */
+#define RESAMPLE_POLY_LEVEL_AVG_SHIFT       4
+/* proportional gain: ppm per millisecond of level error */
+#define RESAMPLE_POLY_KP                    40
+/* integral gain: 2^-n ppm/256 per millisecond of level error in each update */
+#define RESAMPLE_POLY_KI_SHIFT              2
+
+typedef struct {
+    uint32_t in_sample_rate;
+    uint32_t out_sample_rate;
+    uint8_t channels;
+    uint8_t taps;
+
+    /* (RESAMPLE_POLY_PHASES + 1) * taps coefficients in Q15, oldest sample first */
+    int16_t *coef;
+    /* history of each channel, stored twice to get a continuous window without wrap */
+    int16_t *history;
+    uint8_t history_idx;
+
+    /* input samples to be pushed into history before next output sample */
+    uint32_t pending;
+    /* fractional position of next output sample between two input samples, Q0.32 */
+    uint32_t frac;
+    /* input samples consumed by each output sample, Q32.32 */
+    uint64_t step_nominal;
+    uint64_t step;
+
+    /* ASRC mode */
+    int32_t ppm;
+    int32_t level_err_avg;          // unit is output sample, Q8
+    int32_t integral;               // unit is ppm, Q8
+} resample_poly_t;
+
+static float resample_poly_sinc(float x)
+{
+    if (x == 0.0f) {
+        return 1.0f;
+    }
+    x *= (float)M_PI;
+    return sinf(x) / x;
+}
+
+static void resample_poly_build_coef(resample_poly_t *resample, float cutoff)
+{
+    float half = (float)(resample->taps / 2);
+    float tmp[RESAMPLE_POLY_MAX_TAPS];
+
+    for (uint32_t p = 0; p <= RESAMPLE_POLY_PHASES; p++) {
+        int16_t *coef = &resample->coef[p * resample->taps];
+        float sum = 0.0f;
+        int32_t sum_q15 = 0;
+        uint32_t center = 0;
+
+        for (uint32_t j = 0; j < resample->taps; j++) {
+            /* distance between output sample and input sample j */
+            float x = half - 1.0f + (float)p / RESAMPLE_POLY_PHASES - (float)j;
+            float w = 0.0f;
+
+            if ((x > -half) && (x < half)) {
+                /* blackman window */
+                w = 0.42f + 0.5f * cosf((float)M_PI * x / half) + 0.08f * cosf(2.0f * (float)M_PI * x / half);
+            }
+            tmp[j] = cutoff * resample_poly_sinc(cutoff * x) * w;
+            sum += tmp[j];
+        }
+
+        /* normalize DC gain of each phase, put rounding error into the largest tap */
+        for (uint32_t j = 0; j < resample->taps; j++) {
+            coef[j] = (int16_t)lrintf(tmp[j] * 32768.0f / sum);
+            sum_q15 += coef[j];
+            if (coef[j] > coef[center]) {
+                center = j;
+            }
+        }
+        coef[center] += (int16_t)(32768 - sum_q15);
+    }
+}
+
+static void resample_poly_update_step(resample_poly_t *resample)
+{
+    resample->step = resample->step_nominal + (int64_t)resample->step_nominal * resample->ppm / 1000000;
+}
+
+void *resample_poly_init(uint32_t in_sample_rate, uint32_t out_sample_rate, uint8_t channels)
+{
+    resample_poly_t *resample;
+    uint32_t taps;
+    float cutoff;
+
+    if ((in_sample_rate == 0) || (out_sample_rate == 0) || (channels == 0)) {
+        return NULL;
+    }
+
+    /* enlarge filter length when downsampling to keep the same transition band in input domain */
+    taps = RESAMPLE_POLY_TAPS * ((in_sample_rate + out_sample_rate - 1) / out_sample_rate);
+    if (taps > RESAMPLE_POLY_MAX_TAPS) {
+        taps = RESAMPLE_POLY_MAX_TAPS;
+    }
+    cutoff = RESAMPLE_POLY_CUTOFF;
+    if (in_sample_rate > out_sample_rate) {
+        cutoff = cutoff * out_sample_rate / in_sample_rate;
+    }
+
+    resample = pvPortMalloc(sizeof(resample_poly_t));
+    if (resample == NULL) {
+        return NULL;
+    }
+    resample->coef = pvPortMalloc(sizeof(int16_t) * (RESAMPLE_POLY_PHASES + 1) * taps);
+    resample->history = pvPortMalloc(sizeof(int16_t) * 2 * taps * channels);
+    if ((resample->coef == NULL) || (resample->history == NULL)) {
+        resample_poly_destroy(resample);
+        return NULL;
+    }
+
+    resample->in_sample_rate = in_sample_rate;
+    resample->out_sample_rate = out_sample_rate;
+    resample->channels = channels;
+    resample->taps = taps;
+    resample_poly_build_coef(resample, cutoff);
+
+    memset((void *)resample->history, 0, sizeof(int16_t) * 2 * taps * channels);
+    resample->history_idx = 0;
+    /* skip the first half of filter to reduce the delay */
+    resample->pending = taps / 2;
+    resample->frac = 0;
+    resample->step_nominal = ((uint64_t)in_sample_rate << 32) / out_sample_rate;
+    resample->step = resample->step_nominal;
+
+    resample->ppm = 0;
+    resample->level_err_avg = 0;
+    resample->integral = 0;
+
+    return resample;
+}
+
+void resample_poly_destroy(void *handle)
+{
+    resample_poly_t *resample = handle;
+
+    if (resample == NULL) {
+        return;
+    }
+
+    if (resample->coef) {
+        vPortFree(resample->coef);
+    }
+    if (resample->history) {
+        vPortFree(resample->history);
+    }
+    vPortFree(resample);
+}
+
+uint32_t resample_poly_exec(void *handle, const int16_t *in, uint32_t *in_samples, int16_t *out, uint32_t out_samples)
+{
+    resample_poly_t *resample = handle;
+    uint32_t taps = resample->taps;
+    uint8_t channels = resample->channels;
+    uint32_t in_left = *in_samples;
+    uint32_t produced = 0;
+    int16_t coef[RESAMPLE_POLY_MAX_TAPS];
+
+    while (produced < out_samples) {
+        /* push input samples into history until next output position is reached */
+        while (resample->pending && in_left) {
+            uint32_t idx = resample->history_idx;
+            for (uint8_t c = 0; c < channels; c++) {
+                int16_t *history = &resample->history[c * 2 * taps];
+                history[idx] = in[c];
+                history[idx + taps] = in[c];
+            }
+            idx++;
+            if (idx >= taps) {
+                idx = 0;
+            }
+            resample->history_idx = idx;
+            in += channels;
+            in_left--;
+            resample->pending--;
+        }
+        if (resample->pending) {
+            break;
+        }
+
+        /* interpolate coefficients between two adjacent phases */
+        uint32_t phase = resample->frac >> (32 - RESAMPLE_POLY_PHASE_BITS);
+        int32_t weight = (resample->frac >> (32 - RESAMPLE_POLY_PHASE_BITS - RESAMPLE_POLY_WEIGHT_BITS)) & ((1 << RESAMPLE_POLY_WEIGHT_BITS) - 1);
+        const int16_t *c0 = &resample->coef[phase * taps];
+        const int16_t *c1 = c0 + taps;
+        for (uint32_t j = 0; j < taps; j++) {
+            coef[j] = c0[j] + (((c1[j] - c0[j]) * weight) >> RESAMPLE_POLY_WEIGHT_BITS);
+        }
+
+        for (uint8_t c = 0; c < channels; c++) {
+            const int16_t *window = &resample->history[c * 2 * taps + resample->history_idx];
+            int32_t acc = 1 << 14;
+            for (uint32_t j = 0; j < taps; j++) {
+                acc += (int32_t)window[j] * coef[j];
+            }
+            acc >>= 15;
+            if (acc > 32767) {
+                acc = 32767;
+            }
+            else if (acc < -32768) {
+                acc = -32768;
+            }
+            *out++ = (int16_t)acc;
+        }
+        produced++;
+
+        /* move to position of next output sample */
+        uint64_t pos = (uint64_t)resample->frac + resample->step;
+        resample->frac = (uint32_t)pos;
+        resample->pending = (uint32_t)(pos >> 32);
+    }
+
+    *in_samples -= in_left;
+
+    return produced;
+}
+
+void resample_poly_set_ppm(void *handle, int32_t ppm)
+{
+    resample_poly_t *resample = handle;
+
+    if (ppm > RESAMPLE_POLY_MAX_PPM) {
+        ppm = RESAMPLE_POLY_MAX_PPM;
+    }
+    else if (ppm < -RESAMPLE_POLY_MAX_PPM) {
+        ppm = -RESAMPLE_POLY_MAX_PPM;
+    }
+    resample->ppm = ppm;
+    resample_poly_update_step(resample);
+}
+
+int32_t resample_poly_track_level(void *handle, uint32_t level, uint32_t target)
+{
+    resample_poly_t *resample = handle;
+    int32_t samples_per_ms = resample->out_sample_rate / 1000;
+    int32_t err, ppm;
+
+    if (samples_per_ms == 0) {
+        samples_per_ms = 1;
+    }
+
+    /*
+     * More data than target in buffer means source clock is faster than sink, so
+     * more input samples should be consumed for each output sample, and vice versa.
+     */
+    err = ((int32_t)level - (int32_t)target) << 8;
+    resample->level_err_avg += (err - resample->level_err_avg) >> RESAMPLE_POLY_LEVEL_AVG_SHIFT;
+
+    resample->integral += (resample->level_err_avg / samples_per_ms) >> RESAMPLE_POLY_KI_SHIFT;
+    if (resample->integral > (RESAMPLE_POLY_MAX_PPM << 8)) {
+        resample->integral = RESAMPLE_POLY_MAX_PPM << 8;
+    }
+    else if (resample->integral < -(RESAMPLE_POLY_MAX_PPM << 8)) {
+        resample->integral = -(RESAMPLE_POLY_MAX_PPM << 8);
+    }
+
+    ppm = (resample->level_err_avg * RESAMPLE_POLY_KP / samples_per_ms + resample->integral) >> 8;
+    resample_poly_set_ppm(resample, ppm);
+
+    return resample->ppm;
+}
@@ -0,0 +1,85 @@
+#ifndef _RESAMPLE_POLY_H
+#define _RESAMPLE_POLY_H
+
+#include <stdint.h>
+
+/*
+ * Polyphase FIR resampler running on MCU. Any pair of sample rates is supported,
+ * the conversion ratio can also be adjusted on the fly to track the clock drift
+ * between source and sink (asynchronous sample rate conversion).
+ */
+
+/* number of phases in coefficient table, coefficients between phases are interpolated */
+#define RESAMPLE_POLY_PHASE_BITS            5
+#define RESAMPLE_POLY_PHASES                (1 << RESAMPLE_POLY_PHASE_BITS)
+/* taps of each phase for upsampling, it's enlarged for downsampling */
+#define RESAMPLE_POLY_TAPS                  16
+#define RESAMPLE_POLY_MAX_TAPS              64
+/* maximum ratio adjustment in ASRC mode, unit is ppm */
+#define RESAMPLE_POLY_MAX_PPM               1000
+
+/************************************************************************************
+ * @fn      resample_poly_init
+ *
+ * @brief   init a polyphase resampler instance.
+ *
+ * @param   in_sample_rate: sample rate of input PCM data.
+ * @param   out_sample_rate: sample rate of output PCM data.
+ * @param   channels: channels of interleaved PCM data to be resampled.
+ *
+ * @return  handler of created resample instance, NULL will be returned when failed.
+ */
+void *resample_poly_init(uint32_t in_sample_rate, uint32_t out_sample_rate, uint8_t channels);
+
+/************************************************************************************
+ * @fn      resample_poly_destroy
+ *
+ * @brief   destroy a polyphase resampler instance.
+ *
+ * @param   handle: resample handler.
+ */
+void resample_poly_destroy(void *handle);
+
+/************************************************************************************
+ * @fn      resample_poly_exec
+ *
+ * @brief   execute resample until all input samples are consumed or output buffer is full.
+ *
+ * @param   handle: resample handler.
+ * @param   in: interleaved input PCM data.
+ * @param   in_samples: number of input samples (per channel), this value will be updated
+ *                      to the number of consumed samples before return.
+ * @param   out: buffer to store interleaved output PCM data.
+ * @param   out_samples: space of output buffer, unit is sample (per channel).
+ *
+ * @return  number of samples (per channel) stored in output buffer.
+ */
+uint32_t resample_poly_exec(void *handle, const int16_t *in, uint32_t *in_samples, int16_t *out, uint32_t out_samples);
+
+/************************************************************************************
+ * @fn      resample_poly_set_ppm
+ *
+ * @brief   adjust conversion ratio. Positive value means more input samples are consumed
+ *          for each output sample, the output is shortened.
+ *
+ * @param   handle: resample handler.
+ * @param   ppm: adjustment in ppm, limited to RESAMPLE_POLY_MAX_PPM.
+ */
+void resample_poly_set_ppm(void *handle, int32_t ppm);
+
+/************************************************************************************
+ * @fn      resample_poly_track_level
+ *
+ * @brief   ASRC mode, adjust conversion ratio according to the fill level of buffer
+ *          which stores output PCM data. The ratio is updated by a PI controller to
+ *          keep the level around target.
+ *
+ * @param   handle: resample handler.
+ * @param   level: current buffer level, unit is output sample.
+ * @param   target: expected buffer level, unit is output sample.
+ *
+ * @return  current ratio adjustment in ppm.
+ */
+int32_t resample_poly_track_level(void *handle, uint32_t level, uint32_t target);
+
+#endif  // _RESAMPLE_POLY_H
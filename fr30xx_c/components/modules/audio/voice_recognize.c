@@ -6,20 +6,18 @@
 
 #include "voice_recognize.h"
 
-#define STORE_MIC_PCM_DATA_SAMPLES      128
-
 typedef struct {
     audio_hw_t *hw;
     audio_hw_output_t *hw_output;
-    
-    uint16_t *buffer;
+    /* samples overwritten by hardware before they were released */
+    uint32_t dropped_samples;
 } voice_recognize_env_t;
 
 static audio_scene_t *voice_recognize_scene = NULL;
 
 static void hw_receive_pcm(uint32_t samples)
 {
-    audio_scene_evt_hw_in_new_samples_t *evt = (void *)pvPortMalloc(sizeof(audio_scene_evt_hw_in_new_samples_t));
+    audio_scene_evt_hw_in_new_samples_t *evt = (void *)audio_scene_evt_alloc(sizeof(audio_scene_evt_hw_in_new_samples_t));
     
     if (evt) {
         evt->evt.type = AUDIO_SCENE_EVT_TYPE_HW_IN_NEW_SAMPLES;
@@ -63,8 +61,7 @@ static void init(audio_scene_t *scene)
     
     voice_recognize_scene = scene;
 
-    env->buffer = pvPortMalloc(STORE_MIC_PCM_DATA_SAMPLES * sizeof(uint16_t) * param->channels);
-    
+    env->dropped_samples = 0;
     env->hw = audio_hw_create(param->hw_type, NULL, param->hw_base_addr, AUDIO_HW_DIR_IN, param->sample_rate, param->channels);
     env->hw_output = audio_hw_output_add(env->hw, hw_receive_pcm);
 }
@@ -75,7 +72,6 @@ static void destroy(audio_scene_t *scene)
     
     audio_hw_destroy(env->hw);
     
-    vPortFree(env->buffer);
     vPortFree(scene->env);
     vPortFree(scene->param);
     vPortFree(scene);
@@ -85,19 +81,18 @@ static void destroy(audio_scene_t *scene)
 static void event_handler(audio_scene_t *scene, audio_scene_evt_t *evt)
 {
     voice_recognize_env_t *env = scene->env;
-    voice_recognize_param_t *param = scene->param;
 
     switch(evt->type) {
         case AUDIO_SCENE_EVT_TYPE_HW_IN_NEW_SAMPLES:
             {
-                int encoded_frame_count;
                 audio_scene_evt_hw_in_new_samples_t *_evt = (void *)evt;
                 uint32_t adc_new_samples = _evt->adc_new_samples;
-                while(adc_new_samples) {
-                    uint32_t samples = adc_new_samples > STORE_MIC_PCM_DATA_SAMPLES ? STORE_MIC_PCM_DATA_SAMPLES : adc_new_samples;
-                    samples = audio_hw_read_pcm(env->hw_output, env->buffer, samples, param->channels);
-//                    voice_recognize_launch((int16_t *)env->buffer, samples);
-                    adc_new_samples -= samples;
+                audio_hw_view_t view;
+                uint32_t samples;
+
+                samples = audio_hw_view_acquire(env->hw_output, &view, adc_new_samples);
+                if (audio_hw_view_release(env->hw_output, samples) == false) {
+                    env->dropped_samples += samples;
                 }
             }
             break;
@@ -58,6 +58,40 @@ struct co_list
 /// simplify type name of list
 typedef struct co_list co_list_t;
 
+struct co_dlist;
+
+/// structure of a doubly-linked list element header
+struct co_dlist_hdr
+{
+    /// Pointer to next co_dlist_hdr
+    struct co_dlist_hdr *next;
+    /// Pointer to previous co_dlist_hdr
+    struct co_dlist_hdr *prev;
+    /// List this element is linked in, NULL when it is not in any list
+    struct co_dlist *list;
+};
+
+/// simplify type name of doubly-linked list element header
+typedef struct co_dlist_hdr co_dlist_hdr_t;
+
+/**
+ * Doubly-linked list. Extract, find, insert and size take constant time, use it
+ * instead of co_list when elements are removed from the middle of the list or
+ * moved between lists frequently.
+ */
+struct co_dlist
+{
+    /// pointer to first element of the list
+    struct co_dlist_hdr *first;
+    /// pointer to the last element
+    struct co_dlist_hdr *last;
+    /// number of elements in the list
+    uint16_t size;
+};
+
+/// simplify type name of doubly-linked list
+typedef struct co_dlist co_dlist_t;
+
 /*
  * MACROS
  ****************************************************************************************
@@ -297,5 +331,172 @@ __STATIC_INLINE struct co_list_hdr *co_list_next(const struct co_list_hdr *const
     return(list_hdr->next);
 }
 
+/**
+ ****************************************************************************************
+ * @brief Initialize a doubly-linked list to defaults values.
+ *
+ * @param list           Pointer to the list structure.
+ ****************************************************************************************
+ */
+void co_dlist_init(struct co_dlist *list);
+
+/**
+ ****************************************************************************************
+ * @brief Add an element as last on the doubly-linked list.
+ *
+ * @param list           Pointer to the list structure
+ * @param list_hdr       Pointer to the header to add, it shall not be in any list
+ ****************************************************************************************
+ */
+void co_dlist_push_back(struct co_dlist *list, struct co_dlist_hdr *list_hdr);
+
+/**
+ ****************************************************************************************
+ * @brief Add an element as first on the doubly-linked list.
+ *
+ * @param list           Pointer to the list structure
+ * @param list_hdr       Pointer to the header to add, it shall not be in any list
+ ****************************************************************************************
+ */
+void co_dlist_push_front(struct co_dlist *list, struct co_dlist_hdr *list_hdr);
+
+/**
+ ****************************************************************************************
+ * @brief Extract the first element of the doubly-linked list.
+ * @param list           Pointer to the list structure
+ * @return The pointer to the element extracted, and NULL if the list is empty.
+ ****************************************************************************************
+ */
+struct co_dlist_hdr *co_dlist_pop_front(struct co_dlist *list);
+
+/**
+ ****************************************************************************************
+ * @brief Extract an element from the doubly-linked list if it belongs to the list.
+ *
+ * The list is not walked, the element records the list it is linked in.
+ *
+ * @param list           Pointer to the list structure
+ * @param list_hdr       Element to extract
+ *
+ * @return true if the element is in the list, false otherwise
+ ****************************************************************************************
+ */
+bool co_dlist_extract(struct co_dlist *list, struct co_dlist_hdr *list_hdr);
+
+/**
+ ****************************************************************************************
+ * @brief Insert a given element in the doubly-linked list before the referenced element.
+ *
+ * @param list           Pointer to the list structure
+ * @param elt_ref_hdr    Pointer to the referenced element (NULL to insert at the beginning)
+ * @param elt_to_add_hdr Pointer to the element to be inserted
+ ****************************************************************************************
+ */
+void co_dlist_insert_before(struct co_dlist *list,
+                        struct co_dlist_hdr *elt_ref_hdr, struct co_dlist_hdr *elt_to_add_hdr);
+
+/**
+ ****************************************************************************************
+ * @brief Insert a given element in the doubly-linked list after the referenced element.
+ *
+ * @param list           Pointer to the list structure
+ * @param elt_ref_hdr    Pointer to the referenced element (NULL to insert at the end)
+ * @param elt_to_add_hdr Pointer to the element to be inserted
+ ****************************************************************************************
+ */
+void co_dlist_insert_after(struct co_dlist *list,
+                        struct co_dlist_hdr *elt_ref_hdr, struct co_dlist_hdr *elt_to_add_hdr);
+
+/**
+ ****************************************************************************************
+ * @brief Test if an element is in the doubly-linked list.
+ *
+ * @param list           Pointer to the list structure
+ * @param list_hdr       Pointer to the searched element
+ *
+ * @return true if the element is found in the list, false otherwise
+ ****************************************************************************************
+ */
+__STATIC_INLINE bool co_dlist_find(const struct co_dlist *list, const struct co_dlist_hdr *list_hdr)
+{
+    return (list_hdr->list == list);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Number of elements present in the doubly-linked list.
+ *
+ * @param list           Pointer to the list structure
+ *
+ * @return Number of elements present in the list
+ ****************************************************************************************
+ */
+__STATIC_INLINE uint16_t co_dlist_size(const struct co_dlist *const list)
+{
+    return (list->size);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Test if the doubly-linked list is empty.
+ * @param list           Pointer to the list structure.
+ * @return true if the list is empty, false else otherwise.
+ ****************************************************************************************
+ */
+__STATIC_INLINE bool co_dlist_is_empty(const struct co_dlist *const list)
+{
+    return (list->first == NULL);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Pick the first element from the doubly-linked list without removing it.
+ *
+ * @param list           Pointer to the list structure.
+ *
+ * @return First element address. Returns NULL pointer if the list is empty.
+ ****************************************************************************************
+ */
+__STATIC_INLINE struct co_dlist_hdr *co_dlist_pick(const struct co_dlist *const list)
+{
+    return (list->first);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Return following element of a doubly-linked list element.
+ *
+ * @param list_hdr     Pointer to the list element.
+ *
+ * @return The pointer to the next element.
+ ****************************************************************************************
+ */
+__STATIC_INLINE struct co_dlist_hdr *co_dlist_next(const struct co_dlist_hdr *const list_hdr)
+{
+    return (list_hdr->next);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Return preceding element of a doubly-linked list element.
+ *
+ * @param list_hdr     Pointer to the list element.
+ *
+ * @return The pointer to the previous element.
+ ****************************************************************************************
+ */
+__STATIC_INLINE struct co_dlist_hdr *co_dlist_prev(const struct co_dlist_hdr *const list_hdr)
+{
+    return (list_hdr->prev);
+}
+
+/**
+ ****************************************************************************************
+ * @brief Measure co_list and co_dlist operations with DWT cycle counter and print
+ *        the result, available when CO_LIST_BENCHMARK is enabled in co_list.c.
+ ****************************************************************************************
+ */
+void co_list_benchmark(void);
+
 /// @} CO_LIST
 #endif // _CO_LIST_H_
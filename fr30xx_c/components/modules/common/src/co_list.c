@@ -27,6 +27,17 @@
 #include <stdbool.h>
 #include "co_list.h"     // common list definitions
 
+/*
+ * DEFINES
+ ****************************************************************************************
+ */
+/// set to 1 to build co_list_benchmark
+#define CO_LIST_BENCHMARK       0
+
+#if CO_LIST_BENCHMARK
+#include <stdio.h>
+#endif
+
 /*
  * FUNCTION DEFINTIONS
  ****************************************************************************************
@@ -402,4 +413,237 @@ uint16_t co_list_size(struct co_list *list)
     return count;
 }
 
+void co_dlist_init(struct co_dlist *list)
+{
+    list->first = NULL;
+    list->last = NULL;
+    list->size = 0;
+}
+
+void co_dlist_push_back(struct co_dlist *list,
+                        struct co_dlist_hdr *list_hdr)
+{
+    // link the element before it is reachable from the list
+    list_hdr->next = NULL;
+    list_hdr->prev = list->last;
+    list_hdr->list = list;
+    // a walker in interrupt may follow the element as soon as it is linked
+    __DMB();
+
+    // check if list is empty
+    if (co_dlist_is_empty(list))
+    {
+        // list empty => pushed element is also head
+        list->first = list_hdr;
+    }
+    else
+    {
+        // list not empty => update next of last
+        list->last->next = list_hdr;
+    }
+
+    // add element at the end of the list
+    list->last = list_hdr;
+    list->size++;
+}
+
+void co_dlist_push_front(struct co_dlist *list,
+                         struct co_dlist_hdr *list_hdr)
+{
+    list_hdr->next = list->first;
+    list_hdr->prev = NULL;
+    list_hdr->list = list;
+
+    // check if list is empty
+    if (co_dlist_is_empty(list))
+    {
+        // list empty => pushed element is also tail
+        list->last = list_hdr;
+    }
+    else
+    {
+        list->first->prev = list_hdr;
+    }
+
+    // add element at the beginning of the list
+    list->first = list_hdr;
+    list->size++;
+}
+
+struct co_dlist_hdr *co_dlist_pop_front(struct co_dlist *list)
+{
+    struct co_dlist_hdr *element = list->first;
+
+    if (element != NULL)
+    {
+        co_dlist_extract(list, element);
+    }
+
+    return element;
+}
+
+bool co_dlist_extract(struct co_dlist *list, struct co_dlist_hdr *list_hdr)
+{
+    if (list_hdr->list != list)
+    {
+        return false;
+    }
+
+    // unlink from the previous element first, so a walker never meets a freed element
+    if (list_hdr->prev == NULL)
+    {
+        list->first = list_hdr->next;
+    }
+    else
+    {
+        list_hdr->prev->next = list_hdr->next;
+    }
+
+    if (list_hdr->next == NULL)
+    {
+        list->last = list_hdr->prev;
+    }
+    else
+    {
+        list_hdr->next->prev = list_hdr->prev;
+    }
+
+    list_hdr->next = NULL;
+    list_hdr->prev = NULL;
+    list_hdr->list = NULL;
+    list->size--;
+
+    return true;
+}
+
+void co_dlist_insert_before(struct co_dlist *list,
+                        struct co_dlist_hdr *elt_ref_hdr, struct co_dlist_hdr *elt_to_add_hdr)
+{
+    // If no element referenced or the referenced one is the first
+    if ((elt_ref_hdr == NULL) || (elt_ref_hdr->prev == NULL))
+    {
+        co_dlist_push_front(list, elt_to_add_hdr);
+    }
+    else
+    {
+        elt_to_add_hdr->next = elt_ref_hdr;
+        elt_to_add_hdr->prev = elt_ref_hdr->prev;
+        elt_to_add_hdr->list = list;
+
+        elt_ref_hdr->prev->next = elt_to_add_hdr;
+        elt_ref_hdr->prev = elt_to_add_hdr;
+        list->size++;
+    }
+}
+
+void co_dlist_insert_after(struct co_dlist *list,
+                        struct co_dlist_hdr *elt_ref_hdr, struct co_dlist_hdr *elt_to_add_hdr)
+{
+    // If no element referenced or the referenced one is the last
+    if ((elt_ref_hdr == NULL) || (elt_ref_hdr->next == NULL))
+    {
+        co_dlist_push_back(list, elt_to_add_hdr);
+    }
+    else
+    {
+        elt_to_add_hdr->next = elt_ref_hdr->next;
+        elt_to_add_hdr->prev = elt_ref_hdr;
+        elt_to_add_hdr->list = list;
+
+        elt_ref_hdr->next->prev = elt_to_add_hdr;
+        elt_ref_hdr->next = elt_to_add_hdr;
+        list->size++;
+    }
+}
+
+#if CO_LIST_BENCHMARK
+#define CO_LIST_BENCH_NODES     64
+#define CO_LIST_BENCH_LOOPS     256
+
+struct co_list_bench_node
+{
+    struct co_list_hdr hdr;
+    struct co_dlist_hdr dhdr;
+};
+
+static struct co_list_bench_node co_list_bench_nodes[CO_LIST_BENCH_NODES];
+
+static void co_list_bench_run(uint16_t count)
+{
+    struct co_list list, other;
+    struct co_dlist dlist, dother;
+    uint32_t start, cycles[2][3] = {{0}};
+    // results of find and size are accumulated here, otherwise the calls are removed
+    volatile uint32_t sink = 0;
+    uint32_t seed = 0x12345678;
+
+    co_list_init(&list);
+    co_list_init(&other);
+    co_dlist_init(&dlist);
+    co_dlist_init(&dother);
+    for (uint16_t i = 0; i < count; i++)
+    {
+        co_list_push_back(&list, &co_list_bench_nodes[i].hdr);
+        co_dlist_push_back(&dlist, &co_list_bench_nodes[i].dhdr);
+    }
+
+    for (uint32_t loop = 0; loop < CO_LIST_BENCH_LOOPS; loop++)
+    {
+        struct co_list_bench_node *node;
+
+        // xorshift32, pick a random element and move it to the other list and back
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        node = &co_list_bench_nodes[seed % count];
+
+        start = DWT->CYCCNT;
+        co_list_extract(&list, &node->hdr);
+        co_list_push_back(&other, &node->hdr);
+        cycles[0][0] += DWT->CYCCNT - start;
+        start = DWT->CYCCNT;
+        co_dlist_extract(&dlist, &node->dhdr);
+        co_dlist_push_back(&dother, &node->dhdr);
+        cycles[1][0] += DWT->CYCCNT - start;
+
+        start = DWT->CYCCNT;
+        sink += co_list_find(&list, &node->hdr);
+        cycles[0][1] += DWT->CYCCNT - start;
+        start = DWT->CYCCNT;
+        sink += co_dlist_find(&dlist, &node->dhdr);
+        cycles[1][1] += DWT->CYCCNT - start;
+
+        start = DWT->CYCCNT;
+        sink += co_list_size(&list);
+        cycles[0][2] += DWT->CYCCNT - start;
+        start = DWT->CYCCNT;
+        sink += co_dlist_size(&dlist);
+        cycles[1][2] += DWT->CYCCNT - start;
+
+        co_list_extract(&other, &node->hdr);
+        co_list_push_back(&list, &node->hdr);
+        co_dlist_extract(&dother, &node->dhdr);
+        co_dlist_push_back(&dlist, &node->dhdr);
+    }
+
+    printf("%3d nodes, mean cycles     move   find   size\r\n", count);
+    printf("  co_list             %6d %6d %6d\r\n", cycles[0][0] / CO_LIST_BENCH_LOOPS,
+            cycles[0][1] / CO_LIST_BENCH_LOOPS, cycles[0][2] / CO_LIST_BENCH_LOOPS);
+    printf("  co_dlist            %6d %6d %6d\r\n", cycles[1][0] / CO_LIST_BENCH_LOOPS,
+            cycles[1][1] / CO_LIST_BENCH_LOOPS, cycles[1][2] / CO_LIST_BENCH_LOOPS);
+}
+
+void co_list_benchmark(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (uint16_t count = 4; count <= CO_LIST_BENCH_NODES; count <<= 2)
+    {
+        co_list_bench_run(count);
+    }
+}
+#endif // CO_LIST_BENCHMARK
+
 /// @} CO_LIST
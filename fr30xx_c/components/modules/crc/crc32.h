@@ -7,7 +7,69 @@ extern "C" {
 
 #include <stdint.h>
 
-unsigned int crc32(unsigned int crc, const unsigned char *buf, unsigned int len);
+/*
+ * CRC-32 (IEEE 802.3, same as zlib). Buffers are calculated by software with
+ * slice-by-8 tables. When CRC32_HW_ENABLE is set, buffers not shorter than
+ * CRC32_HW_THRESHOLD are fed to the CRC engine by DMA when the engine is not used
+ * by others, software is used again when a transfer does not finish in time.
+ */
+
+/// set to 1 to use CRC engine for long buffers, not verified on hardware yet
+#define CRC32_HW_ENABLE             0
+/// the shortest buffer calculated by the CRC engine
+#define CRC32_HW_THRESHOLD          1024
+
+typedef struct {
+    /// CRC of the data processed so far
+    uint32_t crc;
+} crc32_ctx_t;
+
+/************************************************************************************
+ * @fn      crc32
+ *
+ * @brief   calculate CRC-32 of a buffer, compatible with crc32 of zlib.
+ *
+ * @param   crc: CRC of the preceding data, 0 for the first buffer.
+ * @param   buf: data to be calculated.
+ * @param   len: length of data.
+ *
+ * @return  CRC of the preceding data and this buffer.
+ */
+uint32_t crc32(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+/************************************************************************************
+ * @fn      crc32_init
+ *
+ * @brief   start a new streaming calculation.
+ */
+void crc32_init(crc32_ctx_t *ctx);
+
+/************************************************************************************
+ * @fn      crc32_update
+ *
+ * @brief   add data to a streaming calculation, can be called any times.
+ */
+void crc32_update(crc32_ctx_t *ctx, const void *buf, uint32_t len);
+
+/************************************************************************************
+ * @fn      crc32_final
+ *
+ * @brief   get the result of a streaming calculation.
+ *
+ * @return  CRC-32 of all data added by crc32_update.
+ */
+uint32_t crc32_final(crc32_ctx_t *ctx);
+
+/************************************************************************************
+ * @fn      crc32_combine
+ *
+ * @brief   get CRC of two concatenated blocks from CRC of each block.
+ *
+ * @param   crc1: CRC of the first block.
+ * @param   crc2: CRC of the second block.
+ * @param   len2: length of the second block.
+ */
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint32_t len2);
 
 const uint32_t *crc32_get_table(void);
 
@@ -16,4 +78,3 @@ const uint32_t *crc32_get_table(void);
 #endif
 
 #endif
-
@@ -0,0 +1,297 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "fr30xx.h"
+
+#include "dsp.h"
+#include "dsp_mem.h"
+#include "dsp_ring.h"
+#include "rpmsg_platform.h"
+
+#include "FreeRTOS.h"
+
+#define DSP_RING_ID(stream_id, dir)         ((stream_id) * 2 + (dir))
+#define DSP_RING_MIN_SIZE                   64
+
+static dsp_ring_t *dsp_ring_table[DSP_RING_MAX_STREAMS * 2];
+static uint16_t dsp_ring_stream_used = 0;
+static bool dsp_ring_doorbell_inited = false;
+
+static void dsp_ring_doorbell_handler(uint32_t msg)
+{
+    while (msg) {
+        uint32_t ring_id = __CLZ(__RBIT(msg));
+        dsp_ring_t *ring;
+
+        msg &= ~(1u << ring_id);
+        if (ring_id >= (DSP_RING_MAX_STREAMS * 2)) {
+            continue;
+        }
+        ring = dsp_ring_table[ring_id];
+        if (ring && ring->notify) {
+            ring->notify(ring, ring->arg);
+        }
+    }
+}
+
+static void dsp_ring_doorbell(dsp_ring_t *ring)
+{
+    platform_doorbell_ring(1u << DSP_RING_ID(ring->stream_id, ring->dir));
+}
+
+uint8_t dsp_ring_stream_alloc(void)
+{
+    uint8_t stream_id = DSP_RING_STREAM_ID_INVALID;
+
+    GLOBAL_INT_DISABLE();
+    for (uint8_t i = 0; i < DSP_RING_MAX_STREAMS; i++) {
+        if ((dsp_ring_stream_used & (1u << i)) == 0) {
+            dsp_ring_stream_used |= (1u << i);
+            stream_id = i;
+            break;
+        }
+    }
+    GLOBAL_INT_RESTORE();
+
+    return stream_id;
+}
+
+void dsp_ring_stream_free(uint8_t stream_id)
+{
+    if (stream_id >= DSP_RING_MAX_STREAMS) {
+        return;
+    }
+
+    GLOBAL_INT_DISABLE();
+    dsp_ring_stream_used &= ~(1u << stream_id);
+    GLOBAL_INT_RESTORE();
+}
+
+dsp_ring_t *dsp_ring_create(uint8_t stream_id, uint8_t dir, uint32_t size)
+{
+    dsp_ring_t *ring;
+    uint32_t ring_id;
+    uint32_t addr;
+    void *raw;
+
+    if ((stream_id >= DSP_RING_MAX_STREAMS) || (dir > DSP_RING_DIR_FROM_DSP)) {
+        return NULL;
+    }
+    ring_id = DSP_RING_ID(stream_id, dir);
+    if (dsp_ring_table[ring_id]) {
+        return NULL;
+    }
+
+    /* round up to power of 2, so that index can be wrapped with a mask */
+    if (size < DSP_RING_MIN_SIZE) {
+        size = DSP_RING_MIN_SIZE;
+    }
+    size = 1u << (32 - __CLZ(size - 1));
+
+    ring = pvPortMalloc(sizeof(dsp_ring_t));
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    /* control block and buffer are allocated together, reserve space for alignment */
+    raw = dsp_mem_alloc(sizeof(dsp_ring_ctrl_t) + size + DSP_RING_CACHE_LINE);
+    if (raw == NULL) {
+        vPortFree(ring);
+        return NULL;
+    }
+    /* DSP can only access the ring in its DRAM */
+    if (((uint32_t)raw < DSP_DRAM_MCU_BASE_ADDR) || ((uint32_t)raw >= (DSP_DRAM_MCU_BASE_ADDR + DSP_DRAM_SIZE))) {
+        dsp_mem_free(raw);
+        vPortFree(ring);
+        return NULL;
+    }
+    addr = ((uint32_t)raw + DSP_RING_CACHE_LINE - 1) & ~(DSP_RING_CACHE_LINE - 1);
+
+    ring->raw = raw;
+    ring->ctrl = (void *)addr;
+    ring->buffer = (void *)(addr + sizeof(dsp_ring_ctrl_t));
+    ring->mask = size - 1;
+    ring->stream_id = stream_id;
+    ring->dir = dir;
+    ring->notify = NULL;
+    ring->arg = NULL;
+
+    memset((void *)ring->ctrl, 0, sizeof(dsp_ring_ctrl_t));
+    ring->ctrl->size = size;
+    ring->ctrl->buffer = MCU_SRAM_2_DSP_DRAM(ring->buffer);
+    ring->ctrl->ring_id = ring_id;
+    __DMB();
+
+    if (dsp_ring_doorbell_inited == false) {
+        platform_doorbell_register(dsp_ring_doorbell_handler);
+        dsp_ring_doorbell_inited = true;
+    }
+    GLOBAL_INT_DISABLE();
+    dsp_ring_table[ring_id] = ring;
+    GLOBAL_INT_RESTORE();
+
+    return ring;
+}
+
+void dsp_ring_destroy(dsp_ring_t *ring)
+{
+    if (ring == NULL) {
+        return;
+    }
+
+    GLOBAL_INT_DISABLE();
+    dsp_ring_table[DSP_RING_ID(ring->stream_id, ring->dir)] = NULL;
+    GLOBAL_INT_RESTORE();
+
+    dsp_mem_free(ring->raw);
+    vPortFree(ring);
+}
+
+void dsp_ring_set_notify(dsp_ring_t *ring, void (*notify)(dsp_ring_t *ring, void *arg), void *arg)
+{
+    GLOBAL_INT_DISABLE();
+    ring->notify = notify;
+    ring->arg = arg;
+    GLOBAL_INT_RESTORE();
+}
+
+uint32_t dsp_ring_get_dsp_addr(dsp_ring_t *ring)
+{
+    return MCU_SRAM_2_DSP_DRAM(ring->ctrl);
+}
+
+uint32_t dsp_ring_get_count(dsp_ring_t *ring)
+{
+    return ring->ctrl->head - ring->ctrl->tail;
+}
+
+uint32_t dsp_ring_get_space(dsp_ring_t *ring)
+{
+    return ring->ctrl->size - (ring->ctrl->head - ring->ctrl->tail);
+}
+
+static uint32_t dsp_ring_copy_in(dsp_ring_t *ring, const uint8_t *data, uint32_t length)
+{
+    dsp_ring_ctrl_t *ctrl = ring->ctrl;
+    uint32_t head = ctrl->head;
+    uint32_t space = ctrl->size - (head - ctrl->tail);
+    uint32_t offset, first;
+
+    if (length > space) {
+        length = space;
+    }
+    if (length == 0) {
+        return 0;
+    }
+
+    offset = head & ring->mask;
+    first = ctrl->size - offset;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(&ring->buffer[offset], data, first);
+    memcpy(&ring->buffer[0], &data[first], length - first);
+
+    /* data should be visible before head is updated */
+    __DMB();
+    ctrl->head = head + length;
+
+    return length;
+}
+
+uint32_t dsp_ring_write(dsp_ring_t *ring, const void *data, uint32_t length)
+{
+    dsp_ring_ctrl_t *ctrl = ring->ctrl;
+    uint32_t written;
+
+    written = dsp_ring_copy_in(ring, data, length);
+    if (written < length) {
+        /* ask DSP to notify when space is released, check again to avoid missing it */
+        if (ctrl->prod_wait == ctrl->prod_ack) {
+            ctrl->prod_wait++;
+        }
+        __DMB();
+        written += dsp_ring_copy_in(ring, (const uint8_t *)data + written, length - written);
+    }
+
+    __DMB();
+    if (written && (ctrl->cons_wait != ctrl->cons_ack)) {
+        ctrl->cons_ack = ctrl->cons_wait;
+        dsp_ring_doorbell(ring);
+    }
+
+    return written;
+}
+
+uint32_t dsp_ring_peek(dsp_ring_t *ring, uint8_t **data)
+{
+    dsp_ring_ctrl_t *ctrl = ring->ctrl;
+    uint32_t tail = ctrl->tail;
+    uint32_t count = ctrl->head - tail;
+    uint32_t offset;
+
+    if (count == 0) {
+        /* ask DSP to notify when new data is written, check again to avoid missing it */
+        if (ctrl->cons_wait == ctrl->cons_ack) {
+            ctrl->cons_wait++;
+        }
+        __DMB();
+        count = ctrl->head - tail;
+        if (count == 0) {
+            return 0;
+        }
+    }
+    /* head is read before data */
+    __DMB();
+
+    offset = tail & ring->mask;
+    if (count > (ctrl->size - offset)) {
+        count = ctrl->size - offset;
+    }
+    *data = &ring->buffer[offset];
+
+    return count;
+}
+
+void dsp_ring_consume(dsp_ring_t *ring, uint32_t length)
+{
+    dsp_ring_ctrl_t *ctrl = ring->ctrl;
+
+    if (length == 0) {
+        return;
+    }
+
+    /* data should be fully read before the space is released */
+    __DMB();
+    ctrl->tail += length;
+
+    __DMB();
+    if (ctrl->prod_wait != ctrl->prod_ack) {
+        ctrl->prod_ack = ctrl->prod_wait;
+        dsp_ring_doorbell(ring);
+    }
+}
+
+uint32_t dsp_ring_read(dsp_ring_t *ring, void *data, uint32_t length)
+{
+    uint8_t *dst = data;
+    uint32_t read = 0;
+
+    while (read < length) {
+        uint8_t *src;
+        uint32_t count = dsp_ring_peek(ring, &src);
+
+        if (count == 0) {
+            break;
+        }
+        if (count > (length - read)) {
+            count = length - read;
+        }
+        memcpy(&dst[read], src, count);
+        dsp_ring_consume(ring, count);
+        read += count;
+    }
+
+    return read;
+}
@@ -0,0 +1,215 @@
+#ifndef _DSP_RING_H
+#define _DSP_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Single-producer/single-consumer byte rings shared between MCU and DSP. Control
+ * block and data buffer are both located in DSP DRAM, so data can flow between
+ * the two cores continuously without passing pointers in each rpmsg invocation.
+ *
+ * Layout of control block in DSP DRAM (all fields are 32-bit, little endian):
+ *
+ *  offset 0x00: producer line, only written by producer
+ *      head        free running byte counter of written data
+ *      prod_wait   increased by producer when it is waiting for space
+ *      cons_ack    copied from cons_wait by producer after consumer is notified
+ *  offset 0x20: consumer line, only written by consumer
+ *      tail        free running byte counter of read data
+ *      cons_wait   increased by consumer when it is waiting for data
+ *      prod_ack    copied from prod_wait by consumer after producer is notified
+ *  offset 0x40: constant after creation
+ *      size        buffer size in bytes, power of 2
+ *      buffer      DSP address of data buffer
+ *      ring_id     doorbell bit of this ring
+ *
+ * Each line is aligned to DSP cache line, DSP should invalidate the line written
+ * by the other side before reading it, and write back its own line after data
+ * is written back. Doorbell is sent through IPC channel 2, the message is a bit
+ * mask of ring IDs, ring_id = stream_id * 2 + dir.
+ */
+
+#define DSP_RING_CACHE_LINE             32
+#define DSP_RING_MAX_STREAMS            16
+
+#define DSP_RING_STREAM_ID_INVALID      0xFF
+
+enum dsp_ring_dir {
+    DSP_RING_DIR_TO_DSP,        // MCU is producer, such as bitstream to be decoded
+    DSP_RING_DIR_FROM_DSP,      // DSP is producer, such as decoded PCM data
+};
+
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t prod_wait;
+    volatile uint32_t cons_ack;
+    uint32_t rsv0[DSP_RING_CACHE_LINE / 4 - 3];
+
+    volatile uint32_t tail;
+    volatile uint32_t cons_wait;
+    volatile uint32_t prod_ack;
+    uint32_t rsv1[DSP_RING_CACHE_LINE / 4 - 3];
+
+    uint32_t size;
+    uint32_t buffer;
+    uint32_t ring_id;
+    uint32_t rsv2[DSP_RING_CACHE_LINE / 4 - 3];
+} dsp_ring_ctrl_t;
+
+typedef struct dsp_ring {
+    /* MCU view of control block and data buffer */
+    dsp_ring_ctrl_t *ctrl;
+    uint8_t *buffer;
+    uint32_t mask;
+    /* allocated block in DSP DRAM, control block is aligned inside this block */
+    void *raw;
+
+    uint8_t stream_id;
+    uint8_t dir;
+
+    /* called in interrupt when doorbell of this ring is received */
+    void (*notify)(struct dsp_ring *ring, void *arg);
+    void *arg;
+} dsp_ring_t;
+
+/************************************************************************************
+ * @fn      dsp_ring_stream_alloc
+ *
+ * @brief   allocate an unused stream ID, each stream can have one ring in each direction.
+ *
+ * @return  allocated stream ID, DSP_RING_STREAM_ID_INVALID will be returned when failed.
+ */
+uint8_t dsp_ring_stream_alloc(void);
+
+/************************************************************************************
+ * @fn      dsp_ring_stream_free
+ *
+ * @brief   release a stream ID allocated by dsp_ring_stream_alloc.
+ *
+ * @param   stream_id: stream ID to be released.
+ */
+void dsp_ring_stream_free(uint8_t stream_id);
+
+/************************************************************************************
+ * @fn      dsp_ring_create
+ *
+ * @brief   create a ring in DSP DRAM.
+ *
+ * @param   stream_id: stream ID, @ref dsp_ring_stream_alloc.
+ * @param   dir: direction of data flow, @ref dsp_ring_dir.
+ * @param   size: buffer size in bytes, it will be rounded up to power of 2.
+ *
+ * @return  ring handler, NULL will be returned when failed.
+ */
+dsp_ring_t *dsp_ring_create(uint8_t stream_id, uint8_t dir, uint32_t size);
+
+/************************************************************************************
+ * @fn      dsp_ring_destroy
+ *
+ * @brief   destroy a created ring. DSP should be detached from this ring before.
+ *
+ * @param   ring: ring handler.
+ */
+void dsp_ring_destroy(dsp_ring_t *ring);
+
+/************************************************************************************
+ * @fn      dsp_ring_set_notify
+ *
+ * @brief   set callback of doorbell. For DSP_RING_DIR_TO_DSP ring it is called when
+ *          space is released by DSP, otherwise it is called when new data is available.
+ *
+ * @param   ring: ring handler.
+ * @param   notify: callback function, it is called in interrupt.
+ * @param   arg: parameter of callback function.
+ */
+void dsp_ring_set_notify(dsp_ring_t *ring, void (*notify)(dsp_ring_t *ring, void *arg), void *arg);
+
+/************************************************************************************
+ * @fn      dsp_ring_get_dsp_addr
+ *
+ * @brief   get DSP address of control block, used to attach this ring to DSP modules.
+ *
+ * @param   ring: ring handler.
+ *
+ * @return  DSP address of control block.
+ */
+uint32_t dsp_ring_get_dsp_addr(dsp_ring_t *ring);
+
+/************************************************************************************
+ * @fn      dsp_ring_get_count
+ *
+ * @brief   get length of data in ring.
+ *
+ * @param   ring: ring handler.
+ *
+ * @return  available data length in bytes.
+ */
+uint32_t dsp_ring_get_count(dsp_ring_t *ring);
+
+/************************************************************************************
+ * @fn      dsp_ring_get_space
+ *
+ * @brief   get free space of ring.
+ *
+ * @param   ring: ring handler.
+ *
+ * @return  free space in bytes.
+ */
+uint32_t dsp_ring_get_space(dsp_ring_t *ring);
+
+/************************************************************************************
+ * @fn      dsp_ring_write
+ *
+ * @brief   producer side, copy data into ring. DSP is notified when the ring was empty
+ *          and DSP is waiting for data. If the ring is full before all data are written,
+ *          producer will be notified by DSP after space is released.
+ *
+ * @param   ring: ring handler.
+ * @param   data: data to be written.
+ * @param   length: data length in bytes.
+ *
+ * @return  written length, may be smaller than length when no enough space.
+ */
+uint32_t dsp_ring_write(dsp_ring_t *ring, const void *data, uint32_t length);
+
+/************************************************************************************
+ * @fn      dsp_ring_peek
+ *
+ * @brief   consumer side, get continuous readable data without copy. Data in ring may
+ *          be split into two segments at the end of buffer, call this function again
+ *          after dsp_ring_consume to get the second one. If no data is available,
+ *          consumer will be notified by DSP after new data is written.
+ *
+ * @param   ring: ring handler.
+ * @param   data: used to store address of readable data.
+ *
+ * @return  length of continuous readable data.
+ */
+uint32_t dsp_ring_peek(dsp_ring_t *ring, uint8_t **data);
+
+/************************************************************************************
+ * @fn      dsp_ring_consume
+ *
+ * @brief   consumer side, release data returned by dsp_ring_peek. DSP is notified when
+ *          it is waiting for space.
+ *
+ * @param   ring: ring handler.
+ * @param   length: released length in bytes.
+ */
+void dsp_ring_consume(dsp_ring_t *ring, uint32_t length);
+
+/************************************************************************************
+ * @fn      dsp_ring_read
+ *
+ * @brief   consumer side, copy data from ring, wrap of buffer is handled.
+ *
+ * @param   ring: ring handler.
+ * @param   data: buffer to store read data.
+ * @param   length: expected length in bytes.
+ *
+ * @return  read length, may be smaller than length when no enough data.
+ */
+uint32_t dsp_ring_read(dsp_ring_t *ring, void *data, uint32_t length);
+
+#endif  // _DSP_RING_H
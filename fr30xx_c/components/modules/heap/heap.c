@@ -10,6 +10,7 @@
 
 #include "fr30xx.h"
 #include "heap.h"
+#include "crc32.h"
 
 /*
  * MACRO DEFINITIONS
@@ -22,7 +23,35 @@
 
 #define CO_ALIGN4_HI(val)           (((val)+3)&~3)
 
-#define HEAP_MEM_DEBUG              1
+/// heap_mem_benchmark is provided to compare latency of allocators, HEAP_TYPE_DRAM_BLOCK is used by it
+#define HEAP_MEM_BENCHMARK          0
+
+/// allocator used by heap_mem_init for each heap type, @ref heap_algo_t
+#define HEAP_SRAM_ALGO              HEAP_ALGO_TLSF
+#define HEAP_DRAM_ALGO              HEAP_ALGO_LIST
+#define HEAP_BTDM_ALGO              HEAP_ALGO_TLSF
+#define HEAP_PSRAM_ALGO             HEAP_ALGO_TLSF
+
+/// profiler: number of allocation sites tracked is (1 << HEAP_PROF_SITES_LOG2)
+#define HEAP_PROF_SITES_LOG2        6
+#define HEAP_PROF_SITES             (1 << HEAP_PROF_SITES_LOG2)
+/// profiler snapshot starts with "HPRF"
+#define HEAP_PROF_MAGIC             0x46525048
+#define HEAP_PROF_VERSION           1
+
+/// TLSF: number of second level lists is (1 << TLSF_SL_INDEX_COUNT_LOG2)
+#define TLSF_SL_INDEX_COUNT_LOG2    3
+#define TLSF_SL_INDEX_COUNT         (1 << TLSF_SL_INDEX_COUNT_LOG2)
+/// TLSF: blocks smaller than (1 << TLSF_FL_INDEX_SHIFT) are linearly mapped into first list
+#define TLSF_FL_INDEX_SHIFT         (TLSF_SL_INDEX_COUNT_LOG2 + 2)
+#define TLSF_SMALL_BLOCK_SIZE       (1 << TLSF_FL_INDEX_SHIFT)
+/// TLSF: the largest block managed is smaller than (1 << TLSF_FL_INDEX_MAX)
+#define TLSF_FL_INDEX_MAX           24
+#define TLSF_FL_INDEX_COUNT         (TLSF_FL_INDEX_MAX - TLSF_FL_INDEX_SHIFT + 1)
+
+/// TLSF: flag stored in size of a used block, the physical previous block is free
+#define TLSF_PREV_FREE              0x00000001
+#define HEAP_SIZE_MASK              (~3)
 
 #if HEAP_MEM_DEBUG
 #if defined (__ARMCC_VERSION) || defined(__ICCARM__)
@@ -126,13 +155,37 @@ struct mblock_used
 #endif
 };
 
+/*
+ * TLSF block layout is compatible with the list allocator: used blocks have the
+ * same descriptor as struct mblock_used, free blocks start with the descriptor of
+ * struct mblock_free and the size is copied into the last word of the block, so
+ * that the physical neighbours can be merged without walking any list.
+ */
+/// TLSF control structure, stored at the beginning of the heap
+struct tlsf_control
+{
+    /// bitmap of non-empty first level lists
+    uint32_t fl_bitmap;
+    /// bitmaps of non-empty second level lists
+    uint8_t sl_bitmap[TLSF_FL_INDEX_COUNT];
+    /// heads of free block lists
+    struct mblock_free *blocks[TLSF_FL_INDEX_COUNT][TLSF_SL_INDEX_COUNT];
+};
+
+/// the smallest TLSF block should be able to store free block descriptor and size copy
+#define TLSF_BLOCK_SIZE_MIN         (sizeof(struct mblock_free) + sizeof(uint32_t))
+
 /// heap environment definition
 struct heap_env_tag
 {
-    /// Root pointer = pointer to first element of heap linked lists
+    /// Root pointer = pointer to first element of heap linked lists, or first block of TLSF heaps
     struct mblock_free * heap[HEAP_TYPE_BLOCKS];
     /// Size of heaps
     uint32_t heap_size[HEAP_TYPE_BLOCKS];
+    /// allocator of heaps, @ref heap_algo_t
+    uint8_t algo[HEAP_TYPE_BLOCKS];
+    /// TLSF control structures, NULL for list heaps
+    struct tlsf_control *tlsf[HEAP_TYPE_BLOCKS];
 
 #if (HEAP_MEM_DEBUG)
     /// Size of heap used
@@ -147,6 +200,37 @@ struct heap_env_tag
 /// Heap environment
 struct heap_env_tag heap_env_app;
 
+#if HEAP_MEM_PROFILE
+/// Live usage of one allocation site, also the record format in snapshot
+struct heap_prof_site
+{
+    /// caller address, 0 is used for the sites dropped when the table is full
+    uint32_t return_addr;
+    /// @ref heap_prof_kind_t
+    uint32_t kind;
+    uint32_t bytes;
+    uint32_t count;
+    uint32_t allocs;
+    uint32_t peak_bytes;
+    /// bytes held when heap usage of all sites reached the maximum
+    uint32_t at_peak_bytes;
+};
+
+/// Profiler environment definition
+struct heap_prof_env_tag
+{
+    /// open addressing hash table of sites
+    struct heap_prof_site sites[HEAP_PROF_SITES];
+    struct heap_prof_site overflow;
+    uint32_t site_count;
+    /// bytes of HEAP_PROF_KIND_HEAP sites
+    uint32_t total_bytes;
+    uint32_t peak_total_bytes;
+};
+
+static struct heap_prof_env_tag heap_prof_env;
+#endif //HEAP_MEM_PROFILE
+
 #undef configTOTAL_HEAP_SIZE
 #define configTOTAL_HEAP_SIZE       0x19000
 
@@ -201,57 +285,50 @@ static bool mem_is_in_heap(uint8_t type, void* mem_ptr)
     return ret;
 }
 
-/*
- * FUNCTION DEFINITIONS
- ****************************************************************************************
+#if HEAP_MEM_DEBUG
+/**
+ * Add allocated size into usage statistics
+ *
+ * @param[in] type Memory type.
+ * @param[in] size Size of the allocated block (including delimiter).
  */
-void heap_mem_init(uint8_t type, uint8_t* heap, uint32_t heap_size)
+static void heap_usage_add(uint8_t type, uint32_t size)
 {
-    // align first free descriptor to word boundary
-    heap_env_app.heap[type] =  (struct mblock_free*)CO_ALIGN4_HI((uint32_t)heap);
-
-    GLOBAL_INT_DISABLE();
+    uint32_t totalusedsize = 0;
+    uint8_t cursor;
 
-    // initialize the first block
-    //  + compute the size from the last aligned word before heap_end
-    heap_env_app.heap[type]->free_size = ((uint32_t)&heap[heap_size] & (~3)) - (uint32_t)(heap_env_app.heap[type]);
-    heap_env_app.heap[type]->corrupt_check = HEAP_LIST_PATTERN;
-    heap_env_app.heap[type]->next = NULL;
-    heap_env_app.heap[type]->previous = NULL;
+    heap_env_app.heap_used[type] += size;
+    if (heap_env_app.max_heap_used_single[type] < heap_env_app.heap_used[type])
+    {
+        heap_env_app.max_heap_used_single[type] = heap_env_app.heap_used[type];
+    }
 
-    heap_env_app.heap_size[type] = heap_size;
+    // calculate max used size
+    for(cursor = 0 ; cursor < HEAP_TYPE_BLOCKS ; cursor ++)
+    {
+        totalusedsize +=  heap_env_app.heap_used[cursor];
+    }
 
-    GLOBAL_INT_RESTORE();
+    if(heap_env_app.max_heap_used < totalusedsize)
+    {
+        heap_env_app.max_heap_used = totalusedsize;
+    }
 }
+#endif //HEAP_MEM_DEBUG
 
-__RAM_CODE __attribute__((noinline)) void *heap_mem_alloc(uint8_t type, uint32_t size)
+/**
+ * Best fit allocation from the sorted free list, the time is in proportion to the
+ * number of free blocks.
+ *
+ * @param[in] type Memory type.
+ * @param[in,out] totalsize Wanted block size, updated to the size actually used.
+ * @return Allocated block, NULL when no free block is large enough.
+ */
+static struct mblock_used *heap_list_alloc(uint8_t type, uint32_t *totalsize)
 {
     struct mblock_free *node = NULL,*found = NULL;
-    uint8_t cursor = 0;
-    struct mblock_used *alloc = NULL;
-    uint32_t totalsize;
-
-#if HEAP_MEM_DEBUG
-    volatile uint32_t address;
-    __asm("MOV %[result], LR":[result] "=r" (address));
-#endif
-
-    // compute overall block size (including requested size PLUS descriptor size)
-    totalsize = CO_ALIGN4_HI(size) + sizeof(struct mblock_used);
-    if(totalsize < sizeof(struct mblock_free))
-    {
-        totalsize = sizeof(struct mblock_free);
-    }
-
-    // sanity check: the totalsize should be large enough to hold free block descriptor
-    ASSERT_ERR(totalsize >= sizeof(struct mblock_free));
-
-    // protect accesses to descriptors
-    GLOBAL_INT_DISABLE();
-
-#if HEAP_MEM_DEBUG
-    uint32_t totalfreesize = 0;
-#endif //HEAP_MEM_DEBUG
+    struct mblock_used *alloc;
+    uint32_t size = *totalsize;
 
     // Select Heap to use, first try to use current heap.
     node = heap_env_app.heap[type];
@@ -261,14 +338,11 @@ __RAM_CODE __attribute__((noinline)) void *heap_mem_alloc(uint8_t type, uint32_t
     while (node != NULL)
     {
         ASSERT_ERR(node->corrupt_check == HEAP_LIST_PATTERN);
-#if HEAP_MEM_DEBUG
-        totalfreesize += node->free_size;
-#endif //HEAP_MEM_DEBUG
 
         // check if there is enough room in this free block
-        if (node->free_size >= (totalsize))
+        if (node->free_size >= (size))
         {
-            if ((node->free_size >= (totalsize + sizeof(struct mblock_free)))
+            if ((node->free_size >= (size + sizeof(struct mblock_free)))
                     || (node->previous != NULL))
             {
                 // if a match was already found, check if this one is smaller
@@ -283,151 +357,66 @@ __RAM_CODE __attribute__((noinline)) void *heap_mem_alloc(uint8_t type, uint32_t
         node = node->next;
     }
 
-    // Update size to use complete list if possible.
-    if(found != NULL)
+    if(found == NULL)
     {
-        if (found->free_size < (totalsize + sizeof(struct mblock_free)))
-        {
-            totalsize = found->free_size;
-        }
+        return NULL;
     }
 
-#if HEAP_MEM_DEBUG
-    heap_env_app.heap_used[type] = heap_env_app.heap_size[type] - totalfreesize;
-    if(found != NULL)
+    // Update size to use complete list if possible.
+    if (found->free_size < (size + sizeof(struct mblock_free)))
     {
-        heap_env_app.heap_used[type] += totalsize;
-        if (heap_env_app.max_heap_used_single[type] < heap_env_app.heap_used[type])
-        {
-            heap_env_app.max_heap_used_single[type] = heap_env_app.heap_used[type];
-        }
+        size = found->free_size;
     }
 
+    // sublist completely reused
+    if (found->free_size == size)
     {
-        // calculate max used size
-        uint32_t totalusedsize = 0;
-        for(cursor = 0 ; cursor < HEAP_TYPE_BLOCKS ; cursor ++)
-        {
-            totalusedsize +=  heap_env_app.heap_used[cursor];
-        }
+        ASSERT_ERR(found->previous != NULL);
 
-        if(heap_env_app.max_heap_used < totalusedsize)
+        // update double linked list
+        found->previous->next = found->next;
+        if(found->next != NULL)
         {
-            heap_env_app.max_heap_used = totalusedsize;
+            found->next->previous = found->previous;
         }
-    }
-#endif //HEAP_MEM_DEBUG
 
-    // Re-boot platform if no more empty space
-    if(found == NULL)
-    {
-        heap_dump_used_mem(HEAP_TYPE_SRAM_BLOCK);
-        heap_dump_used_mem(HEAP_TYPE_DRAM_BLOCK);
-        heap_dump_used_mem(HEAP_TYPE_BTDM_BLOCK);
-        while(1);
+        // compute the pointer to the beginning of the free space
+        alloc = (struct mblock_used*) ((uint32_t)found);
     }
     else
     {
-        // sublist completely reused
-        if (found->free_size == totalsize)
-        {
-            ASSERT_ERR(found->previous != NULL);
+        // found a free block that matches, subtract the allocation size from the
+        // free block size. If equal, the free block will be kept with 0 size... but
+        // moving it out of the linked list is too much work.
+        found->free_size -= size;
 
-            // update double linked list
-            found->previous->next = found->next;
-            if(found->next != NULL)
-            {
-                found->next->previous = found->previous;
-            }
-
-            // compute the pointer to the beginning of the free space
-            alloc = (struct mblock_used*) ((uint32_t)found);
-        }
-        else
-        {
-            // found a free block that matches, subtract the allocation size from the
-            // free block size. If equal, the free block will be kept with 0 size... but
-            // moving it out of the linked list is too much work.
-            found->free_size -= totalsize;
-
-            // compute the pointer to the beginning of the free space
-            alloc = (struct mblock_used*) ((uint32_t)found + found->free_size);
-        }
-
-        // save the size of the allocated block
-        alloc->size = totalsize;
-        alloc->corrupt_check = HEAP_ALLOCATED_PATTERN;
-
-#if HEAP_MEM_DEBUG
-        alloc->return_addr = address;
-#endif
-
-        // move to the user memory space
-        alloc++;
+        // compute the pointer to the beginning of the free space
+        alloc = (struct mblock_used*) ((uint32_t)found + found->free_size);
     }
 
-    // end of protection (as early as possible)
-    GLOBAL_INT_RESTORE();
-    ASSERT_ERR(node == NULL);
+    alloc->size = size;
+    *totalsize = size;
 
-    return (void*)alloc;
+    return alloc;
 }
 
-__RAM_CODE __attribute__((noinline)) void heap_mem_free(void* mem_ptr)
+/**
+ * Insert a released block into the sorted free list and merge it with the adjacent
+ * free blocks.
+ *
+ * @param[in] type Memory type.
+ * @param[in] freed Released block.
+ * @param[in] size Size of the released block (including delimiter).
+ */
+static void heap_list_free(uint8_t type, struct mblock_free *freed, uint32_t size)
 {
-    struct mblock_free *freed;
-    struct mblock_used *bfreed;
     struct mblock_free *node, *next_node, *prev_node;
-    uint32_t size;
-    uint8_t cursor = 0;
-
-#if HEAP_MEM_DEBUG
-    volatile uint32_t address;
-    __asm("MOV %[result], LR":[result] "=r" (address));
-#endif
-
-    // sanity checks
-    ASSERT_INFO(mem_ptr != NULL, mem_ptr, 0);
-
-    // point to the block descriptor (before user memory so decrement)
-    bfreed = ((struct mblock_used *)mem_ptr) - 1;
-
-    // check if memory block has been corrupted or not
-    ASSERT_INFO(bfreed->corrupt_check == HEAP_ALLOCATED_PATTERN, bfreed->corrupt_check, mem_ptr);
-    // change corruption token in order to know if buffer has been already freed.
-    bfreed->corrupt_check = HEAP_FREE_PATTERN;
-
-    // point to the first node of the free elements linked list
-    size = bfreed->size;
-    node = NULL;
-
-    freed = ((struct mblock_free *)bfreed);
-#if HEAP_MEM_DEBUG
-    freed->return_addr = address;
-#endif
-
-    // protect accesses to descriptors
-    GLOBAL_INT_DISABLE();
 
-    // Retrieve where memory block comes from
-    while(((cursor < HEAP_TYPE_BLOCKS)) && (node == NULL))
-    {
-        if(mem_is_in_heap(cursor, mem_ptr))
-        {
-            // Select Heap to use, first try to use current heap.
-            node = heap_env_app.heap[cursor];
-        }
-        else
-        {
-            cursor ++;
-        }
-    }
+    node = heap_env_app.heap[type];
+    prev_node = NULL;
 
     // sanity checks
-    ASSERT_ERR(node != NULL);
-    ASSERT_ERR(((uint32_t)mem_ptr > (uint32_t)node));
-
-    prev_node = NULL;
+    ASSERT_ERR(((uint32_t)freed > (uint32_t)node));
 
     while(node != NULL)
     {
@@ -453,7 +442,7 @@ __RAM_CODE __attribute__((noinline)) void heap_mem_free(void* mem_ptr)
                     next_node->next->previous = node;
                 }
             }
-            goto free_end;
+            return;
         }
         else if ((uint32_t)freed < (uint32_t)node)
         {
@@ -484,90 +473,889 @@ __RAM_CODE __attribute__((noinline)) void heap_mem_free(void* mem_ptr)
                 node->previous = freed;
                 freed->free_size = size;
             }
-            goto free_end;
+            return;
         }
 
         // move to the next free block node
         prev_node = node;
         node = node->next;
-
     }
 
-    freed->corrupt_check = HEAP_LIST_PATTERN;
-
     // if reached here, freed block is after last free block and not contiguous
     prev_node->next = (struct mblock_free*)freed;
     freed->next = NULL;
     freed->previous = prev_node;
     freed->free_size = size;
     freed->corrupt_check = HEAP_LIST_PATTERN;
+}
 
-free_end:
-
-#if HEAP_MEM_DEBUG
-    heap_env_app.heap_used[cursor] -= size;
-#endif //HEAP_MEM_DEBUG
+/// index of the most significant set bit, word should not be 0
+static __inline int tlsf_fls(uint32_t word)
+{
+    return 31 - __CLZ(word);
+}
 
-    // end of protection
-    GLOBAL_INT_RESTORE();
+/// index of the least significant set bit, word should not be 0
+static __inline int tlsf_ffs(uint32_t word)
+{
+    return __CLZ(__RBIT(word));
 }
 
-#if (HEAP_MEM_DEBUG)
-uint32_t heap_get_mem_usage(uint8_t type)
+/**
+ * Get the free list a block of given size belongs to
+ */
+static void tlsf_mapping_insert(uint32_t size, int *fli, int *sli)
 {
-    ASSERT_ERR(type < HEAP_TYPE_BLOCKS);
+    int fl, sl;
 
-    return heap_env_app.heap_used[type];
+    if (size < TLSF_SMALL_BLOCK_SIZE)
+    {
+        // small blocks are stored in first list, step is (TLSF_SMALL_BLOCK_SIZE / TLSF_SL_INDEX_COUNT)
+        fl = 0;
+        sl = size / (TLSF_SMALL_BLOCK_SIZE / TLSF_SL_INDEX_COUNT);
+    }
+    else
+    {
+        fl = tlsf_fls(size);
+        sl = (size >> (fl - TLSF_SL_INDEX_COUNT_LOG2)) ^ TLSF_SL_INDEX_COUNT;
+        fl -= (TLSF_FL_INDEX_SHIFT - 1);
+    }
+
+    *fli = fl;
+    *sli = sl;
 }
 
-uint32_t heap_get_mem_available(uint8_t type)
+/**
+ * Get the first free list in which every block is large enough for given size
+ */
+static void tlsf_mapping_search(uint32_t size, int *fli, int *sli)
 {
-    ASSERT_ERR(type < HEAP_TYPE_BLOCKS);
-    
-    return heap_env_app.heap_size[type] - heap_env_app.heap_used[type];
+    if (size >= TLSF_SMALL_BLOCK_SIZE)
+    {
+        size += (1 << (tlsf_fls(size) - TLSF_SL_INDEX_COUNT_LOG2)) - 1;
+    }
+
+    tlsf_mapping_insert(size, fli, sli);
 }
 
-uint32_t heap_get_max_mem_usage_single(uint8_t type)
+/**
+ * Find a non-empty free list with the help of bitmaps, no list is walked.
+ */
+static struct mblock_free *tlsf_search(struct tlsf_control *control, int *fli, int *sli)
 {
-    ASSERT_ERR(type < HEAP_TYPE_BLOCKS);
+    int fl = *fli;
+    int sl = *sli;
+    uint32_t sl_map, fl_map;
 
-    return heap_env_app.max_heap_used_single[type];
+    if (fl >= TLSF_FL_INDEX_COUNT)
+    {
+        return NULL;
+    }
+
+    sl_map = control->sl_bitmap[fl] & (~0U << sl);
+    if (sl_map == 0)
+    {
+        // no block in this first level list, search in larger ones
+        fl_map = control->fl_bitmap & (~0U << (fl + 1));
+        if (fl_map == 0)
+        {
+            return NULL;
+        }
+        fl = tlsf_ffs(fl_map);
+        sl_map = control->sl_bitmap[fl];
+    }
+    sl = tlsf_ffs(sl_map);
+
+    *fli = fl;
+    *sli = sl;
+
+    return control->blocks[fl][sl];
 }
 
-uint32_t heap_get_max_mem_usage(void)
+/**
+ * Put a free block at the head of the matching free list
+ */
+static void tlsf_insert(struct tlsf_control *control, struct mblock_free *block, uint32_t size)
 {
-    uint32_t ret = heap_env_app.max_heap_used;
+    struct mblock_used *next_phys;
+    int fl, sl;
 
-    return ret;
+    tlsf_mapping_insert(size, &fl, &sl);
+
+    block->corrupt_check = HEAP_LIST_PATTERN;
+    block->free_size = size;
+    block->previous = NULL;
+    block->next = control->blocks[fl][sl];
+    if (block->next != NULL)
+    {
+        block->next->previous = block;
+    }
+    control->blocks[fl][sl] = block;
+    control->fl_bitmap |= (1U << fl);
+    control->sl_bitmap[fl] |= (1U << sl);
+
+    // copy size into the last word, and tell the next block its previous one is free
+    *(uint32_t *)((uint32_t)block + size - sizeof(uint32_t)) = size;
+    next_phys = (struct mblock_used *)((uint32_t)block + size);
+    next_phys->size |= TLSF_PREV_FREE;
 }
 
-void heap_dump_used_mem(uint8_t type)
+/**
+ * Take a free block out of its free list
+ */
+static void tlsf_remove(struct tlsf_control *control, struct mblock_free *block)
 {
-    struct mblock_free *node;
-    uint32_t heap_size;
+    int fl, sl;
 
-#define HEAP_RSV_TAIL_SIZE      0x10
-    
-    if (type >= HEAP_TYPE_BLOCKS) {
-        return;
+    ASSERT_INFO(block->corrupt_check == HEAP_LIST_PATTERN, block->corrupt_check, block);
+
+    tlsf_mapping_insert(block->free_size, &fl, &sl);
+
+    if (block->next != NULL)
+    {
+        block->next->previous = block->previous;
     }
-    
-    node = heap_env_app.heap[type];
-    heap_size = heap_env_app.heap_size[type];
-    GLOBAL_INT_DISABLE();
-    while (heap_size > HEAP_RSV_TAIL_SIZE) {
-        if (node->corrupt_check == HEAP_ALLOCATED_PATTERN) {
-            struct mblock_used *used_node = (void *)node;
-            printf("LR: 0x%08x, SIZE: 0x%08x, ADDR: 0x%08x.\r\n", used_node->return_addr, used_node->size, (uint32_t)used_node);
-            heap_size -= used_node->size;
-            node = (void *)((uint32_t)node + used_node->size);
-        }
-        else {
-            heap_size -= node->free_size;
-            node = (void *)((uint32_t)node + node->free_size);
+    if (block->previous != NULL)
+    {
+        block->previous->next = block->next;
+    }
+    else
+    {
+        control->blocks[fl][sl] = block->next;
+        if (block->next == NULL)
+        {
+            control->sl_bitmap[fl] &= ~(1U << sl);
+            if (control->sl_bitmap[fl] == 0)
+            {
+                control->fl_bitmap &= ~(1U << fl);
+            }
         }
     }
-    GLOBAL_INT_RESTORE();
 }
-#endif // (HEAP_MEM_DEBUG)
+
+/**
+ * Good fit allocation from TLSF free lists, the time is bounded and independent
+ * of the number of free blocks.
+ *
+ * @param[in] type Memory type.
+ * @param[in,out] totalsize Wanted block size, updated to the size actually used.
+ * @return Allocated block, NULL when no free block is large enough.
+ */
+static struct mblock_used *heap_tlsf_alloc(uint8_t type, uint32_t *totalsize)
+{
+    struct tlsf_control *control = heap_env_app.tlsf[type];
+    struct mblock_free *found;
+    struct mblock_used *alloc;
+    uint32_t size = *totalsize;
+    int fl, sl;
+
+    if (size < TLSF_BLOCK_SIZE_MIN)
+    {
+        size = TLSF_BLOCK_SIZE_MIN;
+    }
+
+    tlsf_mapping_search(size, &fl, &sl);
+    found = tlsf_search(control, &fl, &sl);
+    if (found == NULL)
+    {
+        return NULL;
+    }
+
+    tlsf_remove(control, found);
+
+    if (found->free_size >= (size + TLSF_BLOCK_SIZE_MIN))
+    {
+        // return the tail to free lists
+        tlsf_insert(control, (struct mblock_free *)((uint32_t)found + size), found->free_size - size);
+    }
+    else
+    {
+        // use the whole block
+        size = found->free_size;
+        ((struct mblock_used *)((uint32_t)found + size))->size &= ~TLSF_PREV_FREE;
+    }
+
+    // the previous block of a free block is always in use
+    alloc = (struct mblock_used *)found;
+    alloc->size = size;
+    *totalsize = size;
+
+    return alloc;
+}
+
+/**
+ * Release a block into TLSF free lists, merge it with the physical neighbours.
+ *
+ * @param[in] type Memory type.
+ * @param[in] freed Released block.
+ * @param[in] size Size of the released block (including delimiter).
+ * @param[in] prev_free The physical previous block is free.
+ */
+static void heap_tlsf_free(uint8_t type, struct mblock_free *freed, uint32_t size, bool prev_free)
+{
+    struct tlsf_control *control = heap_env_app.tlsf[type];
+    struct mblock_free *next_phys, *prev_phys;
+    uint32_t prev_size;
+
+    next_phys = (struct mblock_free *)((uint32_t)freed + size);
+    if (next_phys->corrupt_check == HEAP_LIST_PATTERN)
+    {
+        tlsf_remove(control, next_phys);
+        size += next_phys->free_size;
+    }
+
+    if (prev_free)
+    {
+        prev_size = *(uint32_t *)((uint32_t)freed - sizeof(uint32_t));
+        prev_phys = (struct mblock_free *)((uint32_t)freed - prev_size);
+        ASSERT_INFO(prev_phys->free_size == prev_size, prev_phys->free_size, prev_size);
+        tlsf_remove(control, prev_phys);
+        size += prev_size;
+        freed = prev_phys;
+    }
+
+    tlsf_insert(control, freed, size);
+}
+
+/*
+ * FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+void heap_mem_init(uint8_t type, uint8_t* heap, uint32_t heap_size)
+{
+    static const uint8_t default_algo[HEAP_TYPE_BLOCKS] = {
+        [HEAP_TYPE_SRAM_BLOCK] = HEAP_SRAM_ALGO,
+        [HEAP_TYPE_DRAM_BLOCK] = HEAP_DRAM_ALGO,
+        [HEAP_TYPE_BTDM_BLOCK] = HEAP_BTDM_ALGO,
+        [HEAP_TYPE_PSRAM_BLOCK] = HEAP_PSRAM_ALGO,
+    };
+
+    ASSERT_ERR(type < HEAP_TYPE_BLOCKS);
+
+    heap_mem_init_ex(type, heap, heap_size, default_algo[type]);
+}
+
+void heap_mem_init_ex(uint8_t type, uint8_t* heap, uint32_t heap_size, uint8_t algo)
+{
+    struct tlsf_control *control;
+    struct mblock_used *sentinel;
+    uint32_t heap_end;
+
+    ASSERT_ERR(type < HEAP_TYPE_BLOCKS);
+
+    // compute the size from the last aligned word before heap_end
+    heap_end = (uint32_t)&heap[heap_size] & (~3);
+
+    GLOBAL_INT_DISABLE();
+
+    heap_env_app.algo[type] = algo;
+
+    if (algo == HEAP_ALGO_TLSF)
+    {
+        // control structure is stored at the beginning, followed by the first free block
+        control = (struct tlsf_control *)CO_ALIGN4_HI((uint32_t)heap);
+        memset((void *)control, 0, sizeof(struct tlsf_control));
+        heap_env_app.tlsf[type] = control;
+        heap_env_app.heap[type] = (struct mblock_free *)CO_ALIGN4_HI((uint32_t)control + sizeof(struct tlsf_control));
+
+        // a used block with size 0 at the end stops merging and heap dump
+        sentinel = (struct mblock_used *)(heap_end - sizeof(struct mblock_used));
+        sentinel->corrupt_check = HEAP_ALLOCATED_PATTERN;
+        sentinel->size = 0;
+#if HEAP_MEM_DEBUG
+        sentinel->return_addr = 0;
+#endif
+
+        heap_env_app.heap_size[type] = heap_end - (uint32_t)heap_env_app.heap[type];
+        tlsf_insert(control, heap_env_app.heap[type], (uint32_t)sentinel - (uint32_t)heap_env_app.heap[type]);
+    }
+    else
+    {
+        // align first free descriptor to word boundary
+        heap_env_app.tlsf[type] = NULL;
+        heap_env_app.heap[type] =  (struct mblock_free*)CO_ALIGN4_HI((uint32_t)heap);
+
+        // initialize the first block
+        heap_env_app.heap[type]->free_size = heap_end - (uint32_t)(heap_env_app.heap[type]);
+        heap_env_app.heap[type]->corrupt_check = HEAP_LIST_PATTERN;
+        heap_env_app.heap[type]->next = NULL;
+        heap_env_app.heap[type]->previous = NULL;
+
+        heap_env_app.heap_size[type] = heap_size;
+    }
+
+#if HEAP_MEM_DEBUG
+    heap_env_app.heap_used[type] = heap_env_app.heap_size[type] - heap_env_app.heap[type]->free_size;
+#endif //HEAP_MEM_DEBUG
+
+    GLOBAL_INT_RESTORE();
+}
+
+__RAM_CODE __attribute__((noinline)) void *heap_mem_alloc(uint8_t type, uint32_t size)
+{
+#if HEAP_MEM_DEBUG
+    volatile uint32_t address;
+    __asm("MOV %[result], LR":[result] "=r" (address));
+
+    return heap_mem_alloc_lr(type, size, address);
+#else
+    return heap_mem_alloc_lr(type, size, 0);
+#endif
+}
+
+__RAM_CODE void *heap_mem_alloc_lr(uint8_t type, uint32_t size, uint32_t return_addr)
+{
+    void *alloc;
+
+    alloc = heap_mem_try_alloc(type, size, return_addr);
+
+    // Re-boot platform if no more empty space
+    if(alloc == NULL)
+    {
+        GLOBAL_INT_DISABLE();
+        for (uint8_t cursor = 0; cursor < HEAP_TYPE_BLOCKS; cursor++)
+        {
+            heap_dump_used_mem(cursor);
+        }
+        while(1);
+        GLOBAL_INT_RESTORE();
+    }
+
+    return alloc;
+}
+
+__RAM_CODE void *heap_mem_try_alloc(uint8_t type, uint32_t size, uint32_t return_addr)
+{
+    struct mblock_used *alloc = NULL;
+    uint32_t totalsize;
+
+    if ((type >= HEAP_TYPE_BLOCKS) || (heap_env_app.heap[type] == NULL))
+    {
+        return NULL;
+    }
+
+    // compute overall block size (including requested size PLUS descriptor size)
+    totalsize = CO_ALIGN4_HI(size) + sizeof(struct mblock_used);
+    if(totalsize < sizeof(struct mblock_free))
+    {
+        totalsize = sizeof(struct mblock_free);
+    }
+
+    // sanity check: the totalsize should be large enough to hold free block descriptor
+    ASSERT_ERR(totalsize >= sizeof(struct mblock_free));
+
+    // protect accesses to descriptors
+    GLOBAL_INT_DISABLE();
+
+    if (heap_env_app.algo[type] == HEAP_ALGO_TLSF)
+    {
+        alloc = heap_tlsf_alloc(type, &totalsize);
+    }
+    else
+    {
+        alloc = heap_list_alloc(type, &totalsize);
+    }
+
+    if(alloc != NULL)
+    {
+#if HEAP_MEM_DEBUG
+        heap_usage_add(type, totalsize);
+#endif //HEAP_MEM_DEBUG
+#if HEAP_MEM_PROFILE
+        heap_prof_record(return_addr, HEAP_PROF_KIND_HEAP, totalsize);
+#endif //HEAP_MEM_PROFILE
+
+        // save the size of the allocated block
+        alloc->corrupt_check = HEAP_ALLOCATED_PATTERN;
+
+#if HEAP_MEM_DEBUG
+        alloc->return_addr = return_addr;
+#endif
+
+        // move to the user memory space
+        alloc++;
+    }
+
+    // end of protection (as early as possible)
+    GLOBAL_INT_RESTORE();
+
+    return (void*)alloc;
+}
+
+__RAM_CODE __attribute__((noinline)) void heap_mem_free(void* mem_ptr)
+{
+    struct mblock_free *freed;
+    struct mblock_used *bfreed;
+    uint32_t size;
+    uint8_t cursor = 0;
+
+#if HEAP_MEM_DEBUG
+    volatile uint32_t address;
+    __asm("MOV %[result], LR":[result] "=r" (address));
+#endif
+#if HEAP_MEM_PROFILE
+    uint32_t alloc_address;
+#endif
+
+    // sanity checks
+    ASSERT_INFO(mem_ptr != NULL, mem_ptr, 0);
+
+    // point to the block descriptor (before user memory so decrement)
+    bfreed = ((struct mblock_used *)mem_ptr) - 1;
+
+    // check if memory block has been corrupted or not
+    ASSERT_INFO(bfreed->corrupt_check == HEAP_ALLOCATED_PATTERN, bfreed->corrupt_check, mem_ptr);
+    // change corruption token in order to know if buffer has been already freed.
+    bfreed->corrupt_check = HEAP_FREE_PATTERN;
+
+    freed = ((struct mblock_free *)bfreed);
+#if HEAP_MEM_PROFILE
+    alloc_address = bfreed->return_addr;
+#endif
+#if HEAP_MEM_DEBUG
+    freed->return_addr = address;
+#endif
+
+    // protect accesses to descriptors
+    GLOBAL_INT_DISABLE();
+
+    // Retrieve where memory block comes from
+    while((cursor < HEAP_TYPE_BLOCKS) && (mem_is_in_heap(cursor, mem_ptr) == false))
+    {
+        cursor ++;
+    }
+
+    // sanity checks
+    ASSERT_ERR(cursor < HEAP_TYPE_BLOCKS);
+
+    // flags in size is updated when neighbours are released, read it after protection
+    size = bfreed->size & HEAP_SIZE_MASK;
+    if (heap_env_app.algo[cursor] == HEAP_ALGO_TLSF)
+    {
+        heap_tlsf_free(cursor, freed, size, (bfreed->size & TLSF_PREV_FREE) != 0);
+    }
+    else
+    {
+        heap_list_free(cursor, freed, size);
+    }
+
+#if HEAP_MEM_DEBUG
+    heap_env_app.heap_used[cursor] -= size;
+#endif //HEAP_MEM_DEBUG
+#if HEAP_MEM_PROFILE
+    heap_prof_record(alloc_address, HEAP_PROF_KIND_HEAP, -(int32_t)size);
+#endif //HEAP_MEM_PROFILE
+
+    // end of protection
+    GLOBAL_INT_RESTORE();
+}
+
+bool heap_mem_is_inited(uint8_t type)
+{
+    return (type < HEAP_TYPE_BLOCKS) && (heap_env_app.heap[type] != NULL);
+}
+
+#if (HEAP_MEM_DEBUG)
+uint32_t heap_get_mem_usage(uint8_t type)
+{
+    ASSERT_ERR(type < HEAP_TYPE_BLOCKS);
+
+    return heap_env_app.heap_used[type];
+}
+
+uint32_t heap_get_mem_available(uint8_t type)
+{
+    ASSERT_ERR(type < HEAP_TYPE_BLOCKS);
+    
+    return heap_env_app.heap_size[type] - heap_env_app.heap_used[type];
+}
+
+uint32_t heap_get_max_mem_usage_single(uint8_t type)
+{
+    ASSERT_ERR(type < HEAP_TYPE_BLOCKS);
+
+    return heap_env_app.max_heap_used_single[type];
+}
+
+uint32_t heap_get_max_mem_usage(void)
+{
+    uint32_t ret = heap_env_app.max_heap_used;
+
+    return ret;
+}
+
+void heap_dump_used_mem(uint8_t type)
+{
+    struct mblock_free *node;
+    uint32_t heap_size;
+    uint32_t size;
+
+#define HEAP_RSV_TAIL_SIZE      0x10
+    
+    if (type >= HEAP_TYPE_BLOCKS) {
+        return;
+    }
+    
+    node = heap_env_app.heap[type];
+    heap_size = heap_env_app.heap_size[type];
+    GLOBAL_INT_DISABLE();
+    while (heap_size > HEAP_RSV_TAIL_SIZE) {
+        if (node->corrupt_check == HEAP_ALLOCATED_PATTERN) {
+            struct mblock_used *used_node = (void *)node;
+            size = used_node->size & HEAP_SIZE_MASK;
+            if (size == 0) {
+                // end of TLSF heap
+                break;
+            }
+            printf("LR: 0x%08x, SIZE: 0x%08x, ADDR: 0x%08x.\r\n", used_node->return_addr, size, (uint32_t)used_node);
+        }
+        else {
+            size = node->free_size;
+        }
+        heap_size -= size;
+        node = (void *)((uint32_t)node + size);
+    }
+    GLOBAL_INT_RESTORE();
+}
+#endif // (HEAP_MEM_DEBUG)
+
+void heap_get_frag_info(uint8_t type, heap_frag_info_t *info)
+{
+    struct tlsf_control *control;
+    struct mblock_free *node;
+    uint32_t fl_map, sl_map;
+    int fl, sl;
+
+    memset((void *)info, 0, sizeof(heap_frag_info_t));
+
+    if ((type >= HEAP_TYPE_BLOCKS) || (heap_env_app.heap[type] == NULL)) {
+        return;
+    }
+
+    GLOBAL_INT_DISABLE();
+    if (heap_env_app.algo[type] == HEAP_ALGO_TLSF) {
+        control = heap_env_app.tlsf[type];
+        fl_map = control->fl_bitmap;
+        while (fl_map) {
+            fl = tlsf_ffs(fl_map);
+            fl_map &= ~(1U << fl);
+            sl_map = control->sl_bitmap[fl];
+            while (sl_map) {
+                sl = tlsf_ffs(sl_map);
+                sl_map &= ~(1U << sl);
+                for (node = control->blocks[fl][sl]; node != NULL; node = node->next) {
+                    info->total_free += node->free_size;
+                    if (info->largest_free < node->free_size) {
+                        info->largest_free = node->free_size;
+                    }
+                    info->free_blocks++;
+                }
+            }
+        }
+    }
+    else {
+        for (node = heap_env_app.heap[type]; node != NULL; node = node->next) {
+            info->total_free += node->free_size;
+            if (info->largest_free < node->free_size) {
+                info->largest_free = node->free_size;
+            }
+            info->free_blocks++;
+        }
+    }
+    GLOBAL_INT_RESTORE();
+}
+
+#if HEAP_MEM_PROFILE
+void heap_prof_record(uint32_t return_addr, uint8_t kind, int32_t size)
+{
+    struct heap_prof_site *site = NULL, *node;
+    uint32_t index, bytes;
+
+    // Fibonacci hashing, caller addresses are close to each other
+    index = (return_addr * 0x9E3779B1) >> (32 - HEAP_PROF_SITES_LOG2);
+    for (uint32_t i = 0; i < HEAP_PROF_SITES; i++) {
+        node = &heap_prof_env.sites[(index + i) & (HEAP_PROF_SITES - 1)];
+        if ((node->return_addr == return_addr) && (node->kind == kind)) {
+            site = node;
+            break;
+        }
+        if (node->return_addr == 0) {
+            if (size < 0) {
+                // allocated before the profiler is reset
+                return;
+            }
+            node->return_addr = return_addr;
+            node->kind = kind;
+            heap_prof_env.site_count++;
+            site = node;
+            break;
+        }
+    }
+    if (site == NULL) {
+        site = &heap_prof_env.overflow;
+    }
+
+    if (size > 0) {
+        site->bytes += size;
+        site->count++;
+        site->allocs++;
+        if (site->peak_bytes < site->bytes) {
+            site->peak_bytes = site->bytes;
+        }
+        if (kind == HEAP_PROF_KIND_HEAP) {
+            heap_prof_env.total_bytes += size;
+            if (heap_prof_env.peak_total_bytes < heap_prof_env.total_bytes) {
+                // new peak is rare after start-up, take a picture of all sites
+                heap_prof_env.peak_total_bytes = heap_prof_env.total_bytes;
+                for (uint32_t i = 0; i < HEAP_PROF_SITES; i++) {
+                    heap_prof_env.sites[i].at_peak_bytes = heap_prof_env.sites[i].bytes;
+                }
+                heap_prof_env.overflow.at_peak_bytes = heap_prof_env.overflow.bytes;
+            }
+        }
+    }
+    else {
+        bytes = -size;
+        if (bytes > site->bytes) {
+            bytes = site->bytes;
+        }
+        site->bytes -= bytes;
+        if (site->count) {
+            site->count--;
+        }
+        if (kind == HEAP_PROF_KIND_HEAP) {
+            heap_prof_env.total_bytes -= bytes;
+        }
+    }
+}
+
+void heap_prof_reset(void)
+{
+    GLOBAL_INT_DISABLE();
+    memset((void *)&heap_prof_env, 0, sizeof(heap_prof_env));
+    GLOBAL_INT_RESTORE();
+}
+
+/*
+ * Snapshot format, all fields are 32-bit little endian:
+ *   header: magic, version, HEAP_TYPE_BLOCKS, number of sites, total bytes, peak total bytes
+ *   heaps: heap size, used, max used, algo, total free, largest free, free blocks
+ *   sites: struct heap_prof_site, the last one is overflow site
+ *   crc32 of all above
+ * Interrupt is only disabled when a record is copied, sites may change while the
+ * snapshot is sent.
+ */
+void heap_prof_snapshot(heap_prof_write_t write)
+{
+    uint32_t header[6];
+    uint32_t heap_info[7];
+    struct heap_prof_site site;
+    heap_frag_info_t frag;
+    uint32_t crc = 0, count, index = 0;
+
+    GLOBAL_INT_DISABLE();
+    header[0] = HEAP_PROF_MAGIC;
+    header[1] = HEAP_PROF_VERSION;
+    header[2] = HEAP_TYPE_BLOCKS;
+    header[3] = heap_prof_env.site_count + 1;
+    header[4] = heap_prof_env.total_bytes;
+    header[5] = heap_prof_env.peak_total_bytes;
+    GLOBAL_INT_RESTORE();
+    crc = crc32(crc, (const uint8_t *)header, sizeof(header));
+    write(header, sizeof(header));
+
+    for (uint8_t type = 0; type < HEAP_TYPE_BLOCKS; type++) {
+        heap_get_frag_info(type, &frag);
+        heap_info[0] = heap_env_app.heap_size[type];
+        heap_info[1] = heap_env_app.heap_used[type];
+        heap_info[2] = heap_env_app.max_heap_used_single[type];
+        heap_info[3] = heap_env_app.algo[type];
+        heap_info[4] = frag.total_free;
+        heap_info[5] = frag.largest_free;
+        heap_info[6] = frag.free_blocks;
+        crc = crc32(crc, (const uint8_t *)heap_info, sizeof(heap_info));
+        write(heap_info, sizeof(heap_info));
+    }
+
+    // sites are never removed until reset, the first (count) used slots are sent
+    for (count = header[3] - 1; count > 0; count--) {
+        do {
+            GLOBAL_INT_DISABLE();
+            site = heap_prof_env.sites[index];
+            GLOBAL_INT_RESTORE();
+            index++;
+        } while ((site.return_addr == 0) && (index < HEAP_PROF_SITES));
+        crc = crc32(crc, (const uint8_t *)&site, sizeof(site));
+        write(&site, sizeof(site));
+    }
+
+    GLOBAL_INT_DISABLE();
+    site = heap_prof_env.overflow;
+    GLOBAL_INT_RESTORE();
+    crc = crc32(crc, (const uint8_t *)&site, sizeof(site));
+    write(&site, sizeof(site));
+
+    write(&crc, sizeof(crc));
+}
+#endif //HEAP_MEM_PROFILE
+
+#if HEAP_MEM_BENCHMARK
+#define HEAP_BENCH_SLOTS            64
+#define HEAP_BENCH_LOOPS            4000
+#define HEAP_BENCH_BUCKETS          16
+
+struct heap_bench_stat
+{
+    uint32_t count;
+    uint32_t total;
+    uint32_t max;
+    /// bucket n counts calls taking [2^n, 2^(n+1)) cycles
+    uint32_t hist[HEAP_BENCH_BUCKETS];
+};
+
+static uint32_t heap_bench_seed;
+
+static uint32_t heap_bench_rand(void)
+{
+    // xorshift32
+    heap_bench_seed ^= heap_bench_seed << 13;
+    heap_bench_seed ^= heap_bench_seed >> 17;
+    heap_bench_seed ^= heap_bench_seed << 5;
+
+    return heap_bench_seed;
+}
+
+static void heap_bench_record(struct heap_bench_stat *stat, uint32_t cycles)
+{
+    int bucket = cycles ? tlsf_fls(cycles) : 0;
+
+    if (bucket >= HEAP_BENCH_BUCKETS)
+    {
+        bucket = HEAP_BENCH_BUCKETS - 1;
+    }
+    stat->hist[bucket]++;
+    stat->count++;
+    stat->total += cycles;
+    if (stat->max < cycles)
+    {
+        stat->max = cycles;
+    }
+}
+
+static void heap_bench_report(const char *name, const struct heap_bench_stat *stat)
+{
+    printf("  %s: count %d, mean %d, max %d cycles\r\n", name, stat->count, stat->count ? stat->total / stat->count : 0, stat->max);
+    for (int i = 0; i < HEAP_BENCH_BUCKETS; i++)
+    {
+        if (stat->hist[i])
+        {
+            printf("    [%5d, %5d): %d\r\n", 1 << i, 1 << (i + 1), stat->hist[i]);
+        }
+    }
+}
+
+/// size of the next block to be allocated in each workload
+static uint32_t heap_bench_size(uint8_t workload)
+{
+    static const uint16_t audio_frames[] = {120, 240, 512, 1024};
+
+    switch (workload)
+    {
+        case 0:
+            // fifo: small messages
+            return 16 + (heap_bench_rand() % 240);
+        case 1:
+            // random: wide size range, random lifetime
+            return 8 + (heap_bench_rand() % 1016);
+        default:
+            // audio: codec frames mixed with small control messages
+            if (heap_bench_rand() & 1)
+            {
+                return audio_frames[heap_bench_rand() % 4];
+            }
+            return 16 + (heap_bench_rand() % 48);
+    }
+}
+
+static void heap_bench_run(uint8_t algo, uint8_t workload)
+{
+    static void *slots[HEAP_BENCH_SLOTS];
+    static uint32_t sizes[HEAP_BENCH_SLOTS];
+    static const char *workload_name[] = {"fifo", "random", "audio"};
+    struct heap_bench_stat alloc_stat, free_stat;
+    uint32_t live = 0, limit, head = 0, start, cycles;
+    uint32_t index, size;
+
+    memset((void *)&alloc_stat, 0, sizeof(alloc_stat));
+    memset((void *)&free_stat, 0, sizeof(free_stat));
+    memset((void *)slots, 0, sizeof(slots));
+    heap_bench_seed = 0x12345678;
+
+    heap_mem_init_ex(HEAP_TYPE_DRAM_BLOCK, (uint8_t *)ucHeap_dram, configTOTAL_DRAM_SIZE, algo);
+    // keep live data under 40% of the heap, failure of allocation is not recoverable
+    limit = configTOTAL_DRAM_SIZE * 2 / 5;
+
+    for (uint32_t loop = 0; loop < HEAP_BENCH_LOOPS; loop++)
+    {
+        if (workload == 0)
+        {
+            index = head++ % HEAP_BENCH_SLOTS;
+        }
+        else
+        {
+            index = heap_bench_rand() % HEAP_BENCH_SLOTS;
+        }
+        size = heap_bench_size(workload);
+
+        // release the slot, or the oldest ones when the limit is reached
+        while ((slots[index] != NULL) || ((live + size) > limit))
+        {
+            uint32_t victim = slots[index] ? index : (heap_bench_rand() % HEAP_BENCH_SLOTS);
+
+            if (slots[victim] == NULL)
+            {
+                continue;
+            }
+            start = DWT->CYCCNT;
+            heap_mem_free(slots[victim]);
+            cycles = DWT->CYCCNT - start;
+            heap_bench_record(&free_stat, cycles);
+            slots[victim] = NULL;
+            live -= sizes[victim];
+        }
+
+        start = DWT->CYCCNT;
+        slots[index] = heap_mem_alloc(HEAP_TYPE_DRAM_BLOCK, size);
+        cycles = DWT->CYCCNT - start;
+        heap_bench_record(&alloc_stat, cycles);
+        sizes[index] = size;
+        live += size;
+    }
+
+    for (index = 0; index < HEAP_BENCH_SLOTS; index++)
+    {
+        if (slots[index] != NULL)
+        {
+            heap_mem_free(slots[index]);
+        }
+    }
+
+    printf("%s %s:\r\n", algo == HEAP_ALGO_TLSF ? "tlsf" : "list", workload_name[workload]);
+    heap_bench_report("alloc", &alloc_stat);
+    heap_bench_report("free", &free_stat);
+}
+
+void heap_mem_benchmark(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (uint8_t workload = 0; workload < 3; workload++)
+    {
+        heap_bench_run(HEAP_ALGO_LIST, workload);
+        heap_bench_run(HEAP_ALGO_TLSF, workload);
+    }
+}
+#endif // HEAP_MEM_BENCHMARK
 
@@ -2,22 +2,81 @@
 #define __HEAP_H__
 
 #include <stdint.h>
+#include <stdbool.h>
+
+/// keep caller address in block descriptors and usage statistics
+#ifndef HEAP_MEM_DEBUG
+#define HEAP_MEM_DEBUG              1
+#endif
+
+/// aggregate live heap usage per allocation site, depends on HEAP_MEM_DEBUG
+#ifndef HEAP_MEM_PROFILE
+#define HEAP_MEM_PROFILE            0
+#endif
+
+#if HEAP_MEM_PROFILE && (HEAP_MEM_DEBUG == 0)
+#error "HEAP_MEM_PROFILE needs caller address kept by HEAP_MEM_DEBUG"
+#endif
 
 enum heap_type_t {
     HEAP_TYPE_SRAM_BLOCK,
     HEAP_TYPE_DRAM_BLOCK,
     HEAP_TYPE_BTDM_BLOCK,
+    HEAP_TYPE_PSRAM_BLOCK,
     HEAP_TYPE_BLOCKS,
 };
 
+enum heap_algo_t {
+    /// best fit from a sorted free list, alloc and free time grow with fragmentation
+    HEAP_ALGO_LIST,
+    /// two-level segregated fit, constant alloc and free time
+    HEAP_ALGO_TLSF,
+};
+
+enum heap_prof_kind_t {
+    /// block allocated by heap_mem_alloc
+    HEAP_PROF_KIND_HEAP,
+    /// object allocated from slab pages, the pages are counted as heap blocks
+    HEAP_PROF_KIND_SLAB,
+};
+
+typedef struct {
+    /// sum of all free blocks
+    uint32_t total_free;
+    /// the largest allocation can be served is a bit smaller than this
+    uint32_t largest_free;
+    uint32_t free_blocks;
+} heap_frag_info_t;
+
+/// used to send profiler snapshot, for example to a UART
+typedef void (*heap_prof_write_t)(const void *data, uint32_t length);
+
 void heap_mem_init(uint8_t type, uint8_t* heap, uint32_t heap_size);
+void heap_mem_init_ex(uint8_t type, uint8_t* heap, uint32_t heap_size, uint8_t algo);
 void *heap_mem_alloc(uint8_t type, uint32_t size);
+/// same as heap_mem_alloc, return_addr is kept as the owner of the block, used by
+/// allocators built on heap to report their callers
+void *heap_mem_alloc_lr(uint8_t type, uint32_t size, uint32_t return_addr);
+/// same as heap_mem_alloc_lr, NULL is returned instead of halting when the heap is
+/// exhausted or not initialized
+void *heap_mem_try_alloc(uint8_t type, uint32_t size, uint32_t return_addr);
 void heap_mem_free(void* mem_ptr);
+bool heap_mem_is_inited(uint8_t type);
 
 uint32_t heap_get_mem_usage(uint8_t type);
 uint32_t heap_get_mem_available(uint8_t type);
 uint32_t heap_get_max_mem_usage_single(uint8_t type);
 uint32_t heap_get_max_mem_usage(void);
 void heap_dump_used_mem(uint8_t type);
+void heap_get_frag_info(uint8_t type, heap_frag_info_t *info);
+
+/// add size into (or subtract from when size is negative) the site of return_addr,
+/// should be called with interrupt disabled
+void heap_prof_record(uint32_t return_addr, uint8_t kind, int32_t size);
+void heap_prof_reset(void);
+/// send a binary snapshot of all sites and heaps, parsed by tools/heap_prof.py
+void heap_prof_snapshot(heap_prof_write_t write);
+
+void heap_mem_benchmark(void);
 
 #endif  // __HEAP_H__
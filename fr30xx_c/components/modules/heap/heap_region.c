@@ -0,0 +1,204 @@
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "fr30xx.h"
+#include "heap.h"
+#include "heap_slab.h"
+#include "heap_region.h"
+
+/*
+ * MACRO DEFINITIONS
+ ****************************************************************************************
+ */
+/// regions are tried in tiers: with the preferred capability, without any preference
+/// capability, with the opposite one
+#define HEAP_REGION_TIERS           3
+
+/*
+ * LOCAL TYPE DEFINITIONS
+ ****************************************************************************************
+ */
+struct heap_region_env_tag
+{
+    heap_region_desc_t desc[HEAP_TYPE_BLOCKS];
+    uint32_t allocs[HEAP_TYPE_BLOCKS];
+    uint32_t fallback_allocs[HEAP_TYPE_BLOCKS];
+    uint32_t misses[HEAP_TYPE_BLOCKS];
+};
+
+/*
+ * LOCAL VARIABLE DEFINITIONS
+ ****************************************************************************************
+ */
+/// default description of each heap type, BTDM heap is only used by callers opting in
+static struct heap_region_env_tag heap_region_env = {
+    .desc = {
+        [HEAP_TYPE_SRAM_BLOCK] = {HEAP_CAP_DMA | HEAP_CAP_FAST, 0},
+        [HEAP_TYPE_DRAM_BLOCK] = {HEAP_CAP_DMA | HEAP_CAP_DSP, 0},
+        [HEAP_TYPE_BTDM_BLOCK] = {HEAP_CAP_DMA | HEAP_CAP_FAST | HEAP_CAP_OWNED, 8 * 1024},
+        [HEAP_TYPE_PSRAM_BLOCK] = {HEAP_CAP_BULK, 0},
+    },
+};
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+static uint8_t heap_region_tier(uint8_t caps, uint8_t prefer)
+{
+    uint8_t opposite = prefer ^ (HEAP_CAP_FAST | HEAP_CAP_BULK);
+
+    if (caps & prefer)
+    {
+        return 0;
+    }
+    else if ((caps & opposite) == 0)
+    {
+        return 1;
+    }
+    else
+    {
+        return 2;
+    }
+}
+
+static bool heap_region_has_room(uint8_t type, uint32_t size)
+{
+    uint32_t reserve = heap_region_env.desc[type].reserve;
+
+    if (reserve == 0)
+    {
+        return true;
+    }
+
+#if HEAP_MEM_DEBUG
+    return heap_get_mem_available(type) >= (reserve + size);
+#else
+    // usage is not tracked, keep the whole heap for its owner
+    return false;
+#endif
+}
+
+/*
+ * FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+void heap_region_add(uint8_t type, uint8_t *base, uint32_t size, uint8_t caps, uint32_t reserve)
+{
+    if (type >= HEAP_TYPE_BLOCKS)
+    {
+        return;
+    }
+
+    heap_region_env.desc[type].caps = caps;
+    heap_region_env.desc[type].reserve = reserve;
+    heap_mem_init(type, base, size);
+}
+
+void heap_region_set_desc(uint8_t type, const heap_region_desc_t *desc)
+{
+    if (type >= HEAP_TYPE_BLOCKS)
+    {
+        return;
+    }
+
+    heap_region_env.desc[type] = *desc;
+}
+
+__attribute__((noinline)) void *heap_region_alloc(uint32_t size, uint8_t hints)
+{
+    uint8_t required = hints & HEAP_CAP_REQUIRED;
+    uint8_t prefer = hints & (HEAP_CAP_FAST | HEAP_CAP_BULK);
+    uint8_t tiers = (hints & HEAP_HINT_STRICT) ? 1 : HEAP_REGION_TIERS;
+    uint8_t excluded = (hints & HEAP_HINT_OWNED) ? 0 : HEAP_CAP_OWNED;
+    void *ptr;
+
+#if HEAP_MEM_DEBUG
+    volatile uint32_t address;
+    __asm("MOV %[result], LR":[result] "=r" (address));
+#else
+    uint32_t address = 0;
+#endif
+
+    if ((prefer == 0) || (prefer == (HEAP_CAP_FAST | HEAP_CAP_BULK)))
+    {
+        prefer = (size > HEAP_REGION_BULK_SIZE) ? HEAP_CAP_BULK : HEAP_CAP_FAST;
+    }
+
+    for (uint8_t tier = 0; tier < tiers; tier++)
+    {
+        for (uint8_t type = 0; type < HEAP_TYPE_BLOCKS; type++)
+        {
+            uint8_t caps = heap_region_env.desc[type].caps;
+
+            if ((heap_mem_is_inited(type) == false)
+                    || (caps & excluded)
+                    || ((caps & required) != required)
+                    || (heap_region_tier(caps, prefer) != tier))
+            {
+                continue;
+            }
+
+            ptr = NULL;
+            if (heap_region_has_room(type, size))
+            {
+                ptr = heap_mem_try_alloc(type, size, address);
+            }
+            if (ptr != NULL)
+            {
+                heap_region_env.allocs[type]++;
+                if (tier)
+                {
+                    heap_region_env.fallback_allocs[type]++;
+                }
+                return ptr;
+            }
+            heap_region_env.misses[type]++;
+        }
+    }
+
+    return NULL;
+}
+
+void heap_region_free(void *ptr)
+{
+    // slab layer hands heap blocks over to heap_mem_free
+    heap_slab_free(ptr);
+}
+
+bool heap_region_get_stat(uint8_t type, heap_region_stat_t *stat)
+{
+    heap_frag_info_t frag;
+
+    if (type >= HEAP_TYPE_BLOCKS)
+    {
+        return false;
+    }
+
+    memset((void *)stat, 0, sizeof(heap_region_stat_t));
+
+    heap_get_frag_info(type, &frag);
+    stat->caps = heap_region_env.desc[type].caps;
+    stat->inited = heap_mem_is_inited(type);
+    stat->largest_free = frag.largest_free;
+    stat->allocs = heap_region_env.allocs[type];
+    stat->fallback_allocs = heap_region_env.fallback_allocs[type];
+    stat->misses = heap_region_env.misses[type];
+
+#if HEAP_MEM_DEBUG
+    if (stat->inited)
+    {
+        stat->used = heap_get_mem_usage(type);
+        stat->size = stat->used + heap_get_mem_available(type);
+        stat->max_used = heap_get_max_mem_usage_single(type);
+        stat->pressure = (uint8_t)((uint64_t)stat->used * 100 / stat->size);
+    }
+#endif
+
+    return true;
+}
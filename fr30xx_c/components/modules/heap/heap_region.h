@@ -0,0 +1,116 @@
+#ifndef __HEAP_REGION_H__
+#define __HEAP_REGION_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "heap.h"
+
+/*
+ * Placement aware allocation over all heaps. Each heap type is described by the
+ * capabilities of its memory, callers ask for capabilities and a preference
+ * instead of a heap, the allocation falls back to other regions when the preferred
+ * ones are exhausted. NULL is returned when no region can serve it, the system is
+ * never halted by this layer.
+ *
+ * Heaps owned by other modules (SRAM by pvPortMalloc, BTDM by btdm_malloc) are
+ * initialized by their owners and used by this layer once initialized. Other
+ * regions, such as PSRAM after it is enabled, are added by heap_region_add. BTDM
+ * heap halts the system when btdm_malloc fails, it is marked with HEAP_CAP_OWNED
+ * and skipped unless the caller opts in with HEAP_HINT_OWNED.
+ */
+
+/// memory can be accessed by DMA, required when set
+#define HEAP_CAP_DMA                0x01
+/// memory can be accessed by DSP, required when set
+#define HEAP_CAP_DSP                0x02
+/// zero wait state memory, preferred when set
+#define HEAP_CAP_FAST               0x04
+/// large and slow memory, preferred when set
+#define HEAP_CAP_BULK               0x08
+/// heap is owned by another module (BTDM by btdm_malloc), only used with HEAP_HINT_OWNED
+#define HEAP_CAP_OWNED              0x10
+/// regions with HEAP_CAP_OWNED can serve this allocation
+#define HEAP_HINT_OWNED             0x40
+/// do not fall back to regions without the preferred capability
+#define HEAP_HINT_STRICT            0x80
+
+#define HEAP_CAP_REQUIRED           (HEAP_CAP_DMA | HEAP_CAP_DSP)
+
+/// without FAST or BULK hint, allocations larger than this prefer BULK regions
+#define HEAP_REGION_BULK_SIZE       4096
+
+typedef struct {
+    /// HEAP_CAP_xxx
+    uint8_t caps;
+    /// free bytes kept for the owner of this heap, not used by this layer
+    uint32_t reserve;
+} heap_region_desc_t;
+
+typedef struct {
+    uint8_t caps;
+    bool inited;
+    uint32_t size;
+    uint32_t used;
+    uint32_t max_used;
+    uint32_t largest_free;
+    /// allocations served by this region
+    uint32_t allocs;
+    /// allocations served by this region when the preferred regions were exhausted
+    uint32_t fallback_allocs;
+    /// allocations this region was tried but could not serve
+    uint32_t misses;
+    /// used * 100 / size
+    uint8_t pressure;
+} heap_region_stat_t;
+
+/************************************************************************************
+ * @fn      heap_region_add
+ *
+ * @brief   initialize a heap and add it as a region, for example PSRAM after it is enabled.
+ *
+ * @param   type: heap type used by this region, @ref heap_type_t.
+ * @param   base: start address of the memory.
+ * @param   size: size of the memory.
+ * @param   caps: capabilities of the memory, HEAP_CAP_xxx.
+ * @param   reserve: free bytes kept for callers using heap_mem_alloc on this type directly.
+ */
+void heap_region_add(uint8_t type, uint8_t *base, uint32_t size, uint8_t caps, uint32_t reserve);
+
+/************************************************************************************
+ * @fn      heap_region_set_desc
+ *
+ * @brief   change capabilities and reserve of a region.
+ */
+void heap_region_set_desc(uint8_t type, const heap_region_desc_t *desc);
+
+/************************************************************************************
+ * @fn      heap_region_alloc
+ *
+ * @brief   allocate memory from the most suitable region.
+ *
+ * @param   size: wanted size.
+ * @param   hints: required capabilities (HEAP_CAP_DMA, HEAP_CAP_DSP) and preference
+ *                 (HEAP_CAP_FAST or HEAP_CAP_BULK, HEAP_HINT_STRICT, HEAP_HINT_OWNED).
+ *
+ * @return  allocated memory, NULL will be returned when no region can serve it.
+ */
+void *heap_region_alloc(uint32_t size, uint8_t hints);
+
+/************************************************************************************
+ * @fn      heap_region_free
+ *
+ * @brief   release memory allocated by heap_region_alloc, pvPortMalloc or heap_mem_alloc.
+ */
+void heap_region_free(void *ptr);
+
+/************************************************************************************
+ * @fn      heap_region_get_stat
+ *
+ * @brief   get usage and pressure of a region.
+ *
+ * @return  false when type is invalid.
+ */
+bool heap_region_get_stat(uint8_t type, heap_region_stat_t *stat);
+
+#endif  // __HEAP_REGION_H__
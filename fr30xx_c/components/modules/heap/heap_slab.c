@@ -0,0 +1,336 @@
+/*
+ * INCLUDE FILES
+ ****************************************************************************************
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "fr30xx.h"
+#include "heap.h"
+#include "heap_slab.h"
+
+/*
+ * MACRO DEFINITIONS
+ ****************************************************************************************
+ */
+/// set to 0 to send all allocations to heap_mem_alloc
+#define HEAP_SLAB_ENABLE            1
+
+/// Pattern used to check if an object is not corrupted
+#define HEAP_SLAB_PATTERN           (0x5CA55CA5)
+#define HEAP_SLAB_FREE_PATTERN      (0xC55CC55C)
+
+/// empty pages kept by each class to avoid taking and releasing pages repeatedly
+#define HEAP_SLAB_KEEP_EMPTY        1
+
+/*
+ * LOCAL TYPE DEFINITIONS
+ ****************************************************************************************
+ */
+struct heap_slab_page;
+
+/// Object descriptor, the layout is the same as the used block descriptor in heap.c,
+/// so heap_slab_free can tell objects from heap blocks by corrupt_check.
+struct heap_slab_obj
+{
+    /// HEAP_SLAB_PATTERN when used, HEAP_SLAB_FREE_PATTERN when free
+    uint32_t corrupt_check;
+    /// page of this object when used, next free object in the page when free
+    void *link;
+
+#if HEAP_MEM_DEBUG
+    uint32_t return_addr;
+#endif
+};
+
+struct heap_slab_class;
+
+/// Page header, objects are stored after it
+struct heap_slab_page
+{
+    /// link in partial list of the class
+    struct heap_slab_page *next;
+    struct heap_slab_page *previous;
+    struct heap_slab_class *cls;
+    struct heap_slab_obj *free_list;
+    uint8_t used;
+    uint8_t count;
+};
+
+struct heap_slab_class
+{
+    /// pages with free objects
+    struct heap_slab_page *partial;
+    /// pages without used objects
+    uint16_t empty_pages;
+    heap_slab_stat_t stat;
+};
+
+struct heap_slab_env_tag
+{
+    struct heap_slab_class cls[HEAP_TYPE_BLOCKS][HEAP_SLAB_CLASSES];
+    uint32_t large[HEAP_TYPE_BLOCKS];
+};
+
+/*
+ * LOCAL VARIABLE DEFINITIONS
+ ****************************************************************************************
+ */
+/// object size and objects per page of each class
+static const uint16_t heap_slab_class_size[HEAP_SLAB_CLASSES] = {16, 32, 48, 64, 96, 128, 192, 256};
+static const uint8_t heap_slab_class_count[HEAP_SLAB_CLASSES] = {16, 16, 12, 12, 8, 8, 6, 4};
+/// class of each size, index is ((size + 15) >> 4)
+static const uint8_t heap_slab_size_map[(HEAP_SLAB_SIZE_MAX >> 4) + 1] = {
+    0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7,
+};
+
+static struct heap_slab_env_tag heap_slab_env;
+
+/*
+ * LOCAL FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+static void heap_slab_partial_push(struct heap_slab_class *cls, struct heap_slab_page *page)
+{
+    page->previous = NULL;
+    page->next = cls->partial;
+    if (page->next != NULL)
+    {
+        page->next->previous = page;
+    }
+    cls->partial = page;
+}
+
+static void heap_slab_partial_remove(struct heap_slab_class *cls, struct heap_slab_page *page)
+{
+    if (page->next != NULL)
+    {
+        page->next->previous = page->previous;
+    }
+    if (page->previous != NULL)
+    {
+        page->previous->next = page->next;
+    }
+    else
+    {
+        cls->partial = page->next;
+    }
+}
+
+/**
+ * Take an object from the first partial page, should be called with interrupt disabled.
+ */
+static struct heap_slab_obj *heap_slab_take(struct heap_slab_class *cls)
+{
+    struct heap_slab_page *page = cls->partial;
+    struct heap_slab_obj *obj;
+
+    obj = page->free_list;
+    page->free_list = obj->link;
+    if (page->used++ == 0)
+    {
+        cls->empty_pages--;
+    }
+    if (page->free_list == NULL)
+    {
+        heap_slab_partial_remove(cls, page);
+    }
+
+    obj->corrupt_check = HEAP_SLAB_PATTERN;
+    obj->link = page;
+
+    cls->stat.used++;
+    if (cls->stat.high_water < cls->stat.used)
+    {
+        cls->stat.high_water = cls->stat.used;
+    }
+
+    return obj;
+}
+
+/**
+ * Get a page from heap and split it into objects.
+ */
+static struct heap_slab_page *heap_slab_page_create(uint8_t type, struct heap_slab_class *cls, uint8_t index)
+{
+    struct heap_slab_page *page;
+    struct heap_slab_obj *obj;
+    uint32_t stride = sizeof(struct heap_slab_obj) + heap_slab_class_size[index];
+    uint8_t count = heap_slab_class_count[index];
+
+    page = heap_mem_alloc(type, sizeof(struct heap_slab_page) + stride * count);
+    if (page == NULL)
+    {
+        return NULL;
+    }
+
+    page->cls = cls;
+    page->used = 0;
+    page->count = count;
+    page->free_list = NULL;
+    obj = (struct heap_slab_obj *)(page + 1);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        obj->corrupt_check = HEAP_SLAB_FREE_PATTERN;
+        obj->link = page->free_list;
+        page->free_list = obj;
+        obj = (struct heap_slab_obj *)((uint32_t)obj + stride);
+    }
+
+    return page;
+}
+
+/*
+ * FUNCTION DEFINITIONS
+ ****************************************************************************************
+ */
+__RAM_CODE __attribute__((noinline)) void *heap_slab_alloc(uint8_t type, uint32_t size)
+{
+    struct heap_slab_class *cls;
+    struct heap_slab_page *page;
+    struct heap_slab_obj *obj = NULL;
+    uint8_t index;
+
+#if HEAP_MEM_DEBUG
+    volatile uint32_t address;
+    __asm("MOV %[result], LR":[result] "=r" (address));
+#endif
+
+    if ((HEAP_SLAB_ENABLE == 0) || (size > HEAP_SLAB_SIZE_MAX))
+    {
+        heap_slab_env.large[type]++;
+#if HEAP_MEM_DEBUG
+        return heap_mem_alloc_lr(type, size, address);
+#else
+        return heap_mem_alloc(type, size);
+#endif
+    }
+
+    index = heap_slab_size_map[(size + 15) >> 4];
+    cls = &heap_slab_env.cls[type][index];
+
+    GLOBAL_INT_DISABLE();
+    if (cls->partial != NULL)
+    {
+        obj = heap_slab_take(cls);
+        cls->stat.hit++;
+#if HEAP_MEM_PROFILE
+        heap_prof_record(address, HEAP_PROF_KIND_SLAB, sizeof(struct heap_slab_obj) + cls->stat.size);
+#endif
+    }
+    GLOBAL_INT_RESTORE();
+
+    if (obj == NULL)
+    {
+        // all pages are full, heap_mem_alloc protects itself
+        page = heap_slab_page_create(type, cls, index);
+        if (page == NULL)
+        {
+            return NULL;
+        }
+
+        GLOBAL_INT_DISABLE();
+        cls->stat.size = heap_slab_class_size[index];
+        cls->stat.pages++;
+        cls->stat.miss++;
+        cls->empty_pages++;
+        heap_slab_partial_push(cls, page);
+        obj = heap_slab_take(cls);
+#if HEAP_MEM_PROFILE
+        heap_prof_record(address, HEAP_PROF_KIND_SLAB, sizeof(struct heap_slab_obj) + cls->stat.size);
+#endif
+        GLOBAL_INT_RESTORE();
+    }
+
+#if HEAP_MEM_DEBUG
+    obj->return_addr = address;
+#endif
+
+    return (void *)(obj + 1);
+}
+
+__RAM_CODE __attribute__((noinline)) void heap_slab_free(void *mem_ptr)
+{
+    struct heap_slab_obj *obj;
+    struct heap_slab_page *page, *release = NULL;
+    struct heap_slab_class *cls;
+
+    if (mem_ptr == NULL)
+    {
+        return;
+    }
+
+    obj = ((struct heap_slab_obj *)mem_ptr) - 1;
+    if (obj->corrupt_check != HEAP_SLAB_PATTERN)
+    {
+        // allocated by heap_mem_alloc, or freed twice which is checked by heap_mem_free
+        heap_mem_free(mem_ptr);
+        return;
+    }
+
+    GLOBAL_INT_DISABLE();
+
+    page = obj->link;
+    cls = page->cls;
+
+#if HEAP_MEM_PROFILE
+    heap_prof_record(obj->return_addr, HEAP_PROF_KIND_SLAB, -(int32_t)(sizeof(struct heap_slab_obj) + cls->stat.size));
+#endif
+
+    obj->corrupt_check = HEAP_SLAB_FREE_PATTERN;
+    obj->link = page->free_list;
+    page->free_list = obj;
+    if (page->used == page->count)
+    {
+        // page was full
+        heap_slab_partial_push(cls, page);
+    }
+    cls->stat.used--;
+
+    if (--page->used == 0)
+    {
+        if (cls->empty_pages >= HEAP_SLAB_KEEP_EMPTY)
+        {
+            heap_slab_partial_remove(cls, page);
+            cls->stat.pages--;
+            release = page;
+        }
+        else
+        {
+            cls->empty_pages++;
+        }
+    }
+
+    GLOBAL_INT_RESTORE();
+
+    if (release != NULL)
+    {
+        heap_mem_free(release);
+    }
+}
+
+bool heap_slab_get_stat(uint8_t type, uint8_t cls, heap_slab_stat_t *stat)
+{
+    if ((type >= HEAP_TYPE_BLOCKS) || (cls >= HEAP_SLAB_CLASSES))
+    {
+        return false;
+    }
+
+    GLOBAL_INT_DISABLE();
+    *stat = heap_slab_env.cls[type][cls].stat;
+    GLOBAL_INT_RESTORE();
+    stat->size = heap_slab_class_size[cls];
+
+    return true;
+}
+
+uint32_t heap_slab_get_large_count(uint8_t type)
+{
+    if (type >= HEAP_TYPE_BLOCKS)
+    {
+        return 0;
+    }
+
+    return heap_slab_env.large[type];
+}
@@ -0,0 +1,47 @@
+#ifndef __HEAP_SLAB_H__
+#define __HEAP_SLAB_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "heap.h"
+
+/*
+ * Small allocations are served from per size class free lists. Each class takes
+ * pages from heap_mem_alloc, a page is split into objects of the same size and
+ * given back to the heap when it becomes empty. Allocations larger than the
+ * largest class go to heap_mem_alloc directly. heap_slab_free accepts memory
+ * from both heap_slab_alloc and heap_mem_alloc.
+ * Both functions can be called from interrupt, a new page is only requested from
+ * the heap when all pages of the class are full.
+ */
+
+/// number of size classes
+#define HEAP_SLAB_CLASSES           8
+/// the largest allocation served by size classes
+#define HEAP_SLAB_SIZE_MAX          256
+
+typedef struct {
+    /// object size of this class
+    uint16_t size;
+    /// allocations served by a free object
+    uint32_t hit;
+    /// allocations needed a new page
+    uint32_t miss;
+    /// objects in use
+    uint32_t used;
+    /// the maximum objects in use
+    uint32_t high_water;
+    /// pages taken from heap
+    uint16_t pages;
+} heap_slab_stat_t;
+
+void *heap_slab_alloc(uint8_t type, uint32_t size);
+void heap_slab_free(void *mem_ptr);
+
+/// statistics of one size class, false will be returned when cls is invalid
+bool heap_slab_get_stat(uint8_t type, uint8_t cls, heap_slab_stat_t *stat);
+/// number of allocations larger than HEAP_SLAB_SIZE_MAX
+uint32_t heap_slab_get_large_count(uint8_t type);
+
+#endif  // __HEAP_SLAB_H__
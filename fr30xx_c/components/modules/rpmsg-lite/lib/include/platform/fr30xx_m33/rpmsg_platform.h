@@ -41,6 +41,10 @@ int32_t platform_interrupt_disable(uint32_t vector_id);
 int32_t platform_in_isr(void);
 void platform_notify(uint32_t vector_id);
 
+/* doorbell of shared memory streams */
+void platform_doorbell_register(void (*handler)(uint32_t msg));
+void platform_doorbell_ring(uint32_t msg);
+
 /* platform low-level time-delay (busy loop) */
 void platform_time_delay(uint32_t num_msec);
 
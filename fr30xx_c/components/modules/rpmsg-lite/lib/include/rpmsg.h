@@ -12,6 +12,7 @@
 #define RPMSG_MSG_TYPE_SYNC_INVOKE          0x00000003
 #define RPMSG_MSG_TYPE_SYNC_RETURN          0x00000004
 #define RPMSG_MSG_TYPE_ASYNC_MSG            0x00000005
+#define RPMSG_MSG_TYPE_SYNC_RETURN_ID       0x00000006  // return of synchronous invocation tagged with request ID
 
 #define RPMSG_SYNC_FUNC_MSG(type, sub_type) (((type)<<16) | (sub_type))
 #define RPSMG_SYNC_FUNC_TYPE(func_id)       ((func_id)>>16)
@@ -25,6 +26,21 @@
 
 #define RPMSG_SYNC_FUNC_SUM                 RPMSG_SYNC_FUNC_MSG(RPMSG_SYNC_FUNC_TYPE_TEST, 0x0001)
 
+/* priority lanes of invocation, requests in high lane are handled before those in low lane */
+#define RPMSG_INVOKE_LANE_HIGH              0   // real-time audio path
+#define RPMSG_INVOKE_LANE_LOW               1   // housekeeping, such as memory usage, cpu usage, etc.
+#define RPMSG_INVOKE_LANE_NUM               2
+
+/* maximum outstanding invocations, each of them holds a buffer in share memory */
+#define RPMSG_INVOKE_MAX_PENDING            RL_BUFFER_COUNT
+/* invocation slots can only be used by high lane */
+#define RPMSG_INVOKE_HIGH_LANE_RSV          1
+
+/* status returned by rpmsg_invoke_wait when no response is received before timeout */
+#define RPMSG_INVOKE_STATUS_TIMEOUT         0xffffffff
+/* status sent back by the other side when func_id is not supported by its image */
+#define RPMSG_INVOKE_STATUS_UNKNOWN_FUNC    0xfffffffe
+
 /** @addtogroup rpmsg syncronize invoke message definations
   * @{
   */
@@ -58,24 +74,37 @@ struct rpmsg_msg_t {
         struct {
             uint32_t func_id;
             void *param;
+            /* request ID, should be returned with RPMSG_MSG_TYPE_SYNC_RETURN_ID */
+            uint32_t req_id;
+            uint8_t lane;
         } sync_func;
 
         struct {
             uint32_t status;
             uint32_t result;
+            /* only valid in message with type RPMSG_MSG_TYPE_SYNC_RETURN_ID */
+            uint32_t req_id;
         } sync_ret;
 
         struct rpmsg_async_msg_t async_msg;
     } p;
 };
 
+struct rpmsg_invoke;
+
+/* called in interrupt context when response of an asynchronous invocation is received */
+typedef void (*rpmsg_invoke_cb_t)(struct rpmsg_invoke *invoke, uint32_t status, uint32_t result, void *arg);
+
 /*-----------------------------------------------------------------------------------*/
 /* Exported functions ---------------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
 
 uint32_t rpmsg_sync_invoke(struct rpmsg_lite_instance *rpmsg, uint32_t func_id, void *param, uint32_t *ret);
+struct rpmsg_invoke *rpmsg_invoke_async(struct rpmsg_lite_instance *rpmsg, uint8_t lane, uint32_t func_id, void *param, rpmsg_invoke_cb_t callback, void *arg);
+uint32_t rpmsg_invoke_wait(struct rpmsg_invoke *invoke, uint32_t timeout, uint32_t *ret);
 uint32_t rpmsg_send_async(struct rpmsg_lite_instance *rpmsg, struct rpmsg_async_msg_t *async_msg);
 uint32_t rpmsg_send_sync_ret(struct rpmsg_lite_instance *rpmsg, uint32_t status, uint32_t ret);
+uint32_t rpmsg_send_sync_ret_id(struct rpmsg_lite_instance *rpmsg, uint32_t req_id, uint32_t status, uint32_t ret);
 
 struct rpmsg_lite_instance *rpmsg_master_init(void (*recv)(struct rpmsg_lite_instance *rpmsg, struct rpmsg_msg_t *msg));
 void rpmsg_master_recover(struct rpmsg_lite_instance *rpmsg);
@@ -84,6 +113,7 @@ void rpmsg_wait_master_ready(struct rpmsg_lite_instance *rpmsg);
 void rpmsg_destroy(struct rpmsg_lite_instance *rpmsg);
 
 uint32_t rpmsg_recv_msg(struct rpmsg_lite_instance *rpmsg, struct rpmsg_msg_t **msg, uint32_t *msg_len);
+uint32_t rpmsg_recv_msg_prio(struct rpmsg_lite_instance *rpmsg, struct rpmsg_msg_t **msg, uint32_t *msg_len);
 
 struct rpmsg_lite_instance *rpmsg_get_remote_instance(void);
 struct rpmsg_lite_instance *rpmsg_get_master_instance(void);
@@ -26,6 +26,9 @@ static int32_t isr_counter     = 0;
 static int32_t disable_counter = 0;
 static void *platform_lock;
 
+/* channel 2 is used as doorbell of shared memory streams, message is a bit mask of ring IDs */
+static void (*doorbell_handler)(uint32_t msg) = NULL;
+
 static void platform_global_isr_disable(void)
 {
     __asm volatile("cpsid i");
@@ -228,6 +231,11 @@ static void ipc_mcu_rx(struct __IPC_HandleTypeDef *hipc, enum_IPC_Chl_Sel_t ch,
     else if (ch == IPC_CH_1) {
         env_isr(1);
     }
+    else if (ch == IPC_CH_2) {
+        if (doorbell_handler) {
+            doorbell_handler(msg);
+        }
+    }
 }
 
 static void ipc_mcu_tx(struct __IPC_HandleTypeDef *hipc, enum_IPC_Chl_Sel_t ch)
@@ -240,6 +248,32 @@ void ipc_mcu_irq(void)
     ipc_IRQHandler(&ipc_mcu);
 }
 
+/**
+ * platform_doorbell_register
+ *
+ * Register handler of doorbell notification from DSP, the handler is called in interrupt.
+ *
+ * @param handler Doorbell handler, message is a bit mask of ring IDs.
+ */
+void platform_doorbell_register(void (*handler)(uint32_t msg))
+{
+    doorbell_handler = handler;
+}
+
+/**
+ * platform_doorbell_ring
+ *
+ * Send doorbell notification to DSP, should be called in task context.
+ *
+ * @param msg Bit mask of ring IDs.
+ */
+void platform_doorbell_ring(uint32_t msg)
+{
+    env_lock_mutex(platform_lock);
+    ipc_msg_send(&ipc_mcu, IPC_CH_2, msg);
+    env_unlock_mutex(platform_lock);
+}
+
 /**
  * platform_init
  *
@@ -249,8 +283,8 @@ int32_t platform_init(void)
 {
     __SYSTEM_APP_IPC_CLK_ENABLE();
     ipc_mcu.IPCx = IPC_MCU;
-    ipc_mcu.RxEnableChannels = IPC_CH_0 | IPC_CH_1;
-    ipc_mcu.TxEnableChannels = IPC_CH_0 | IPC_CH_1;
+    ipc_mcu.RxEnableChannels = IPC_CH_0 | IPC_CH_1 | IPC_CH_2;
+    ipc_mcu.TxEnableChannels = IPC_CH_0 | IPC_CH_1 | IPC_CH_2;
     ipc_mcu.RxCallback = ipc_mcu_rx;
     ipc_mcu.TxCallback = ipc_mcu_tx;
     ipc_init(&ipc_mcu);
@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <assert.h>
 
@@ -31,59 +32,332 @@ static struct rpmsg_lite_endpoint *ept_async = NULL;
 static struct rpmsg_lite_instance *remote_rpmsg = NULL;
 static struct rpmsg_lite_instance *master_rpmsg = NULL;
 
-static LOCK *ept_sync_lock;
-
 static void (*msg_callback)(struct rpmsg_lite_instance *rpmsg, struct rpmsg_msg_t *msg) = NULL;
 
+struct rpmsg_invoke_ret {
+    uint32_t status;
+    uint32_t result;
+};
+
+struct rpmsg_invoke {
+    /* 0: this slot is free */
+    uint32_t req_id;
+    uint8_t lane;
+    /* the waiter has given up, slot should be freed when response is received */
+    uint8_t abandoned;
+    rpmsg_invoke_cb_t callback;
+    void *arg;
+    /* used to deliver response to waiter, @ref struct rpmsg_invoke_ret */
+    void *ret_queue;
+};
+
+static struct rpmsg_invoke invoke_pool[RPMSG_INVOKE_MAX_PENDING];
+/* free slots for each lane, low lane takes slot from both of them */
+static LOCK *invoke_slots[RPMSG_INVOKE_LANE_NUM];
+static uint32_t invoke_req_id = 0;
+static uint32_t invoke_pending = 0;
+/* set by rpmsg_destroy, no new invocation is started */
+static volatile bool invoke_closing = false;
+/* callers inside rpmsg_invoke_async */
+static volatile uint32_t invoke_entering = 0;
+
+/* messages received by rpmsg_recv_msg_prio and not handled yet */
+static struct {
+    struct rpmsg_msg_t *msg;
+    uint32_t msg_len;
+    uint32_t src_addr;
+} recv_stash[RL_BUFFER_COUNT];
+static uint8_t recv_stash_cnt = 0;
+
+static void rpmsg_invoke_pool_init(void)
+{
+    for (uint32_t i=0; i<RPMSG_INVOKE_MAX_PENDING; i++) {
+        invoke_pool[i].req_id = 0;
+        if (invoke_pool[i].ret_queue == NULL) {
+            env_create_queue(&invoke_pool[i].ret_queue, 1, sizeof(struct rpmsg_invoke_ret));
+        }
+    }
+    env_create_mutex((void **)&invoke_slots[RPMSG_INVOKE_LANE_HIGH], RPMSG_INVOKE_MAX_PENDING);
+    env_create_mutex((void **)&invoke_slots[RPMSG_INVOKE_LANE_LOW], RPMSG_INVOKE_MAX_PENDING - RPMSG_INVOKE_HIGH_LANE_RSV);
+    invoke_pending = 0;
+    invoke_closing = false;
+}
+
+/* wait for all invocations to be completed, new ones are refused from now on */
+static void rpmsg_invoke_pool_drain(void)
+{
+    invoke_closing = true;
+
+    /*
+     * callers blocked for a slot get one when an invocation is completed, then give it
+     * back and return. Wait for them before taking the slots, a low lane caller holding
+     * a low lane slot would wait for a high lane slot forever.
+     */
+    while (invoke_entering) {
+        env_sleep_msec(1);
+    }
+
+    /* every pending invocation holds a high lane slot */
+    for (uint32_t i=0; i<RPMSG_INVOKE_MAX_PENDING; i++) {
+        env_lock_mutex(invoke_slots[RPMSG_INVOKE_LANE_HIGH]);
+    }
+}
+
+static void rpmsg_invoke_pool_deinit(void)
+{
+    for (uint32_t i=0; i<RPMSG_INVOKE_LANE_NUM; i++) {
+        env_delete_mutex(invoke_slots[i]);
+        invoke_slots[i] = ((void *)0);
+    }
+}
+
+static void rpmsg_invoke_free(struct rpmsg_invoke *invoke)
+{
+    uint8_t lane = invoke->lane;
+
+    GLOBAL_INT_DISABLE();
+    invoke->req_id = 0;
+    invoke_pending--;
+    if (invoke_pending == 0) {
+        system_prevent_sleep_clear(SYSTEM_PREVENT_SLEEP_TYPE_DSP);
+    }
+    GLOBAL_INT_RESTORE();
+
+    env_unlock_mutex(invoke_slots[RPMSG_INVOKE_LANE_HIGH]);
+    if (lane == RPMSG_INVOKE_LANE_LOW) {
+        env_unlock_mutex(invoke_slots[RPMSG_INVOKE_LANE_LOW]);
+    }
+}
+
+/* called in interrupt context when a message is received from sync endpoint */
+static int32_t rpmsg_sync_rx_cb(void *payload, uint32_t payload_len, uint32_t src, void *priv)
+{
+    struct rpmsg_msg_t *msg = payload;
+    struct rpmsg_invoke *invoke = NULL;
+    struct rpmsg_invoke_ret ret;
+
+    if ((msg->msg_type != RPMSG_MSG_TYPE_SYNC_RETURN)
+        && (msg->msg_type != RPMSG_MSG_TYPE_SYNC_RETURN_ID)) {
+        return rpmsg_queue_rx_cb(payload, payload_len, src, priv);
+    }
+
+    GLOBAL_INT_DISABLE();
+    for (uint32_t i=0; i<RPMSG_INVOKE_MAX_PENDING; i++) {
+        struct rpmsg_invoke *tmp = &invoke_pool[i];
+        if (tmp->req_id == 0) {
+            continue;
+        }
+        if (msg->msg_type == RPMSG_MSG_TYPE_SYNC_RETURN_ID) {
+            if (tmp->req_id == msg->p.sync_ret.req_id) {
+                invoke = tmp;
+                break;
+            }
+        }
+        else {
+            /* untagged return from the other side, requests are handled in order */
+            if ((invoke == NULL) || ((int32_t)(tmp->req_id - invoke->req_id) < 0)) {
+                invoke = tmp;
+            }
+        }
+    }
+    GLOBAL_INT_RESTORE();
+
+    if (invoke == NULL) {
+        return RL_RELEASE;
+    }
+
+    ret.status = msg->p.sync_ret.status;
+    ret.result = msg->p.sync_ret.result;
+    if (invoke->callback) {
+        invoke->callback(invoke, ret.status, ret.result, invoke->arg);
+        rpmsg_invoke_free(invoke);
+    }
+    else if (invoke->abandoned) {
+        rpmsg_invoke_free(invoke);
+    }
+    else {
+        env_put_queue(invoke->ret_queue, &ret, 0);
+    }
+
+    return RL_RELEASE;
+}
+
 /************************************************************************************
- * @fn      rpmsg_sync_invoke
+ * @fn      rpmsg_invoke_async
  *
- * @brief   Start synchronous invocation to the other side.
+ * @brief   Start asynchronous invocation to the other side. Each request is tagged with
+ *          an ID, up to RPMSG_INVOKE_MAX_PENDING requests can be outstanding at the same
+ *          time. This function is blocked when no slot is available for the lane.
  *
  * @param   rpmsg: rpmsg instance.
+ * @param   lane: priority lane, @ref RPMSG_INVOKE_LANE_HIGH.
  * @param   func_id: request function ID.
  * @param   param: all parameters.
- * @param   ret: return value.
+ * @param   callback: called in interrupt context when response is received. NULL: caller
+ *                    should use rpmsg_invoke_wait to get the response.
+ * @param   arg: parameter of callback.
  *
- * @return  the function is handled by the other side normally or note
+ * @return  completion handle, NULL will be returned when failed. When callback is set,
+ *          the handle is released after callback is called.
  */
-uint32_t rpmsg_sync_invoke(struct rpmsg_lite_instance *rpmsg, uint32_t func_id, void *param, uint32_t *ret)
+struct rpmsg_invoke *rpmsg_invoke_async(struct rpmsg_lite_instance *rpmsg, uint8_t lane, uint32_t func_id, void *param, rpmsg_invoke_cb_t callback, void *arg)
 {
+    struct rpmsg_invoke *invoke = NULL;
     struct rpmsg_msg_t *msg;
     uint32_t msg_len;
-    uint32_t src_addr;
-    uint32_t status;
-    int32_t remote_call_ret;
-    
-    if (rpmsg == NULL) {
-        return -1;
+    uint32_t req_id;
+    bool closing;
+
+    if ((rpmsg == NULL) || (lane >= RPMSG_INVOKE_LANE_NUM)) {
+        return NULL;
     }
 
-    env_lock_mutex(ept_sync_lock);
-    system_prevent_sleep_set(SYSTEM_PREVENT_SLEEP_TYPE_DSP);
-    
+    GLOBAL_INT_DISABLE();
+    closing = invoke_closing;
+    if (closing == false) {
+        invoke_entering++;
+    }
+    GLOBAL_INT_RESTORE();
+    if (closing) {
+        return NULL;
+    }
+
+    /* low lane can not use the slots reserved for high lane */
+    if (lane == RPMSG_INVOKE_LANE_LOW) {
+        env_lock_mutex(invoke_slots[RPMSG_INVOKE_LANE_LOW]);
+    }
+    env_lock_mutex(invoke_slots[RPMSG_INVOKE_LANE_HIGH]);
+
+    GLOBAL_INT_DISABLE();
+    invoke_entering--;
+    closing = invoke_closing;
+    GLOBAL_INT_RESTORE();
+    if (closing) {
+        env_unlock_mutex(invoke_slots[RPMSG_INVOKE_LANE_HIGH]);
+        if (lane == RPMSG_INVOKE_LANE_LOW) {
+            env_unlock_mutex(invoke_slots[RPMSG_INVOKE_LANE_LOW]);
+        }
+        return NULL;
+    }
+
+    /* the slot taken above keeps rpmsg_destroy waiting for this invocation */
+    GLOBAL_INT_DISABLE();
+    for (uint32_t i=0; i<RPMSG_INVOKE_MAX_PENDING; i++) {
+        if (invoke_pool[i].req_id == 0) {
+            invoke = &invoke_pool[i];
+            break;
+        }
+    }
+    invoke_req_id++;
+    if (invoke_req_id == 0) {
+        invoke_req_id++;
+    }
+    req_id = invoke_req_id;
+    invoke->req_id = req_id;
+    invoke->lane = lane;
+    invoke->abandoned = false;
+    invoke->callback = callback;
+    invoke->arg = arg;
+    if (invoke_pending == 0) {
+        system_prevent_sleep_set(SYSTEM_PREVENT_SLEEP_TYPE_DSP);
+    }
+    invoke_pending++;
+    GLOBAL_INT_RESTORE();
+
     msg = rpmsg_lite_alloc_tx_buffer(rpmsg, &msg_len, RL_BLOCK);
-    
+
     msg->msg_type = RPMSG_MSG_TYPE_SYNC_INVOKE;
     msg->p.sync_func.func_id = func_id;
     msg->p.sync_func.param = param;
-    
-//    fputc('S', NULL);
+    msg->p.sync_func.req_id = req_id;
+    msg->p.sync_func.lane = lane;
+
     rpmsg_lite_send_nocopy(rpmsg, ept_async, EPT_ADDR_ASYNC, msg, msg_len);
-    remote_call_ret = rpmsg_queue_recv_nocopy(rpmsg, queue_sync, (uint32_t *)&src_addr, (char **)&msg, &msg_len, 1000);
-    assert(RL_SUCCESS == remote_call_ret);
-//    fputc('s', NULL);
+
+    return invoke;
+}
+
+/************************************************************************************
+ * @fn      rpmsg_invoke_wait
+ *
+ * @brief   Wait for response of an asynchronous invocation started without callback. The
+ *          handle is released after this function returns, except timeout happens. In that
+ *          case the handle is released when response is received.
+ *
+ * @param   invoke: handle returned by rpmsg_invoke_async.
+ * @param   timeout: timeout in ms, RL_BLOCK: wait forever.
+ * @param   ret: return value.
+ *
+ * @return  the function is handled by the other side normally or not,
+ *          RPMSG_INVOKE_STATUS_TIMEOUT: no response is received before timeout.
+ */
+uint32_t rpmsg_invoke_wait(struct rpmsg_invoke *invoke, uint32_t timeout, uint32_t *ret)
+{
+    struct rpmsg_invoke_ret invoke_ret;
+    bool received = true;
+
+    if (env_get_queue(invoke->ret_queue, &invoke_ret, timeout) == 0) {
+        GLOBAL_INT_DISABLE();
+        /* check again in case response is received just now */
+        if (env_get_queue(invoke->ret_queue, &invoke_ret, 0) == 0) {
+            invoke->abandoned = true;
+            received = false;
+        }
+        GLOBAL_INT_RESTORE();
+    }
+
+    if (received == false) {
+        return RPMSG_INVOKE_STATUS_TIMEOUT;
+    }
 
     if (ret) {
-        *ret = msg->p.sync_ret.result;
+        *ret = invoke_ret.result;
     }
-    status = msg->p.sync_ret.status;
+    rpmsg_invoke_free(invoke);
+
+    return invoke_ret.status;
+}
+
+/************************************************************************************
+ * @fn      rpmsg_sync_invoke
+ *
+ * @brief   Start synchronous invocation to the other side. The invocation is sent in
+ *          high lane for audio functions and low lane for the others.
+ *
+ * @param   rpmsg: rpmsg instance.
+ * @param   func_id: request function ID.
+ * @param   param: all parameters.
+ * @param   ret: return value.
+ *
+ * @return  the function is handled by the other side normally or note
+ */
+uint32_t rpmsg_sync_invoke(struct rpmsg_lite_instance *rpmsg, uint32_t func_id, void *param, uint32_t *ret)
+{
+    struct rpmsg_invoke *invoke;
+    uint32_t status;
+    uint8_t lane;
+
+    if (rpmsg == NULL) {
+        return -1;
+    }
+
+    /* audio functions are in real-time path, let them overtake the others */
+    if (RPSMG_SYNC_FUNC_TYPE(func_id) == RPMSG_SYNC_FUNC_TYPE_AUDIO) {
+        lane = RPMSG_INVOKE_LANE_HIGH;
+    }
+    else {
+        lane = RPMSG_INVOKE_LANE_LOW;
+    }
+
+//    fputc('S', NULL);
+    invoke = rpmsg_invoke_async(rpmsg, lane, func_id, param, NULL, NULL);
+    if (invoke == NULL) {
+        return -1;
+    }
+    status = rpmsg_invoke_wait(invoke, 1000, ret);
+    assert(RPMSG_INVOKE_STATUS_TIMEOUT != status);
+//    fputc('s', NULL);
 
-    system_prevent_sleep_clear(SYSTEM_PREVENT_SLEEP_TYPE_DSP);
-    env_unlock_mutex(ept_sync_lock);
-    
-    rpmsg_lite_release_rx_buffer(rpmsg, msg);
-    
     return status;
 }
 
@@ -141,6 +415,36 @@ uint32_t rpmsg_send_sync_ret(struct rpmsg_lite_instance *rpmsg, uint32_t status,
     return 0;
 }
 
+/************************************************************************************
+ * @fn      rpmsg_send_sync_ret_id
+ *
+ * @brief   Send response tagged with request ID to the other side after execute
+ *          synchronous invocation, requests can be handled out of order with this function.
+ *
+ * @param   rpmsg: rpmsg instance.
+ * @param   req_id: request ID carried in msg->p.sync_func.req_id of the invocation.
+ * @param   status: handle the invocation normally or not.
+ * @param   ret: return value of request function.
+ *
+ * @return  The message is sent to the other side successfully or not
+ */
+uint32_t rpmsg_send_sync_ret_id(struct rpmsg_lite_instance *rpmsg, uint32_t req_id, uint32_t status, uint32_t ret)
+{
+    struct rpmsg_msg_t *msg;
+    uint32_t msg_len;
+
+    msg = rpmsg_lite_alloc_tx_buffer(rpmsg, &msg_len, RL_BLOCK);
+
+    msg->msg_type = RPMSG_MSG_TYPE_SYNC_RETURN_ID;
+    msg->p.sync_ret.status = status;
+    msg->p.sync_ret.result = ret;
+    msg->p.sync_ret.req_id = req_id;
+
+    rpmsg_lite_send_nocopy(rpmsg, ept_sync, EPT_ADDR_SYNC, msg, msg_len);
+
+    return 0;
+}
+
 /************************************************************************************
  * @fn      rpmsg_master_init
  *
@@ -161,10 +465,10 @@ struct rpmsg_lite_instance *rpmsg_master_init(void (*recv)(struct rpmsg_lite_ins
 
     queue_sync  = rpmsg_queue_create(my_rpmsg);
     queue_async = rpmsg_queue_create(my_rpmsg);
-    ept_sync  = rpmsg_lite_create_ept(my_rpmsg, EPT_ADDR_SYNC, rpmsg_queue_rx_cb, queue_sync);
+    ept_sync  = rpmsg_lite_create_ept(my_rpmsg, EPT_ADDR_SYNC, rpmsg_sync_rx_cb, queue_sync);
     ept_async = rpmsg_lite_create_ept(my_rpmsg, EPT_ADDR_ASYNC, rpmsg_queue_rx_cb, queue_async);
 
-    env_create_mutex((void **)&ept_sync_lock, 1);
+    rpmsg_invoke_pool_init();
 
     msg_callback = recv;
     master_rpmsg = my_rpmsg;
@@ -220,10 +524,10 @@ struct rpmsg_lite_instance *rpmsg_remote_init(void (*recv)(struct rpmsg_lite_ins
 
     queue_sync  = rpmsg_queue_create(my_rpmsg);
     queue_async = rpmsg_queue_create(my_rpmsg);
-    ept_sync  = rpmsg_lite_create_ept(my_rpmsg, EPT_ADDR_SYNC, rpmsg_queue_rx_cb, queue_sync);
+    ept_sync  = rpmsg_lite_create_ept(my_rpmsg, EPT_ADDR_SYNC, rpmsg_sync_rx_cb, queue_sync);
     ept_async = rpmsg_lite_create_ept(my_rpmsg, EPT_ADDR_ASYNC, rpmsg_queue_rx_cb, queue_async);
     
-    env_create_mutex((void **)&ept_sync_lock, 1);
+    rpmsg_invoke_pool_init();
     
     msg_callback = recv;
     remote_rpmsg = my_rpmsg;
@@ -254,13 +558,14 @@ void rpmsg_wait_master_ready(struct rpmsg_lite_instance *rpmsg)
 /************************************************************************************
  * @fn      rpmsg_destroy
  *
- * @brief   destroy an initialized rpmsg-lite instance.
+ * @brief   destroy an initialized rpmsg-lite instance. Pending invocations are waited
+ *          for, invocations started after this call are refused.
  *
  * @param   rpmsg: rpmsg-lite instance.
  */
 void rpmsg_destroy(struct rpmsg_lite_instance *rpmsg)
 {
-    env_lock_mutex(ept_sync_lock);
+    rpmsg_invoke_pool_drain();
 
     (void)rpmsg_lite_destroy_ept(rpmsg, ept_sync);
     ept_sync = ((void *)0);
@@ -280,10 +585,7 @@ void rpmsg_destroy(struct rpmsg_lite_instance *rpmsg)
         master_rpmsg = NULL;
     }
 
-    env_unlock_mutex(ept_sync_lock);
-    
-    env_delete_mutex(ept_sync_lock);
-    ept_sync_lock = ((void *)0);
+    rpmsg_invoke_pool_deinit();
 }
 
 /************************************************************************************
@@ -306,6 +608,52 @@ uint32_t rpmsg_recv_msg(struct rpmsg_lite_instance *rpmsg, struct rpmsg_msg_t **
     return src_addr;
 }
 
+/************************************************************************************
+ * @fn      rpmsg_recv_msg_prio
+ *
+ * @brief   Same as rpmsg_recv_msg, but invocations in high lane are returned before
+ *          other messages which have been received.
+ *
+ * @param   rpmsg: rpmsg-lite instance.
+ * @param   msg: data storage address
+ * @param   msg_len: message length
+ *
+ * @return  the endpoint address used by the other side to send this message
+ */
+uint32_t rpmsg_recv_msg_prio(struct rpmsg_lite_instance *rpmsg, struct rpmsg_msg_t **msg, uint32_t *msg_len)
+{
+    uint32_t src_addr;
+    uint8_t index = 0;
+
+    /* collect all received messages, only block when nothing is available */
+    while (recv_stash_cnt < RL_BUFFER_COUNT) {
+        if (rpmsg_queue_recv_nocopy(rpmsg, queue_async, &recv_stash[recv_stash_cnt].src_addr,
+                                    (char **)&recv_stash[recv_stash_cnt].msg, &recv_stash[recv_stash_cnt].msg_len,
+                                    recv_stash_cnt ? 0 : RL_BLOCK) != RL_SUCCESS) {
+            break;
+        }
+        recv_stash_cnt++;
+    }
+
+    for (uint8_t i=0; i<recv_stash_cnt; i++) {
+        if ((recv_stash[i].msg->msg_type == RPMSG_MSG_TYPE_SYNC_INVOKE)
+            && (recv_stash[i].msg->p.sync_func.lane == RPMSG_INVOKE_LANE_HIGH)) {
+            index = i;
+            break;
+        }
+    }
+
+    *msg = recv_stash[index].msg;
+    *msg_len = recv_stash[index].msg_len;
+    src_addr = recv_stash[index].src_addr;
+    recv_stash_cnt--;
+    for (uint8_t i=index; i<recv_stash_cnt; i++) {
+        recv_stash[i] = recv_stash[i+1];
+    }
+
+    return src_addr;
+}
+
 /************************************************************************************
  * @fn      rpmsg_get_remote_instance
  *
@@ -334,7 +682,7 @@ static int32_t rpmsg_queue_rx_tmp(void *payload, uint32_t payload_len, uint32_t
 {
     struct rpmsg_msg_t *msg = payload;
     if ((src == EPT_ADDR_SYNC) && (msg->msg_type == RPMSG_MSG_TYPE_MASTER_READY)) {
-        ept_sync->rx_cb = rpmsg_queue_rx_cb;
+        ept_sync->rx_cb = rpmsg_sync_rx_cb;
         rpmsg_lite_release_rx_buffer_dur_recover(rpmsg_get_remote_instance(), msg);
     }
     return 0;
@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+#
+# Timing model of the erase/program engine in driver_flash.c (flash_op_process),
+# used to check its scheduling against NOR flash timings and interrupt loads
+# without hardware.
+#
+#   flash_engine_model.py --sectors 16 --irq-period 625 --irq-jitter 300
+#   flash_engine_model.py --sweep-min-run 0,100,200,400,800
+#
+# The model follows the engine: status is polled every POLL_US, a pending
+# interrupt stops the engine between commands, or suspends a command which has
+# run for at least MIN_RUN_US. Interrupts are served while the flash is idle or
+# suspended, then the caller calls flash_op_process again, which resumes the
+# flash. "--blocking" models the old driver, which masked interrupts for the
+# whole operation.
+#
+import argparse
+import random
+import sys
+
+
+class Nor(object):
+    """NOR flash executing one erase or program command"""
+
+    def __init__(self, args, rng):
+        self.args = args
+        self.rng = rng
+        self.left = 0.0
+        self.suspends = 0
+
+    def start(self, kind):
+        if kind == "erase":
+            base = self.args.erase_us
+        else:
+            base = self.args.program_us
+        self.left = base * self.rng.uniform(1.0 - self.args.spread, 1.0 + self.args.spread)
+
+    def run(self, us):
+        """run for us microseconds, return True when the command is finished"""
+        self.left -= us
+        return self.left <= 0
+
+    def suspend(self):
+        self.suspends += 1
+        # some parts redo part of the work after a resume
+        self.left += self.args.suspend_penalty_us
+        return self.args.t_sus_us
+
+
+class Irqs(object):
+    """interrupt arrivals, served in order when the CPU can take them"""
+
+    def __init__(self, args, rng):
+        self.args = args
+        self.rng = rng
+        self.next = self._gap()
+        self.pending = []
+        self.latency = []
+
+    def _gap(self):
+        jitter = self.rng.uniform(-self.args.irq_jitter, self.args.irq_jitter)
+        return max(1.0, self.args.irq_period + jitter)
+
+    def advance(self, now):
+        while self.next <= now:
+            self.pending.append(self.next)
+            self.next += self._gap()
+
+    def is_pending(self, now):
+        self.advance(now)
+        return len(self.pending) > 0
+
+    def serve(self, now):
+        """serve pending interrupts, return the time when the CPU is free again"""
+        self.advance(now)
+        while self.pending:
+            arrival = self.pending.pop(0)
+            self.latency.append(now - arrival)
+            now += self.args.isr_us
+            self.advance(now)
+        return now
+
+
+def simulate(args, min_run_us, seed):
+    rng = random.Random(seed)
+    nor = Nor(args, rng)
+    irqs = Irqs(args, rng)
+    commands = ["erase"] * args.sectors + ["program"] * args.pages
+    now = 0.0
+    index = 0
+    in_flight = False
+    suspended = False
+    min_run_polls = max(1, int(min_run_us // args.poll_us)) if min_run_us else 0
+
+    starved = False
+    while index < len(commands) or in_flight:
+        if now > args.limit_ms * 1000.0:
+            # suspended too often to make progress
+            starved = True
+            break
+        if args.blocking:
+            # interrupts masked until everything is done
+            for kind in commands:
+                nor.start(kind)
+                while not nor.run(args.poll_us):
+                    now += args.poll_us
+                now += args.poll_us
+            index = len(commands)
+            in_flight = False
+            break
+
+        # flash_op_process: resume, finish the command in flight, issue next ones
+        if suspended:
+            now += args.cmd_us
+            suspended = False
+        yielded = False
+        progressed = False
+        while True:
+            if in_flight:
+                polls = 0
+                while True:
+                    now += args.poll_us
+                    if nor.run(args.poll_us):
+                        in_flight = False
+                        progressed = True
+                        break
+                    polls += 1
+                    if polls >= min_run_polls and irqs.is_pending(now):
+                        now += nor.suspend()
+                        suspended = True
+                        break
+                if suspended:
+                    yielded = True
+                    break
+            if index >= len(commands):
+                break
+            # at least one command is finished or issued in each call
+            if progressed and irqs.is_pending(now):
+                yielded = True
+                break
+            nor.start(commands[index])
+            now += args.cmd_us
+            index += 1
+            in_flight = True
+            progressed = True
+        # GLOBAL_INT_RESTORE, pending interrupts are served
+        if yielded or irqs.is_pending(now):
+            now = irqs.serve(now)
+
+    now = irqs.serve(now)
+    lat = sorted(irqs.latency) or [0.0]
+    return {
+        "starved": starved,
+        "total_ms": now / 1000.0,
+        "suspends": nor.suspends,
+        "irqs": len(irqs.latency),
+        "lat_mean": sum(lat) / len(lat),
+        "lat_p99": lat[min(len(lat) - 1, int(len(lat) * 0.99))],
+        "lat_max": lat[-1],
+    }
+
+
+def report(name, result):
+    if result["starved"]:
+        print("%-14s starved, not finished in %.1f ms, %d suspends" % (name, result["total_ms"], result["suspends"]))
+        return
+    print("%-14s total %9.1f ms  suspends %6d  irqs %6d  latency us: mean %8.1f  p99 %8.1f  max %9.1f" % (
+        name, result["total_ms"], result["suspends"], result["irqs"],
+        result["lat_mean"], result["lat_p99"], result["lat_max"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="timing model of the flash erase/program engine")
+    parser.add_argument("--sectors", type=int, default=16, help="4KB sectors to erase")
+    parser.add_argument("--pages", type=int, default=0, help="256B pages to program")
+    parser.add_argument("--erase-us", type=float, default=45000, help="typical sector erase time")
+    parser.add_argument("--program-us", type=float, default=600, help="typical page program time")
+    parser.add_argument("--spread", type=float, default=0.3, help="+/- spread of erase and program time")
+    parser.add_argument("--t-sus-us", type=float, default=30, help="suspend latency")
+    parser.add_argument("--suspend-penalty-us", type=float, default=0, help="work redone after each resume")
+    parser.add_argument("--cmd-us", type=float, default=2, help="time to send a command")
+    parser.add_argument("--poll-us", type=float, default=20, help="FLASH_ENGINE_POLL_US")
+    parser.add_argument("--min-run-us", type=float, default=400, help="FLASH_ENGINE_MIN_RUN_US")
+    parser.add_argument("--irq-period", type=float, default=625, help="mean interval of interrupts")
+    parser.add_argument("--irq-jitter", type=float, default=300, help="+/- jitter of interrupt interval")
+    parser.add_argument("--isr-us", type=float, default=40, help="duration of each interrupt handler")
+    parser.add_argument("--blocking", action="store_true", help="model the old driver")
+    parser.add_argument("--sweep-min-run", help="comma separated FLASH_ENGINE_MIN_RUN_US values")
+    parser.add_argument("--limit-ms", type=float, default=60000, help="give up when the operation takes longer")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    if args.sweep_min_run:
+        for value in args.sweep_min_run.split(","):
+            report("min_run %s" % value, simulate(args, float(value), args.seed))
+    else:
+        report("blocking" if args.blocking else "engine", simulate(args, args.min_run_us, args.seed))
+        if not args.blocking:
+            args.blocking = True
+            report("blocking", simulate(args, args.min_run_us, args.seed))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
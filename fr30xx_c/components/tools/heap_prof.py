@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+#
+# Parse heap profiler snapshots sent by heap_prof_snapshot() and symbolize the
+# allocation sites with addr2line.
+#
+#   heap_prof.py -e app.elf capture.bin
+#   heap_prof.py -e app.elf -p COM3 -b 921600
+#
+# Capture can be a raw dump of UART, data before a snapshot is skipped. The last
+# complete snapshot in the capture is reported.
+#
+import argparse
+import struct
+import subprocess
+import sys
+import zlib
+
+MAGIC = 0x46525048
+VERSION = 1
+
+HEAP_NAMES = ["SRAM", "DRAM", "BTDM", "PSRAM"]
+ALGO_NAMES = ["list", "tlsf"]
+KIND_NAMES = ["heap", "slab"]
+
+HEADER_FMT = "<6I"
+HEAP_FMT = "<7I"
+SITE_FMT = "<7I"
+
+
+def parse(data, offset):
+    size = struct.calcsize(HEADER_FMT)
+    magic, version, types, sites, total, peak = struct.unpack_from(HEADER_FMT, data, offset)
+    if magic != MAGIC or version != VERSION:
+        return None
+    end = offset + size + types * struct.calcsize(HEAP_FMT) + sites * struct.calcsize(SITE_FMT)
+    if end + 4 > len(data):
+        return None
+    (crc,) = struct.unpack_from("<I", data, end)
+    if zlib.crc32(data[offset:end]) & 0xffffffff != crc:
+        return None
+
+    snapshot = {"total": total, "peak": peak, "heaps": [], "sites": []}
+    pos = offset + size
+    for i in range(types):
+        values = struct.unpack_from(HEAP_FMT, data, pos)
+        pos += struct.calcsize(HEAP_FMT)
+        keys = ("size", "used", "max_used", "algo", "total_free", "largest_free", "free_blocks")
+        heap = dict(zip(keys, values))
+        heap["name"] = HEAP_NAMES[i] if i < len(HEAP_NAMES) else str(i)
+        snapshot["heaps"].append(heap)
+    for i in range(sites):
+        values = struct.unpack_from(SITE_FMT, data, pos)
+        pos += struct.calcsize(SITE_FMT)
+        keys = ("addr", "kind", "bytes", "count", "allocs", "peak_bytes", "at_peak_bytes")
+        site = dict(zip(keys, values))
+        if site["addr"] != 0 or site["allocs"] != 0:
+            snapshot["sites"].append(site)
+    return snapshot
+
+
+def find_last(data):
+    result = None
+    offset = data.find(struct.pack("<I", MAGIC))
+    while offset >= 0:
+        snapshot = parse(data, offset)
+        if snapshot is not None:
+            result = snapshot
+        offset = data.find(struct.pack("<I", MAGIC), offset + 1)
+    return result
+
+
+def symbolize(addrs, elf, tool):
+    names = {0: "<dropped, site table is full>"}
+    query = [a for a in addrs if a != 0]
+    if elf is None or not query:
+        for a in query:
+            names[a] = "0x%08x" % a
+        return names
+    # return address points after the BL instruction in thumb mode
+    args = [tool, "-f", "-s", "-C", "-e", elf] + ["0x%x" % ((a & ~1) - 2) for a in query]
+    try:
+        lines = subprocess.check_output(args, universal_newlines=True).splitlines()
+    except (OSError, subprocess.CalledProcessError) as err:
+        sys.stderr.write("addr2line failed: %s\n" % err)
+        lines = []
+    for i, a in enumerate(query):
+        if 2 * i + 1 < len(lines):
+            names[a] = "%s (%s)" % (lines[2 * i], lines[2 * i + 1])
+        else:
+            names[a] = "0x%08x" % a
+    return names
+
+
+def report(snapshot, names, top):
+    print("heap   algo       size       used   max used   free  largest  blocks  frag")
+    for heap in snapshot["heaps"]:
+        if heap["size"] == 0:
+            continue
+        frag = 0.0
+        if heap["total_free"]:
+            frag = 100.0 * (1 - float(heap["largest_free"]) / heap["total_free"])
+        print("%-6s %-4s %10d %10d %10d %6d %8d %7d %4.1f%%" % (
+            heap["name"], ALGO_NAMES[heap["algo"]] if heap["algo"] < len(ALGO_NAMES) else "?",
+            heap["size"], heap["used"], heap["max_used"], heap["total_free"],
+            heap["largest_free"], heap["free_blocks"], frag))
+
+    print("")
+    print("profiled heap bytes: %d now, %d at peak" % (snapshot["total"], snapshot["peak"]))
+    print("slab sites are objects inside slab pages, pages are counted by the slab heap site")
+
+    for title, key in (("live", "bytes"), ("at peak", "at_peak_bytes")):
+        print("")
+        print("top sites by %s bytes:" % title)
+        print("kind      bytes  count   allocs  site peak  site")
+        sites = sorted(snapshot["sites"], key=lambda s: s[key], reverse=True)
+        for site in sites[:top]:
+            if site[key] == 0:
+                break
+            print("%-4s %10d %6d %8d %10d  %s" % (
+                KIND_NAMES[site["kind"]] if site["kind"] < len(KIND_NAMES) else "?",
+                site[key], site["count"], site["allocs"], site["peak_bytes"], names[site["addr"]]))
+
+
+def read_serial(port, baud, timeout):
+    import serial
+    data = b""
+    with serial.Serial(port, baud, timeout=timeout) as ser:
+        while True:
+            chunk = ser.read(4096)
+            if not chunk:
+                break
+            data += chunk
+            if find_last(data) is not None:
+                break
+    return data
+
+
+def main():
+    parser = argparse.ArgumentParser(description="heap profiler snapshot viewer")
+    parser.add_argument("capture", nargs="?", help="file with captured UART data")
+    parser.add_argument("-e", "--elf", help="ELF file used to symbolize allocation sites")
+    parser.add_argument("-p", "--port", help="read snapshot from serial port, pyserial is needed")
+    parser.add_argument("-b", "--baud", type=int, default=115200)
+    parser.add_argument("-t", "--timeout", type=float, default=2.0, help="seconds without data to stop reading")
+    parser.add_argument("--addr2line", default="arm-none-eabi-addr2line")
+    parser.add_argument("-n", "--top", type=int, default=20)
+    args = parser.parse_args()
+
+    if args.port:
+        data = read_serial(args.port, args.baud, args.timeout)
+    elif args.capture:
+        with open(args.capture, "rb") as f:
+            data = f.read()
+    else:
+        parser.error("capture file or serial port is needed")
+
+    snapshot = find_last(data)
+    if snapshot is None:
+        sys.exit("no valid snapshot found")
+
+    names = symbolize(sorted(set(s["addr"] for s in snapshot["sites"])), args.elf, args.addr2line)
+    report(snapshot, names, args.top)
+
+
+if __name__ == "__main__":
+    main()
@@ -4,6 +4,7 @@
 
 #include "fr30xx.h"
 #include "heap.h"
+#include "heap_slab.h"
 
 #define configTOTAL_BTDM_HEAP_SIZE  ( ( 30 * 1024 ) )
 
@@ -18,12 +19,12 @@ void * btdm_malloc( size_t xWantedSize )
         heap_mem_init(HEAP_TYPE_BTDM_BLOCK, (void *)ucHeap, configTOTAL_BTDM_HEAP_SIZE);
     }
     
-    return heap_mem_alloc(HEAP_TYPE_BTDM_BLOCK, xWantedSize);
+    return heap_slab_alloc(HEAP_TYPE_BTDM_BLOCK, xWantedSize);
 }
 
 void btdm_free( void * pv )
 {
-    heap_mem_free(pv);
+    heap_slab_free(pv);
 }
 
 __RAM_CODE void *btdm_calloc(unsigned int count, unsigned int size)
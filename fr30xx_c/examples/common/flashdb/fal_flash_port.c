@@ -20,6 +20,10 @@ static int read(long offset, uint8_t *buf, size_t size);
 static int write(long offset, uint8_t *buf, size_t size);
 static int erase(long offset, size_t size);
 
+/* protection window kept open between fal_flash_session_begin and fal_flash_session_end */
+static struct flash_session_t session;
+static bool session_enabled = false;
+
 //static sfud_flash_t sfud_dev = NULL;
 const struct fal_flash_dev onchip_flash =
 {
@@ -36,6 +40,45 @@ static int init(void)
     return 0;
 }
 
+/* window of the session only covers partitions of FlashDB, not the whole flash */
+static void session_prepare(void)
+{
+    const struct fal_partition *table;
+    size_t count, i;
+    uint32_t start = 0xffffffff, end = 0;
+
+    if ((session_enabled == false) || session.opened) {
+        return;
+    }
+
+    table = fal_get_partition_table(&count);
+    for (i = 0; i < count; i++) {
+        if (strncmp(table[i].flash_name, onchip_flash.name, FAL_DEV_NAME_MAX) == 0) {
+            if (table[i].offset < start) {
+                start = table[i].offset;
+            }
+            if (table[i].offset + table[i].len > end) {
+                end = table[i].offset + table[i].len;
+            }
+        }
+    }
+
+    if (start < end) {
+        flash_session_open(&session, QSPI0, onchip_flash.addr + start, end - start);
+    }
+}
+
+void fal_flash_session_begin(void)
+{
+    session_enabled = true;
+}
+
+void fal_flash_session_end(void)
+{
+    session_enabled = false;
+    flash_session_close(&session);
+}
+
 static int read(long offset, uint8_t *buf, size_t size)
 {
     flash_read(QSPI0, offset, size, buf);
@@ -46,22 +89,40 @@ static int read(long offset, uint8_t *buf, size_t size)
 static int write(long offset, uint8_t *buf, size_t size)
 {
     uint8_t *temp_ptr =  NULL;
+    uint8_t result;
 
+    session_prepare();
     if(((uint32_t )buf & 0xff000000) == FLASH_DAC_BASE) {
         temp_ptr = pvPortMalloc(size);
         memcpy(temp_ptr,buf,size);
-        flash_write(QSPI0, offset, size, temp_ptr);
+        buf = temp_ptr;
+    }
+
+    if (session.opened) {
+        result = flash_session_write(&session, offset, size, buf);
+    }
+    else {
+        result = flash_write(QSPI0, offset, size, buf);
+    }
+
+    if (temp_ptr) {
         vPortFree(temp_ptr);
     }
-    else
-        flash_write(QSPI0, offset, size, buf);
 
-    return size;
+    return (result == 0) ? (int)size : -1;
 }
 
 static int erase(long offset, size_t size)
 {
-    flash_erase(QSPI0, offset,size);
+    uint8_t result;
+
+    session_prepare();
+    if (session.opened) {
+        result = flash_session_erase(&session, offset, size);
+    }
+    else {
+        result = flash_erase(QSPI0, offset,size);
+    }
 	
-    return size;
+    return (result == 0) ? (int)size : -1;
 }
@@ -2,6 +2,7 @@
 
 #include "fr30xx.h"
 #include "flashdb.h"
+#include "fdb_app.h"
 
 /* KVDB object */
 static struct fdb_kvdb kvdb={0};
@@ -18,10 +19,15 @@ static void lock(fdb_db_t db)
 
     cpu_sr = CPU_SR_Save(0x20);
     cpu_sr |= 0xff00;
+
+    /* writes and erases of one KV operation share a protection window */
+    fal_flash_session_begin();
 }
 
 static void unlock(fdb_db_t db)
 {
+    fal_flash_session_end();
+
     cpu_sr &= 0xff;
     CPU_SR_Restore(cpu_sr);
 }
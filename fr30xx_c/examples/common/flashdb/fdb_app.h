@@ -22,5 +22,10 @@ size_t flashdb_get_length(uint32_t key);
 
 fdb_err_t flashdb_del(uint32_t key);
 
+/* keep the flash unprotected from the first write or erase until session end, implemented in fal_flash_port.c */
+void fal_flash_session_begin(void);
+
+void fal_flash_session_end(void);
+
 #endif
 
@@ -204,7 +204,6 @@ extern uint8_t ota_svc_id;
  * LOCAL FUNCTIONS (غ)
  */
 __RAM_CODE static uint8_t app_otas_crc_cal(uint32_t firmware_length,uint32_t new_bin_addr,uint32_t crc_data_t);
-uLong ZEXPORT crc32(uLong crc, const Bytef *buf, uInt len);
 uint32_t get_boot_crc(uint32_t imagesize,uint32_t length);
 /******************************************************************************
  * EXTERN FUNCTIONS (ⲿ)
@@ -520,6 +519,7 @@ void app_otas_recv_data(uint8_t conidx,uint8_t *p_data,uint16_t len)
     vPortFree(req);
 }
 
+/* checksum of firmware defined by OTA peer, it is not the CRC-32 calculated by crc32 module */
 static uint32_t Crc32CalByByte(int crc,uint8_t* ptr, int len)
 {
     int i = 0;
@@ -562,20 +562,22 @@ __RAM_CODE static uint8_t app_otas_crc_cal(uint32_t firmware_length,uint32_t new
 
 uint32_t get_boot_crc(uint32_t imagesize,uint32_t length)
 {
-    uint32_t crc_data = 0,i = 0;
+    uint32_t crc_data;
+    crc32_ctx_t ctx;
     uint8_t * crc_check_data = pvPortMalloc(0x1000);
-    uint8_t ret = 0;
     uint32_t data_size = length;
     uint32_t read_address = imagesize;
+    crc32_init(&ctx);
     while(data_size > 0x1000)
     {
         flash_read(QSPI0,read_address, 0x1000,crc_check_data);
-        crc_data = crc32(crc_data, crc_check_data,0x1000);
+        crc32_update(&ctx, crc_check_data,0x1000);
         data_size -= 0x1000;
         read_address += 0x1000;
     }
     flash_read(QSPI0,read_address, data_size,crc_check_data);
-    crc_data = crc32(crc_data, crc_check_data,data_size);
+    crc32_update(&ctx, crc_check_data,data_size);
+    crc_data = crc32_final(&ctx);
     printf("file crc:%x\r\n",crc_data);
     vPortFree(crc_check_data);
     return crc_data;